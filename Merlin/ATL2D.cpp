@@ -28,7 +28,7 @@ inline void ResetSupport(AcceleratorSupport* s)
 struct ApplyATL
 {
 
-	ApplyATL(RealVector& gmy, double vibv, std::mt19937_64* rg, ATL2D::ATLMode theMode) :
+	ApplyATL(RealVector& gmy, double vibv, PhiloxEngine* rg, ATL2D::ATLMode theMode) :
 		n(0), yy(gmy), vv(vibv), rng(rg), atlMode(theMode)
 	{
 	}
@@ -53,7 +53,7 @@ struct ApplyATL
 	int n;
 	RealVector yy;
 	double vv;
-	std::mt19937_64* rng;
+	PhiloxEngine* rng;
 	ATL2D::ATLMode atlMode;
 
 };
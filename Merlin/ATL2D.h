@@ -12,6 +12,7 @@
 #include <iostream>
 #include "AcceleratorSupport.h"
 #include "LinearAlgebra.h"
+#include "PhiloxEngine.h"
 
 /**
  *
@@ -109,7 +110,7 @@ private:
 	double vv;
 
 	AcceleratorSupportList theSupports;
-	std::mt19937_64* rg;
+	PhiloxEngine* rg;
 
 	RealMatrix evecsT;
 	RealVector evals;
@@ -253,6 +253,7 @@ inline Aperture* AcceleratorComponent::GetAperture() const
 inline void AcceleratorComponent::SetAperture(Aperture* ap)
 {
 	itsAperture = ap;
+	ModelChanged();
 }
 
 inline WakePotentials* AcceleratorComponent::GetWakePotentials() const
@@ -29,6 +29,18 @@ ApertureAbstract::~ApertureAbstract()
 
 }
 
+size_t ApertureAbstract::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		inside[i] = CheckWithinApertureBoundaries(x[i], y[i], z);
+		count += inside[i];
+	}
+	return count;
+}
+
 Aperture::Aperture()
 {
 
@@ -77,6 +89,20 @@ inline bool CircularAperture::CheckWithinApertureBoundaries(double x, double y,
 		return true;
 }
 
+size_t CircularAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < minEllipDim) | !(x[i] * x[i] + y[i] * y[i] >= ellipHalfWidth2);
+		count += inside[i];
+	}
+	return count;
+}
+
 RectangularAperture::RectangularAperture(double aper1, double aper2)
 {
 	setRectHalfWidth(aper1);
@@ -115,6 +141,20 @@ inline bool RectangularAperture::CheckWithinApertureBoundaries(double x, double
 		return true;
 }
 
+size_t RectangularAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < minRectDim) | !((ax >= rectHalfWidth) | (ay >= rectHalfHeight));
+		count += inside[i];
+	}
+	return count;
+}
+
 EllipticalAperture::EllipticalAperture(double aper3, double aper4)
 {
 	setEllipHalfWidth(aper3);
@@ -151,6 +191,21 @@ inline bool EllipticalAperture::CheckWithinApertureBoundaries(double x, double y
 		return true;
 }
 
+size_t EllipticalAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < minEllipDim) | !((x[i] * x[i] + y[i] * y[i] * ellipHalfWidth2overEllipHalfHeight2)
+			>= ellipHalfWidth2);
+		count += inside[i];
+	}
+	return count;
+}
+
 RectEllipseAperture::RectEllipseAperture()
 {
 
@@ -198,6 +253,21 @@ inline bool RectEllipseAperture::CheckWithinApertureBoundaries(double x, double
 		return true;
 }
 
+size_t RectEllipseAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < minDim) | !(((x[i] * x[i] + y[i] * y[i] * ellipHalfWidth2overEllipHalfHeight2)
+			>= ellipHalfWidth2) | (ax >= rectHalfWidth) | (ay >= rectHalfHeight));
+		count += inside[i];
+	}
+	return count;
+}
+
 OctagonalAperture::OctagonalAperture()
 {
 
@@ -237,6 +307,21 @@ inline bool OctagonalAperture::CheckWithinApertureBoundaries(double x, double y,
 		return true;
 }
 
+size_t OctagonalAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < minRectDim) | !((ax >= rectHalfWidth) | (ay >= rectHalfHeight)
+			| (const1 * (y[i] - const2) - const3 * (x[i] - rectHalfWidth) <= 0));
+		count += inside[i];
+	}
+	return count;
+}
+
 Aperture* ApertureFactory::getInstance(string type, double s, double aper1, double aper2, double aper3, double aper4)
 {
 	map<string, getAperture>::iterator itr = apertureTypes.find(type);
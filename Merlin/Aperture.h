@@ -42,6 +42,24 @@ public:
 	 */
 	virtual bool CheckWithinApertureBoundaries(double x, double y, double z) const = 0;
 
+	/**
+	 *	Batched CheckWithinApertureBoundaries for n particles at the same z.
+	 *	The default calls CheckWithinApertureBoundaries for each particle;
+	 *	apertures override it with a branch-free loop the compiler can
+	 *	vectorise. A class that overrides CheckWithinApertureBoundaries
+	 *	must override this too, or call the ApertureAbstract version.
+	 *	An override must agree with CheckWithinApertureBoundaries for every
+	 *	input, including NaN coordinates, which NANCheckProcess removes later.
+	 *  @param[in] x the x coordinates of the particles
+	 *  @param[in] y the y coordinates of the particles
+	 *  @param[in] z the z location coordinate of the particles
+	 *  @param[in] n the number of particles
+	 *  @param[out] inside set to 1 for each particle within the boundaries, 0 otherwise
+	 *  @return the number of particles within the boundaries
+	 */
+	virtual size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+		char* inside) const;
+
 	/**
 	 *	Pure virtual function/interface for getting particle type
 	 *	@return string of aperture typename
@@ -294,6 +312,11 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  CircularAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new CircularAperture instance - only called by ApertureFactory::getInstance class
 	 *  @return constructed Aperture pointer of assigned type CircularAperture
@@ -328,6 +351,11 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  RectangularAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new RectangularAperture instance - only called by ApertureFactory::getInstance class
 	 *  @return constructed Aperture pointer of assigned type RectangularAperture
@@ -364,6 +392,11 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  EllipticalAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new EllipticalAperture instance - only called by ApertureFactory::getInstance class
 	 *  @return constructed Aperture pointer of assigned type EllipticalAperture
@@ -404,6 +437,11 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  RectEllipseAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new RectEllipseAperture instance - only called by ApertureFactory::getInstance class
 	 *  @return constructed Aperture pointer of assigned type RectEllipseAperture
@@ -443,6 +481,11 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  OctagonalAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new OctagonalAperture instance - only called by ApertureFactory::getInstance class
 	 *  @return constructed Aperture pointer of assigned type OctagonalAperture
@@ -0,0 +1,203 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "AsyncOutputWriter.h"
+#include "MerlinException.h"
+
+namespace
+{
+
+const char magic[8] = "MRLNREC";
+const size_t nameLength = 16;
+
+struct Header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t width;
+};
+
+} // end anonymous namespace
+
+AsyncOutputWriter::AsyncOutputWriter(const std::string& filename, const std::vector<std::string>& columns,
+	Formatter f, size_t nrec, size_t nblocks) :
+	width(columns.size()), blockRecords(std::max<size_t>(nrec, 1)), format(f),
+	out(filename.c_str(), std::ios::binary), blocks(std::max<size_t>(nblocks, 2)), counts(blocks.size(), 0),
+	head(0), fill(0), tail(0), pending(0), stop(false), failed(false)
+{
+	if(!out)
+	{
+		throw MerlinException("AsyncOutputWriter: cannot open " + filename);
+	}
+
+	if(format)
+	{
+		out << "#";
+		for(size_t k = 0; k < width; k++)
+		{
+			out << (k ? " " : "") << columns[k];
+		}
+		out << std::endl;
+	}
+	else
+	{
+		Header header;
+		memcpy(header.magic, magic, sizeof(magic));
+		header.version = version;
+		header.width = width;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for(const std::string& c : columns)
+		{
+			char name[nameLength] = {};
+			memcpy(name, c.data(), std::min(c.size(), nameLength));
+			out.write(name, nameLength);
+		}
+	}
+
+	for(auto& b : blocks)
+	{
+		b.resize(width * blockRecords);
+	}
+	writer = std::thread(&AsyncOutputWriter::Run, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter()
+{
+	if(fill > 0)
+	{
+		Submit();
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+	}
+	submitted.notify_one();
+	writer.join();
+	out.close();
+}
+
+void AsyncOutputWriter::Submit()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	counts[head] = fill;
+	pending++;
+	submitted.notify_one();
+
+	head = (head + 1) % blocks.size();
+	fill = 0;
+	written.wait(guard, [this]
+	{
+		return pending < blocks.size();
+	});
+}
+
+void AsyncOutputWriter::WaitForWriter()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	written.wait(guard, [this]
+	{
+		return pending == 0;
+	});
+}
+
+void AsyncOutputWriter::Flush()
+{
+	if(fill > 0)
+	{
+		Submit();
+	}
+	WaitForWriter();
+
+	// the writer is idle until the next block is submitted
+	out.flush();
+	if(failed || !out)
+	{
+		throw MerlinException("AsyncOutputWriter: error writing output");
+	}
+}
+
+void AsyncOutputWriter::Run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while(true)
+	{
+		submitted.wait(guard, [this]
+		{
+			return pending > 0 || stop;
+		});
+		if(pending == 0)
+		{
+			return;
+		}
+
+		const size_t b = tail;
+		guard.unlock();
+		WriteBlock(blocks[b].data(), counts[b]);
+		guard.lock();
+
+		failed = failed || !out;
+		tail = (tail + 1) % blocks.size();
+		pending--;
+		written.notify_all();
+	}
+}
+
+void AsyncOutputWriter::WriteBlock(const double* data, size_t n)
+{
+	if(format)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			format(out, data + i * width);
+		}
+	}
+	else
+	{
+		const std::uint64_t count = n;
+		out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		out.write(reinterpret_cast<const char*>(data), n * width * sizeof(double));
+	}
+}
+
+bool AsyncOutputWriter::ReadBinary(const std::string& filename, std::vector<std::string>& columns,
+	std::vector<double>& records)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	Header header;
+	if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, magic, sizeof(magic)) != 0
+		|| header.version != version)
+	{
+		return false;
+	}
+
+	columns.clear();
+	for(size_t k = 0; k < header.width; k++)
+	{
+		char name[nameLength + 1] = {};
+		if(!in.read(name, nameLength))
+		{
+			return false;
+		}
+		columns.push_back(name);
+	}
+
+	records.clear();
+	std::uint64_t count;
+	while(in.read(reinterpret_cast<char*>(&count), sizeof(count)))
+	{
+		const size_t n = count * header.width;
+		const size_t offset = records.size();
+		records.resize(offset + n);
+		if(!in.read(reinterpret_cast<char*>(records.data() + offset), n * sizeof(double)))
+		{
+			return false;
+		}
+	}
+	return in.eof();
+}
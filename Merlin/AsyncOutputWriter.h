@@ -0,0 +1,151 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef AsyncOutputWriter_h
+#define AsyncOutputWriter_h 1
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes fixed width records of doubles to a file from a background
+ * thread, so that the caller (typically a SimulationOutput recording
+ * every particle at every element) never waits on the disk.
+ *
+ * Records are copied into a ring of pre-allocated blocks. When a block
+ * is full it is handed to the writer thread and the caller carries on
+ * filling the next one; with the default of two blocks this is double
+ * buffering. The caller only waits if every block is still waiting to be
+ * written.
+ *
+ * Without a formatter the file is binary, in native byte order:
+ *
+ *	char[8]		magic "MRLNREC"
+ *	uint32		layout version
+ *	uint32		record width
+ *	char[16]	name of each column, nul padded
+ *
+ * followed by blocks, each a uint64 record count and then the records.
+ * ReadBinary() reads such a file back. With a formatter the file is text:
+ * a header line "#" followed by the column names, and then each record
+ * as written by the formatter on the writer thread.
+ */
+class AsyncOutputWriter
+{
+public:
+
+	/**
+	 * Writes one record as text, including any line end.
+	 */
+	typedef std::function<void (std::ostream&, const double*)> Formatter;
+
+	/**
+	 * Opens filename and starts the writer thread. Throws MerlinException
+	 * if the file cannot be opened.
+	 *
+	 * @param[in] filename The output file
+	 * @param[in] columns Name of each value in a record
+	 * @param[in] format Text formatter, or empty for binary output
+	 * @param[in] blockRecords Number of records in each block
+	 * @param[in] nblocks Number of blocks in the ring, at least 2
+	 */
+	AsyncOutputWriter(const std::string& filename, const std::vector<std::string>& columns,
+		Formatter format = Formatter(), size_t blockRecords = 16384, size_t nblocks = 2);
+
+	/**
+	 * Writes out any remaining records and stops the writer thread.
+	 */
+	~AsyncOutputWriter();
+
+	/**
+	 * Returns space for one record of Width() values, to be filled in
+	 * before the next call.
+	 */
+	double* Append()
+	{
+		if(fill == blockRecords)
+		{
+			Submit();
+		}
+		return blocks[head].data() + width * fill++;
+	}
+
+	size_t Width() const
+	{
+		return width;
+	}
+
+	/**
+	 * Waits until every record appended so far is written and flushed to
+	 * the file. Throws MerlinException if any write failed.
+	 */
+	void Flush();
+
+	/**
+	 * Reads a binary file written without a formatter, returning the
+	 * column names and all the records one after another.
+	 *
+	 * @retval true if the file is a valid record file
+	 */
+	static bool ReadBinary(const std::string& filename, std::vector<std::string>& columns,
+		std::vector<double>& records);
+
+	/**
+	 * Version of the binary layout.
+	 */
+	static const std::uint32_t version = 1;
+
+private:
+
+	const size_t width;
+	const size_t blockRecords;
+	Formatter format;
+	std::ofstream out;
+
+	std::vector<std::vector<double> > blocks;
+	std::vector<size_t> counts;
+
+	/**
+	 * Block being filled, and the number of records in it.
+	 */
+	size_t head;
+	size_t fill;
+
+	/**
+	 * Oldest block waiting to be written, and the number of blocks
+	 * waiting or being written. Shared with the writer thread.
+	 */
+	size_t tail;
+	size_t pending;
+	bool stop;
+	bool failed;
+
+	std::mutex lock;
+	std::condition_variable submitted;
+	std::condition_variable written;
+	std::thread writer;
+
+	/**
+	 * Hands the current block to the writer and moves to the next one,
+	 * waiting for it to be written if necessary.
+	 */
+	void Submit();
+	void WaitForWriter();
+	void Run();
+	void WriteBlock(const double* data, size_t n);
+
+	AsyncOutputWriter(const AsyncOutputWriter&) = delete;
+	AsyncOutputWriter& operator=(const AsyncOutputWriter&) = delete;
+};
+
+#endif
@@ -9,6 +9,7 @@
 #define BunchProcess_h 1
 
 #include "merlin_config.h"
+#include <cstddef>
 #include <string>
 
 class AcceleratorComponent;
@@ -79,6 +80,52 @@ public:
 	 */
 	virtual double GetMaxAllowedStepSize() const = 0;
 
+	/**
+	 *	Returns true if, for the current component, the process acts
+	 *	on each particle independently. The step may then be applied
+	 *	one tile of particles at a time by BeginTiles(), DoProcessTile()
+	 *	and EndTiles() instead of DoProcess() (see
+	 *	ProcessStepManager::SetTileSize()).
+	 */
+	virtual bool IsParticleLocal() const
+	{
+		return false;
+	}
+
+	/**
+	 *	Returns true if EndTiles() acts on the whole bunch, so that no
+	 *	later process may share the same pass over the tiles.
+	 */
+	virtual bool IsTileBarrier() const
+	{
+		return false;
+	}
+
+	/**
+	 *	Prepare the step ds, which will be applied in ntiles tiles.
+	 */
+	virtual void BeginTiles(double ds, size_t ntiles)
+	{
+	}
+
+	/**
+	 *	Apply the step ds to the particles [first, last), which form
+	 *	tile number tile. Particles which are removed are compacted, in
+	 *	order, to the front of the range and the new end is returned.
+	 *	Different tiles may be processed concurrently.
+	 */
+	virtual size_t DoProcessTile(double ds, size_t tile, size_t first, size_t last)
+	{
+		return last;
+	}
+
+	/**
+	 *	Complete the step ds once all the tiles have been processed.
+	 */
+	virtual void EndTiles(double ds)
+	{
+	}
+
 	/**
 	 *	Returns true if this process is active.
 	 *	@retval true If process is active
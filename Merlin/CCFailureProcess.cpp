@@ -810,8 +810,8 @@ double CCFailureProcess::CalcM_22(int start, int end, bool horizontal)
 
 pair<double, double> CCFailureProcess::CalcMu(int element)
 {
-	PhaseAdvance* PA = new PhaseAdvance(AccModelCC, TwissCC, EnergyCC);
-	pair<double, double> Mu = PA->CalcIntegerPart(element);
+	PhaseAdvance PA(AccModelCC, TwissCC, EnergyCC);
+	pair<double, double> Mu = PA.CalcIntegerPart(element);
 	return Mu;
 }
 
@@ -10,6 +10,9 @@
 #include "RingDeltaTProcess.h"
 #include "ClosedOrbit.h"
 #include "TLASimp.h"
+#include "CompiledLattice.h"
+#include "TPSA.h"
+#include "ParallelFor.h"
 
 #ifdef DEBUG_CLOSED_ORBIT
 #include "NANCheckProcess.h"
@@ -21,7 +24,7 @@ using namespace ParticleTracking;
 
 ClosedOrbit::ClosedOrbit(AcceleratorModel* aModel, double refMomentum) :
 	theModel(aModel), p0(refMomentum), transverseOnly(false), radiation(false), useFullAcc(false), delta(1.0e-9), tol(
-		1.0e-26), max_iter(20), bendscale(0), theTracker(new ParticleTracker)
+		1.0e-26), max_iter(20), bendscale(0), useTPSA(false), hasProcesses(false), theTracker(new ParticleTracker)
 {
 }
 
@@ -33,6 +36,7 @@ ClosedOrbit::~ClosedOrbit()
 void ClosedOrbit::AddProcess(ParticleBunchProcess* aProcess)
 {
 	theTracker->AddProcess(aProcess);
+	hasProcesses = true;
 }
 
 void ClosedOrbit::TransverseOnly(bool flag)
@@ -87,8 +91,104 @@ void ClosedOrbit::ScaleBendPathLength(double scale)
 	bendscale = scale;
 }
 
+void ClosedOrbit::UseTPSA(bool flag)
+{
+	useTPSA = flag;
+}
+
+bool ClosedOrbit::FindClosedOrbitTPSA(PSvector& particle, int ncpt)
+{
+	const int cpt = transverseOnly ? 4 : 6;
+
+	CompiledLattice lattice(theModel->GetRing(ncpt));
+
+	RealVector g(cpt);
+	RealMatrix dg(cpt);
+	w = 1.0;
+	iter = 1;
+
+	while((w > tol) && (iter < max_iter))
+	{
+		TPSA<1> x[6];
+		for(int k = 0; k < 6; k++)
+		{
+			x[k] = TPSA<1>::Variable(k, particle[k]);
+		}
+
+		// this can only fail on the first pass, before particle is changed
+		if(!lattice.TrackMap(x, p0, 1.0, bendscale))
+		{
+			return false;
+		}
+
+		for(int k = 0; k < cpt; k++)
+		{
+			for(int m = 0; m < cpt; m++)
+			{
+				dg(m, k) = x[m].Derivative(k);
+			}
+			dg(k, k) -= 1.;
+			g(k) = x[k].Value() - particle[k];
+		}
+
+		SVDMatrix<double> invdg(dg);
+		g = invdg(g);
+		for(int row = 0; row < cpt; row++)
+		{
+			particle[row] -= g(row);
+		}
+
+		w = g * g; // dot product!
+		iter++;
+	}
+	return true;
+}
+
+void ClosedOrbit::TrackColumns(const PSvectorArray& in, PSvectorArray& out, int ncpt, int nt)
+{
+	Parallel::ForThreadBlocks(in.size(), nt, 1, [&](int, size_t first, size_t last)
+	{
+		ParticleBunch bunch(p0, 1.0);
+		for(size_t i = first; i < last; i++)
+		{
+			bunch.push_back(in[i]);
+		}
+
+		ParticleTracker tracker(theModel->GetRing(ncpt), &bunch, false);
+		if(radiation)
+		{
+			SynchRadParticleProcess* srproc = new SynchRadParticleProcess(1);
+			if(radstepsize == 0)
+			{
+				srproc->SetNumComponentSteps(radnumsteps);
+			}
+			else
+			{
+				srproc->SetMaxComponentStepSize(radstepsize);
+			}
+			srproc->AdjustBunchReferenceEnergy(false);
+			tracker.AddProcess(srproc);
+		}
+		if(bendscale != 0)
+		{
+			RingDeltaTProcess* ringdt = new RingDeltaTProcess(2);
+			ringdt->SetBendScale(bendscale);
+			tracker.AddProcess(ringdt);
+		}
+		tracker.Run();
+
+		const PSvectorArray& result = tracker.GetTrackedBunch().GetParticles();
+		std::copy(result.begin(), result.end(), out.begin() + first);
+	});
+}
+
 void ClosedOrbit::FindClosedOrbit(PSvector& particle, int ncpt)
 {
+	if(useTPSA && !radiation && !hasProcesses && FindClosedOrbitTPSA(particle, ncpt))
+	{
+		return;
+	}
+
 	const int cpt = transverseOnly ? 4 : 6;
 
 	ParticleBunch bunch(p0, 1.0);
@@ -141,6 +241,11 @@ void ClosedOrbit::FindClosedOrbit(PSvector& particle, int ncpt)
 	w = 1.0;
 	iter = 1;
 
+	// Without added processes each column is tracked on its own, so the
+	// columns may be shared between threads, each with its own tracker.
+	const int nt = hasProcesses ? 1 : std::min(Parallel::ThreadsFor(cpt + 1, 1), cpt + 1);
+	PSvectorArray tracked(cpt + 1);
+
 #ifdef DEBUG_CLOSED_ORBIT
 	cout << "Finding closed orbit:" << endl;
 	NANproc = new NANCheckProcess();
@@ -152,21 +257,27 @@ void ClosedOrbit::FindClosedOrbit(PSvector& particle, int ncpt)
 		// Note that 'bunch' always corresponds to the initial bunch
 		// (it is *not* the tracked bunch)
 		// Note that the *first* particle is the reference ray
-		ParticleBunch::iterator ip;
-
 		k = 0;
-		for(ip = bunch.begin(); ip != bunch.end(); ip++, k++)
+		for(ParticleBunch::iterator p = bunch.begin(); p != bunch.end(); p++, k++)
 		{
-			*ip = particle;
+			*p = particle;
 			if(k > 0)
 			{
-				(*ip)[k - 1] += delta;
+				(*p)[k - 1] += delta;
 			}
 		}
 
-		theTracker->Run();
-
-		ip = theTracker->GetTrackedBunch().begin();
+		PSvectorArray::const_iterator ip;
+		if(nt > 1)
+		{
+			TrackColumns(bunch.GetParticles(), tracked, ncpt, nt);
+			ip = tracked.begin();
+		}
+		else
+		{
+			theTracker->Run();
+			ip = theTracker->GetTrackedBunch().GetParticles().begin();
+		}
 		const Particle& p_ref = *ip++; // reference particle
 
 #ifdef DEBUG_CLOSED_ORBIT
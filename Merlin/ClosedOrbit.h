@@ -35,6 +35,13 @@ public:
 	void SetTolerance(double tolerance);        // default: 1.0e-26
 	void SetMaxIterations(int max_iterations);  // default: 20
 
+	// If true, the one-turn Jacobian for each Newton step is taken from a
+	// single pass of a first-order TPSA through a CompiledLattice, instead
+	// of tracking displaced particles, so delta is not used. The particle
+	// tracking is still used if the ring cannot be compiled, or with
+	// radiation or added processes.
+	void UseTPSA(bool flag);                    // default: false
+
 	void AddProcess(ParticleBunchProcess* aProcess);
 
 	// The following member functions are available for diagnostics
@@ -58,7 +65,15 @@ private:
 	double radstepsize;
 	int radnumsteps;
 	double bendscale;
+	bool useTPSA;
+	bool hasProcesses;
 	ParticleTracker* theTracker;
+
+	bool FindClosedOrbitTPSA(PSvector& particle, int ncpt);
+
+	// Track the particles in, from ncpt once around the ring, into out,
+	// in nt blocks on separate threads
+	void TrackColumns(const PSvectorArray& in, PSvectorArray& out, int ncpt, int nt);
 };
 
 #endif
@@ -5,6 +5,7 @@
  * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
  */
 
+#include <algorithm>
 #include <iterator>
 #include <iomanip>
 #include <typeinfo>
@@ -21,6 +22,8 @@
 #include "ParticleComponentTracker.h"
 
 #include "CollimateParticleProcess.h"
+#include "ParallelFor.h"
+#include "RandomNG.h"
 
 #include "utils.h"
 #include "PhysicalUnits.h"
@@ -44,6 +47,10 @@ void OutputIndexParticles(const PSvectorArray lost_p, const list<size_t>& lost_i
 	}
 }
 
+// Scattering a particle through a collimator jaw costs as much as tracking
+// thousands of particles through a drift, so short loops are worth sharing
+const size_t scatterGrainSize = 16;
+
 } // end anonymous namespace
 
 namespace ParticleTracking
@@ -52,10 +59,13 @@ namespace ParticleTracking
 CollimateParticleProcess::CollimateParticleProcess(int priority, int mode, std::ostream* osp) :
 	ParticleBunchProcess("PARTICLE COLLIMATION", priority), cmode(mode), os(osp), createLossFiles(false), file_prefix(
 		""), lossThreshold(1), nstart(0), pindex(nullptr), CollimationOutputSet(false), ColParProTurn(0),
-	FirstElementSet(0), scatter(false), bin_size(0.1 * PhysicalUnits::meter), Imperfections(false)
+	FirstElementSet(0), scatter(false), bin_size(0.1 * PhysicalUnits::meter), Imperfections(false), turn(0),
+	element(0), nstep(0), tileCollimation(false)
 {
 }
 
+thread_local std::vector<CollimateParticleProcess::DisposedParticle>* CollimateParticleProcess::disposeBuffer = nullptr;
+
 CollimateParticleProcess::~CollimateParticleProcess()
 {
 	if(pindex != nullptr)
@@ -97,6 +107,14 @@ void CollimateParticleProcess::SetCurrentComponent(AcceleratorComponent& compone
 		++ColParProTurn;
 	}
 
+	element = component.GetBeamlineIndex();
+	if(passes.size() <= element)
+	{
+		passes.resize(element + 1, 0);
+	}
+	turn = passes[element]++;
+	nstep = 0;
+
 	active = (currentBunch != nullptr) && (component.GetAperture() != nullptr);
 	if(active)
 	{
@@ -172,6 +190,126 @@ double CollimateParticleProcess::GetMaxAllowedStepSize() const
 	}
 }
 
+void CollimateParticleProcess::BeginTiles(double ds, size_t ntiles)
+{
+	s += ds;
+	tileCollimation = fequal(s, next_s);
+	if(tileCollimation)
+	{
+		const size_t n = currentBunch->size();
+		check_x.resize(n);
+		check_y.resize(n);
+		inside.resize(n);
+		tileFirst.assign(ntiles, 0);
+		tileCount.assign(ntiles, 0);
+		tileLost.resize(ntiles);
+		tileLostOffset.resize(ntiles);
+		for(size_t t = 0; t < ntiles; t++)
+		{
+			tileLost[t].clear();
+			tileLostOffset[t].clear();
+		}
+	}
+}
+
+size_t CollimateParticleProcess::DoProcessTile(double ds, size_t tile, size_t first, size_t last)
+{
+	if(!tileCollimation)
+	{
+		return last;
+	}
+	tileFirst[tile] = first;
+	tileCount[tile] = last - first;
+	if(CheckAperture(first, last) == last - first || is_collimator)
+	{
+		return last;
+	}
+
+	// Outside a magnet aperture the particle is lost without scattering
+	const PSvectorArray::iterator p0 = currentBunch->begin();
+	size_t end = first;
+	for(size_t i = first; i < last; i++)
+	{
+		if(inside[i])
+		{
+			if(end != i)
+			{
+				p0[end] = p0[i];
+			}
+			end++;
+		}
+		else
+		{
+			tileLost[tile].push_back(p0[i]);
+			tileLostOffset[tile].push_back(i - first);
+		}
+	}
+	return end;
+}
+
+void CollimateParticleProcess::EndTiles(double ds)
+{
+	if(tileCollimation)
+	{
+		currentBunch->SetIntS(s - ds);
+
+		// The tiles have been closed up; find where each now starts to
+		// give the bunch indices the unfused step would have seen
+		PSvectorArray lost;
+		bool outside = false;
+		size_t offset = 0;
+		for(size_t t = 0; t < tileCount.size(); t++)
+		{
+			if(is_collimator)
+			{
+				if(offset != tileFirst[t])
+				{
+					const size_t first = tileFirst[t];
+					const size_t last = first + tileCount[t];
+					std::move(check_x.begin() + first, check_x.begin() + last, check_x.begin() + offset);
+					std::move(check_y.begin() + first, check_y.begin() + last, check_y.begin() + offset);
+					std::move(inside.begin() + first, inside.begin() + last, inside.begin() + offset);
+				}
+				outside = outside || std::find(inside.begin() + offset, inside.begin() + offset + tileCount[t], 0)
+					!= inside.begin() + offset + tileCount[t];
+			}
+			for(size_t k : tileLostOffset[t])
+			{
+				LostParticlePositions.push_back(offset + k);
+			}
+			lost.insert(lost.end(), tileLost[t].begin(), tileLost[t].end());
+			offset += tileCount[t];
+		}
+
+		if(outside)
+		{
+			CollimateChecked();
+		}
+		else if(!lost.empty())
+		{
+			nstep++;
+			if(pindex != nullptr)
+			{
+				list<size_t>::iterator ip = pindex->begin();
+				size_t at = 0;
+				for(size_t i : LostParticlePositions)
+				{
+					std::advance(ip, i - at);
+					ip = pindex->erase(ip);
+					at = i + 1;
+				}
+			}
+			DisposeLosses(lost);
+		}
+		SetNextS();
+	}
+
+	if(!active)
+	{
+		s_total += currentComponent->GetLength();
+	}
+}
+
 void CollimateParticleProcess::IndexParticles(bool index)
 {
 	if(index && pindex == nullptr)
@@ -202,42 +340,55 @@ void CollimateParticleProcess::SetLossThreshold(double losspc)
 
 void CollimateParticleProcess::DoCollimation()
 {
-	//The aperture of this element
-	const Aperture *ap = currentComponent->GetAperture();
+	// Check the whole bunch in batches. If we are collimating at the end
+	// of a collimator, track back a drift first.
+	// Do not do this at the start of the element.
+	const size_t n = currentBunch->size();
+	if(n == 0)
+	{
+		return;
+	}
+	check_x.resize(n);
+	check_y.resize(n);
+	inside.resize(n);
+	const int nt = Parallel::ThreadsFor(n);
+	std::vector<size_t> counts(nt, 0);
+	Parallel::ForThreadBlocks(n, nt, 8, [&](int t, size_t first, size_t last)
+	{
+		counts[t] = CheckAperture(first, last);
+	});
 
-	// If there are no losses there is no need to go through the expensive
-	// process of copying all the particles to a new bunch. So check first
-	bool any_loss = false;
-	size_t first_loss = 0;
-	if(is_collimator)
+	// If there are no losses there is nothing more to do
+	size_t ninside = 0;
+	for(size_t c : counts)
 	{
-		for(PSvectorArray::iterator p = currentBunch->begin(); p != currentBunch->end(); p++)
-		{
-			if(!ap->CheckWithinApertureBoundaries((*p).x() - bin_size * (*p).xp(), (*p).y() - bin_size * (*p).yp(), s))
-			{
-				any_loss = true;
-				first_loss = p - currentBunch->begin();
-				break;
-			}
-		}
+		ninside += c;
 	}
-	else
+	if(ninside == n)
 	{
-		for(PSvectorArray::iterator p = currentBunch->begin(); p != currentBunch->end(); p++)
-		{
-			if(!ap->CheckWithinApertureBoundaries((*p).x(), (*p).y(), s))
-			{
-				any_loss = true;
-				first_loss = p - currentBunch->begin();
-				break;
-			}
-		}
+		return;
 	}
 
-	if(!any_loss)
+	CollimateChecked();
+}
+
+size_t CollimateParticleProcess::CheckAperture(size_t first, size_t last)
+{
+	const Aperture *ap = currentComponent->GetAperture();
+	const PSvectorArray::iterator p0 = currentBunch->begin();
+	for(size_t i = first; i < last; i++)
 	{
-		return;
+		const Particle& p = p0[i];
+		check_x[i] = is_collimator ? p.x() - bin_size * p.xp() : p.x();
+		check_y[i] = is_collimator ? p.y() - bin_size * p.yp() : p.y();
 	}
+	return ap->CheckBatchWithinApertureBoundaries(&check_x[first], &check_y[first], s, last - first, &inside[first]);
+}
+
+void CollimateParticleProcess::CollimateChecked()
+{
+	const size_t n = currentBunch->size();
+	const PSvectorArray::iterator p0 = currentBunch->begin();
 
 	//The array of lost particles
 	PSvectorArray lost;
@@ -249,49 +400,59 @@ void CollimateParticleProcess::DoCollimation()
 		ip = pindex->begin();
 	}
 
-	//For copying surviving particles to, which is faster than deleting the individual lost particles
-	ParticleBunch* NewBunch = new ParticleBunch(currentBunch->GetReferenceMomentum(), currentBunch->GetTotalCharge()
-		/ currentBunch->size());
-	NewBunch->reserve(currentBunch->size());
-
-	size_t particle_number = 0;
-
-	if(is_collimator)
+	// In counter-based random number mode the particles outside the
+	// collimator aperture are all scattered first, each with its own
+	// stream, so that this may be done in parallel.
+	const bool scatter_first = is_collimator && RandomNG::isCounterBased();
+	std::vector<size_t> hits;
+	std::vector<char> hit_lost;
+	size_t next_hit = 0;
+	if(scatter_first)
 	{
-		for(PSvectorArray::iterator p = currentBunch->begin(); p != currentBunch->end();)
+		for(size_t i = 0; i < n; i++)
 		{
-			(*p).x() -= bin_size * (*p).xp();
-			(*p).y() -= bin_size * (*p).yp();
-			p++;
+			if(!inside[i])
+			{
+				p0[i].x() = check_x[i];
+				p0[i].y() = check_y[i];
+				hits.push_back(i);
+			}
 		}
+		ScatterHits(hits, hit_lost);
 	}
+	nstep++;
 
-	for(PSvectorArray::iterator p = currentBunch->begin(); p != currentBunch->end();)
+	// Flag the lost particles; they are removed together afterwards
+	removed.assign(n, 0);
+	for(size_t particle_number = 0; particle_number < n; particle_number++)
 	{
-		// If we are collimating at the end of the element, track back a drift
-		// Do not do this at the start of the element.
-
-//		if(is_collimator)
-//		{
-//			(*p).x() -= bin_size * (*p).xp();
-//			(*p).y() -= bin_size * (*p).yp();
-//		}
-		if(particle_number >= first_loss && !ap->CheckWithinApertureBoundaries((*p).x(), (*p).y(), s))
+		Particle& p = p0[particle_number];
+		if(!inside[particle_number])
 		{
 			// If the 'aperture' is a collimator, then the particle is lost
-			// if the DoScatter(*p) returns true (energy cut)
+			// if the DoScatter(p) returns true (energy cut)
 			// If not a collimator, then do not scatter and directly remove the particle.
-			if(!is_collimator || DoScatter(*p))
+			bool is_lost = !is_collimator;
+			if(scatter_first)
+			{
+				is_lost = hit_lost[next_hit++];
+			}
+			else if(is_collimator)
+			{
+				p.x() = check_x[particle_number];
+				p.y() = check_y[particle_number];
+				is_lost = DoScatter(p);
+			}
+
+			if(is_lost)
 			{
 				if(is_collimator)
 				{
-					(*p).ct() += (s - bin_size);
+					p.ct() += (s - bin_size);
 				}
 
-				lost.push_back(*p);
+				removed[particle_number] = 1;
 
-				// This is slow for a STL Vector - instead we place the surviving particles into a new bunch and then swap - this is faster
-				p++;
 				if(pindex != nullptr)
 				{
 					lost_i.push_back(*ip);
@@ -299,42 +460,34 @@ void CollimateParticleProcess::DoCollimation()
 				}
 
 				LostParticlePositions.push_back(particle_number);
+				continue;
 			}
-			else
-			{
-				(*p).location() = currentComponent->GetComponentLatticePosition();
-				//Particle survives collimator
-				NewBunch->AddParticle(*p);
-				// need to increment iterators
-				p++;
-				if(pindex != nullptr)
-				{
-					ip++;
-				}
-			}
+
+			//Particle survives collimator
+			p.location() = currentComponent->GetComponentLatticePosition();
 		}
-		else
+		else if(is_collimator)
 		{
-			if(is_collimator)
-			{
-				(*p).x() += bin_size * (*p).xp();
-				(*p).y() += bin_size * (*p).yp();
-			}
+			// Not interacting with the collimator: round trip the drift
+			// exactly as if it had been applied
+			p.x() = check_x[particle_number] + bin_size * p.xp();
+			p.y() = check_y[particle_number] + bin_size * p.yp();
+		}
 
-			//Not interacting with the collimator: "Inside" the aperture; particle lives
-			NewBunch->AddParticle(*p);
-			p++;
-			if(pindex != nullptr)
-			{
-				ip++;
-			}
+		//"Inside" the aperture or survived scattering; particle lives
+		if(pindex != nullptr)
+		{
+			ip++;
 		}
-		particle_number++;
 	}
+	currentBunch->RemoveParticles(removed, &lost);
+	DisposeLosses(lost);
+}
 
-	currentBunch->clear();
-	currentBunch->swap(*NewBunch);
-	delete NewBunch;
+void CollimateParticleProcess::DisposeLosses(PSvectorArray& lost)
+{
+	//The aperture of this element
+	const Aperture *ap = currentComponent->GetAperture();
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -643,6 +796,66 @@ void CollimateParticleProcess::DoOutput(const PSvectorArray& lostb, const list<s
 	}
 }
 
+void CollimateParticleProcess::ScatterHits(const std::vector<size_t>& hits, std::vector<char>& lost)
+{
+	const PSvectorArray::iterator p = currentBunch->begin();
+	lost.resize(hits.size());
+
+	auto scatter_hit = [&](size_t k)
+	{
+		Particle& pk = p[hits[k]];
+		RandomNG::Stream stream(pk.id(), turn, element, nstep);
+		lost[k] = DoScatter(pk);
+	};
+
+	const int nt = PrepareParallelScatter() ? Parallel::ThreadsFor(hits.size(), scatterGrainSize) : 1;
+	if(nt == 1)
+	{
+		for(size_t k = 0; k < hits.size(); k++)
+		{
+			scatter_hit(k);
+		}
+		return;
+	}
+
+	std::vector<std::vector<DisposedParticle> > buffers(nt);
+	Parallel::ForThreadBlocks(hits.size(), nt, 1, [&](int t, size_t first, size_t last)
+	{
+		disposeBuffer = &buffers[t];
+		for(size_t k = first; k < last; k++)
+		{
+			scatter_hit(k);
+		}
+		disposeBuffer = nullptr;
+	});
+
+	// The blocks hold consecutive particles, so this keeps the serial order
+	for(std::vector<DisposedParticle>& buffer : buffers)
+	{
+		for(DisposedParticle& d : buffer)
+		{
+			DisposeParticle(d.pos, d.p);
+		}
+	}
+}
+
+void CollimateParticleProcess::DisposeParticle(double pos, Particle& p)
+{
+	if(disposeBuffer)
+	{
+		disposeBuffer->push_back(DisposedParticle{pos, p});
+		return;
+	}
+
+	if(CollimationOutputSet)
+	{
+		for(CollimationOutput* output : CollimationOutputVector)
+		{
+			output->Dispose(*currentComponent, pos, p, ColParProTurn);
+		}
+	}
+}
+
 bool CollimateParticleProcess::DoScatter(Particle& p)
 {
 	const CollimatorAperture *tap = (CollimatorAperture *) currentComponent->GetAperture();
@@ -8,6 +8,7 @@
 #ifndef CollimateParticleProcess_h
 #define CollimateParticleProcess_h 1
 
+#include <cstdint>
 #include <map>
 #include <set>
 #include <list>
@@ -84,6 +85,25 @@ public:
 	 */
 	virtual double GetMaxAllowedStepSize() const;
 
+	/**
+	 * In a fused step the aperture is checked one tile at a time.
+	 * Particles outside the aperture of a magnet are removed within the
+	 * tile and their losses are output once all the tiles are done.
+	 * Particles outside a collimator are scattered after the tiles, over
+	 * the whole bunch, which ends the fused pass.
+	 */
+	virtual bool IsParticleLocal() const
+	{
+		return true;
+	}
+	virtual bool IsTileBarrier() const
+	{
+		return is_collimator;
+	}
+	virtual void BeginTiles(double ds, size_t ntiles);
+	virtual size_t DoProcessTile(double ds, size_t tile, size_t first, size_t last);
+	virtual void EndTiles(double ds);
+
 	/**
 	 * If set to true, the process scatters the particles in
 	 * energy and angle at a Collimator element, if the particle is
@@ -193,9 +213,52 @@ protected:
 	double FirstElementS;
 	bool FirstElementSet;
 
+	/**
+	 * Pass a particle lost inside the current element to each
+	 * CollimationOutput. While particles are being scattered in parallel
+	 * the call is buffered and replayed in particle order at the end of
+	 * the step.
+	 * @param[in] pos The position of the loss along the element
+	 * @param[in] p The lost particle
+	 */
+	void DisposeParticle(double pos, Particle& p);
+
+	/**
+	 * Called in counter-based random number mode before the particles
+	 * outside the aperture of a collimator are scattered.
+	 * @retval true DoScatter() may be called concurrently for different
+	 * particles in the current element
+	 */
+	virtual bool PrepareParallelScatter()
+	{
+		return false;
+	}
+
 private:
 
 	virtual void DoCollimation();
+
+	/**
+	 * Checks the particles [first, last) of the current bunch against
+	 * the aperture, filling check_x, check_y and inside.
+	 * @return The number of particles inside the aperture
+	 */
+	size_t CheckAperture(size_t first, size_t last);
+
+	/**
+	 * Scatters or removes the particles of the current bunch found
+	 * outside the aperture by CheckAperture().
+	 */
+	void CollimateChecked();
+
+	/**
+	 * Passes the particles lost in the current element to each
+	 * CollimationOutput, tracking them from the entrance of a magnet to
+	 * the point of loss, and checks the loss threshold. The indices of
+	 * lost particles in the bunch are taken from LostParticlePositions.
+	 */
+	void DisposeLosses(PSvectorArray& lost);
+
 	void SetNextS();
 	virtual void DoOutput(const PSvectorArray& lostb, const std::list<size_t>& lost_i);
 	void bin_lost_output(const PSvectorArray& lostb);
@@ -208,10 +271,65 @@ private:
 	double Xr; /// radiation length
 	virtual bool DoScatter(Particle&);
 
+	/**
+	 * Scatter the particles of the current bunch with indices hits
+	 * through the collimator, each with its own random number stream,
+	 * setting lost to the result of DoScatter() for each.
+	 */
+	void ScatterHits(const std::vector<size_t>& hits, std::vector<char>& lost);
+
+	/**
+	 * A loss reported while scattering in parallel.
+	 */
+	struct DisposedParticle
+	{
+		double pos;
+		Particle p;
+	};
+
+	/**
+	 * The loss buffer of the calling thread while scattering in parallel.
+	 */
+	static thread_local std::vector<DisposedParticle>* disposeBuffer;
+
+	/**
+	 * Number of times each beamline element has been entered, and for the
+	 * current element that count, its beamline index and the collimation
+	 * step within it. Together with the particle id these select the
+	 * random number stream used for scattering.
+	 */
+	std::vector<std::uint64_t> passes;
+	std::uint64_t turn;
+	size_t element;
+	std::uint64_t nstep;
+
 	/**
 	 * A list of particles we want to use in the input array
 	 */
 	std::vector<unsigned int> LostParticlePositions;
+
+	/**
+	 * Transverse positions checked against the aperture, the result
+	 * and whether the particle is lost, for each particle, kept between
+	 * steps to avoid reallocation.
+	 */
+	std::vector<double> check_x;
+	std::vector<double> check_y;
+	std::vector<char> inside;
+	std::vector<char> removed;
+
+	/**
+	 * Whether the aperture is checked in the current fused step, and for
+	 * each tile the index of its first particle, the number of particles
+	 * it held when checked, and the particles removed from it with their
+	 * offsets in the tile. Each tile is only written by the thread
+	 * processing it.
+	 */
+	bool tileCollimation;
+	std::vector<size_t> tileFirst;
+	std::vector<size_t> tileCount;
+	std::vector<PSvectorArray> tileLost;
+	std::vector<std::vector<size_t> > tileLostOffset;
 };
 
 inline void CollimateParticleProcess::CreateParticleLossFiles(bool flg, string fprefix)
@@ -35,7 +35,8 @@ namespace ParticleTracking
 {
 
 CollimateProtonProcess::CollimateProtonProcess(int priority, int mode, std::ostream* osp) :
-	CollimateParticleProcess(priority, mode, osp), scattermodel(nullptr)
+	CollimateParticleProcess(priority, mode, osp), scattermodel(nullptr), material_index(0), scatter_plot(false),
+	jaw_impact(false)
 {
 
 }
@@ -48,9 +49,6 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 	double P0 = currentBunch->GetReferenceMomentum();
 	double E0 = sqrt(P0 * P0 + pow(PhysicalConstants::ProtonMassMeV * PhysicalUnits::MeV, 2));
 
-	bool scatter_plot = 0;
-	bool jaw_impact = 0;
-
 	// Length of the collimator
 	double coll_length = currentComponent->GetLength();
 
@@ -59,32 +57,6 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 
 	Collimator* C = static_cast<Collimator*>(currentComponent);
 
-	string ColName = currentComponent->GetName();
-
-	if(scattermodel->ScatterPlot_on)
-	{
-		for(vector<string>::iterator its = scattermodel->ScatterPlotNames.begin(); its !=
-			scattermodel->ScatterPlotNames.end(); ++its)
-		{
-			if(ColName == *its)
-			{
-				scatter_plot = 1;
-			}
-		}
-	}
-
-	if(scattermodel->JawImpact_on)
-	{
-		for(vector<string>::iterator its = scattermodel->JawImpactNames.begin(); its !=
-			scattermodel->JawImpactNames.end(); ++its)
-		{
-			if(ColName == *its)
-			{
-				jaw_impact = 1;
-			}
-		}
-	}
-
 	const Aperture *colap = C->GetAperture();
 
 	//set scattering model
@@ -100,7 +72,7 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		double E1 = E0 * (1 + p.dp());
 		//Note that pathlength should be calculated with E0
 
-		double xlen = scattermodel->PathLength(C->material, E0);
+		double xlen = scattermodel->PathLength(material_index);
 
 		double E2 = 0;
 
@@ -115,13 +87,13 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		//Jaw Impact
 		if(jaw_impact && z == 0)
 		{
-			scattermodel->JawImpact(p, ColParProTurn, ColName);
+			scattermodel->JawImpact(p, ColParProTurn, currentComponent->GetName());
 		}
 
 		//Scatter Plot
 		if(scatter_plot && z == 0)
 		{
-			scattermodel->ScatterPlot(p, z, ColParProTurn, ColName);
+			scattermodel->ScatterPlot(p, z, ColParProTurn, currentComponent->GetName());
 		}
 
 		//Energy Loss
@@ -133,14 +105,7 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		{
 			p.ct() = z;
 
-			if(CollimationOutputSet)
-			{
-				for(CollimationOutputIterator = CollimationOutputVector.begin(); CollimationOutputIterator !=
-					CollimationOutputVector.end(); ++CollimationOutputIterator)
-				{
-					(*CollimationOutputIterator)->Dispose(*currentComponent, (z + zstep), p, ColParProTurn);
-				}
-			}
+			DisposeParticle(z + zstep, p);
 			return true;
 		}
 
@@ -156,7 +121,7 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		z += zstep;
 		if(scatter_plot)
 		{
-			scattermodel->ScatterPlot(p, z, ColParProTurn, ColName);
+			scattermodel->ScatterPlot(p, z, ColParProTurn, currentComponent->GetName());
 		}
 
 		if((colap->CheckWithinApertureBoundaries((p.x()), (p.y()), z)))
@@ -175,18 +140,11 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		//Scattering - use E2
 		if(interacted)
 		{
-			if(!scattermodel->ParticleScatter(p, C->material, E2))
+			if(!scattermodel->ParticleScatter(p, material_index, E2))
 			{
 				p.ct() = z;
 
-				if(CollimationOutputSet)
-				{
-					for(CollimationOutputIterator = CollimationOutputVector.begin(); CollimationOutputIterator !=
-						CollimationOutputVector.end(); ++CollimationOutputIterator)
-					{
-						(*CollimationOutputIterator)->Dispose(*currentComponent, (z + zstep), p, ColParProTurn);
-					}
-				}
+				DisposeParticle(z + zstep, p);
 				return true;
 			}
 		}
@@ -195,14 +153,7 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 		{
 			p.ct() = z;
 
-			if(CollimationOutputSet)
-			{
-				for(CollimationOutputIterator = CollimationOutputVector.begin(); CollimationOutputIterator !=
-					CollimationOutputVector.end(); ++CollimationOutputIterator)
-				{
-					(*CollimationOutputIterator)->Dispose(*currentComponent, (z + zstep), p, ColParProTurn);
-				}
-			}
+			DisposeParticle(z + zstep, p);
 			return true;
 		}
 
@@ -214,6 +165,34 @@ bool CollimateProtonProcess::DoScatter(Particle& p)
 	return true;
 }
 
+void CollimateProtonProcess::SetCurrentComponent(AcceleratorComponent& component)
+{
+	CollimateParticleProcess::SetCurrentComponent(component);
+
+	Collimator* C = dynamic_cast<Collimator*>(currentComponent);
+	if(!active || !is_collimator || C == nullptr || scattermodel == nullptr)
+	{
+		return;
+	}
+
+	// Resolve everything the scattering loop needs for this collimator once
+	double P0 = currentBunch->GetReferenceMomentum();
+	double E0 = sqrt(P0 * P0 + pow(PhysicalConstants::ProtonMassMeV * PhysicalUnits::MeV, 2));
+	material_index = scattermodel->SelectMaterial(C->material, E0);
+
+	const string& ColName = C->GetName();
+	const vector<string>& plots = scattermodel->ScatterPlotNames;
+	const vector<string>& impacts = scattermodel->JawImpactNames;
+	scatter_plot = scattermodel->ScatterPlot_on && find(plots.begin(), plots.end(), ColName) != plots.end();
+	jaw_impact = scattermodel->JawImpact_on && find(impacts.begin(), impacts.end(), ColName) != impacts.end();
+}
+
+bool CollimateProtonProcess::PrepareParallelScatter()
+{
+	// Scatter plot and jaw impact records are kept in the order they are made
+	return scattermodel != nullptr && !scatter_plot && !jaw_impact;
+}
+
 void CollimateProtonProcess::SetScatteringModel(Collimation::ScatteringModel* s)
 {
 	scattermodel = s;
@@ -30,13 +30,34 @@ public:
 	 */
 	CollimateProtonProcess(int priority, int mode, std::ostream* osp = nullptr);
 
+	/**
+	 * Sets the current accelerator component. For a collimator the
+	 * cross sections of its material are selected in the ScatteringModel.
+	 */
+	virtual void SetCurrentComponent(AcceleratorComponent& component);
+
 	void SetScatteringModel(Collimation::ScatteringModel* s);
 
 private:
 	Collimation::ScatteringModel* scattermodel;
 
+	/**
+	 * The index of the collimator material in the ScatteringModel, and
+	 * whether scatter plot and jaw impact data is recorded for the
+	 * collimator
+	 */
+	size_t material_index;
+	bool scatter_plot;
+	bool jaw_impact;
+
 	bool DoScatter(Particle&);
 
+	/**
+	 * Parallel scattering is possible unless scatter plot or jaw impact
+	 * data is being recorded for the current collimator.
+	 */
+	bool PrepareParallelScatter();
+
 };
 
 } // end namespace ParticleTracking
@@ -40,6 +40,29 @@ inline bool CollimatorAperture::CheckWithinApertureBoundaries(double x, double y
 	return fabs(x1) * 2 < x_jaw && fabs(y1) * 2 < y_jaw;
 }
 
+size_t CollimatorAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	const double quick = (x_offset_entry == 0 && y_offset_entry == 0 && x_offset_exit == 0 && y_offset_exit == 0)
+		? minDim : 0;
+
+	const double x_off = (z * (x_offset_entry - x_offset_exit) / CollimatorLength) - x_offset_entry;
+	const double y_off = (z * (y_offset_entry - y_offset_exit) / CollimatorLength) - y_offset_entry;
+
+	const double x_jaw = (z * (w_exit - GetFullEntranceWidth()) / CollimatorLength) + GetFullEntranceWidth();
+	const double y_jaw = (z * (h_exit - GetFullEntranceHeight()) / CollimatorLength) + GetFullEntranceHeight();
+
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double x1 = ((x[i] + x_off) * cosalpha) - ((y[i] + y_off) * sinalpha);
+		const double y1 = ((x[i] + x_off) * sinalpha) + ((y[i] + y_off) * cosalpha);
+		inside[i] = (fabs(x[i]) + fabs(y[i]) < quick) | ((fabs(x1) * 2 < x_jaw) & (fabs(y1) * 2 < y_jaw));
+		count += inside[i];
+	}
+	return count;
+}
+
 void CollimatorAperture::SetEntranceWidth(double width)
 {
 	w_entrance = width;
@@ -138,6 +161,12 @@ inline bool UnalignedCollimatorAperture::CheckWithinApertureBoundaries(double x,
 	return fabs(x1) * 2 < GetFullEntranceWidth() && fabs(y1) * 2 < GetFullEntranceHeight();
 }
 
+size_t UnalignedCollimatorAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	return ApertureAbstract::CheckBatchWithinApertureBoundaries(x, y, z, n, inside);
+}
+
 inline bool CollimatorApertureWithErrors::CheckWithinApertureBoundaries(double x, double y, double z) const
 {
 	double x_off = (z * (x_offset_entry - x_offset_exit) / CollimatorLength) - x_offset_entry;
@@ -155,6 +184,12 @@ inline bool CollimatorApertureWithErrors::CheckWithinApertureBoundaries(double x
 	return fabs(x1) * 2 < x_jaw && fabs(y1) * 2 < y_jaw;
 }
 
+size_t CollimatorApertureWithErrors::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	return ApertureAbstract::CheckBatchWithinApertureBoundaries(x, y, z, n, inside);
+}
+
 OneSidedUnalignedCollimatorAperture::OneSidedUnalignedCollimatorAperture(double w, double h, double t, double length,
 	double x_off, double y_off, bool side) :
 	CollimatorAperture(w, h, t, length, x_off, y_off), JawSide(side)
@@ -180,6 +215,12 @@ inline bool OneSidedUnalignedCollimatorAperture::CheckWithinApertureBoundaries(d
 	}
 }
 
+size_t OneSidedUnalignedCollimatorAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+	char* inside) const
+{
+	return ApertureAbstract::CheckBatchWithinApertureBoundaries(x, y, z, n, inside);
+}
+
 void OneSidedUnalignedCollimatorAperture::SetJawSide(bool side)
 {
 	JawSide = side;
@@ -136,6 +136,13 @@ public:
 	 */
 	virtual bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  CollimatorAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 *  The jaw position at z is found once for the whole batch.
+	 */
+	virtual size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n,
+		char* inside) const;
+
 protected:
 	double alpha;
 	double CollimatorLength;
@@ -166,6 +173,11 @@ public:
 	 *  @return true/false flag
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
+
+	/**
+	 *  UnalignedCollimatorAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
 };
 
 class CollimatorApertureWithErrors: public CollimatorAperture
@@ -180,6 +192,11 @@ class CollimatorApertureWithErrors: public CollimatorAperture
 	 *  @return true/false flag
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
+
+	/**
+	 *  CollimatorApertureWithErrors override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
 };
 
 class UnalignedCollimatorApertureWithErrors: public UnalignedCollimatorAperture
@@ -213,6 +230,11 @@ public:
 	 *  @return true/false flag
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
+
+	/**
+	 *  OneSidedUnalignedCollimatorAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
 	bool JawSide;
 
 	/**
@@ -51,46 +51,14 @@ namespace ParticleTracking
 // Constructor
 
 CollimatorWakeProcess::CollimatorWakeProcess(int modes, int prio, size_t nb, double ns) :
-	WakeFieldProcess(prio, nb, ns)
+	WakeFieldProcess(prio, nb, ns), nmodes(modes), collimator_wake(nullptr)
 {
-	nmodes = modes;
-	Cm = new double*[modes + 1];
-	Sm = new double*[modes + 1];
-	wake_ct = new double*[modes + 1];
-	wake_st = new double*[modes + 1];
-	wake_cl = new double*[modes + 1];
-	wake_sl = new double*[modes + 1];
-	for(int i = 0; i <= nmodes; i++)
-	{
-		Cm[i] = new double[1000];
-		Sm[i] = new double[1000];
-		wake_ct[i] = new double[1000];
-		wake_st[i] = new double[1000];
-		wake_cl[i] = new double[1000];
-		wake_sl[i] = new double[1000];
-	}
 }
 
 // Destructor
 
 CollimatorWakeProcess::~CollimatorWakeProcess()
 {
-	for(int i = 0; i < nmodes; i++)
-	{
-		delete[] Cm[i];
-		delete[] Sm[i];
-		delete[] wake_ct[i];
-		delete[] wake_st[i];
-		delete[] wake_cl[i];
-		delete[] wake_sl[i];
-	}
-
-	delete[] Cm;
-	delete[] Sm;
-	delete[] wake_ct;
-	delete[] wake_st;
-	delete[] wake_cl;
-	delete[] wake_sl;
 }
 
 // Calculates the moments Cm for each slice
@@ -122,50 +90,39 @@ double CollimatorWakeProcess::CalculateSm(int mode, int slice)
 // Calculate the transverse wake with modes
 void CollimatorWakeProcess::CalculateWakeT(double dz, int currmode)
 {
-	vector<double> w(nbins);
-	for(size_t slice = 0; slice < nbins; slice++)
+	const CollimatorWakePotentials* wake = collimator_wake;
+	SampledWake& w = GetSampledWake(wake, transWake, currmode);
+	w.Sample([wake, currmode](double z)
 	{
-		w[slice] = collimator_wake->Wtrans(slice * dz, currmode);
-	}
-
-	for(size_t slice = 0; slice < nbins; slice++)
-	{
-		int i = slice;
-		wake_ct[currmode][i] = 0;
-		wake_st[currmode][i] = 0;
-
-		for(size_t j = slice; j < bunchSlices.size() - 1; j++)
-		{
-			wake_ct[currmode][i] += w[j - i] * Cm[currmode][j];
-			wake_st[currmode][i] += w[j - i] * Sm[currmode][j];
-		}
-	}
+		return wake->Wtrans(z, currmode);
+	}, nbins + 1, dz, 0);
+	w.Correlate(Cm[currmode].data(), wake_ct[currmode].data(), Sm[currmode].data(), wake_st[currmode].data());
 }
 
 // This function calculates the longitudinal wake with modes
 void CollimatorWakeProcess::CalculateWakeL(double dz, int currmode)
 {
-	vector<double> w(nbins);
-	for(size_t slice = 0; slice < nbins; slice++)
-	{
-		w[slice] = collimator_wake->Wlong(slice * dz, currmode);
-	}
-
-	for(size_t i = 0; i < nbins; i++)
+	const CollimatorWakePotentials* wake = collimator_wake;
+	SampledWake& w = GetSampledWake(wake, longWake, currmode);
+	w.Sample([wake, currmode](double z)
 	{
-		wake_cl[currmode][i] = 0;
-		wake_sl[currmode][i] = 0;
-		for(size_t j = i; j < bunchSlices.size() - 1; j++)
-		{
-			wake_cl[currmode][i] += w[j - i] * Cm[currmode][j];
-			wake_sl[currmode][i] += w[j - i] * Sm[currmode][j];
-		}
-	}
+		return wake->Wlong(z, currmode);
+	}, nbins + 1, dz, 0);
+	w.Correlate(Cm[currmode].data(), wake_cl[currmode].data(), Sm[currmode].data(), wake_sl[currmode].data());
 }
 
 void CollimatorWakeProcess::ApplyWakefield(double ds) //  int nmodes)
 {
 	collimator_wake = (CollimatorWakePotentials *) currentWake;
+
+	// the last slice is empty, and pads the sums
+	Cm.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+	Sm.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+	wake_ct.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+	wake_st.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+	wake_cl.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+	wake_sl.assign(nmodes + 1, vector<double>(nbins + 1, 0.0));
+
 	for(int m = 1; m <= nmodes; m++)
 	{
 		for(size_t n = 0; n < nbins; n++)
@@ -43,17 +43,17 @@ private:
 
 	int nmodes;
 
-//    double Cm[5][1000];
-	double** Cm;
-//    double Sm[5][1000];
-	double** Sm;
-//	double wake_s;
-//	double wake_c;
-
-	double** wake_sl;
-	double** wake_cl;
-	double** wake_ct;
-	double** wake_st;
+	/**
+	 * The moments and wakes of each mode at each slice, indexed
+	 * [mode][slice], with nbins + 1 slices.
+	 */
+	vector<vector<double> > Cm;
+	vector<vector<double> > Sm;
+
+	vector<vector<double> > wake_sl;
+	vector<vector<double> > wake_cl;
+	vector<vector<double> > wake_ct;
+	vector<vector<double> > wake_st;
 
 	CollimatorWakePotentials* collimator_wake;
 
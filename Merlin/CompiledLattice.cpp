@@ -0,0 +1,393 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <algorithm>
+#include "CompiledLattice.h"
+#include "StdIntegrators.h"
+#include "TTrackSim.h"
+#include "ComponentFrame.h"
+#include "ParallelFor.h"
+#include "SectorBend.h"
+
+namespace ParticleTracking
+{
+
+CompiledLattice::Entry::Entry() :
+	component(nullptr), aperture(nullptr), length(0), P0(0), q(0), state(uncompiled), momentumFree(false), bend(false),
+	fused(0)
+{
+}
+
+CompiledLattice::CompiledLattice(const AcceleratorModel::RingIterator& aRing) :
+	isRing(true), ring(aRing), beamline(), flat(false), fuse(false), checkApertures(false), tileSize(512), turn(0),
+	valid(false), generation(0)
+{
+	stepper.AddProcess(new TTrnsProc<ParticleComponentTracker>());
+}
+
+CompiledLattice::CompiledLattice(const AcceleratorModel::Beamline& bline) :
+	isRing(false), ring(), beamline(bline), flat(false), fuse(false), checkApertures(false), tileSize(512), turn(0),
+	valid(false), generation(0)
+{
+	stepper.AddProcess(new TTrnsProc<ParticleComponentTracker>());
+}
+
+void CompiledLattice::AssumeFlatLattice(bool f)
+{
+	flat = f;
+	valid = false;
+}
+
+void CompiledLattice::FuseDrifts(bool f)
+{
+	fuse = f;
+	valid = false;
+}
+
+void CompiledLattice::CheckApertures(bool check)
+{
+	checkApertures = check;
+	valid = false;
+}
+
+void CompiledLattice::SetTileSize(size_t n)
+{
+	assert(n > 0);
+	tileSize = n;
+}
+
+void CompiledLattice::Invalidate()
+{
+	valid = false;
+}
+
+void CompiledLattice::Invalidate(size_t n)
+{
+	if(valid && n < entries.size() && entries[n].fused == 0)
+	{
+		entries[n].state = uncompiled;
+	}
+	else
+	{
+		valid = false;
+	}
+}
+
+size_t CompiledLattice::GetNumberCompiled() const
+{
+	size_t n = 0;
+	for(std::vector<Entry>::const_iterator e = entries.begin(); e != entries.end(); e++)
+	{
+		if(e->component && e->state == compiled)
+		{
+			n++;
+		}
+	}
+	return n;
+}
+
+template<class I>
+void CompiledLattice::Build(I first, I last)
+{
+	// The same transformations, in the same order, as TrackingSimulation
+	do
+	{
+		ComponentFrame* frame = *first;
+		entries.emplace_back();
+		Entry& e = entries.back();
+
+		if(!flat)
+		{
+			e.entrance.AddTransform(frame->GetEntrancePlaneTransform());
+		}
+		if(const Transform3D* t = frame->GetEntranceGeometryPatch())
+		{
+			e.entrance.AddTransform(*t);
+		}
+		if(frame->IsComponent())
+		{
+			e.component = &frame->GetComponent();
+			e.aperture = e.component->GetAperture();
+			e.length = e.component->GetLength();
+			e.bend = dynamic_cast<SectorBend*>(e.component) != nullptr;
+		}
+		if(const Transform3D* t = frame->GetExitGeometryPatch())
+		{
+			e.exit.AddTransform(*t);
+		}
+		if(!flat)
+		{
+			e.exit.AddTransform(frame->GetExitPlaneTransform());
+		}
+	} while(++first != last);
+}
+
+void CompiledLattice::Rebuild()
+{
+	generation = ModelElement::GetModelGeneration();
+	entries.clear();
+	if(isRing)
+	{
+		Build(ring, ring);
+	}
+	else
+	{
+		Build(beamline.begin(), beamline.end());
+	}
+	valid = true;
+}
+
+bool CompiledLattice::Prepare(Entry& e, double P0, double q)
+{
+	if(e.state == fallback)
+	{
+		return false;
+	}
+	if(e.state == compiled && (e.momentumFree || (e.P0 == P0 && e.q == q)))
+	{
+		return true;
+	}
+
+	e.body.clear();
+	e.fused = 0;
+	if(e.component)
+	{
+		CompilableIntegrator* ci = nullptr;
+		try
+		{
+			e.component->PrepareTracker(tracker);
+			ci = dynamic_cast<CompilableIntegrator*>(tracker.GetIntegrator());
+		}
+		catch(ComponentTracker::UnknownComponent&)
+		{
+			// reported by the fallback tracking
+		}
+
+		bool ok = ci && ci->Compile(e.body);
+		tracker.Reset();
+		if(!ok)
+		{
+			e.body.clear();
+			e.state = fallback;
+			return false;
+		}
+	}
+
+	e.P0 = P0;
+	e.q = q;
+	e.state = compiled;
+	e.momentumFree = e.body.IsDrift();
+	return true;
+}
+
+bool CompiledLattice::IsFusable(const Entry& e) const
+{
+	return e.state == compiled && e.momentumFree && e.fused == 0 && e.entrance.empty() && e.exit.empty()
+		   && !(checkApertures && e.aperture);
+}
+
+size_t CompiledLattice::Fuse(size_t i, double P0, double q)
+{
+	// Drifts do not depend on the momentum, so the merged entries are
+	// never recompiled and may safely be left with an empty body.
+	size_t j = i + 1;
+	while(j < entries.size() && Prepare(entries[j], P0, q) && IsFusable(entries[j]))
+	{
+		entries[i].body.Append(entries[j].body);
+		entries[j].fused = 1;
+		j++;
+	}
+	entries[i].body.MergeDrifts();
+	entries[i].fused = j - i;
+	return j;
+}
+
+size_t CompiledLattice::CheckAperture(const Entry& e, PSvectorArray::iterator first, PSvectorArray::iterator last,
+	std::vector<double>& xy, std::vector<char>& inside, std::vector<LostParticle>& losses) const
+{
+	const size_t n = last - first;
+	xy.resize(2 * n);
+	inside.resize(n);
+	for(size_t k = 0; k < n; k++)
+	{
+		xy[k] = first[k].x();
+		xy[n + k] = first[k].y();
+	}
+
+	if(e.aperture->CheckBatchWithinApertureBoundaries(xy.data(), xy.data() + n, e.length, n, inside.data()) == n)
+	{
+		return n;
+	}
+
+	PSvectorArray::iterator out = first;
+	for(size_t k = 0; k < n; k++)
+	{
+		if(inside[k])
+		{
+			if(out != first + k)
+			{
+				*out = first[k];
+			}
+			++out;
+		}
+		else
+		{
+			LostParticle lp = {first[k], e.component, turn};
+			losses.push_back(lp);
+		}
+	}
+	return out - first;
+}
+
+void CompiledLattice::TrackCompiled(ParticleBunch& bunch, size_t first, size_t last)
+{
+	PSvectorArray& particles = bunch.GetParticles();
+	const size_t n = particles.size();
+	const size_t ntiles = (n + tileSize - 1) / tileSize;
+
+	std::vector<size_t> kept(ntiles);
+	std::vector<std::vector<LostParticle> > tileLost(checkApertures ? ntiles : 0);
+
+	Parallel::ForThreadBlocks(ntiles, Parallel::ThreadsFor(n), 1, [&](int, size_t t0, size_t t1)
+	{
+		std::vector<double> xy;
+		std::vector<char> inside;
+		for(size_t t = t0; t < t1; t++)
+		{
+			const PSvectorArray::iterator p0 = particles.begin() + t * tileSize;
+			PSvectorArray::iterator p1 = particles.begin() + std::min((t + 1) * tileSize, n);
+			for(size_t i = first; i < last; i++)
+			{
+				const Entry& e = entries[i];
+				e.entrance.Apply(p0, p1);
+				e.body.Apply(p0, p1);
+				if(checkApertures && e.aperture)
+				{
+					p1 = p0 + CheckAperture(e, p0, p1, xy, inside, tileLost[t]);
+				}
+				e.exit.Apply(p0, p1);
+			}
+			kept[t] = p1 - p0;
+		}
+	});
+
+	// close the gaps left by lost particles, keeping the particle order
+	size_t end = 0;
+	for(size_t t = 0; t < ntiles; t++)
+	{
+		const PSvectorArray::iterator p0 = particles.begin() + t * tileSize;
+		if(end != t * tileSize)
+		{
+			std::move(p0, p0 + kept[t], particles.begin() + end);
+		}
+		end += kept[t];
+	}
+	if(end != n)
+	{
+		particles.erase(particles.begin() + end, particles.end());
+	}
+	for(size_t t = 0; t < tileLost.size(); t++)
+	{
+		lost.insert(lost.end(), tileLost[t].begin(), tileLost[t].end());
+	}
+
+	for(size_t i = first; i < last; i++)
+	{
+		if(entries[i].component)
+		{
+			bunch.IncrReferenceTime(entries[i].length);
+		}
+	}
+}
+
+void CompiledLattice::Update()
+{
+	if(!valid || generation != ModelElement::GetModelGeneration())
+	{
+		Rebuild();
+	}
+}
+
+bool CompiledLattice::PrepareEntries(size_t first, size_t last, double P0, double q)
+{
+	Update();
+	assert(first <= last && last <= entries.size());
+
+	// the integrators take the momentum and charge from the bunch
+	if(!reference || reference->GetReferenceMomentum() != P0 || reference->GetChargeSign() != q)
+	{
+		reference.reset(new ParticleBunch(P0, q));
+	}
+	tracker.SetBunch(*reference);
+
+	bool ok = true;
+	for(size_t i = first; i < last; i++)
+	{
+		ok = Prepare(entries[i], P0, q) && ok;
+	}
+	return ok;
+}
+
+void CompiledLattice::Track(ParticleBunch& bunch)
+{
+	Update();
+
+	tracker.SetBunch(bunch);
+	stepper.Initialise(bunch);
+
+	const size_t n = entries.size();
+	size_t i = 0;
+	while(i < n)
+	{
+		// the run of compiled entries from i
+		size_t j = i;
+		while(j < n && Prepare(entries[j], bunch.GetReferenceMomentum(), bunch.GetChargeSign()))
+		{
+			if(fuse && IsFusable(entries[j]))
+			{
+				j = Fuse(j, bunch.GetReferenceMomentum(), bunch.GetChargeSign());
+			}
+			else
+			{
+				j++;
+			}
+		}
+		if(j > i)
+		{
+			TrackCompiled(bunch, i, j);
+			i = j;
+		}
+
+		if(i < n)
+		{
+			Entry& e = entries[i];
+			e.entrance.Apply(bunch);
+			stepper.Track(*e.component);
+			if(checkApertures && e.aperture)
+			{
+				PSvectorArray& particles = bunch.GetParticles();
+				std::vector<double> xy;
+				std::vector<char> inside;
+				size_t kept = CheckAperture(e, particles.begin(), particles.end(), xy, inside, lost);
+				particles.erase(particles.begin() + kept, particles.end());
+			}
+			e.exit.Apply(bunch);
+			i++;
+		}
+	}
+	turn++;
+}
+
+void CompiledLattice::Track(ParticleBunch& bunch, size_t nturns)
+{
+	for(size_t t = 0; t < nturns; t++)
+	{
+		Track(bunch);
+	}
+}
+
+} // end namespace ParticleTracking
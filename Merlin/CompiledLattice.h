@@ -0,0 +1,287 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef CompiledLattice_h
+#define CompiledLattice_h 1
+
+#include "merlin_config.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "AcceleratorModel.h"
+#include "ParticleBunch.h"
+#include "ParticleComponentTracker.h"
+#include "ProcessStepManager.h"
+#include "KernelSequence.h"
+
+namespace ParticleTracking
+{
+
+/**
+ *	Tracks a ParticleBunch through a beamline or ring with maps which
+ *	are built once and replayed on every later pass, for multi-turn
+ *	tracking without a BunchProcess.
+ *
+ *	The lattice frames are walked once into a flat list of entries,
+ *	each holding the frame transformations and, for the components
+ *	whose integrator is a CompilableIntegrator (the TRANSPORT drift,
+ *	multipole and sector bend, markers and non-recording monitors),
+ *	the KernelSequence which tracks through the whole component. An
+ *	entry is compiled when it is first reached, for the reference
+ *	momentum and charge of the bunch at that point, and is rebuilt if
+ *	either changes. Runs of compiled entries are applied to the bunch
+ *	one tile at a time, with no virtual dispatch, allocation or string
+ *	handling. Other components (RF structures, solenoids, ...) are
+ *	tracked by the default integrator set as in a ParticleTracker.
+ *
+ *	Without drift fusion and aperture checks the result is bit-identical
+ *	to a ParticleTracker with the TRANSPORT integrators and no other
+ *	processes.
+ *
+ *	The entries are rebuilt whenever the model generation changes (see
+ *	ModelElement::GetModelGeneration()), which happens when an element
+ *	is changed through a channel or moved, for example by
+ *	AcceleratorErrors. Invalidate() forces a rebuild after any other
+ *	change to the lattice.
+ */
+class CompiledLattice
+{
+public:
+
+	/**
+	 *	A particle removed by an aperture.
+	 */
+	struct LostParticle
+	{
+		PSvector p;
+		const AcceleratorComponent* component;
+		size_t turn;
+	};
+
+	explicit CompiledLattice(const AcceleratorModel::RingIterator& ring);
+	explicit CompiledLattice(const AcceleratorModel::Beamline& bline);
+
+	/**
+	 *	If flat is true, the transformations between the component
+	 *	frames are ignored, as in TrackingSimulation::AssumeFlatLattice().
+	 */
+	void AssumeFlatLattice(bool flat);
+
+	/**
+	 *	If fuse is true, consecutive drifts, markers and monitors which
+	 *	are compiled as drifts, with no frame transformation or aperture
+	 *	check between them, are tracked as a single drift of their total
+	 *	length. The result then agrees with unfused tracking only to
+	 *	rounding. Default false.
+	 */
+	void FuseDrifts(bool fuse);
+
+	/**
+	 *	If check is true, particles outside the aperture at the exit of
+	 *	each component are removed from the bunch and recorded (see
+	 *	GetLostParticles()). Default false.
+	 */
+	void CheckApertures(bool check);
+
+	/**
+	 *	Set the number of particles which pass through a run of compiled
+	 *	entries together. Default 512.
+	 */
+	void SetTileSize(size_t n);
+
+	/**
+	 *	Force the lattice to be recompiled on the next Track().
+	 */
+	void Invalidate();
+
+	/**
+	 *	Force the component of lattice frame n to be recompiled when it
+	 *	is next used, after a change which is not seen by the model
+	 *	generation, such as a direct call to SetFieldStrength().
+	 */
+	void Invalidate(size_t n);
+
+	/**
+	 *	Track the bunch once through the beamline (one turn of a ring).
+	 */
+	void Track(ParticleBunch& bunch);
+
+	/**
+	 *	Track the bunch nturns times through the lattice.
+	 */
+	void Track(ParticleBunch& bunch, size_t nturns);
+
+	/**
+	 *	Track the phase space point x[0..5], ordered as in a PSvector,
+	 *	once through the lattice with the compiled maps, for reference
+	 *	momentum P0 and charge q. T may be double, or a TPSA, which gives
+	 *	the Taylor map of the whole lattice about x in a single pass. If
+	 *	bendScale is not zero, ct is increased by bendScale times the
+	 *	length of each sector bend, as by RingDeltaTProcess. Apertures
+	 *	are not checked.
+	 *
+	 *	@return false, with x unchanged, if any component cannot be
+	 *	compiled (for example an RF structure).
+	 */
+	template<class T>
+	bool TrackMap(T* x, double P0, double q = 1, double bendScale = 0);
+
+	/**
+	 *	As TrackMap(), but only through the lattice frames first to
+	 *	last - 1, counted from the start of the beamline (or ring).
+	 *
+	 *	@return false, with x unchanged, if any of those components
+	 *	cannot be compiled.
+	 */
+	template<class T>
+	bool TrackMapBetween(T* x, size_t first, size_t last, double P0, double q = 1, double bendScale = 0);
+
+	/**
+	 *	@return The number of passes tracked so far.
+	 */
+	size_t GetTurn() const
+	{
+		return turn;
+	}
+
+	/**
+	 *	@return The number of lattice frames, and the number of those
+	 *	which are currently tracked from compiled maps.
+	 */
+	size_t GetNumberOfEntries() const
+	{
+		return entries.size();
+	}
+	size_t GetNumberCompiled() const;
+
+	/**
+	 *	@return The particles removed by the aperture checks, in the order
+	 *	in which they were lost.
+	 */
+	const std::vector<LostParticle>& GetLostParticles() const
+	{
+		return lost;
+	}
+
+	void ClearLostParticles()
+	{
+		lost.clear();
+	}
+
+private:
+
+	typedef enum
+	{
+		uncompiled,
+		compiled,
+		fallback
+
+	} EntryState;
+
+	struct Entry
+	{
+		AcceleratorComponent* component;
+		KernelSequence entrance;
+		KernelSequence body;
+		KernelSequence exit;
+		const Aperture* aperture;
+		double length;
+		double P0;
+		double q;
+		EntryState state;
+		bool momentumFree;
+		bool bend;
+
+		/**
+		 *	The number of entries whose drifts are merged into body, or 0
+		 *	if the body has not been fused.
+		 */
+		size_t fused;
+
+		Entry();
+	};
+
+	template<class I>
+	void Build(I first, I last);
+
+	void Rebuild();
+	void Update();
+	bool Prepare(Entry& e, double P0, double q);
+	bool PrepareEntries(size_t first, size_t last, double P0, double q);
+	bool IsFusable(const Entry& e) const;
+	size_t Fuse(size_t i, double P0, double q);
+	void TrackCompiled(ParticleBunch& bunch, size_t first, size_t last);
+	size_t CheckAperture(const Entry& e, PSvectorArray::iterator first, PSvectorArray::iterator last,
+		std::vector<double>& xy, std::vector<char>& inside, std::vector<LostParticle>& losses) const;
+
+	bool isRing;
+	AcceleratorModel::RingIterator ring;
+	AcceleratorModel::Beamline beamline;
+
+	bool flat;
+	bool fuse;
+	bool checkApertures;
+	size_t tileSize;
+	size_t turn;
+	bool valid;
+	unsigned long generation;
+
+	std::vector<Entry> entries;
+	std::vector<LostParticle> lost;
+
+	/**
+	 *	Used to select the integrator of each component.
+	 */
+	ParticleComponentTracker tracker;
+
+	/**
+	 *	An empty bunch, which gives the integrators the momentum and
+	 *	charge for TrackMap().
+	 */
+	std::unique_ptr<ParticleBunch> reference;
+
+	/**
+	 *	Tracks the components which are not compiled.
+	 */
+	ProcessStepManager stepper;
+
+	//Copy protection
+	CompiledLattice(const CompiledLattice& rhs);
+	CompiledLattice& operator=(const CompiledLattice& rhs);
+};
+
+template<class T>
+bool CompiledLattice::TrackMap(T* x, double P0, double q, double bendScale)
+{
+	Update();
+	return TrackMapBetween(x, 0, entries.size(), P0, q, bendScale);
+}
+
+template<class T>
+bool CompiledLattice::TrackMapBetween(T* x, size_t first, size_t last, double P0, double q, double bendScale)
+{
+	if(!PrepareEntries(first, last, P0, q))
+	{
+		return false;
+	}
+
+	for(std::vector<Entry>::const_iterator e = entries.begin() + first; e != entries.begin() + last; e++)
+	{
+		e->entrance.Apply(x);
+		e->body.Apply(x);
+		if(e->bend && bendScale != 0)
+		{
+			x[ps_CT] += bendScale * e->length;
+		}
+		e->exit.Apply(x);
+	}
+	return true;
+}
+
+} // end namespace ParticleTracking
+
+#endif
@@ -87,6 +87,39 @@ public:
 	 */
 	bool AtExit(double step = 0) const;
 
+	/**
+	 *	Returns true if the integrator tracks the current component by
+	 *	acting on each particle independently, so that a step can be
+	 *	applied one tile of particles at a time with BeginTiles(),
+	 *	TrackTile() and EndTiles().
+	 */
+	virtual bool IsParticleLocal() const
+	{
+		return false;
+	}
+
+	/**
+	 *	Prepares the step ds for TrackTile(). Called once per step.
+	 */
+	virtual void BeginTiles(double ds)
+	{
+	}
+
+	/**
+	 *	Applies the step ds, including any entrance or exit maps, to the
+	 *	particles [first, last). The integrator state is not changed, so
+	 *	that tiles may be tracked concurrently.
+	 */
+	virtual void TrackTile(double ds, size_t first, size_t last) const
+	{
+	}
+
+	/**
+	 *	Completes a step applied with TrackTile().
+	 *  @return Remaining length of current component
+	 */
+	virtual double EndTiles(double ds);
+
 protected:
 
 	friend class ComponentTracker;
@@ -188,6 +221,12 @@ inline double ComponentIntegrator::Track(double ds)
 	return GetRemainingLength();
 }
 
+inline double ComponentIntegrator::EndTiles(double ds)
+{
+	cur_S += ds;
+	return GetRemainingLength();
+}
+
 inline bool ComponentIntegrator::AtEntrance() const
 {
 	return fequal(cur_S, 0.0);
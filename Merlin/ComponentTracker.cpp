@@ -28,6 +28,11 @@ public:
 	//	Performs no action.
 	virtual void TrackStep(double ds);
 
+	virtual bool IsParticleLocal() const
+	{
+		return true;
+	}
+
 	//	Returns the component index for this integrator.
 	virtual int GetComponentIndex() const;
 };
@@ -108,6 +113,31 @@ double ComponentTracker::TrackStep(double ds)
 	return itsState;
 }
 
+bool ComponentTracker::IsParticleLocal() const
+{
+	return integrator != nullptr && integrator->IsParticleLocal();
+}
+
+void ComponentTracker::BeginTiles(double ds)
+{
+	assert(itsState == initialised || itsState == tracking);
+	assert(integrator->IsValidStep(ds));
+
+	integrator->BeginTiles(ds);
+}
+
+void ComponentTracker::TrackTile(double ds, size_t first, size_t last) const
+{
+	integrator->TrackTile(ds, first, last);
+}
+
+double ComponentTracker::EndTiles(double ds)
+{
+	double sToExit = integrator->EndTiles(ds);
+	itsState = fequal(sToExit, 0) ? finished : tracking;
+	return itsState;
+}
+
 void ComponentTracker::Reset()
 {
 	integrator = nullptr;
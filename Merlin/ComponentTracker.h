@@ -82,6 +82,22 @@ public:
 	 */
 	double TrackStep(double ds);
 
+	/**
+	 *	Returns true if the current integrator can track a step one
+	 *	tile of particles at a time (see
+	 *	ComponentIntegrator::IsParticleLocal()).
+	 */
+	bool IsParticleLocal() const;
+
+	/**
+	 *	Track a step ds as a series of tiles. BeginTiles() is followed
+	 *	by TrackTile() for each tile, which may be called concurrently,
+	 *	and then EndTiles(), which has the same result as TrackStep().
+	 */
+	void BeginTiles(double ds);
+	void TrackTile(double ds, size_t first, size_t last) const;
+	double EndTiles(double ds);
+
 	/**
 	 *	Returns the current state of the Tracker.
 	 */
@@ -113,6 +129,15 @@ public:
 	 */
 	bool SelectIntegrator(int index, AcceleratorComponent& component);
 
+	/**
+	 *	Returns the integrator selected for the current component, or
+	 *	nullptr if there is none.
+	 */
+	ComponentIntegrator* GetIntegrator() const
+	{
+		return integrator;
+	}
+
 	/**
 	 *	Function operator overload. Tracks the specified
 	 *	AcceleratorComponent in one step.
@@ -224,6 +249,12 @@ public:
 			currentBunch->IncrReferenceTime(ds);
 			return s;
 		}
+		virtual double EndTiles(double ds)
+		{
+			double s = ComponentIntegrator::EndTiles(ds);
+			currentBunch->IncrReferenceTime(ds);
+			return s;
+		}
 	protected:
 		_B* currentBunch;
 	};
@@ -17,6 +17,24 @@
 #include "PhysicalConstants.h"
 #include "PhysicalUnits.h"
 #include "RandomNG.h"
+#include "TableCache.h"
+
+namespace
+{
+
+/**
+ * Version of the diffractive model, part of the table cache key.
+ * Increase it whenever a change alters the generated tables.
+ */
+const double DiffractiveModelVersion = 2;
+
+/**
+ * Factor by which the largest cross section found on a 3 x 3 grid of
+ * points in each (t, xi) cell is raised to bound it over the whole cell.
+ */
+const double CellMargin = 1.05;
+
+} // end anonymous namespace
 
 using namespace PhysicalUnits;
 using namespace PhysicalConstants;
@@ -143,7 +161,30 @@ void ppDiffractiveScatter::GenerateDistribution(double energy)
 {
 	if(!Configured)
 	{
-		GenerateDsigDtDxi(energy);
+		const std::vector<double> key = {DiffractiveModelVersion, energy, t_min, t_max, xi_min, xi_max, double(N)};
+		std::vector<std::vector<double> > tables;
+		if(TableCache::Load("ppDiffractiveScatter", key, tables) && tables.size() == 4 && tables[0].size() == 4
+			&& tables[1].size() == size_t(N) && tables[2].size() == size_t(N) && tables[3].size() == size_t(N * N))
+		{
+			ss = tables[0][0];
+			SigDiffractive = tables[0][1];
+			t_step = tables[0][2];
+			xi_step = tables[0][3];
+			std::copy(tables[1].begin(), tables[1].end(), tarray);
+			std::copy(tables[2].begin(), tables[2].end(), xarray);
+			CellMax.swap(tables[3]);
+			std::cout << "Nucleon Diffractive total cross section total "  << SigDiffractive * 1000.0 << " mb (cached)"
+					  << std::endl;
+			BuildSampler();
+		}
+		else
+		{
+			GenerateDsigDtDxi(energy);
+			CellMax.clear();
+			BuildSampler();
+			TableCache::Store("ppDiffractiveScatter", key, {{ss, SigDiffractive, t_step, xi_step},
+				std::vector<double>(tarray, tarray + N), std::vector<double>(xarray, xarray + N), CellMax});
+		}
 		Configured = true;
 	}
 }
@@ -257,71 +298,97 @@ double ppDiffractiveScatter::SelectXi()
 	return xi;
 }
 
-std::pair<double, double> ppDiffractiveScatter::Select()
+/**
+ * The tarray and xarray lookup tables split t and xi into N bins each of
+ * equal probability under their own distributions. Each of the N*N cells
+ * is weighted by its bound on the cross section (see FindCellMax()) times
+ * its area, the envelope from which Select() samples.
+ */
+void ppDiffractiveScatter::BuildSampler()
 {
-	double xx, tt;
-	static bool kilroy = false;
-	if(kilroy)
+	for(int i = 0; i < N; i++)
 	{
-		std::cout << "open file" << std::endl;
-		kilroy = false;
-	}
+		double width = (i < (N - 1) ? tarray[i + 1] : 1) - tarray[i];
+		t_low[i] = t_min + tarray[i] * (t_max - t_min);
+		t_width[i] = width * (t_max - t_min);
 
-	retry:
-
-	double rt = N * RandomNG::uniform(0, 1);
-	int it = int(rt);
-	double extra = rt - it;
-	double deltat = 0.0;
-	if(it < (N - 1))
-	{
-		deltat = tarray[it + 1] - tarray[it];
-	}
-	else
-	{
-		deltat = 1 - tarray[it];
-	}
-	tt = tarray[it] + extra * deltat;
-	tt = t_min + tt * (t_max - t_min);
-	if(tt < 0 || deltat < 0)
-	{
-		goto retry;
+		width = (i < (N - 1) ? xarray[i + 1] : 1) - xarray[i];
+		xi_low[i] = xi_min + xarray[i] * (xi_max - xi_min);
+		xi_width[i] = width * (xi_max - xi_min);
 	}
 
-	double rx = N * RandomNG::uniform(0, 1);
-	int ix = int(rx);
-	extra = rx - ix;
-	double deltax = 0.0;
-	if(ix < (N - 1))
+	if(CellMax.size() != size_t(N * N))
 	{
-		deltax = xarray[ix + 1] - xarray[ix];
+		FindCellMax();
 	}
-	else
+
+	std::vector<double> weights(N * N, 0.0);
+	for(int it = 0; it < N; it++)
 	{
-		deltax = 1 - xarray[ix];
+		for(int ix = 0; ix < N; ix++)
+		{
+			weights[it * N + ix] = CellMax[it * N + ix] * t_width[it] * xi_width[ix];
+		}
 	}
-	xx = xarray[ix] + extra * deltax;
-	xx = xi_min + xx * (xi_max - xi_min);
-
-	double ds = PomeronScatter(tt, xx, ss) * 0.001;
-
-	double ds2 = SigDiffractive / (N * N * deltax * (xi_max - xi_min) * deltat * (t_max - t_min));
-
-	static double fudge = 1;
-	double rat = fudge * ds / ds2;
+	CellSampler = AliasSampler(weights);
+}
 
-	if(rat > 1)
+void ppDiffractiveScatter::FindCellMax()
+{
+	CellMax.assign(N * N, 0.0);
+	for(int it = 0; it < N; it++)
 	{
-		fudge /= rat;    //rat=fudge/rat;
+		if(t_low[it] < 0 || t_width[it] < 0)
+		{
+			continue;
+		}
+		for(int ix = 0; ix < N; ix++)
+		{
+			if(xi_width[ix] < 0)
+			{
+				continue;
+			}
+			double fmax = 0;
+			for(int i = 0; i < 3; i++)
+			{
+				const double tt = t_low[it] + 0.5 * i * t_width[it];
+				for(int j = 0; j < 3; j++)
+				{
+					const double xx = xi_low[ix] + 0.5 * j * xi_width[ix];
+					fmax = std::max(fmax, PomeronScatter(tt, xx, ss));
+				}
+			}
+			CellMax[it * N + ix] = CellMargin * fmax;
+		}
 	}
-	if(RandomNG::uniform(0, 1) > rat)
+}
+
+std::pair<double, double> ppDiffractiveScatter::Select()
+{
+	// a point picked uniformly under the envelope, accepted with the ratio
+	// of the cross section there to the bound of its cell
+	while(true)
 	{
-		goto retry;
+		const size_t cell = CellSampler(RandomNG::uniform(0, 1));
+		const size_t it = cell / N;
+		const size_t ix = cell % N;
+		const double tt = t_low[it] + RandomNG::uniform(0, 1) * t_width[it];
+		const double xx = xi_low[ix] + RandomNG::uniform(0, 1) * xi_width[ix];
+		if(RandomNG::uniform(0, 1) * CellMax[cell] < PomeronScatter(tt, xx, ss))
+		{
+			return std::make_pair(tt, sqrt(ss * xx));
+		}
 	}
+}
 
-	double mrec = sqrt(ss * xx);
+double ppDiffractiveScatter::DifferentialCrossSection(double t, double xi) const
+{
+	return PomeronScatter(t, xi, ss) * 0.001;
+}
 
-	return std::make_pair(tt, mrec);
+double ppDiffractiveScatter::GetS() const
+{
+	return ss;
 }
 
 /**
@@ -12,6 +12,7 @@
 #include <complex>
 
 #include "Interpolation.h"
+#include "TabulatedSampler.h"
 
 namespace ParticleTracking
 {
@@ -139,15 +140,43 @@ public:
 	 */
 	void EnableDebug(bool debug);
 
-//Get our scattering (roger)
+	/**
+	 * Picks a (t, recoil mass) pair from the differential cross section.
+	 * A cell of the (t, xi) grid is picked in constant time with an alias
+	 * table, weighted by a bound on the cross section over the cell, and
+	 * a point in it is accepted with the ratio of the cross section there
+	 * to the bound, so the pair follows the cross section exactly.
+	 */
 	std::pair<double, double> Select();
 
+	/**
+	 * The differential cross section d^2 sigma / dt dxi (barn) sampled by
+	 * Select(), after GenerateDistribution()
+	 */
+	double DifferentialCrossSection(double t, double xi) const;
+
+	/**
+	 * Gets s of the interaction (GeV^2), with recoil mass sqrt(s xi)
+	 */
+	double GetS() const;
+
 private:
 	/**
 	 * Generates the differential cross section at a given t value and energy
 	 * The energy is the sqrt(s) of the interaction
 	 */
 	inline double PomeronScatter(const double t_input, const double xi_input, const double energy) const;
+
+	/**
+	 * Builds the alias table used by Select() from tarray and xarray
+	 */
+	void BuildSampler();
+
+	/**
+	 * Finds CellMax from the cross section on a 3 x 3 grid of points in
+	 * each cell, including its edges
+	 */
+	void FindCellMax();
 	double PomeronScatter2(double t_input, double xi_input, double energy);
 
 	/**
@@ -215,6 +244,20 @@ private:
 //s of the interaction
 	double ss;
 
+	/**
+	 * Cells of the (t, xi) grid, as lower edge and width of each t and xi
+	 * bin, with an alias table selecting cell it * N + ix in proportion to
+	 * its cross section
+	 */
+	double t_low[N], t_width[N];
+	double xi_low[N], xi_width[N];
+	AliasSampler CellSampler;
+
+	/**
+	 * An upper bound on the cross section in each cell
+	 */
+	std::vector<double> CellMax;
+
 }; //End class ppDiffractiveScatter
 
 } //End namespace ParticleTracking
@@ -17,6 +17,18 @@ typedef std::complex<double> Complex;
 #include "PhysicalConstants.h"
 #include "PhysicalUnits.h"
 #include "RandomNG.h"
+#include "TableCache.h"
+
+namespace
+{
+
+/**
+ * Version of the elastic model, part of the table cache key.
+ * Increase it whenever a change alters the generated tables.
+ */
+const double ElasticModelVersion = 1;
+
+} // end anonymous namespace
 
 namespace ParticleTracking
 {
@@ -113,12 +125,32 @@ void ppElasticScatter::GenerateTDistribution(double energy)
 {
 	if(!Configured)
 	{
+		// Debug runs write the intermediate tables, so always generate them
+		const std::vector<double> key = {ElasticModelVersion, energy, t_min, t_max, step};
+		std::vector<std::vector<double> > tables;
+		if(!Debug && TableCache::Load("ppElasticScatter", key, tables) && tables.size() == 2 && tables[0].size() == 2
+			&& tables[1].size() > 1)
+		{
+			SigElastic = tables[0][0];
+			SigElasticN = tables[0][1];
+			TSampler = InverseCDFSampler(tables[1]);
+			std::cout << "Elastic Cross section (with peak): " << SigElastic * 1000 << " mb (cached)" << std::endl;
+			std::cout << "Elastic Cross section (without peak): " << SigElasticN * 1000 << " mb (cached)" << std::endl;
+			Configured = true;
+			return;
+		}
+
 		Uniformt = new std::vector<double>;
 		DSig = new std::vector<double>;
 		DSigN = new std::vector<double>;
 
 		GenerateDsigDt(energy);
-		IntegrateDsigDt();
+		std::vector<double> Sig = IntegrateDsigDt();
+
+		if(!Debug)
+		{
+			TableCache::Store("ppElasticScatter", key, {{SigElastic, SigElasticN}, Sig});
+		}
 
 		Configured = true;
 		delete Uniformt;
@@ -129,10 +161,6 @@ void ppElasticScatter::GenerateTDistribution(double energy)
 
 ppElasticScatter::~ppElasticScatter()
 {
-	if(LinearInterpolation)
-	{
-		delete LinearInterpolation;
-	}
 }
 
 /**
@@ -203,7 +231,7 @@ void ppElasticScatter::GenerateDsigDt(double energy)
  * Generates the elastic differential cross section
  * Places the results into the vectors t and DSig
  */
-void ppElasticScatter::IntegrateDsigDt()
+std::vector<double> ppElasticScatter::IntegrateDsigDt()
 {
 	unsigned int nSteps = Uniformt->size();
 	std::vector<double> Sig;
@@ -319,7 +347,7 @@ void ppElasticScatter::IntegrateDsigDt()
 		(*SigmaDistributionFile) << 1.0 << "\t" << t_max << std::endl;
 	}
 
-	LinearInterpolation = new Interpolation(Sig, 0, (1.0 / nSteps));    // Interpolation of equally spaced data points
+	TSampler = InverseCDFSampler(Sig);    // Sig holds t at equally spaced points of the integral
 
 	if(Debug)
 	{
@@ -332,7 +360,7 @@ void ppElasticScatter::IntegrateDsigDt()
 	}
 
 	delete InversionInterpolation;
-	//delete LinearInterpolation;
+	return Sig;
 }
 
 /**
@@ -341,7 +369,7 @@ void ppElasticScatter::IntegrateDsigDt()
 double ppElasticScatter::SelectT()
 {
 	double SigValue = RandomNG::uniform(0, 1.0);
-	double t = (*LinearInterpolation)(SigValue);
+	double t = TSampler(SigValue);
 	return t;
 }
 
@@ -11,6 +11,7 @@
 #include <vector>
 #include <complex>
 #include "Interpolation.h"
+#include "TabulatedSampler.h"
 
 namespace ParticleTracking
 {
@@ -29,7 +30,7 @@ public:
 	 * class constructor
 	 */
 	ppElasticScatter() :
-		LinearInterpolation(nullptr), Configured(false), Debug(false)
+		Configured(false), Debug(false)
 	{
 	}
 
@@ -102,15 +103,20 @@ private:
 
 	/**
 	 * Integrates the elastic differential cross section
+	 * @return The inverted distribution, t at equal steps in the integral
 	 */
-	void IntegrateDsigDt();
+	std::vector<double> IntegrateDsigDt();
 
 	/**
-	 * Interpolation classes for the cross section data
+	 * Interpolation class for the integrated cross section data
 	 */
-	Interpolation *LinearInterpolation;
 	Interpolation *InversionInterpolation;
 
+	/**
+	 * Inverse CDF of t used by SelectT()
+	 */
+	InverseCDFSampler TSampler;
+
 	/**
 	 * bool to check if the cross sections have been generated
 	 */
@@ -9,6 +9,7 @@
 
 #include "utils.h"
 #include "RandomNG.h"
+#include "ParallelFor.h"
 #include "HollowELensProcess.h"
 #include "PhysicalUnits.h"
 #include "PhysicalConstants.h"
@@ -61,18 +62,11 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 	// CalcKick Radial and Simple return -ve theta
 	// DoProcess should have p.xp() += theta * sin(ParticleAngle)
 
-	double theta = 0;
 	double Gamma_p = 0;
-	double ParticleAngle;
 
 	bool SimpleProfile = currentComponentHEL->SimpleProfile;
 	bool ACSet = currentComponentHEL->ACSet;
 
-	ParticleBunch* newbunch = new ParticleBunch(currentBunch->GetReferenceMomentum(), currentBunch->GetTotalCharge()
-		/ currentBunch->size());
-	newbunch->clear();
-	newbunch->swap(*currentBunch);
-
 	if(ProtonBeta == 0)
 	{
 		Gamma_p = LorentzGamma(currentBunch->GetReferenceMomentum(), ProtonMass);
@@ -87,25 +81,27 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 	case DC:
 	{
 		//HEL always on
-		for(PSvectorArray::iterator p = newbunch->begin(); p != newbunch->end(); p++)
+		Parallel::ForEach(currentBunch->begin(), currentBunch->end(), [&](Particle& p)
 		{
+			double theta;
+			double ParticleAngle;
 			if(SimpleProfile)
 			{
-				theta = CalcKickSimple(*p);
+				theta = CalcKickSimple(p);
 			}
 			else
 			{
-				theta = CalcKickRadial(*p);
+				theta = CalcKickRadial(p);
 			}
 
 			if(theta != 0)
 			{
-				ParticleAngle = atan2((*p).y(), (*p).x());
+				ParticleAngle = atan2(p.y(), p.x());
 				//~ // Particle phase space angle and amplitude (radius)
-				(*p).xp() += theta * cos(ParticleAngle);
-				(*p).yp() += theta * sin(ParticleAngle);
+				p.xp() += theta * cos(ParticleAngle);
+				p.yp() += theta * sin(ParticleAngle);
 			}
-		}
+		});
 	}
 	break;
 	case AC:
@@ -121,15 +117,17 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 			double Nstep = currentComponentHEL->Nstep;
 			double Tune = currentComponentHEL->Tune;
 			double Multiplier = currentComponentHEL->Multiplier;
-			for(PSvectorArray::iterator p = newbunch->begin(); p != newbunch->end(); p++)
+			Parallel::ForEach(currentBunch->begin(), currentBunch->end(), [&](Particle& p)
 			{
+				double theta;
+				double ParticleAngle;
 				if(SimpleProfile)
 				{
-					theta = CalcKickSimple(*p);
+					theta = CalcKickSimple(p);
 				}
 				else
 				{
-					theta = CalcKickRadial(*p);
+					theta = CalcKickRadial(p);
 				}
 
 				if(theta != 0)
@@ -147,12 +145,12 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 					double Phi = Multiplier * (Turn * OpTune * 2 * pi);
 					theta *= 0.5 * (1 + cos(Phi));
 
-					ParticleAngle = atan2((*p).y(), (*p).x());
+					ParticleAngle = atan2(p.y(), p.x());
 					// Particle phase space angle and amplitude (radius)
-					(*p).xp() += theta * cos(ParticleAngle);
-					(*p).yp() += theta * sin(ParticleAngle);
+					p.xp() += theta * cos(ParticleAngle);
+					p.yp() += theta * sin(ParticleAngle);
 				}
-			}
+			});
 		}
 		else
 		{
@@ -167,25 +165,27 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 
 		if(rando >= 0)
 		{
-			for(PSvectorArray::iterator p = newbunch->begin(); p != newbunch->end(); p++)
+			Parallel::ForEach(currentBunch->begin(), currentBunch->end(), [&](Particle& p)
 			{
+				double theta;
+				double ParticleAngle;
 				if(SimpleProfile)
 				{
-					theta = CalcKickSimple(*p);
+					theta = CalcKickSimple(p);
 				}
 				else
 				{
-					theta = CalcKickRadial(*p);
+					theta = CalcKickRadial(p);
 				}
 
-				ParticleAngle = atan2((*p).y(), (*p).x());
+				ParticleAngle = atan2(p.y(), p.x());
 				if(theta != 0)
 				{
 					// Particle phase space angle and amplitude (radius)
-					(*p).xp() += theta * cos(ParticleAngle);
-					(*p).yp() += theta * sin(ParticleAngle);
+					p.xp() += theta * cos(ParticleAngle);
+					p.yp() += theta * sin(ParticleAngle);
 				}
-			}
+			});
 		}
 	}
 	break;
@@ -201,34 +201,32 @@ void HollowELensProcess::DoProcess(double /*ds*/)
 		}
 		if((Turn % SkipTurn) == 0)
 		{
-			for(PSvectorArray::iterator p = newbunch->begin(); p != newbunch->end(); p++)
+			Parallel::ForEach(currentBunch->begin(), currentBunch->end(), [&](Particle& p)
 			{
+				double theta;
+				double ParticleAngle;
 				if(SimpleProfile)
 				{
-					theta = CalcKickSimple(*p);
+					theta = CalcKickSimple(p);
 				}
 				else
 				{
-					theta = CalcKickRadial(*p);
+					theta = CalcKickRadial(p);
 				}
 
-				ParticleAngle = atan2((*p).y(), (*p).x());
+				ParticleAngle = atan2(p.y(), p.x());
 				if(theta != 0)
 				{
 					// Particle phase space angle and amplitude (radius)
-					(*p).xp() += theta * cos(ParticleAngle);
-					(*p).yp() += theta * sin(ParticleAngle);
+					p.xp() += theta * cos(ParticleAngle);
+					p.yp() += theta * sin(ParticleAngle);
 				}
-			}
+			});
 		}
 	}
 	break;
 	} //end switch
 
-	//Apply changes to particle bunch
-	currentBunch->clear();
-	currentBunch->swap(*newbunch);
-	delete newbunch;
 }
 
 double HollowELensProcess::GetMaxAllowedStepSize() const
@@ -11,6 +11,7 @@
 #include "merlin_config.h"
 #include "ChannelServer.h"
 #include "Channels.h"
+#include "ModelElement.h"
 
 template<class E> class TIRWChannel;
 
@@ -142,6 +143,7 @@ template<class E>
 void TIC_ctor<E>::WriteTo(E* elmnt, double value)
 {
 	(elmnt->*w_f)(value);
+	ModelElement::ModelChanged();
 }
 
 template<class E>
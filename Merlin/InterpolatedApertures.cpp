@@ -10,6 +10,7 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 
 #include "InterpolatedApertures.h"
 
@@ -21,9 +22,59 @@ string InterpolatedRectEllipseAperture::getType()
 }
 
 InterpolatedRectEllipseAperture::InterpolatedRectEllipseAperture(vector<Aperture*> apVec) :
-	ElementApertures(apVec)
+	ElementApertures(apVec), invSpacing(0)
 {
+	static std::atomic<size_t> instances(0);
+	cacheId = ++instances;
 
+	for(Aperture* ap : ElementApertures)
+	{
+		sPositions.push_back(ap->getSlongitudinal());
+	}
+
+	// A single aperture makes one interval of constant size
+	const size_t nIntervals = ElementApertures.size() > 1 ? ElementApertures.size() - 1 : ElementApertures.size();
+	for(size_t n = 1; n <= nIntervals; n++)
+	{
+		Aperture* apBack = ElementApertures[n - 1];
+		Aperture* apFront = ElementApertures[min(n, ElementApertures.size() - 1)];
+		double delta_s = apFront->getSlongitudinal() - apBack->getSlongitudinal();
+
+		Interval i;
+		i.sFront = apFront->getSlongitudinal();
+		i.rectHalfWidth = apFront->getRectHalfWidth();
+		i.rectHalfHeight = apFront->getRectHalfHeight();
+		i.ellipHalfWidth = apFront->getEllipHalfWidth();
+		i.ellipHalfHeight = apFront->getEllipHalfHeight();
+		i.rectHalfWidthSlope = i.rectHalfHeightSlope = i.ellipHalfWidthSlope = i.ellipHalfHeightSlope = 0;
+		if(apFront != apBack)
+		{
+			i.rectHalfWidthSlope = (apFront->getRectHalfWidth() - apBack->getRectHalfWidth()) / delta_s;
+			i.rectHalfHeightSlope = (apFront->getRectHalfHeight() - apBack->getRectHalfHeight()) / delta_s;
+			i.ellipHalfWidthSlope = (apFront->getEllipHalfWidth() - apBack->getEllipHalfWidth()) / delta_s;
+			i.ellipHalfHeightSlope = (apFront->getEllipHalfHeight() - apBack->getEllipHalfHeight()) / delta_s;
+		}
+		i.minEnds = min(
+			{ apFront->getRectHalfWidth(), apFront->getRectHalfHeight(), apFront->getEllipHalfWidth(),
+			  apFront->getEllipHalfHeight(), apBack->getRectHalfWidth(), apBack->getRectHalfHeight(),
+			  apBack->getEllipHalfWidth(), apBack->getEllipHalfHeight() });
+		Intervals.push_back(i);
+	}
+
+	// Equal spacing allows the interval to be found directly
+	if(sPositions.size() > 2)
+	{
+		double spacing = (sPositions.back() - sPositions.front()) / (sPositions.size() - 1);
+		bool equal = spacing > 0;
+		for(size_t n = 1; n < sPositions.size() && equal; n++)
+		{
+			equal = fabs(sPositions[n] - sPositions[n - 1] - spacing) <= 1e-6 * spacing;
+		}
+		if(equal)
+		{
+			invSpacing = 1 / spacing;
+		}
+	}
 }
 
 InterpolatedRectEllipseAperture::~InterpolatedRectEllipseAperture()
@@ -31,54 +82,96 @@ InterpolatedRectEllipseAperture::~InterpolatedRectEllipseAperture()
 
 }
 
-bool InterpolatedRectEllipseAperture::CheckWithinApertureBoundaries(double x, double y, double z) const
+const InterpolatedRectEllipseAperture::Interval& InterpolatedRectEllipseAperture::FindInterval(double z) const
 {
-	Aperture* apBack;
-	Aperture* apFront;
-	double ax = fabs(x);
-	double ay = fabs(y);
-
-	for(size_t n = 1; n < ElementApertures.size(); n++)
+	// Index of the first aperture after the first at or beyond z,
+	// clamped to the last interval
+	const size_t last = Intervals.size();
+	size_t n;
+	if(invSpacing > 0)
 	{
-		if(ElementApertures[n]->getSlongitudinal() >= z)
+		double guess = ceil((z - sPositions.front()) * invSpacing);
+		n = guess < 1 ? 1 : (guess > last ? last : size_t(guess));
+		while(n > 1 && sPositions[n - 1] >= z)
+		{
+			n--;
+		}
+		while(n < last && sPositions[n] < z)
 		{
-			apFront = ElementApertures[n];
-			apBack = ElementApertures[n - 1];
-			break;
+			n++;
 		}
 	}
-	if(ax + ay
-		< min(
-			{ apFront->getRectHalfWidth(), apFront->getRectHalfHeight(), apFront->getEllipHalfWidth(),
-			  apFront->getEllipHalfHeight(), apBack->getRectHalfWidth(), apBack->getRectHalfHeight(),
-			  apBack->getEllipHalfWidth(), apBack->getEllipHalfHeight() }))
-		return true;
+	else
+	{
+		n = std::lower_bound(sPositions.begin() + 1, sPositions.end(), z) - sPositions.begin();
+		n = n < last ? n : last;
+	}
+	return Intervals[n - 1];
+}
+
+const InterpolatedRectEllipseAperture::Slice& InterpolatedRectEllipseAperture::SliceAt(double z) const
+{
+	// All particles of a step are checked at the same z, so keep the last
+	// slice of each thread
+	static thread_local size_t cachedId = 0;
+	static thread_local double cachedZ = 0;
+	static thread_local Slice slice;
+
+	if(cachedId == cacheId && cachedZ == z)
+	{
+		return slice;
+	}
+
+	const Interval& i = FindInterval(z);
+	slice.minEnds = i.minEnds;
+	slice.rectHalfWidth = i.rectHalfWidth - (i.rectHalfWidthSlope * (i.sFront - z));
+	slice.rectHalfHeight = i.rectHalfHeight - (i.rectHalfHeightSlope * (i.sFront - z));
+	slice.ellipHalfWidth = i.ellipHalfWidth - (i.ellipHalfWidthSlope * (i.sFront - z));
+	slice.ellipHalfHeight = i.ellipHalfHeight - (i.ellipHalfHeightSlope * (i.sFront - z));
+	slice.minDim = min({ slice.rectHalfWidth, slice.rectHalfHeight, slice.ellipHalfWidth, slice.ellipHalfHeight });
+	cachedId = cacheId;
+	cachedZ = z;
+	return slice;
+}
 
-	double delta_s = apFront->getSlongitudinal() - apBack->getSlongitudinal();
-	double rectHalfWidthAtZ = apFront->getRectHalfWidth()
-		- (((apFront->getRectHalfWidth() - apBack->getRectHalfWidth()) / delta_s)
-		* (apFront->getSlongitudinal() - z));
-	double rectHalfHeithAtZ = apFront->getRectHalfHeight()
-		- (((apFront->getRectHalfHeight() - apBack->getRectHalfHeight()) / delta_s)
-		* (apFront->getSlongitudinal() - z));
-	double ellipHalfWidthAtZ = apFront->getEllipHalfWidth()
-		- (((apFront->getEllipHalfWidth() - apBack->getEllipHalfWidth()) / delta_s)
-		* (apFront->getSlongitudinal() - z));
-	double ellipHalfHeightAtZ = apFront->getEllipHalfHeight()
-		- (((apFront->getEllipHalfHeight() - apBack->getEllipHalfHeight()) / delta_s)
-		* (apFront->getSlongitudinal() - z));
-
-	if(ax + ay < min(
-			{ rectHalfWidthAtZ, rectHalfHeithAtZ, ellipHalfWidthAtZ, ellipHalfHeightAtZ }))
+bool InterpolatedRectEllipseAperture::CheckWithinApertureBoundaries(double x, double y, double z) const
+{
+	const Slice& a = SliceAt(z);
+	double ax = fabs(x);
+	double ay = fabs(y);
+
+	if(ax + ay < a.minEnds)
+		return true;
+	if(ax + ay < a.minDim)
 		return true;
-	if(((x * x) / (ellipHalfWidthAtZ * ellipHalfWidthAtZ)) + ((y * y) / (ellipHalfHeightAtZ * ellipHalfHeightAtZ)) > 1)
+	if(((x * x) / (a.ellipHalfWidth * a.ellipHalfWidth)) + ((y * y) / (a.ellipHalfHeight * a.ellipHalfHeight)) > 1)
 		return false;
-	if(ax > rectHalfWidthAtZ || ay > rectHalfHeithAtZ)
+	if(ax > a.rectHalfWidth || ay > a.rectHalfHeight)
 		return false;
 	else
 		return true;
 }
 
+size_t InterpolatedRectEllipseAperture::CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z,
+	size_t n, char* inside) const
+{
+	const Slice a = SliceAt(z);
+	const double quick = max(a.minEnds, a.minDim);
+	const double ew2 = a.ellipHalfWidth * a.ellipHalfWidth;
+	const double eh2 = a.ellipHalfHeight * a.ellipHalfHeight;
+
+	size_t count = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		const double ax = fabs(x[i]);
+		const double ay = fabs(y[i]);
+		inside[i] = (ax + ay < quick) | (!(((x[i] * x[i]) / ew2) + ((y[i] * y[i]) / eh2) > 1)
+			& !(ax > a.rectHalfWidth) & !(ay > a.rectHalfHeight));
+		count += inside[i];
+	}
+	return count;
+}
+
 Aperture* InterpolatedRectEllipseAperture::getInstance(vector<Aperture*> apVec)
 {
 	return new InterpolatedRectEllipseAperture(apVec);
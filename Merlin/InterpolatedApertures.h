@@ -46,6 +46,12 @@ public:
 	 */
 	bool CheckWithinApertureBoundaries(double x, double y, double z) const;
 
+	/**
+	 *  InterpolatedRectEllipseAperture override of Aperture member function CheckBatchWithinApertureBoundaries()
+	 *  The aperture at z is interpolated once for the whole batch.
+	 */
+	size_t CheckBatchWithinApertureBoundaries(const double* x, const double* y, double z, size_t n, char* inside) const;
+
 	/**
 	 *  get new InterpolatedRectEllipseAperture instance - only called by ApertureFactory::getInstance class
 	 *  @param[in] vector of Aperture
@@ -53,7 +59,64 @@ public:
 	 */
 	static Aperture* getInstance(vector<Aperture*>);
 
+	/**
+	 *  The apertures interpolated between, in order of s. The intervals
+	 *  are set up from these on construction.
+	 */
 	vector<Aperture*> ElementApertures;
+
+private:
+
+	/**
+	 *  An interval between two apertures: the parameters at the front
+	 *  and their change per unit length, and the smallest of the
+	 *  parameters at either end.
+	 */
+	struct Interval
+	{
+		double sFront;
+		double rectHalfWidth, rectHalfHeight, ellipHalfWidth, ellipHalfHeight;
+		double rectHalfWidthSlope, rectHalfHeightSlope, ellipHalfWidthSlope, ellipHalfHeightSlope;
+		double minEnds;
+	};
+
+	/**
+	 *  The aperture interpolated at one z.
+	 */
+	struct Slice
+	{
+		double minEnds;
+		double minDim;
+		double rectHalfWidth, rectHalfHeight, ellipHalfWidth, ellipHalfHeight;
+	};
+
+	/**
+	 *  @return The interval whose front is the first at or after z
+	 */
+	const Interval& FindInterval(double z) const;
+
+	/**
+	 *  @return The aperture at z, reusing the last result of the calling
+	 *  thread when z is unchanged
+	 */
+	const Slice& SliceAt(double z) const;
+
+	/**
+	 *  The s of each aperture, and the intervals between them.
+	 *  Intervals[n - 1] ends at ElementApertures[n].
+	 */
+	vector<double> sPositions;
+	vector<Interval> Intervals;
+
+	/**
+	 *  If the apertures are equally spaced, 1 / the spacing, otherwise 0
+	 */
+	double invSpacing;
+
+	/**
+	 *  Distinguishes this aperture in the per-thread slice cache
+	 */
+	size_t cacheId;
 };
 
 typedef Aperture* (*getInterpolator)(vector<Aperture*>);
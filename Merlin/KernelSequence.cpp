@@ -0,0 +1,237 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "KernelSequence.h"
+#include "BasicTransportMaps.h"
+#include "TransportMatrix.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "ParallelFor.h"
+
+using namespace PhysicalConstants;
+using namespace PhysicalUnits;
+
+namespace
+{
+
+// particles taken through the whole sequence at a time
+const size_t blockSize = 64;
+
+} // end anonymous namespace
+
+namespace ParticleTracking
+{
+
+KernelSequence::Op::Op(OpKind k, double v) :
+	kind(k), value(v), scale(0)
+{
+}
+
+KernelSequence::KernelSequence()
+{
+}
+
+KernelSequence::~KernelSequence()
+{
+}
+
+KernelSequence::KernelSequence(KernelSequence&& rhs) :
+	ops(std::move(rhs.ops))
+{
+}
+
+KernelSequence& KernelSequence::operator=(KernelSequence&& rhs)
+{
+	ops = std::move(rhs.ops);
+	return *this;
+}
+
+void KernelSequence::AddMap(RTMap* m)
+{
+	std::unique_ptr<RTMap> owned(m);
+	ops.push_back(Op(opMap));
+	m->AppendTerms(ops.back().map);
+}
+
+void KernelSequence::AddMap(RTMap* m, double Eratio)
+{
+	std::unique_ptr<RTMap> owned(m);
+	ops.push_back(Op(opScaledMap, Eratio));
+	m->AppendTerms(ops.back().map);
+}
+
+void KernelSequence::AddDriftMap(double len)
+{
+	std::unique_ptr<RTMap> m(DriftTM(len));
+	ops.push_back(Op(opDriftMap, len));
+	m->AppendTerms(ops.back().map);
+}
+
+void KernelSequence::AddDrift(double len)
+{
+	ops.push_back(Op(opDrift, len));
+}
+
+void KernelSequence::AddLinearDrift(double len)
+{
+	ops.push_back(Op(opLinearDrift, len));
+}
+
+void KernelSequence::AddKick(const MultipoleField& field, double len, double P0, double q, double phi)
+{
+	ops.push_back(Op(opKick, len));
+	ops.back().scale = q * len * eV * SpeedOfLight / P0 * Complex(cos(phi), sin(phi));
+	ops.back().field.reset(new MultipoleField(field));
+}
+
+void KernelSequence::AddRotation(double phi)
+{
+	ops.push_back(Op(opMatrix));
+	ops.back().matrix.reset(new RMtrx(2));
+	TransportMatrix::Srot(phi, ops.back().matrix->R);
+}
+
+void KernelSequence::AddTransform(const Transform3D& t)
+{
+	if(!t.isIdentity())
+	{
+		ops.push_back(Op(opTransform));
+		ops.back().transform.reset(new PSvectorTransform3D(t));
+	}
+}
+
+void KernelSequence::Append(KernelSequence& seq)
+{
+	for(std::vector<Op>::iterator op = seq.ops.begin(); op != seq.ops.end(); op++)
+	{
+		ops.push_back(std::move(*op));
+	}
+	seq.ops.clear();
+}
+
+void KernelSequence::MergeDrifts()
+{
+	std::vector<Op> merged;
+	merged.reserve(ops.size());
+	for(std::vector<Op>::iterator op = ops.begin(); op != ops.end(); op++)
+	{
+		bool isDrift = op->kind == opDriftMap || op->kind == opLinearDrift;
+		if(isDrift && !merged.empty() && merged.back().kind == op->kind)
+		{
+			Op& last = merged.back();
+			last.value += op->value;
+			if(last.kind == opDriftMap)
+			{
+				std::unique_ptr<RTMap> m(DriftTM(last.value));
+				last.map.clear();
+				m->AppendTerms(last.map);
+			}
+		}
+		else
+		{
+			merged.push_back(std::move(*op));
+		}
+	}
+	ops.swap(merged);
+}
+
+bool KernelSequence::IsDrift() const
+{
+	for(std::vector<Op>::const_iterator op = ops.begin(); op != ops.end(); op++)
+	{
+		if(op->kind != opDriftMap && op->kind != opDrift && op->kind != opLinearDrift)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void KernelSequence::clear()
+{
+	ops.clear();
+}
+
+void KernelSequence::ApplyOp(const Op& op, PSvectorArray::iterator first, PSvectorArray::iterator last) const
+{
+	switch(op.kind)
+	{
+	case opMap:
+	case opDriftMap:
+		op.map.Apply(first, last);
+		break;
+	case opScaledMap:
+		op.map.Apply(first, last, op.value);
+		break;
+	case opDrift:
+		for(PSvectorArray::iterator p = first; p != last; p++)
+		{
+			const double xp = p->xp();
+			const double yp = p->yp();
+			p->x() += op.value * xp;
+			p->y() += op.value * yp;
+			p->ct() -= op.value * (xp * xp + yp * yp) / 2.0;
+		}
+		break;
+	case opLinearDrift:
+		for(PSvectorArray::iterator p = first; p != last; p++)
+		{
+			p->x() += p->xp() * op.value;
+			p->y() += p->yp() * op.value;
+		}
+		break;
+	case opKick:
+		for(PSvectorArray::iterator p = first; p != last; p++)
+		{
+			Complex F = op.scale * op.field->GetField2D(p->x(), p->y()) / (1 + p->dp());
+			p->xp() += -F.real();
+			p->yp() += F.imag();
+		}
+		break;
+	case opMatrix:
+		for(PSvectorArray::iterator p = first; p != last; p++)
+		{
+			op.matrix->Apply(*p);
+		}
+		break;
+	case opTransform:
+		for(PSvectorArray::iterator p = first; p != last; p++)
+		{
+			op.transform->Apply(*p);
+		}
+		break;
+	}
+}
+
+void KernelSequence::Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const
+{
+	while(first != last)
+	{
+		PSvectorArray::iterator end = (last - first) > ptrdiff_t(blockSize) ? first + blockSize : last;
+		for(std::vector<Op>::const_iterator op = ops.begin(); op != ops.end(); op++)
+		{
+			ApplyOp(*op, first, end);
+		}
+		first = end;
+	}
+}
+
+void KernelSequence::Apply(ParticleBunch& bunch) const
+{
+	if(ops.empty())
+	{
+		return;
+	}
+
+	PSvectorArray& particles = bunch.GetParticles();
+	Parallel::ForBlocks(particles.size(), blockSize, [this, &particles](size_t first, size_t last)
+	{
+		Apply(particles.begin() + first, particles.begin() + last);
+	});
+}
+
+} // end namespace ParticleTracking
@@ -0,0 +1,256 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef KernelSequence_h
+#define KernelSequence_h 1
+
+#include "merlin_config.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "ParticleBunch.h"
+#include "MultipoleField.h"
+#include "MatrixMaps.h"
+#include "PSvectorTransform3D.h"
+#include "RTMap.h"
+#include "LinearAlgebra.h"
+#include "TrackingKernels.h"
+
+namespace ParticleTracking
+{
+
+/**
+ *	A flat list of particle maps (matrices, drifts, thin kicks and
+ *	frame transformations) which are applied in order.
+ *
+ *	The TRANSPORT integrators build the maps for a step once as a
+ *	KernelSequence, which is then applied to the whole bunch, to one
+ *	tile of it in fused tracking, or appended to a CompiledLattice.
+ *	Applying a sequence involves no virtual calls into the model, no
+ *	allocation and no look up of element parameters. The maps are
+ *	applied to small blocks of particles, one map at a time, so that
+ *	the block stays in cache while it passes through the sequence.
+ *	Each map acts on each particle exactly as the TRANSPORT integrator
+ *	code it replaces, so the results are bit-identical.
+ */
+class KernelSequence
+{
+public:
+
+	KernelSequence();
+	~KernelSequence();
+
+	KernelSequence(KernelSequence&&);
+	KernelSequence& operator=(KernelSequence&&);
+
+	/**
+	 *	Append the map m, which is deleted by the sequence once its
+	 *	terms have been copied into a MapKernel.
+	 */
+	void AddMap(RTMap* m);
+
+	/**
+	 *	Append the map m, applied with dp/p scaled to the momentum
+	 *	Pref of the map, where Eratio = P0/Pref. m is deleted.
+	 */
+	void AddMap(RTMap* m, double Eratio);
+
+	/**
+	 *	Append the second order map of a drift of length len.
+	 */
+	void AddDriftMap(double len);
+
+	/**
+	 *	Append a drift of length len, which is exact to second order
+	 *	in the angles, including the path length.
+	 */
+	void AddDrift(double len);
+
+	/**
+	 *	Append a paraxial drift of length len, which changes x and y
+	 *	only.
+	 */
+	void AddLinearDrift(double len);
+
+	/**
+	 *	Append the thin kick of field integrated over the length len,
+	 *	for particles of charge q and reference momentum P0, with the
+	 *	field rotated by phi. A copy of field is kept.
+	 */
+	void AddKick(const MultipoleField& field, double len, double P0, double q, double phi = 0);
+
+	/**
+	 *	Append a rotation of the particle coordinates by phi about the
+	 *	z axis.
+	 */
+	void AddRotation(double phi);
+
+	/**
+	 *	Append the coordinate transformation t. Identity
+	 *	transformations are ignored.
+	 */
+	void AddTransform(const Transform3D& t);
+
+	/**
+	 *	Move the maps of seq to the end of this sequence.
+	 */
+	void Append(KernelSequence& seq);
+
+	/**
+	 *	Replace each run of consecutive drift maps, and each run of
+	 *	consecutive paraxial drifts, by a single drift of the total
+	 *	length. The result agrees with the original only to rounding.
+	 */
+	void MergeDrifts();
+
+	/**
+	 *	@return true if the sequence only contains drifts (of any kind).
+	 */
+	bool IsDrift() const;
+
+	void clear();
+
+	size_t size() const
+	{
+		return ops.size();
+	}
+
+	bool empty() const
+	{
+		return ops.empty();
+	}
+
+	/**
+	 *	Apply the sequence to the particles [first, last) on the
+	 *	calling thread.
+	 */
+	void Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const;
+
+	/**
+	 *	Apply the sequence to every particle in the bunch. Blocks of the
+	 *	bunch are shared between the threads.
+	 */
+	void Apply(ParticleBunch& bunch) const;
+
+	/**
+	 *	Apply the sequence to the coordinates x[0..5], ordered as in a
+	 *	PSvector, of any value type. With a TPSA this gives the Taylor
+	 *	expansion of the sequence about x.
+	 */
+	template<class T>
+	void Apply(T* x) const;
+
+private:
+
+	typedef enum
+	{
+		opMap,
+		opScaledMap,
+		opDriftMap,
+		opDrift,
+		opLinearDrift,
+		opKick,
+		opMatrix,
+		opTransform
+
+	} OpKind;
+
+	struct Op
+	{
+		OpKind kind;
+
+		/**
+		 *	The length of drifts, or P0/Pref for scaled maps.
+		 */
+		double value;
+
+		Complex scale;
+		MapKernel map;
+		std::unique_ptr<MultipoleField> field;
+		std::unique_ptr<RMtrx> matrix;
+		std::unique_ptr<PSvectorTransform3D> transform;
+
+		Op(OpKind k, double v = 0);
+	};
+
+	void ApplyOp(const Op& op, PSvectorArray::iterator first, PSvectorArray::iterator last) const;
+
+	std::vector<Op> ops;
+
+	//Copy protection
+	KernelSequence(const KernelSequence& rhs);
+	KernelSequence& operator=(const KernelSequence& rhs);
+};
+
+template<class T>
+void KernelSequence::Apply(T* x) const
+{
+	for(std::vector<Op>::const_iterator op = ops.begin(); op != ops.end(); op++)
+	{
+		switch(op->kind)
+		{
+		case opMap:
+		case opDriftMap:
+			op->map.Apply(x);
+			break;
+		case opScaledMap:
+			op->map.Apply(x, op->value);
+			break;
+		case opDrift:
+		{
+			const T xp = x[ps_XP];
+			const T yp = x[ps_YP];
+			x[ps_X] += op->value * xp;
+			x[ps_Y] += op->value * yp;
+			x[ps_CT] -= op->value * (xp * xp + yp * yp) / 2.0;
+			break;
+		}
+		case opLinearDrift:
+			x[ps_X] += x[ps_XP] * op->value;
+			x[ps_Y] += x[ps_YP] * op->value;
+			break;
+		case opKick:
+		{
+			T Br, Bi;
+			Kernels::MultipoleFieldEvaluator(*op->field)(x[ps_X], x[ps_Y], Br, Bi);
+			const T d = 1 + x[ps_DP];
+			const double sr = op->scale.real();
+			const double si = op->scale.imag();
+			x[ps_XP] += -((sr * Br - si * Bi) / d);
+			x[ps_YP] += (sr * Bi + si * Br) / d;
+			break;
+		}
+		case opMatrix:
+		{
+			const RealMatrix& R = op->matrix->R;
+			const int n = R.nrows();
+			T y[6];
+			for(int i = 0; i < n; i++)
+			{
+				y[i] = 0.0;
+				for(int j = 0; j < n; j++)
+				{
+					if(R(i, j) != 0)
+					{
+						y[i] += R(i, j) * x[j];
+					}
+				}
+			}
+			std::copy(y, y + n, x);
+			break;
+		}
+		case opTransform:
+			op->transform->Apply(x);
+			break;
+		}
+	}
+}
+
+} // end namespace ParticleTracking
+
+#endif
@@ -63,11 +63,9 @@ struct LCAVMap
 	double phi0;
 	double E0;
 	double E1;
-	mutable double Esum;
-	mutable size_t np;
 
 	LCAVMap(double g, double ds, double k1, double phi, double p0) :
-		k(k1), Ez(g * ds), L(ds), phi0(phi), E0(p0), E1(p0 + g * ds * cos(phi)), Esum(0), np(0)
+		k(k1), Ez(g * ds), L(ds), phi0(phi), E0(p0), E1(p0 + g * ds * cos(phi))
 	{
 	}
 
@@ -88,9 +86,6 @@ struct LCAVMap
 		x.yp() *= fact;
 
 		x.dp() = Eout / E1 - 1.0;
-
-		Esum += Eout;
-		np++;
 	}
 
 	double Eav() const
@@ -124,6 +124,7 @@ void LatticeFrame::ApplyLocalFrameTransform(const Transform3D& t)
 		(*local_T) *= t;
 	}
 
+	ModelElement::ModelChanged();
 	Invalidate();
 }
 
@@ -138,6 +139,7 @@ void LatticeFrame::SetLocalFrameTransform(const Transform3D& t)
 		(*local_T) = t;
 	}
 
+	ModelElement::ModelChanged();
 	Invalidate();
 }
 
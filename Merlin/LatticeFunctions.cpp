@@ -5,6 +5,7 @@
  * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
  */
 
+#include <exception>
 #include <fstream>
 #include <vector>
 #include "ParticleBunch.h"
@@ -17,10 +18,48 @@
 #include "NumericalConstants.h"
 #include "TLAS.h"
 #include "LatticeFunctions.h"
+#include "ParallelFor.h"
 
 using namespace ParticleTracking;
 using namespace TLAS;
 
+namespace
+{
+
+/*
+ * Call f(n) for each n in [0, count), shared between threads. An
+ * exception thrown by any call is passed on to the caller.
+ */
+template<class F>
+void ForEachConcurrently(size_t count, F f)
+{
+	std::vector<std::exception_ptr> errors(count);
+	Parallel::ForThreadBlocks(count, Parallel::ThreadsFor(count, 1), 1, [&](int, size_t first, size_t last)
+	{
+		for(size_t n = first; n < last; n++)
+		{
+			try
+			{
+				f(n);
+			}
+			catch(...)
+			{
+				errors[n] = std::current_exception();
+			}
+		}
+	});
+
+	for(size_t n = 0; n < count; n++)
+	{
+		if(errors[n])
+		{
+			std::rethrow_exception(errors[n]);
+		}
+	}
+}
+
+} // end anonymous namespace
+
 LatticeFunction::LatticeFunction(int _i, int _j, int _k) :
 	i(_i), j(_j), k(_k)
 {
@@ -96,7 +135,8 @@ void LatticeFunction::Derivative(LatticeFunction* lfnM, LatticeFunction* lfnP, d
 }
 
 LatticeFunctionTable::LatticeFunctionTable(AcceleratorModel* aModel, double refMomentum) :
-	theModel(aModel), p0(refMomentum), delta(1.0e-8), bendscale(1.0e-16), symplectify(false), orbitonly(true)
+	theModel(aModel), p0(refMomentum), delta(1.0e-8), bendscale(1.0e-16), symplectify(false), orbitonly(true),
+	useTPSA(false), fixedMomentum(false), momentumOffset(0)
 {
 	UseDefaultFunctions();
 }
@@ -125,6 +165,11 @@ void LatticeFunctionTable::SetDelta(double new_delta)
 	delta = new_delta;
 }
 
+void LatticeFunctionTable::UseTPSA(bool flag)
+{
+	useTPSA = flag;
+}
+
 void LatticeFunctionTable::ScaleBendPathLength(double scale)
 {
 	bendscale = scale;
@@ -254,11 +299,11 @@ void LatticeFunctionTable::Calculate(PSvector* p, RealMatrix* M)
 {
 	if(orbitonly)
 	{
-		DoCalculateOrbitOnly(bendscale, p);
+		DoCalculateOrbitOnly(lfnlist, bendscale, p);
 	}
 	else
 	{
-		DoCalculate(bendscale, p, M);
+		DoCalculate(lfnlist, bendscale, p, M);
 	}
 }
 
@@ -282,14 +327,29 @@ public:
 
 void LatticeFunctionTable::CalculateEnergyDerivative()
 {
-	double dpP = orbitonly ? DoCalculateOrbitOnly(bendscale) : DoCalculate(bendscale);
+	// the two momenta are calculated concurrently, each into its own copy
+	// of the functions
 	vectorlfn lfnP;
-	for_each(lfnlist.begin(), lfnlist.end(), CopyLatticeFunction(lfnP));
-
-	double dpM = orbitonly ? DoCalculateOrbitOnly(-bendscale) : DoCalculate(-bendscale);
 	vectorlfn lfnM;
+	for_each(lfnlist.begin(), lfnlist.end(), CopyLatticeFunction(lfnP));
 	for_each(lfnlist.begin(), lfnlist.end(), CopyLatticeFunction(lfnM));
 
+	double dpP = 0;
+	double dpM = 0;
+	ForEachConcurrently(2, [&](size_t n)
+	{
+		if(n == 0)
+		{
+			// only one pass writes the matrix files
+			dpP = orbitonly ? DoCalculateOrbitOnly(lfnP, bendscale)
+				  : DoCalculate(lfnP, bendscale, nullptr, nullptr, false);
+		}
+		else
+		{
+			dpM = orbitonly ? DoCalculateOrbitOnly(lfnM, -bendscale) : DoCalculate(lfnM, -bendscale);
+		}
+	});
+
 	for_each(lfnlist.begin(), lfnlist.end(), ClearLatticeFunction());
 
 	double dp = dpP - dpM;
@@ -301,12 +361,50 @@ void LatticeFunctionTable::CalculateEnergyDerivative()
 		(*lfnit)->Derivative(*lfnitM, *lfnitP, dp);
 	}
 
+	for_each(lfnP.begin(), lfnP.end(), DeleteLatticeFunction());
+	for_each(lfnM.begin(), lfnM.end(), DeleteLatticeFunction());
+}
+
+void LatticeFunctionTable::CalculateMomentumScan(const vector<double>& dp, vector<LatticeFunctionTable*>& tables)
+{
+	tables.clear();
+	for(size_t n = 0; n < dp.size(); n++)
+	{
+		LatticeFunctionTable* table = new LatticeFunctionTable(theModel, p0);
+		table->delta = delta;
+		table->bendscale = bendscale;
+		table->symplectify = symplectify;
+		table->useTPSA = useTPSA;
+		table->fixedMomentum = true;
+		table->momentumOffset = dp[n];
+
+		for_each(table->lfnlist.begin(), table->lfnlist.end(), DeleteLatticeFunction());
+		table->lfnlist.clear();
+		for_each(lfnlist.begin(), lfnlist.end(), CopyLatticeFunction(table->lfnlist));
+		table->orbitonly = orbitonly;
+
+		tables.push_back(table);
+	}
+
+	ForEachConcurrently(tables.size(), [&](size_t n)
+	{
+		LatticeFunctionTable* table = tables[n];
+		if(orbitonly)
+		{
+			table->DoCalculateOrbitOnly(table->lfnlist, bendscale);
+		}
+		else
+		{
+			table->DoCalculate(table->lfnlist, bendscale, nullptr, nullptr, false);
+		}
+	});
 }
 
-double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMatrix* MInit)
+double LatticeFunctionTable::DoCalculate(vectorlfn& lfns, double cscale, PSvector* pInit, RealMatrix* MInit,
+	bool output)
 {
         int Ndim,Nsize;
-	for_each(lfnlist.begin(), lfnlist.end(), ClearLatticeFunction());
+	for_each(lfns.begin(), lfns.end(), ClearLatticeFunction());
 
 	PSvector p(0);
 	if(pInit)
@@ -315,8 +413,10 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 	}
 	else
 	{
+		p.dp() = momentumOffset;
 		ClosedOrbit co(theModel, p0);
 		co.SetDelta(delta);
+		co.UseTPSA(useTPSA);
 		co.TransverseOnly(true);
 		co.ScaleBendPathLength(cscale);
 		co.FindClosedOrbit(p);
@@ -331,6 +431,7 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 	{
 		TransferMatrix tm(theModel, p0);
 		tm.SetDelta(delta);
+		tm.UseTPSA(useTPSA);
 		tm.ScaleBendPathLength(cscale);
 		tm.FindTM(M, p);
 	}
@@ -360,8 +461,23 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 		}
 	}
         
-	ofstream nfile("DataFiles/NormMatrix.dat");
-	MatrixForm(N, nfile, OPFormat().precision(6).fixed());
+	for(vectorlfn::iterator lfnit = lfns.begin(); lfnit != lfns.end(); lfnit++)
+	{
+		int i, j, k;
+		(*lfnit)->GetIndices(i, j, k);
+		if(k == 3 && !eigenOK)
+		{
+			cout << " Illegal attempt to calculate longitudinal lattice parameter with unstable motion" << endl;
+			throw MerlinException();
+		}
+	}
+
+	ofstream nfile;
+	if(output)
+	{
+		nfile.open("DataFiles/NormMatrix.dat");
+		MatrixForm(N, nfile, OPFormat().precision(6).fixed());
+	}
 
 	for(row = 0; row < Ndim; row++)
 	{
@@ -376,10 +492,13 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 
        
 	N = N * R;
-	nfile << endl;
-	MatrixForm(R, nfile, OPFormat().precision(6).fixed());
-	nfile << endl;
-	MatrixForm(N, nfile, OPFormat().precision(6).fixed());
+	if(output)
+	{
+		nfile << endl;
+		MatrixForm(R, nfile, OPFormat().precision(6).fixed());
+		nfile << endl;
+		MatrixForm(N, nfile, OPFormat().precision(6).fixed());
+	}
       
 
 	ParticleBunch* particle = new ParticleBunch(p0, 1.0);
@@ -414,6 +533,12 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 	double e1 = e0;
 	double s  = 0;
 
+	// the position, orbit and normalising matrix at each element, from
+	// which the functions are found once the tracking is complete
+	vector<double> sAt;
+	vector<Particle> orbitAt;
+	vector<RealMatrix> NAt;
+
 	do
 	{
 
@@ -457,7 +582,9 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 
 		N  = M21 * N;
 
-		for_each(lfnlist.begin(), lfnlist.end(), CalculateLatticeFunction(s, pref1, N,eigenOK));
+		sAt.push_back(s);
+		orbitAt.push_back(pref1);
+		NAt.push_back(N);
 		if(isMore)
 		{
 			s += tracker.GetCurrentComponent().GetLength();
@@ -470,16 +597,32 @@ double LatticeFunctionTable::DoCalculate(double cscale, PSvector* pInit, RealMat
 
 	} while(loop);
 
-	ofstream mfile("TransferMatrix.dat");
-	MatrixForm(M2, mfile, OPFormat().precision(6).fixed());
+	// each function is independent of the others
+	Parallel::ForThreadBlocks(lfns.size(), Parallel::ThreadsFor(lfns.size(), 1), 1, [&](int, size_t first,
+		size_t last)
+	{
+		for(size_t n = first; n < last; n++)
+		{
+			for(size_t row = 0; row < sAt.size(); row++)
+			{
+				CalculateLatticeFunction(sAt[row], orbitAt[row], NAt[row], eigenOK)(lfns[n]);
+			}
+		}
+	});
+
+	if(output)
+	{
+		ofstream mfile("TransferMatrix.dat");
+		MatrixForm(M2, mfile, OPFormat().precision(6).fixed());
+	}
 
 	delete particle;
 	return p.dp();
 }
 
-double LatticeFunctionTable::DoCalculateOrbitOnly(double cscale, PSvector* pInit)
+double LatticeFunctionTable::DoCalculateOrbitOnly(vectorlfn& lfns, double cscale, PSvector* pInit)
 {
-	for_each(lfnlist.begin(), lfnlist.end(), ClearLatticeFunction());
+	for_each(lfns.begin(), lfns.end(), ClearLatticeFunction());
 
 	PSvector p(0);
 	if(pInit)
@@ -489,7 +632,13 @@ double LatticeFunctionTable::DoCalculateOrbitOnly(double cscale, PSvector* pInit
 	else
 	{
 		ClosedOrbit co(theModel, p0);
+		if(fixedMomentum)
+		{
+			p.dp() = momentumOffset;
+			co.TransverseOnly(true);
+		}
 		co.SetDelta(delta);
+		co.UseTPSA(useTPSA);
 		co.ScaleBendPathLength(cscale);
 		co.FindClosedOrbit(p);
 	}
@@ -518,7 +667,7 @@ double LatticeFunctionTable::DoCalculateOrbitOnly(double cscale, PSvector* pInit
 		ParticleBunch::const_iterator ip = tracker.GetTrackedBunch().begin();
 		const Particle& pref = *ip++;
 
-		for_each(lfnlist.begin(), lfnlist.end(), CalculateLatticeFunction(s, pref, N1));
+		for_each(lfns.begin(), lfns.end(), CalculateLatticeFunction(s, pref, N1));
 		s += tracker.GetCurrentComponent().GetLength();
 		loop = tracker.StepComponent();
 
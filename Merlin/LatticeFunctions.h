@@ -43,11 +43,27 @@ public:
 	void RemoveAllFunctions();
 	void Calculate(PSvector* p = nullptr, RealMatrix* M = nullptr);
 	void CalculateEnergyDerivative();
+
+	/**
+	 * Calculate the functions for each of the momentum offsets dp, with
+	 * the closed orbit found in the transverse planes for that fixed dp.
+	 * The momenta are shared between threads. tables receives one table
+	 * for each offset, with the functions and settings of this table;
+	 * they are created with new and are owned by the caller.
+	 */
+	void CalculateMomentumScan(const vector<double>& dp, vector<LatticeFunctionTable*>& tables);
 	double Value(int i, int j, int k, int ncpt);
 	void PrintTable(ostream& os, int n1 = 0, int n2 = -1);
 	void Size(int& rows, int& cols);
 	int GetSPosIndex(double s);
 	void SetDelta(double new_delta);
+
+	/**
+	 * If true, the closed orbit and the one-turn matrix are found with
+	 * TPSA maps (see ClosedOrbit::UseTPSA()) instead of finite
+	 * differences. Default false.
+	 */
+	void UseTPSA(bool flag);
 	void MakeTMSymplectic(bool flag);
 	int NumberOfRows();
 	void ScaleBendPathLength(double scale);
@@ -61,11 +77,19 @@ private:
 	double bendscale;
 	bool symplectify;
 	bool orbitonly;
+	bool useTPSA;
+	bool fixedMomentum;
+	double momentumOffset;
 
 	vectorlfn lfnlist;
 
-	double DoCalculate(double cscale = 0, PSvector* pInit = nullptr, RealMatrix* MInit = nullptr);
-	double DoCalculateOrbitOnly(double cscale = 0, PSvector* pInit = nullptr);
+	/**
+	 * Calculate the functions lfns. The matrices are also written to
+	 * files if output is true.
+	 */
+	double DoCalculate(vectorlfn& lfns, double cscale = 0, PSvector* pInit = nullptr, RealMatrix* MInit = nullptr,
+		bool output = true);
+	double DoCalculateOrbitOnly(vectorlfn& lfns, double cscale = 0, PSvector* pInit = nullptr);
 	vectorlfn::iterator GetColumn(int i, int j, int k);
 };
 
@@ -5,7 +5,49 @@
  * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
  */
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
 #include "LossMapCollimationOutput.h"
+#include "MerlinException.h"
+
+namespace
+{
+
+/*
+ * Partial loss map file layout, in native byte order:
+ *
+ *	char[8]		magic "MRLNLOS"
+ *	uint32		layout version
+ *	uint32		unused
+ *	uint64		number of elements
+ *
+ * and then for each element
+ *
+ *	uint64		length of the name
+ *	char[]		name
+ *	double		lattice position
+ *	double		length
+ *	uint64		temperature
+ *	uint64		number of intervals
+ *	uint64[]	losses in each interval
+ */
+
+const char partialMagic[8] = "MRLNLOS";
+const std::uint32_t partialVersion = 1;
+
+struct PartialHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t unused;
+	std::uint64_t nelements;
+};
+
+} // end anonymous namespace
 
 namespace ParticleTracking
 {
@@ -17,6 +59,27 @@ void LossMapCollimationOutput::Dispose(AcceleratorComponent& currcomponent, doub
 		currentComponent = &currcomponent;
 	}
 
+	if(streaming)
+	{
+		auto c = componentIndex.find(currentComponent);
+		if(c == componentIndex.end())
+		{
+			const size_t e = FindElement(currentComponent->GetQualifiedName(),
+				currentComponent->GetComponentLatticePosition(), currentComponent->GetLength(),
+				Temperature(*currentComponent));
+			c = componentIndex.insert(std::make_pair(currentComponent, e)).first;
+		}
+
+		std::vector<size_t>& bins = elements[c->second].bins;
+		const size_t k = Interval(pos);
+		if(k >= bins.size())
+		{
+			bins.resize(k + 1, 0);
+		}
+		bins[k]++;
+		return;
+	}
+
 	temp.reset();
 
 	temp.ElementName = currentComponent->GetQualifiedName().c_str();
@@ -26,145 +89,330 @@ void LossMapCollimationOutput::Dispose(AcceleratorComponent& currcomponent, doub
 	temp.position = (pos + temp.s);
 	temp.length = currentComponent->GetLength();
 	temp.lost = 1;
+	temp.interval = IntervalStart(Interval(pos));
+	temp.temperature = Temperature(*currentComponent);
+	temp.p = particle;
 
-	//calculate 10cm interval - move to 10cm binning?
-	double inter = 0.0;
-	bool fin = false;
+	//pushback vector
+	DeadParticles.push_back(temp);
+}
 
-	do
+size_t LossMapCollimationOutput::Interval(double pos)
+{
+	size_t k = pos > 0 ? static_cast<size_t>(pos * 10) : 0;
+	while(k > 0 && pos < IntervalStart(k))
 	{
-		if((pos >= inter) && (pos < (inter + 0.1)))
-		{
-			temp.interval = inter;
-			fin = true;
-		}
-		else
-		{
-			inter += 0.1;
-		}
-	} while(fin == false);
+		k--;
+	}
+	while(pos >= IntervalStart(k + 1))
+	{
+		k++;
+	}
+	return k;
+}
 
-	//For Loss Maps
-	if(currentComponent->GetType() == "Collimator")
+double LossMapCollimationOutput::IntervalStart(size_t k)
+{
+	// The interval starts are running sums of 0.1, so that they are
+	// exactly the values printed in the tencm output.
+	while(intervals.size() <= k)
 	{
-		temp.temperature = LossData::Collimator;
+		intervals.push_back(intervals.back() + 0.1);
 	}
-	else
+	return intervals[k];
+}
+
+LossData::LossTypes LossMapCollimationOutput::Temperature(const AcceleratorComponent& component) const
+{
+	//For Loss Maps
+	if(component.GetType() == "Collimator")
 	{
-		temp.temperature = LossData::Cold;
+		return LossData::Collimator;
 	}
 
 	//Now check for warm regions.
+	const double s = component.GetComponentLatticePosition();
 	for(std::vector<std::pair<double, double> >::const_iterator WarmRegionsIterator = WarmRegions.begin();
 		WarmRegionsIterator != WarmRegions.end(); WarmRegionsIterator++)
 	{
-		if(currentComponent->GetType() != "Collimator" && temp.s >= WarmRegionsIterator->first && temp.s <=
-			WarmRegionsIterator->second)
+		if(s >= WarmRegionsIterator->first && s <= WarmRegionsIterator->second)
 		{
-			temp.temperature = LossData::Warm;
+			return LossData::Warm;
 		}
 	}
+	return LossData::Cold;
+}
 
-	temp.p = particle;
+size_t LossMapCollimationOutput::FindElement(const std::string& name, double s, double length,
+	LossData::LossTypes temperature)
+{
+	auto n = nameIndex.find(name);
+	if(n == nameIndex.end())
+	{
+		n = nameIndex.insert(std::make_pair(name, names.size())).first;
+		names.push_back(name);
+	}
 
-	//pushback vector
-	DeadParticles.push_back(temp);
+	auto e = elementIndex.find(std::make_pair(n->second, s));
+	if(e != elementIndex.end())
+	{
+		return e->second;
+	}
+
+	ElementLosses element;
+	element.name = n->second;
+	element.s = s;
+	element.length = length;
+	element.temperature = temperature;
+	element.bins.assign(static_cast<size_t>(std::max(length, 0.0) * 10) + 1, 0);
+	elements.push_back(element);
+	elementIndex.insert(std::make_pair(std::make_pair(n->second, s), elements.size() - 1));
+	return elements.size() - 1;
 }
 
-LossMapCollimationOutput::LossMapCollimationOutput(OutputType ot)
+LossMapCollimationOutput::LossMapCollimationOutput(OutputType ot) :
+	streaming(false), intervals(1, 0.0)
 {
 	otype = ot;
 }
 
-void LossMapCollimationOutput::Finalise()
+LossMapCollimationOutput::~LossMapCollimationOutput()
 {
-	//First sort DeadParticles according to s
-	sort(DeadParticles.begin(), DeadParticles.end(), Compare_LossData);
+}
 
-	std::cout << "CollimationOutput:: DeadParticles.size() = " << DeadParticles.size() << std::endl;
+void LossMapCollimationOutput::SetStreaming(bool s)
+{
+	if(s && otype == precise)
+	{
+		throw MerlinException("LossMapCollimationOutput: precise losses cannot be streamed");
+	}
+	streaming = s;
+}
 
-	int outit = 0;
-	int total = 0;
+bool LossMapCollimationOutput::GetStreaming() const
+{
+	return streaming;
+}
 
+void LossMapCollimationOutput::AddOutputLoss(LossData d, size_t n)
+{
 	switch(otype)
 	{
 	case nearestelement:
-		for(std::vector<LossData>::const_iterator it = DeadParticles.begin(); it != DeadParticles.end(); ++it)
+		// the first loss of the first element is counted twice, as it
+		// always has been
+		if(OutputLosses.size() == 0)
 		{
-			++total;
-			// Start at s = min and push back the first LossData
-			if(OutputLosses.size() == 0)
-			{
-				OutputLosses.push_back(*it);
-			}
+			d.lost = 1;
+			OutputLosses.push_back(d);
+		}
 
-			// If old element ++loss
-			if(it->ElementName == OutputLosses[outit].ElementName)
-			{
-				OutputLosses[outit].lost += 1;
-			}
-			// If new element OutputLosses.push_back
-			else
-			{
-				OutputLosses.push_back(*it);
-				outit++;
-			}
+		// If old element ++loss
+		if(d.ElementName == OutputLosses.back().ElementName)
+		{
+			OutputLosses.back().lost += n;
+		}
+		// If new element OutputLosses.push_back
+		else
+		{
+			d.lost = n;
+			OutputLosses.push_back(d);
+		}
+		break;
+	case tencm:
+		// If in the same bin ++loss
+		if(OutputLosses.size() != 0 && d.ElementName == OutputLosses.back().ElementName && d.interval
+			== OutputLosses.back().interval)
+		{
+			OutputLosses.back().lost += n;
+		}
+		// If new element outit.push_back and set loss to n
+		else
+		{
+			d.lost = n;
+			OutputLosses.push_back(d);
 		}
 		break;
 	case precise:
-		for(std::vector<LossData>::const_iterator it = DeadParticles.begin(); it != DeadParticles.end(); ++it)
+		break;
+	}
+}
+
+void LossMapCollimationOutput::Finalise()
+{
+	int outit = 0;
+	size_t total = 0;
+
+	if(streaming)
+	{
+		if(otype == precise)
 		{
-			++total;
-			// Start at s = min and push back the first LossData
-			if(OutputLosses.size() == 0)
-			{
-				OutputLosses.push_back(*it);
-			}
+			throw MerlinException("LossMapCollimationOutput: precise losses cannot be streamed");
+		}
 
-			// If position is equal
-			if(it->position == OutputLosses[outit].position)
-			{
-				OutputLosses[outit].lost += 1;
-			}
-			// If new element outit.push_back
-			else
+		// elements in order of s, as the losses are sorted otherwise
+		std::vector<size_t> order(elements.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+		{
+			return elements[a].s < elements[b].s || (elements[a].s == elements[b].s
+			&& names[elements[a].name] < names[elements[b].name]);
+		});
+
+		for(size_t e : order)
+		{
+			const ElementLosses& element = elements[e];
+			LossData d;
+			d.reset();
+			d.ElementName = names[element.name];
+			d.s = element.s;
+			d.length = element.length;
+			d.temperature = element.temperature;
+			for(size_t k = 0; k < element.bins.size(); k++)
 			{
-				OutputLosses.push_back(*it);
-				outit++;
+				if(element.bins[k] > 0)
+				{
+					d.interval = IntervalStart(k);
+					d.position = d.s + d.interval;
+					AddOutputLoss(d, element.bins[k]);
+					total += element.bins[k];
+				}
 			}
 		}
-		break;
-	case tencm:
-		for(std::vector<LossData>::const_iterator it = DeadParticles.begin(); it != DeadParticles.end(); ++it)
+		std::cout << "CollimationOutput:: streamed losses = " << total << std::endl;
+	}
+	else
+	{
+		//First sort DeadParticles according to s
+		sort(DeadParticles.begin(), DeadParticles.end(), Compare_LossData);
+
+		std::cout << "CollimationOutput:: DeadParticles.size() = " << DeadParticles.size() << std::endl;
+
+		total = DeadParticles.size();
+		if(otype == precise)
 		{
-			++total;
-			//if no losses are yet stored
-			if(OutputLosses.size() == 0)
-			{
-				OutputLosses.push_back(*it);
-				OutputLosses[outit].lost = 1;
-			}
-			// If in the same bin ++loss
-			else if((it->ElementName == OutputLosses[outit].ElementName) && (it->interval ==
-				OutputLosses[outit].interval))
+			for(std::vector<LossData>::const_iterator it = DeadParticles.begin(); it != DeadParticles.end(); ++it)
 			{
-				OutputLosses[outit].lost += 1;
+				// Start at s = min and push back the first LossData
+				if(OutputLosses.size() == 0)
+				{
+					OutputLosses.push_back(*it);
+				}
+
+				// If position is equal
+				if(it->position == OutputLosses[outit].position)
+				{
+					OutputLosses[outit].lost += 1;
+				}
+				// If new element outit.push_back
+				else
+				{
+					OutputLosses.push_back(*it);
+					outit++;
+				}
 			}
-			// If new element outit.push_back and set loss to 1
-			else
+		}
+		else
+		{
+			for(std::vector<LossData>::const_iterator it = DeadParticles.begin(); it != DeadParticles.end(); ++it)
 			{
-				OutputLosses.push_back(*it);
-				outit++;
-				OutputLosses[outit].lost = 1;
+				AddOutputLoss(*it, 1);
 			}
 		}
-		break;
 	}
 
 	std::cout << "CollimationOutput:: OutputLosses.size() = " << OutputLosses.size() << std::endl;
 	std::cout << "CollimationOutput:: Total losses = " << total << std::endl;
 }
 
+void LossMapCollimationOutput::WritePartial(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		throw MerlinException("LossMapCollimationOutput: cannot open " + filename);
+	}
+
+	PartialHeader header;
+	memcpy(header.magic, partialMagic, sizeof(partialMagic));
+	header.version = partialVersion;
+	header.unused = 0;
+	header.nelements = elements.size();
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	auto write = [&out](std::uint64_t n)
+		{
+			out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+		};
+	for(const ElementLosses& element : elements)
+	{
+		const std::string& name = names[element.name];
+		write(name.size());
+		out.write(name.data(), name.size());
+		out.write(reinterpret_cast<const char*>(&element.s), sizeof(double));
+		out.write(reinterpret_cast<const char*>(&element.length), sizeof(double));
+		write(element.temperature);
+		write(element.bins.size());
+		for(size_t n : element.bins)
+		{
+			write(n);
+		}
+	}
+
+	out.close();
+	if(!out)
+	{
+		throw MerlinException("LossMapCollimationOutput: error writing " + filename);
+	}
+}
+
+void LossMapCollimationOutput::MergePartial(const std::string& filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	PartialHeader header;
+	if(!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| memcmp(header.magic, partialMagic, sizeof(partialMagic)) != 0 || header.version != partialVersion)
+	{
+		throw MerlinException("LossMapCollimationOutput: " + filename + " is not a partial loss map");
+	}
+
+	auto read = [&in]()
+		{
+			std::uint64_t n = 0;
+			in.read(reinterpret_cast<char*>(&n), sizeof(n));
+			return n;
+		};
+	for(std::uint64_t i = 0; i < header.nelements && in; i++)
+	{
+		std::string name(read(), '\0');
+		in.read(&name[0], name.size());
+		double s = 0, length = 0;
+		in.read(reinterpret_cast<char*>(&s), sizeof(double));
+		in.read(reinterpret_cast<char*>(&length), sizeof(double));
+		const LossData::LossTypes temperature = static_cast<LossData::LossTypes>(read());
+		const size_t nbins = read();
+		if(!in)
+		{
+			break;
+		}
+
+		std::vector<size_t>& bins = elements[FindElement(name, s, length, temperature)].bins;
+		if(nbins > bins.size())
+		{
+			bins.resize(nbins, 0);
+		}
+		for(size_t k = 0; k < nbins; k++)
+		{
+			bins[k] += read();
+		}
+	}
+
+	if(!in)
+	{
+		throw MerlinException("LossMapCollimationOutput: error reading " + filename);
+	}
+}
+
 void LossMapCollimationOutput::Output(std::ostream* os)
 {
 	switch(otype)
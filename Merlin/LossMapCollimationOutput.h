@@ -8,7 +8,9 @@
 #ifndef LossMapCollimationOutput_h
 #define LossMapCollimationOutput_h 1
 
+#include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "CollimationOutput.h"
@@ -59,6 +61,32 @@ public:
 	 */
 	std::vector<std::pair<double, double> > GetWarmRegions() const;
 
+	/**
+	 * Selects streaming accumulation, which must be set before the first
+	 * loss. Rather than keeping a LossData record for every lost particle,
+	 * Dispose() then counts each loss in a histogram of the 10 cm intervals
+	 * of its element, and Finalise() builds the same output from the
+	 * histograms. The memory used depends on the number of elements with
+	 * losses, not on the number of particles. Only the nearestelement and
+	 * tencm output types can be streamed.
+	 */
+	void SetStreaming(bool s);
+	bool GetStreaming() const;
+
+	/**
+	 * Writes the streamed histograms to a binary file, so that the losses
+	 * of separate jobs can be combined with MergePartial() before
+	 * Finalise(). Throws MerlinException if the file cannot be written.
+	 */
+	void WritePartial(const std::string& filename) const;
+
+	/**
+	 * Adds the streamed histograms from a file written by WritePartial().
+	 * Elements are matched by name and lattice position. Throws
+	 * MerlinException if the file cannot be read.
+	 */
+	void MergePartial(const std::string& filename);
+
 protected:
 
 	//A vector of std::pair containing the start and end of warm regions of the machine. Can be empty. First contains the start location, and second the end.
@@ -66,6 +94,53 @@ protected:
 
 private:
 
+	/**
+	 * Streamed losses in one element.
+	 */
+	struct ElementLosses
+	{
+		size_t name;
+		double s;
+		double length;
+		LossData::LossTypes temperature;
+
+		/**
+		 * Number of losses in each 10 cm interval.
+		 */
+		std::vector<size_t> bins;
+	};
+
+	bool streaming;
+
+	/**
+	 * Element names, each stored once.
+	 */
+	std::vector<std::string> names;
+	std::map<std::string, size_t> nameIndex;
+
+	std::vector<ElementLosses> elements;
+	std::map<std::pair<size_t, double>, size_t> elementIndex;
+	std::unordered_map<const AcceleratorComponent*, size_t> componentIndex;
+
+	/**
+	 * Start of each 10 cm interval within an element.
+	 */
+	std::vector<double> intervals;
+
+	/**
+	 * Returns the 10 cm interval holding the position pos within an
+	 * element, and the start of interval k.
+	 */
+	size_t Interval(double pos);
+	double IntervalStart(size_t k);
+	LossData::LossTypes Temperature(const AcceleratorComponent& component) const;
+	size_t FindElement(const std::string& name, double s, double length, LossData::LossTypes temperature);
+
+	/**
+	 * Adds n losses like d to OutputLosses, for the nearestelement and
+	 * tencm output types.
+	 */
+	void AddOutputLoss(LossData d, size_t n);
 };
 
 }
@@ -8,6 +8,7 @@
 #include <cassert>
 #include "PSTypes.h"
 #include "MatrixMaps.h"
+#include "ParallelFor.h"
 
 namespace
 {
@@ -89,10 +90,10 @@ PSvector& RMtrx::Apply(PSvector& x, double p0) const
 
 PSvectorArray& RMtrx::Apply(PSvectorArray& xa) const
 {
-	for(PSvectorArray::iterator p = xa.begin(); p != xa.end(); p++)
+	Parallel::ForEach(xa.begin(), xa.end(), [this](PSvector& p)
 	{
-		Apply(*p);
-	}
+		Apply(p);
+	});
 	return xa;
 }
 
@@ -103,10 +104,10 @@ PSvectorArray& RMtrx::Apply(PSvectorArray& xa, double p0) const
 		return Apply(xa);
 	}
 
-	for(PSvectorArray::iterator p = xa.begin(); p != xa.end(); p++)
+	Parallel::ForEach(xa.begin(), xa.end(), [this, p0](PSvector& p)
 	{
-		Apply(*p, p0);
-	}
+		Apply(p, p0);
+	});
 	return xa;
 }
 
@@ -202,10 +203,10 @@ PSvector& RdpMtrx::Apply(PSvector& x, double p0) const
 
 PSvectorArray& RdpMtrx::Apply(PSvectorArray& xa) const
 {
-	for(PSvectorArray::iterator p = xa.begin(); p != xa.end(); p++)
+	Parallel::ForEach(xa.begin(), xa.end(), [this](PSvector& p)
 	{
-		Apply(*p);
-	}
+		Apply(p);
+	});
 	return xa;
 }
 
@@ -216,10 +217,10 @@ PSvectorArray& RdpMtrx::Apply(PSvectorArray& xa, double p0) const
 		return Apply(xa);
 	}
 
-	for(PSvectorArray::iterator p = xa.begin(); p != xa.end(); p++)
+	Parallel::ForEach(xa.begin(), xa.end(), [this, p0](PSvector& p)
 	{
-		Apply(*p, p0);
-	}
+		Apply(p, p0);
+	});
 	return xa;
 }
 
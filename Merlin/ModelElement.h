@@ -9,6 +9,7 @@
 #define ModelElement_h 1
 
 #include "merlin_config.h"
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -73,6 +74,23 @@ public:
 
 	virtual void AppendBeamlineIndexes(std::vector<size_t>& ivec) const = 0;
 
+	/**
+	 * Returns a counter which is incremented whenever an element of
+	 * any model is changed through a read/write channel or has its
+	 * frame moved. Objects which cache values derived from the model
+	 * (for example ParticleTracking::CompiledLattice) compare it with
+	 * the value at the time the cache was built.
+	 * @return The current model generation
+	 */
+	static unsigned long GetModelGeneration();
+
+	/**
+	 * Increment the model generation. Code which changes element
+	 * parameters directly, rather than through a channel, should call
+	 * this so that cached values are rebuilt.
+	 */
+	static void ModelChanged();
+
 protected:
 
 	/**
@@ -86,6 +104,10 @@ protected:
 	 */
 	std::string id;
 
+private:
+
+	static std::atomic<unsigned long>& Generation();
+
 }; // Class ModelElement
 
 inline ModelElement::ModelElement(const std::string& aName) :
@@ -113,6 +135,22 @@ inline void ModelElement::SetName(const std::string& name)
 	id = name;
 }
 
+inline std::atomic<unsigned long>& ModelElement::Generation()
+{
+	static std::atomic<unsigned long> generation(0);
+	return generation;
+}
+
+inline unsigned long ModelElement::GetModelGeneration()
+{
+	return Generation();
+}
+
+inline void ModelElement::ModelChanged()
+{
+	++Generation();
+}
+
 inline void ModelElement::Init(const std::string& aName)
 {
 	id = aName;
@@ -10,6 +10,7 @@
 #include "ParticleBunchProcess.h"
 #include "ParticleBunch.h"
 #include <string>
+#include <algorithm>
 
 using namespace ParticleTracking;
 
@@ -65,6 +66,33 @@ void NANCheckProcess::DoProcess(const double ds)
 	}
 }
 
+void NANCheckProcess::BeginTiles(double ds, size_t ntiles)
+{
+	tileFound.assign(ntiles, 0);
+}
+
+size_t NANCheckProcess::DoProcessTile(double ds, size_t tile, size_t first, size_t last)
+{
+	const ParticleBunch::iterator p = currentBunch->begin();
+	for(size_t i = first; i < last; i++)
+	{
+		if(!is_good(p[i]) && !reported.count(p[i].id()))
+		{
+			tileFound[tile] = 1;
+			break;
+		}
+	}
+	return last;
+}
+
+void NANCheckProcess::EndTiles(double ds)
+{
+	if(std::find(tileFound.begin(), tileFound.end(), 1) != tileFound.end())
+	{
+		DoProcess(ds);
+	}
+}
+
 void NANCheckProcess::Report(int id) const
 {
 	if(detailed)
@@ -93,19 +121,10 @@ void NANCheckProcess::Report(int id) const
 
 void NANCheckProcess::DoCull()
 {
-	ParticleBunch* NewBunch = new ParticleBunch(currentBunch->GetReferenceMomentum(), currentBunch->GetTotalCharge()
-		/ currentBunch->size());
-	NewBunch->reserve(currentBunch->size());
-	for(auto &p : *currentBunch)
+	currentBunch->RemoveIf([](const PSvector& p)
 	{
-		if(is_good(p))
-		{
-			NewBunch->AddParticle(p);
-		}
-	}
-	currentBunch->clear();
-	currentBunch->swap(*NewBunch);
-	delete NewBunch;
+		return !is_good(p);
+	});
 }
 
 double NANCheckProcess::GetMaxAllowedStepSize() const
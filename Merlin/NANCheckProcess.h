@@ -11,6 +11,7 @@
 #include "ParticleBunchProcess.h"
 #include "ParticleBunch.h"
 #include <set>
+#include <vector>
 
 namespace ParticleTracking
 {
@@ -43,6 +44,23 @@ public:
 	double GetMaxAllowedStepSize() const;
 	void SetCurrentComponent(AcceleratorComponent& component);
 
+	/**
+	 * In a fused step the tiles are only scanned for new invalid
+	 * particles. If any are found, DoProcess() reports (and culls)
+	 * them once all the tiles are done.
+	 */
+	bool IsParticleLocal() const
+	{
+		return true;
+	}
+	bool IsTileBarrier() const
+	{
+		return cull;
+	}
+	void BeginTiles(double ds, size_t ntiles);
+	size_t DoProcessTile(double ds, size_t tile, size_t first, size_t last);
+	void EndTiles(double ds);
+
 	/// Enable or disable detailed mode
 	void SetDetailed(bool enable = true)
 	{
@@ -68,6 +86,7 @@ private:
 	PSvectorArray start_coords; // particles at start of element
 	PSvectorArray prev_coords; // particles at start of element
 	std::set<double> reported;
+	std::vector<char> tileFound;
 };
 
 } // end namespace ParticleTracking
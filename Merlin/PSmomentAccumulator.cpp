@@ -0,0 +1,182 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "PSmomentAccumulator.h"
+
+PSmomentAccumulator::PSmomentAccumulator(bool h) :
+	n(0), higher(h)
+{
+	std::fill(mean, mean + 6, 0.0);
+	std::fill(m2, m2 + 21, 0.0);
+	std::fill(m3, m3 + 6, 0.0);
+	std::fill(m4, m4 + 6, 0.0);
+}
+
+void PSmomentAccumulator::Add(const PSvector* p, size_t np)
+{
+	if(np == 0)
+	{
+		return;
+	}
+
+	// the block on its own, in two passes
+	PSmomentAccumulator b(higher);
+	b.n = np;
+	for(size_t k = 0; k < np; k++)
+	{
+		for(int i = 0; i < 6; i++)
+		{
+			b.mean[i] += p[k][i];
+		}
+	}
+	for(int i = 0; i < 6; i++)
+	{
+		b.mean[i] /= np;
+	}
+
+	for(size_t k = 0; k < np; k++)
+	{
+		double d[6];
+		for(int i = 0; i < 6; i++)
+		{
+			d[i] = p[k][i] - b.mean[i];
+		}
+		double* s = b.m2;
+		for(int i = 0; i < 6; i++)
+		{
+			for(int j = 0; j <= i; j++)
+			{
+				*s++ += d[i] * d[j];
+			}
+		}
+		if(higher)
+		{
+			for(int i = 0; i < 6; i++)
+			{
+				const double d2 = d[i] * d[i];
+				b.m3[i] += d2 * d[i];
+				b.m4[i] += d2 * d2;
+			}
+		}
+	}
+
+	Merge(b);
+}
+
+void PSmomentAccumulator::Merge(const PSmomentAccumulator& b)
+{
+	if(b.n == 0)
+	{
+		return;
+	}
+	if(n == 0)
+	{
+		const bool h = higher;
+		*this = b;
+		higher = h;
+		return;
+	}
+
+	const double na = n;
+	const double nb = b.n;
+	const double nt = na + nb;
+	double delta[6];
+	for(int i = 0; i < 6; i++)
+	{
+		delta[i] = b.mean[i] - mean[i];
+	}
+
+	if(higher)
+	{
+		// the higher moments use the second moments before the update
+		for(int i = 0; i < 6; i++)
+		{
+			const double d = delta[i];
+			const double d2 = d * d;
+			const double m2a = m2[Index(i, i)];
+			const double m2b = b.m2[Index(i, i)];
+			m4[i] += b.m4[i] + d2 * d2 * na * nb * (na * na - na * nb + nb * nb) / (nt * nt * nt)
+				+ 6 * d2 * (na * na * m2b + nb * nb * m2a) / (nt * nt) + 4 * d * (na * b.m3[i] - nb * m3[i]) / nt;
+			m3[i] += b.m3[i] + d2 * d * na * nb * (na - nb) / (nt * nt) + 3 * d * (na * m2b - nb * m2a) / nt;
+		}
+	}
+
+	const double f = na * nb / nt;
+	double* s = m2;
+	const double* sb = b.m2;
+	for(int i = 0; i < 6; i++)
+	{
+		for(int j = 0; j <= i; j++)
+		{
+			*s++ += *sb++ + f * delta[i] * delta[j];
+		}
+	}
+	for(int i = 0; i < 6; i++)
+	{
+		mean[i] += delta[i] * nb / nt;
+	}
+	n = nt;
+}
+
+double PSmomentAccumulator::Covariance(int i, int j) const
+{
+	return n > 0 ? m2[Index(i, j)] / n : 0;
+}
+
+double PSmomentAccumulator::Skewness(int i) const
+{
+	const double v = Variance(i);
+	return v > 0 ? m3[i] / n / (v * sqrt(v)) : 0;
+}
+
+double PSmomentAccumulator::Kurtosis(int i) const
+{
+	const double v = Variance(i);
+	return v > 0 ? m4[i] / n / (v * v) : 0;
+}
+
+PSmoments& PSmomentAccumulator::GetMoments(PSmoments& sigma) const
+{
+	for(int i = 0; i < 6; i++)
+	{
+		sigma[i] = mean[i];
+		for(int j = 0; j <= i; j++)
+		{
+			sigma(i, j) = Covariance(i, j);
+		}
+	}
+	return sigma;
+}
+
+PSvector& PSmomentAccumulator::GetCentroid(PSvector& p) const
+{
+	for(int i = 0; i < 6; i++)
+	{
+		p[i] = mean[i];
+	}
+	return p;
+}
+
+void PSmomentAccumulator::Pack(double* buf) const
+{
+	*buf++ = n;
+	buf = std::copy(mean, mean + 6, buf);
+	buf = std::copy(m2, m2 + 21, buf);
+	buf = std::copy(m3, m3 + 6, buf);
+	std::copy(m4, m4 + 6, buf);
+}
+
+void PSmomentAccumulator::Unpack(const double* buf)
+{
+	n = *buf++;
+	std::copy(buf, buf + 6, mean);
+	std::copy(buf + 6, buf + 27, m2);
+	std::copy(buf + 27, buf + 33, m3);
+	std::copy(buf + 33, buf + 39, m4);
+}
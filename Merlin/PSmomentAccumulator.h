@@ -0,0 +1,124 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef PSmomentAccumulator_h
+#define PSmomentAccumulator_h 1
+
+#include "merlin_config.h"
+#include <cstddef>
+#include "PSvector.h"
+#include "PSmoments.h"
+
+/**
+ *	Accumulates the number, mean and central second moments of a set
+ *	of phase space vectors, and optionally the third and fourth central
+ *	moments of each coordinate.
+ *
+ *	Blocks of vectors are added with a two-pass sum over the block,
+ *	which is still in cache for the second pass, and accumulators are
+ *	combined with the exact pairwise update of Chan, Golub and LeVeque
+ *	(and Pebay for the higher moments). A large set of vectors can then
+ *	be summed in blocks on separate threads, or on separate MPI ranks,
+ *	and the partial results merged without loss of accuracy.
+ */
+class PSmomentAccumulator
+{
+public:
+
+	/**
+	 *	Number of doubles used by Pack() and Unpack().
+	 */
+	static const size_t packedSize = 1 + 6 + 21 + 6 + 6;
+
+	/**
+	 *	An empty accumulator. With higher true the third and fourth
+	 *	moments are also accumulated.
+	 */
+	explicit PSmomentAccumulator(bool higher = false);
+
+	/**
+	 *	Add the n vectors starting at p.
+	 */
+	void Add(const PSvector* p, size_t n);
+
+	/**
+	 *	Add a single vector.
+	 */
+	void Add(const PSvector& p)
+	{
+		Add(&p, 1);
+	}
+
+	/**
+	 *	Combine with the moments of a disjoint set of vectors.
+	 */
+	void Merge(const PSmomentAccumulator& a);
+
+	/**
+	 *	@return The number of vectors added
+	 */
+	double Count() const
+	{
+		return n;
+	}
+
+	double Mean(int i) const
+	{
+		return mean[i];
+	}
+
+	/**
+	 *	@return The covariance of coordinates i and j, normalised by
+	 *	the number of vectors
+	 */
+	double Covariance(int i, int j) const;
+
+	double Variance(int i) const
+	{
+		return Covariance(i, i);
+	}
+
+	/**
+	 *	@return The third and fourth standardised moments of coordinate
+	 *	i. Only available if the higher moments are accumulated.
+	 */
+	double Skewness(int i) const;
+	double Kurtosis(int i) const;
+
+	/**
+	 *	Copy the means and the covariance matrix to sigma.
+	 */
+	PSmoments& GetMoments(PSmoments& sigma) const;
+	PSvector& GetCentroid(PSvector& p) const;
+
+	/**
+	 *	Write the accumulator to packedSize doubles, and read it back,
+	 *	for example to combine the accumulators of several MPI ranks.
+	 */
+	void Pack(double* buf) const;
+	void Unpack(const double* buf);
+
+private:
+
+	double n;
+	double mean[6];
+
+	/**
+	 *	Sums of products of deviations from the mean, lower triangle.
+	 */
+	double m2[21];
+	double m3[6];
+	double m4[6];
+	bool higher;
+
+	static int Index(int i, int j)
+	{
+		return i >= j ? i * (i + 1) / 2 + j : j * (j + 1) / 2 + i;
+	}
+};
+
+#endif
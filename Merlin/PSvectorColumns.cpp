@@ -0,0 +1,113 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "PSvectorColumns.h"
+
+void PSvectorColumns::Assign(const PSvectorArray& particles)
+{
+	const size_t n = particles.size();
+	resize(n);
+
+	// Transpose one column at a time so that each destination
+	// array is written sequentially.
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		double* c = cols[k].data();
+		for(size_t i = 0; i < n; i++)
+		{
+			c[i] = particles[i][k];
+		}
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		const PSvector& p = particles[i];
+		tags[i].type = p.type();
+		tags[i].location = p.location();
+		tags[i].id = p.id();
+		tags[i].sd = p.sd();
+	}
+}
+
+void PSvectorColumns::CopyTo(PSvectorArray& particles) const
+{
+	const size_t n = size();
+	particles.resize(n);
+
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		const double* c = cols[k].data();
+		for(size_t i = 0; i < n; i++)
+		{
+			particles[i][k] = c[i];
+		}
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		PSvector& p = particles[i];
+		p.type() = tags[i].type;
+		p.location() = tags[i].location;
+		p.id() = tags[i].id;
+		p.sd() = tags[i].sd;
+	}
+}
+
+void PSvectorColumns::reserve(size_t n)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].reserve(n);
+	}
+	tags.reserve(n);
+}
+
+void PSvectorColumns::resize(size_t n)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].resize(n);
+	}
+	tags.resize(n);
+}
+
+void PSvectorColumns::clear()
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].clear();
+	}
+	tags.clear();
+}
+
+void PSvectorColumns::push_back(const PSvector& p)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].push_back(p[k]);
+	}
+	PSvectorTag t = {p.type(), p.location(), p.id(), p.sd()};
+	tags.push_back(t);
+}
+
+void PSvectorColumns::erase(size_t i)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].erase(cols[k].begin() + i);
+	}
+	tags.erase(tags.begin() + i);
+}
+
+void PSvectorColumns::swap(PSvectorColumns& rhs)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k].swap(rhs.cols[k]);
+	}
+	tags.swap(rhs.tags);
+}
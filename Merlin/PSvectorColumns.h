@@ -0,0 +1,524 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef PSvectorColumns_h
+#define PSvectorColumns_h 1
+
+#include "merlin_config.h"
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "PSvector.h"
+
+/**
+ *	Number of phase space coordinates held in their own column
+ *	(x, xp, y, yp, ct, dp). The remaining PSvector entries
+ *	(type, location, id, sd) are kept together in a side array.
+ */
+#define PS_COLUMNS 6
+
+/**
+ *	Non-dynamic per-particle data (type, location, id, sd) which is
+ *	carried along with the phase space coordinates but which is not
+ *	touched by the tracking maps.
+ */
+struct PSvectorTag
+{
+	double type;
+	double location;
+	double id;
+	double sd;
+};
+
+/**
+ *	A structure-of-arrays representation of a PSvectorArray.
+ *
+ *	Each of the six phase space coordinates is stored in its own
+ *	contiguous array, so that a map which only modifies a few
+ *	coordinates only streams those columns through memory, and the
+ *	per-coordinate loops can be vectorised by the compiler. Element
+ *	access is provided through a PSvector-like proxy, so that code
+ *	written against the PSvector accessors (x(), xp() etc.) can be used
+ *	unchanged with a PSvectorColumns iterator.
+ */
+class PSvectorColumns
+{
+public:
+
+	class reference;
+	class const_reference;
+	template<class C, class R> class basic_iterator;
+
+	typedef basic_iterator<PSvectorColumns, reference> iterator;
+	typedef basic_iterator<const PSvectorColumns, const_reference> const_iterator;
+	typedef PSvector value_type;
+	typedef size_t size_type;
+
+	PSvectorColumns()
+	{
+	}
+
+	explicit PSvectorColumns(const PSvectorArray& particles)
+	{
+		Assign(particles);
+	}
+
+	/**
+	 *	Replace the contents with the transpose of particles.
+	 */
+	void Assign(const PSvectorArray& particles);
+
+	/**
+	 *	Write the contents back to particles (which is resized to
+	 *	match).
+	 */
+	void CopyTo(PSvectorArray& particles) const;
+
+	size_t size() const
+	{
+		return tags.size();
+	}
+
+	bool empty() const
+	{
+		return tags.empty();
+	}
+
+	void reserve(size_t n);
+	void resize(size_t n);
+	void clear();
+	void push_back(const PSvector& p);
+
+	/**
+	 *	Remove the particle at index i, preserving the order of the
+	 *	remaining particles.
+	 */
+	void erase(size_t i);
+
+	void swap(PSvectorColumns& rhs);
+
+	/**
+	 *	Raw column access. For coord < PS_COLUMNS this returns the
+	 *	contiguous array of that coordinate.
+	 */
+	double* column(PScoord coord)
+	{
+		return cols[coord].data();
+	}
+	const double* column(PScoord coord) const
+	{
+		return cols[coord].data();
+	}
+
+	double* x()
+	{
+		return column(ps_X);
+	}
+	double* xp()
+	{
+		return column(ps_XP);
+	}
+	double* y()
+	{
+		return column(ps_Y);
+	}
+	double* yp()
+	{
+		return column(ps_YP);
+	}
+	double* ct()
+	{
+		return column(ps_CT);
+	}
+	double* dp()
+	{
+		return column(ps_DP);
+	}
+
+	PSvectorTag* tag()
+	{
+		return tags.data();
+	}
+	const PSvectorTag* tag() const
+	{
+		return tags.data();
+	}
+
+	/**
+	 *	Returns a copy of particle i as a PSvector.
+	 */
+	PSvector Get(size_t i) const;
+
+	/**
+	 *	Overwrite particle i with p.
+	 */
+	void Set(size_t i, const PSvector& p);
+
+	reference operator[](size_t i);
+	const_reference operator[](size_t i) const;
+
+	iterator begin();
+	iterator end();
+	const_iterator begin() const;
+	const_iterator end() const;
+
+private:
+
+	std::vector<double> cols[PS_COLUMNS];
+	std::vector<PSvectorTag> tags;
+};
+
+/**
+ *	Mutable proxy for a single particle in a PSvectorColumns.
+ *	Provides the same component accessors as PSvector.
+ */
+class PSvectorColumns::reference
+{
+public:
+
+	reference(PSvectorColumns& c, size_t n) :
+		owner(&c), i(n)
+	{
+	}
+
+	reference(const reference&) = default;
+
+	double& x() const
+	{
+		return owner->cols[ps_X][i];
+	}
+	double& xp() const
+	{
+		return owner->cols[ps_XP][i];
+	}
+	double& y() const
+	{
+		return owner->cols[ps_Y][i];
+	}
+	double& yp() const
+	{
+		return owner->cols[ps_YP][i];
+	}
+	double& ct() const
+	{
+		return owner->cols[ps_CT][i];
+	}
+	double& dp() const
+	{
+		return owner->cols[ps_DP][i];
+	}
+	double& type() const
+	{
+		return owner->tags[i].type;
+	}
+	double& location() const
+	{
+		return owner->tags[i].location;
+	}
+	double& id() const
+	{
+		return owner->tags[i].id;
+	}
+	double& sd() const
+	{
+		return owner->tags[i].sd;
+	}
+
+	double& operator[](PScoord coord) const
+	{
+		return coord < PS_COLUMNS ? owner->cols[coord][i] : (&owner->tags[i].type)[coord - PS_COLUMNS];
+	}
+
+	operator PSvector() const
+	{
+		return owner->Get(i);
+	}
+
+	const reference& operator=(const PSvector& p) const
+	{
+		owner->Set(i, p);
+		return *this;
+	}
+
+	const reference& operator=(const reference& rhs) const
+	{
+		owner->Set(i, rhs);
+		return *this;
+	}
+
+	const reference* operator->() const
+	{
+		return this;
+	}
+
+private:
+	PSvectorColumns* owner;
+	size_t i;
+};
+
+/**
+ *	Read-only proxy for a single particle in a PSvectorColumns.
+ */
+class PSvectorColumns::const_reference
+{
+public:
+
+	const_reference(const PSvectorColumns& c, size_t n) :
+		owner(&c), i(n)
+	{
+	}
+
+	double x() const
+	{
+		return owner->cols[ps_X][i];
+	}
+	double xp() const
+	{
+		return owner->cols[ps_XP][i];
+	}
+	double y() const
+	{
+		return owner->cols[ps_Y][i];
+	}
+	double yp() const
+	{
+		return owner->cols[ps_YP][i];
+	}
+	double ct() const
+	{
+		return owner->cols[ps_CT][i];
+	}
+	double dp() const
+	{
+		return owner->cols[ps_DP][i];
+	}
+	double type() const
+	{
+		return owner->tags[i].type;
+	}
+	double location() const
+	{
+		return owner->tags[i].location;
+	}
+	double id() const
+	{
+		return owner->tags[i].id;
+	}
+	double sd() const
+	{
+		return owner->tags[i].sd;
+	}
+
+	double operator[](PScoord coord) const
+	{
+		return coord < PS_COLUMNS ? owner->cols[coord][i] : (&owner->tags[i].type)[coord - PS_COLUMNS];
+	}
+
+	operator PSvector() const
+	{
+		return owner->Get(i);
+	}
+
+	const const_reference* operator->() const
+	{
+		return this;
+	}
+
+private:
+	const PSvectorColumns* owner;
+	size_t i;
+};
+
+/**
+ *	Random access iterator over a PSvectorColumns. Dereferencing
+ *	returns a proxy (R) rather than a PSvector&.
+ */
+template<class C, class R>
+class PSvectorColumns::basic_iterator
+{
+public:
+
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef PSvector value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef R reference;
+	typedef R pointer;
+
+	basic_iterator() :
+		owner(nullptr), i(0)
+	{
+	}
+
+	basic_iterator(C* c, size_t n) :
+		owner(c), i(n)
+	{
+	}
+
+	/**
+	 *	Allow conversion of iterator to const_iterator.
+	 */
+	template<class C2, class R2>
+	basic_iterator(const basic_iterator<C2, R2>& it) :
+		owner(it.owner), i(it.i)
+	{
+	}
+
+	R operator*() const
+	{
+		return R(*owner, i);
+	}
+	R operator->() const
+	{
+		return R(*owner, i);
+	}
+	R operator[](difference_type n) const
+	{
+		return R(*owner, i + n);
+	}
+
+	/**
+	 *	Index of the current particle in the owning container.
+	 */
+	size_t index() const
+	{
+		return i;
+	}
+
+	basic_iterator& operator++()
+	{
+		++i;
+		return *this;
+	}
+	basic_iterator operator++(int)
+	{
+		basic_iterator t(*this);
+		++i;
+		return t;
+	}
+	basic_iterator& operator--()
+	{
+		--i;
+		return *this;
+	}
+	basic_iterator operator--(int)
+	{
+		basic_iterator t(*this);
+		--i;
+		return t;
+	}
+	basic_iterator& operator+=(difference_type n)
+	{
+		i += n;
+		return *this;
+	}
+	basic_iterator& operator-=(difference_type n)
+	{
+		i -= n;
+		return *this;
+	}
+	basic_iterator operator+(difference_type n) const
+	{
+		return basic_iterator(owner, i + n);
+	}
+	basic_iterator operator-(difference_type n) const
+	{
+		return basic_iterator(owner, i - n);
+	}
+	difference_type operator-(const basic_iterator& rhs) const
+	{
+		return difference_type(i) - difference_type(rhs.i);
+	}
+
+	bool operator==(const basic_iterator& rhs) const
+	{
+		return i == rhs.i;
+	}
+	bool operator!=(const basic_iterator& rhs) const
+	{
+		return i != rhs.i;
+	}
+	bool operator<(const basic_iterator& rhs) const
+	{
+		return i < rhs.i;
+	}
+	bool operator>(const basic_iterator& rhs) const
+	{
+		return i > rhs.i;
+	}
+	bool operator<=(const basic_iterator& rhs) const
+	{
+		return i <= rhs.i;
+	}
+	bool operator>=(const basic_iterator& rhs) const
+	{
+		return i >= rhs.i;
+	}
+
+private:
+	C* owner;
+	size_t i;
+
+	template<class C2, class R2> friend class basic_iterator;
+};
+
+inline PSvectorColumns::reference PSvectorColumns::operator[](size_t i)
+{
+	return reference(*this, i);
+}
+
+inline PSvectorColumns::const_reference PSvectorColumns::operator[](size_t i) const
+{
+	return const_reference(*this, i);
+}
+
+inline PSvectorColumns::iterator PSvectorColumns::begin()
+{
+	return iterator(this, 0);
+}
+
+inline PSvectorColumns::iterator PSvectorColumns::end()
+{
+	return iterator(this, size());
+}
+
+inline PSvectorColumns::const_iterator PSvectorColumns::begin() const
+{
+	return const_iterator(this, 0);
+}
+
+inline PSvectorColumns::const_iterator PSvectorColumns::end() const
+{
+	return const_iterator(this, size());
+}
+
+inline PSvector PSvectorColumns::Get(size_t i) const
+{
+	PSvector p;
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		p[k] = cols[k][i];
+	}
+	p.type() = tags[i].type;
+	p.location() = tags[i].location;
+	p.id() = tags[i].id;
+	p.sd() = tags[i].sd;
+	return p;
+}
+
+inline void PSvectorColumns::Set(size_t i, const PSvector& p)
+{
+	for(PScoord k = 0; k < PS_COLUMNS; k++)
+	{
+		cols[k][i] = p[k];
+	}
+	tags[i].type = p.type();
+	tags[i].location = p.location();
+	tags[i].id = p.id();
+	tags[i].sd = p.sd();
+}
+
+#endif
@@ -31,6 +31,13 @@ public:
 	PSvectorArray& Apply(PSvectorArray& pv) const;
 	PSvector& operator ()(PSvector& p) const;
 
+	/**
+	 *	Apply to the coordinates p[0..5], ordered as in a PSvector, of
+	 *	any value type (for example a TPSA).
+	 */
+	template<class V>
+	void Apply(V* p) const;
+
 private:
 
 	Transform3D T;
@@ -42,4 +49,36 @@ inline PSvector& PSvectorTransform3D::operator ()(PSvector& p) const
 	return Apply(p);
 }
 
+template<class V>
+void PSvectorTransform3D::Apply(V* p) const
+{
+	const Point3D& X0 = T.X();
+	if(bNoRot)
+	{
+		p[ps_X] += (X0.z * p[ps_XP] - X0.x);
+		p[ps_Y] += (X0.z * p[ps_YP] - X0.y);
+		return;
+	}
+
+	// the columns of the rotation
+	const Vector3D ex = T(Vector3D(1, 0, 0));
+	const Vector3D ey = T(Vector3D(0, 1, 0));
+	const Vector3D ez = T(Vector3D(0, 0, 1));
+
+	// X = R(x - X0), V = R(x', y', 1)
+	const V x = p[ps_X] - X0.x;
+	const V y = p[ps_Y] - X0.y;
+	const V X = ex.x * x + ey.x * y - ez.x * X0.z;
+	const V Y = ex.y * x + ey.y * y - ez.y * X0.z;
+	const V Z = ex.z * x + ey.z * y - ez.z * X0.z;
+	const V Vz = ex.z * p[ps_XP] + ey.z * p[ps_YP] + ez.z;
+	const V Vx = (ex.x * p[ps_XP] + ey.x * p[ps_YP] + ez.x) / Vz;
+	const V Vy = (ex.y * p[ps_XP] + ey.y * p[ps_YP] + ez.y) / Vz;
+
+	p[ps_X] = X - Z * Vx;
+	p[ps_Y] = Y - Z * Vy;
+	p[ps_XP] = Vx;
+	p[ps_YP] = Vy;
+}
+
 #endif
@@ -0,0 +1,45 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "ParallelFor.h"
+
+namespace
+{
+
+int numThreads = 0;
+size_t grainSize = 4096;
+
+} // end anonymous namespace
+
+namespace Parallel
+{
+
+void SetNumThreads(int n)
+{
+	numThreads = n > 0 ? n : 0;
+}
+
+int GetNumThreads()
+{
+#ifdef ENABLE_OPENMP
+	return numThreads > 0 ? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+void SetGrainSize(size_t n)
+{
+	grainSize = n > 0 ? n : 1;
+}
+
+size_t GetGrainSize()
+{
+	return grainSize;
+}
+
+} // end namespace Parallel
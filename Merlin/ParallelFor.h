@@ -0,0 +1,174 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef _ParallelFor_h_
+#define _ParallelFor_h_ 1
+
+#include <cstddef>
+#include <vector>
+
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
+/**
+ *	Loops over the particles of a bunch shared between the threads of the
+ *	OpenMP thread pool (enabled with the ENABLE_OPENMP cmake option).
+ *
+ *	The range is always split into contiguous blocks with a static
+ *	schedule and every index is processed exactly once, so a loop body
+ *	which only touches its own particle gives identical results for any
+ *	number of threads. Ranges shorter than the grain size are run on the
+ *	calling thread. Without OpenMP all functions are plain serial loops.
+ */
+namespace Parallel
+{
+
+/**
+ *	Set the number of threads used. A value <= 0 restores the OpenMP default.
+ */
+void SetNumThreads(int n);
+
+/**
+ *	@return The number of threads used for parallel loops.
+ */
+int GetNumThreads();
+
+/**
+ *	Set the smallest loop length that is split between threads.
+ */
+void SetGrainSize(size_t n);
+size_t GetGrainSize();
+
+/**
+ *	@return The number of threads that will be used for a loop of length n,
+ *	splitting loops of at least grain iterations.
+ */
+inline int ThreadsFor(size_t n, size_t grain)
+{
+#ifdef ENABLE_OPENMP
+	return n < grain ? 1 : GetNumThreads();
+#else
+	return 1;
+#endif
+}
+
+inline int ThreadsFor(size_t n)
+{
+	return ThreadsFor(n, GetGrainSize());
+}
+
+/**
+ *	Call f(t, first, last) on nt contiguous blocks covering [0, n), one per
+ *	thread. The blocks are numbered in order, t = 0 .. nt - 1, so results
+ *	gathered per block can be combined in index order. Block boundaries are
+ *	multiples of align so that vector loops only have a scalar tail at the
+ *	end of the range.
+ */
+template<class F>
+void ForThreadBlocks(size_t n, int nt, size_t align, F f)
+{
+	if(nt <= 1)
+	{
+		if(n)
+		{
+			f(0, size_t(0), n);
+		}
+		return;
+	}
+
+	size_t block = (n + nt - 1) / nt;
+	block = ((block + align - 1) / align) * align;
+
+#ifdef ENABLE_OPENMP
+	#pragma omp parallel for schedule(static) num_threads(nt)
+#endif
+	for(int t = 0; t < nt; t++)
+	{
+		const size_t first = t * block < n ? t * block : n;
+		const size_t last = first + block < n ? first + block : n;
+		if(first < last)
+		{
+			f(t, first, last);
+		}
+	}
+}
+
+/**
+ *	Call f(first, last) on contiguous blocks covering [0, n), one per
+ *	thread. Block boundaries are multiples of align.
+ */
+template<class F>
+void ForBlocks(size_t n, size_t align, F f)
+{
+	ForThreadBlocks(n, ThreadsFor(n), align, [&f](int, size_t first, size_t last)
+	{
+		f(first, last);
+	});
+}
+
+/**
+ *	Call f(i) for each i in [0, n).
+ */
+template<class F>
+void For(size_t n, F f)
+{
+	ForBlocks(n, 1, [&f](size_t first, size_t last)
+	{
+		for(size_t i = first; i < last; i++)
+		{
+			f(i);
+		}
+	});
+}
+
+/**
+ *	Call f(*i) for each element of a random access range.
+ */
+template<class It, class F>
+void ForEach(It first, It last, F f)
+{
+	For(last - first, [&first, &f](size_t i)
+	{
+		f(first[i]);
+	});
+}
+
+/**
+ *	@return The smallest i in [0, n) for which pred(i) is true, or n.
+ */
+template<class P>
+size_t FindFirst(size_t n, P pred)
+{
+	const int nt = ThreadsFor(n);
+	std::vector<size_t> found(nt, n);
+
+	ForThreadBlocks(n, nt, 1, [&](int t, size_t first, size_t last)
+	{
+		for(size_t i = first; i < last; i++)
+		{
+			if(pred(i))
+			{
+				found[t] = i;
+				break;
+			}
+		}
+	});
+
+	for(int t = 0; t < nt; t++)
+	{
+		if(found[t] != n)
+		{
+			return found[t];
+		}
+	}
+	return n;
+}
+
+} // end namespace Parallel
+
+#endif
@@ -6,9 +6,17 @@
  */
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <list>
 #include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "Transform3D.h"
 #include "PSvectorTransform3D.h"
 #include "ParticleBunch.h"
@@ -17,6 +25,7 @@
 #include "ParticleDistributionGenerator.h"
 #include "BeamData.h"
 #include "BunchFilter.h"
+#include "MerlinException.h"
 
 #ifdef MERLIN_PROFILE
 #include "MerlinProfile.h"
@@ -35,110 +44,333 @@ namespace
 
 using namespace ParticleTracking;
 
-template<class V>
-struct APSV1
+template<class T>
+inline void SortArray(std::vector<T>& array)
 {
-	V& p;
-	double w;
+	sort(array.begin(), array.end());
+}
 
-	APSV1(V& p0, double n) :
-		p(p0), w(0)
-	{
-	}
-	void operator()(const PSvector& p1)
-	{
-		w++;
-		for(int i = 0; i < 6; i++)
-		{
-			p[i] += (p1[i] - p[i]) / w;
-		}
-	}
+template<class T>
+inline void SortArray(std::list<T>& array)
+{
+	array.sort();
+}
+
+/*
+ * Binary bunch file layout, in native byte order:
+ *
+ *	BunchFileHeader
+ *	char[16]	name of each column, nul padded
+ *	double[]	each column in turn, one value per particle
+ *
+ * The columns are named, so a reader can find the ones it knows in any
+ * order and ignore the rest.
+ */
+
+const char bunchFileMagic[8] = "MRLNBCH";
+const std::uint32_t bunchFileVersion = 1;
+const size_t columnNameLength = 16;
+
+const char* const columnNames[PS_LENGTH] = {"x", "xp", "y", "yp", "ct", "dp", "type", "location", "id", "sd"};
+
+double PSvectorTag::* const tagFields[PS_LENGTH - PS_COLUMNS] =
+{
+	&PSvectorTag::type, &PSvectorTag::location, &PSvectorTag::id, &PSvectorTag::sd
+};
 
+struct BunchFileHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t ncolumns;
+	std::uint64_t count;
+	double p0;
+	double ct0;
+	double chargeSign;
+	double qPerMP;
 };
 
-struct APSV2
+/*
+ * A bunch file mapped read only, with the columns located and checked
+ * against the file size.
+ */
+class BunchFileMap
 {
-	const int u, v;
-	Point2D X;
-	const double w;
+public:
+	explicit BunchFileMap(const std::string& filename);
+	~BunchFileMap();
 
-	APSV2(int i, int j, double n) :
-		u(i), v(j), X(0, 0), w(1 / n)
+	const BunchFileHeader& Header() const
 	{
+		return header;
 	}
-	void operator()(const PSvector& p)
+
+	size_t Count() const
+	{
+		return header.count;
+	}
+
+	/*
+	 * Returns the start of column k of columnNames, or nullptr if the
+	 * file does not hold it.
+	 */
+	const double* Column(int k) const
 	{
-		X.x += w * p[u];
-		X.y += w * p[v];
+		return columns[k];
 	}
 
+private:
+	void* map;
+	size_t size;
+	BunchFileHeader header;
+	const double* columns[PS_LENGTH];
+
+	BunchFileMap(const BunchFileMap&) = delete;
+	BunchFileMap& operator=(const BunchFileMap&) = delete;
 };
 
-struct PSVVAR1
+BunchFileMap::BunchFileMap(const std::string& filename) :
+	map(MAP_FAILED), size(0)
 {
-	PSmoments& S;
-	double w;
-	PSVVAR1(PSmoments& sig, double n) :
-		S(sig), w(0)
+	std::fill(columns, columns + PS_LENGTH, nullptr);
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
 	{
+		throw MerlinException("ParticleBunch: cannot open bunch file " + filename);
 	}
-	void operator()(const PSvector& p)
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(BunchFileHeader)))
 	{
-		w++;
-		for(int i = 0; i < 6; i++)
-			for(int j = 0; j <= i; j++)
+		close(fd);
+		throw MerlinException("ParticleBunch: " + filename + " is not a bunch file");
+	}
+	size = st.st_size;
+	map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		throw MerlinException("ParticleBunch: cannot map bunch file " + filename);
+	}
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	const char* data = static_cast<const char*>(map);
+	memcpy(&header, data, sizeof(header));
+	size_t offset = sizeof(header) + header.ncolumns * columnNameLength;
+	if(memcmp(header.magic, bunchFileMagic, sizeof(bunchFileMagic)) != 0 || header.version != bunchFileVersion
+		|| header.ncolumns > size / columnNameLength || offset > size
+		|| (header.ncolumns > 0 && header.count > (size - offset) / sizeof(double) / header.ncolumns)
+		|| offset + header.ncolumns * header.count * sizeof(double) != size)
+	{
+		munmap(map, size);
+		throw MerlinException("ParticleBunch: " + filename + " is not a valid bunch file");
+	}
+
+	for(size_t c = 0; c < header.ncolumns; c++)
+	{
+		char name[columnNameLength + 1] = {};
+		memcpy(name, data + sizeof(header) + c * columnNameLength, columnNameLength);
+		for(int k = 0; k < PS_LENGTH; k++)
+		{
+			if(strcmp(name, columnNames[k]) == 0)
 			{
-				S(i, j) += ((p[i] - S[i]) * (p[j] - S[j]) - S(i, j)) / w;
+				columns[k] = reinterpret_cast<const double*>(data + offset);
 			}
+		}
+		offset += header.count * sizeof(double);
 	}
+}
 
-};
-
-struct PSVVAR2
+BunchFileMap::~BunchFileMap()
 {
-	PSmoments2D& S;
-	const int u, v;
-	const double w;
+	munmap(map, size);
+}
+
+const size_t momentBlock = 256;
+const size_t momentChunk = 64;
 
-	PSVVAR2(int u1, int v1, double n, PSmoments2D& sig) :
-		S(sig), u(u1), v(v1), w(1 / n)
+// a range of 2^k leaves and the rest, so that the tree of merges is fixed
+// by the number of leaves alone
+inline size_t SplitPoint(size_t first, size_t last)
+{
+	size_t half = 1;
+	while(2 * half < last - first)
 	{
+		half *= 2;
 	}
+	return first + half;
+}
 
-	void operator()(const PSvector& p)
+/*
+ * The accumulator of blocks first .. last - 1 of momentBlock particles,
+ * merged pairwise in a fixed tree.
+ */
+template<class A>
+A ReduceBlocks(const PSvectorArray& particles, size_t first, size_t last, const A& empty)
+{
+	if(last - first == 1)
 	{
-		double x = p[u] - S[0];
-		double y = p[v] - S[1];
-		S(0, 0) += w * x * x;
-		S(0, 1) += w * x * y;
-		S(1, 1) += w * y * y;
+		A acc(empty);
+		const size_t p = first * momentBlock;
+		acc.Add(&particles[p], min(momentBlock, particles.size() - p));
+		return acc;
 	}
+	const size_t mid = SplitPoint(first, last);
+	A acc = ReduceBlocks(particles, first, mid, empty);
+	acc.Merge(ReduceBlocks(particles, mid, last, empty));
+	return acc;
+}
 
-};
-
-template<class IT>
-double Mean(IT F, IT L, int i)
+template<class A>
+A MergeRange(std::vector<A>& partial, size_t first, size_t last)
 {
-	double s = 0;
-	double n = 0;
-	while(F != L)
+	if(last - first == 1)
 	{
-		s += ((*F++)[i] - s) / (++n);
+		return partial[first];
 	}
-	return s;
+	const size_t mid = SplitPoint(first, last);
+	A acc = MergeRange(partial, first, mid);
+	acc.Merge(MergeRange(partial, mid, last));
+	return acc;
 }
 
-template<class T>
-inline void SortArray(std::vector<T>& array)
+/*
+ * Reduce the particles with an accumulator having Add(const PSvector*, n)
+ * and Merge(). The particles are added in blocks of momentBlock (so that
+ * a two-pass block sum stays in cache) and the blocks merged pairwise in
+ * a tree fixed by the number of blocks. On several threads each thread
+ * reduces whole chunks of momentChunk blocks, the subtrees of that tree,
+ * so the result does not depend on the number of threads.
+ */
+template<class A>
+A ReduceParticles(const PSvectorArray& particles, const A& empty)
 {
-	sort(array.begin(), array.end());
+	const size_t n = particles.size();
+	const size_t nblocks = (n + momentBlock - 1) / momentBlock;
+	const size_t nchunks = (nblocks + momentChunk - 1) / momentChunk;
+	const int nt = Parallel::ThreadsFor(n);
+	if(nblocks == 0)
+	{
+		return empty;
+	}
+	if(nt <= 1 || nchunks == 1)
+	{
+		return ReduceBlocks(particles, 0, nblocks, empty);
+	}
+
+	vector<A> partial(nchunks, empty);
+	Parallel::ForThreadBlocks(nchunks, nt, 1, [&](int, size_t first, size_t last)
+	{
+		for(size_t c = first; c < last; c++)
+		{
+			partial[c] = ReduceBlocks(particles, c * momentChunk, min(nblocks, (c + 1) * momentChunk), empty);
+		}
+	});
+	return MergeRange(partial, 0, nchunks);
 }
 
-template<class T>
-inline void SortArray(std::list<T>& array)
+/*
+ * The mean of each coordinate, for the centroid functions, merged as
+ * PSmomentAccumulator does but without the second moments.
+ */
+struct MeanAccumulator
 {
-	array.sort();
-}
+	double n;
+	double mean[6];
+
+	MeanAccumulator() :
+		n(0), mean()
+	{
+	}
+
+	void Add(const PSvector* p, size_t np)
+	{
+		MeanAccumulator b;
+		b.n = np;
+		for(size_t k = 0; k < np; k++)
+		{
+			for(int i = 0; i < 6; i++)
+			{
+				b.mean[i] += p[k][i];
+			}
+		}
+		for(int i = 0; i < 6; i++)
+		{
+			b.mean[i] /= np;
+		}
+		Merge(b);
+	}
+
+	void Merge(const MeanAccumulator& b)
+	{
+		if(b.n == 0)
+		{
+			return;
+		}
+		if(n == 0)
+		{
+			*this = b;
+			return;
+		}
+		const double nt = n + b.n;
+		for(int i = 0; i < 6; i++)
+		{
+			mean[i] += (b.mean[i] - mean[i]) * b.n / nt;
+		}
+		n = nt;
+	}
+};
+
+/*
+ * The mean and the sum of squared deviations of one coordinate.
+ */
+struct CoordAccumulator
+{
+	int coord;
+	double n;
+	double mean;
+	double m2;
+
+	explicit CoordAccumulator(int i) :
+		coord(i), n(0), mean(0), m2(0)
+	{
+	}
+
+	void Add(const PSvector* p, size_t np)
+	{
+		CoordAccumulator b(coord);
+		b.n = np;
+		for(size_t k = 0; k < np; k++)
+		{
+			b.mean += p[k][coord];
+		}
+		b.mean /= np;
+		for(size_t k = 0; k < np; k++)
+		{
+			const double d = p[k][coord] - b.mean;
+			b.m2 += d * d;
+		}
+		Merge(b);
+	}
+
+	void Merge(const CoordAccumulator& b)
+	{
+		if(b.n == 0)
+		{
+			return;
+		}
+		if(n == 0)
+		{
+			*this = b;
+			return;
+		}
+		const double nt = n + b.n;
+		const double delta = b.mean - mean;
+		m2 += b.m2 + n * b.n / nt * delta * delta;
+		mean += delta * b.n / nt;
+		n = nt;
+	}
+};
 
 } //end namespace
 
@@ -147,13 +379,14 @@ namespace ParticleTracking
 
 ParticleBunch::ParticleBunch(double P0, double Q, PSvectorArray& particles) :
 	Bunch(P0, Q), init(false), coords((int) sizeof(PSvector) / sizeof(double)), ScatteringPhysicsModel(0), qPerMP(Q
-		/ particles.size()), pArray()
+		/ particles.size()), layout(arrayOfStructs), residency(particlesValid), pArray()
 {
 	pArray.swap(particles);
 }
 
 ParticleBunch::ParticleBunch(double P0, double Q, std::istream& is) :
-	Bunch(P0, Q), init(false), coords((int) sizeof(PSvector) / sizeof(double)), ScatteringPhysicsModel(0)
+	Bunch(P0, Q), init(false), coords((int) sizeof(PSvector) / sizeof(double)), ScatteringPhysicsModel(0),
+	layout(arrayOfStructs), residency(particlesValid)
 {
 	PSvector p;
 	while(is >> p)
@@ -165,7 +398,8 @@ ParticleBunch::ParticleBunch(double P0, double Q, std::istream& is) :
 }
 
 ParticleBunch::ParticleBunch(double P0, double Qm) :
-	Bunch(P0, Qm), init(false), coords((int) sizeof(PSvector) / sizeof(double)), ScatteringPhysicsModel(0), qPerMP(Qm)
+	Bunch(P0, Qm), init(false), coords((int) sizeof(PSvector) / sizeof(double)), ScatteringPhysicsModel(0), qPerMP(Qm),
+	layout(arrayOfStructs), residency(particlesValid)
 {
 }
 
@@ -240,50 +474,50 @@ double ParticleBunch::GetTotalCharge() const
 
 PSmoments& ParticleBunch::GetMoments(PSmoments& sigma) const
 {
-	sigma.zero();
-	for_each(begin(), end(), APSV1<PSmoments>(sigma, size()));
-	for_each(begin(), end(), PSVVAR1(sigma, size()));
-	return sigma;
+	return AccumulateMoments().GetMoments(sigma);
 }
 
 PSmoments2D& ParticleBunch::GetProjectedMoments(PScoord u, PScoord v, PSmoments2D& sigma) const
 {
-	Point2D X = for_each(begin(), end(), APSV2(u, v, size())).X;
-	sigma[0] = X.x;
-	sigma[1] = X.y;
-	for_each(begin(), end(), PSVVAR2(u, v, size(), sigma));
+	const PSmomentAccumulator m = AccumulateMoments();
+	sigma[0] = m.Mean(u);
+	sigma[1] = m.Mean(v);
+	sigma(0, 0) = m.Covariance(u, u);
+	sigma(0, 1) = m.Covariance(u, v);
+	sigma(1, 1) = m.Covariance(v, v);
 	return sigma;
 }
 
 PSvector& ParticleBunch::GetCentroid(PSvector& p) const
 {
-	p.zero();
-	for_each(begin(), end(), APSV1<PSvector>(p, size()));
+	const MeanAccumulator m = ReduceParticles(Particles(), MeanAccumulator());
+	for(int i = 0; i < 6; i++)
+	{
+		p[i] = m.mean[i];
+	}
 	return p;
 }
 
 std::pair<double, double> ParticleBunch::GetMoments(PScoord i) const
 {
-	double u = Mean(begin(), end(), i);
-	double v = 0;
-	double w = 0;
-	for(const_iterator p = begin(); p != end(); p++)
-	{
-		double x = (*p)[i] - u;
-		v += (x * x - v) / (++w);
-	}
+	const CoordAccumulator m = ReduceParticles(Particles(), CoordAccumulator(i));
+	return make_pair(m.mean, m.n > 0 ? sqrt(m.m2 / m.n) : 0);
+}
 
-	return make_pair(u, sqrt(v));
+PSmomentAccumulator ParticleBunch::AccumulateMoments(bool higher) const
+{
+	return ReduceParticles(Particles(), PSmomentAccumulator(higher));
 }
 
 Point2D ParticleBunch::GetProjectedCentroid(PScoord u, PScoord v) const
 {
-	return for_each(begin(), end(), APSV2(u, v, size())).X;
+	const MeanAccumulator m = ReduceParticles(Particles(), MeanAccumulator());
+	return Point2D(m.mean[u], m.mean[v]);
 }
 
 double ParticleBunch::AdjustRefMomentumToMean()
 {
-	return AdjustRefMomentum(Mean(begin(), end(), ps_DP));
+	return AdjustRefMomentum(ReduceParticles(Particles(), CoordAccumulator(ps_DP)).mean);
 }
 
 double ParticleBunch::AdjustRefMomentum(double dpp)
@@ -302,7 +536,7 @@ double ParticleBunch::AdjustRefMomentum(double dpp)
 
 double ParticleBunch::AdjustRefTimeToMean()
 {
-	double meanct = Mean(begin(), end(), ps_CT);
+	double meanct = ReduceParticles(Particles(), CoordAccumulator(ps_CT)).mean;
 	for(iterator p = begin(); p != end(); p++)
 	{
 		(*p).ct() -= meanct;
@@ -323,14 +557,186 @@ bool ParticleBunch::ApplyTransformation(const Transform3D& t)
 {
 	if(!t.isIdentity())
 	{
-		PSvectorTransform3D(t).Apply(pArray);
+		PSvectorTransform3D(t).Apply(Particles());
 	}
 	return true;
 }
 
 void ParticleBunch::SortByCT()
 {
-	SortArray(pArray);
+	SortArray(Particles());
+}
+
+size_t ParticleBunch::RemoveParticles(const std::vector<char>& removed, PSvectorArray* lost)
+{
+	// Each thread closes the gaps within its own block, then the blocks
+	// are moved down over the gaps between them.
+	PSvectorArray& particles = Particles();
+	const size_t n = particles.size();
+	const int nt = Parallel::ThreadsFor(n);
+	vector<size_t> start(nt, 0);
+	vector<size_t> kept(nt, 0);
+	vector<PSvectorArray> blockLost(lost ? nt : 0);
+	Parallel::ForThreadBlocks(n, nt, 1, [&](int t, size_t first, size_t last)
+	{
+		size_t k = first;
+		for(size_t i = first; i < last; i++)
+		{
+			if(removed[i])
+			{
+				if(lost)
+				{
+					blockLost[t].push_back(particles[i]);
+				}
+			}
+			else
+			{
+				if(k != i)
+				{
+					particles[k] = particles[i];
+				}
+				k++;
+			}
+		}
+		start[t] = first;
+		kept[t] = k - first;
+	});
+
+	size_t end = 0;
+	for(int t = 0; t < nt; t++)
+	{
+		if(kept[t] && end != start[t])
+		{
+			std::move(particles.begin() + start[t], particles.begin() + start[t] + kept[t], particles.begin() + end);
+		}
+		end += kept[t];
+		if(lost)
+		{
+			lost->insert(lost->end(), blockLost[t].begin(), blockLost[t].end());
+		}
+	}
+	particles.erase(particles.begin() + end, particles.end());
+	return n - end;
+}
+
+size_t ParticleBunch::PartitionByCT(double zmin, double zmax, size_t nbins, std::vector<size_t>& counts)
+{
+	const PSvectorArray& particles = Particles();
+	const size_t n = particles.size();
+
+	// Slice boundaries, accumulated in the same way as the slices are
+	// traversed, so that the slice of each particle is the one it
+	// would be found in by walking a sorted bunch.
+	const double dz = (zmax - zmin) / nbins;
+	vector<double> edge(nbins + 1);
+	double z = zmin;
+	for(size_t k = 0; k < nbins; k++)
+	{
+		edge[k] = z;
+		z += dz;
+	}
+	edge[nbins] = zmax;
+
+	// slice index of each particle, nbins for those outside the range,
+	// and a histogram per thread block
+	const int nt = Parallel::ThreadsFor(n);
+	vector<size_t> dest(n);
+	vector<vector<size_t> > hist(nt, vector<size_t>(nbins + 1, 0));
+	Parallel::ForThreadBlocks(n, nt, 1, [&](int t, size_t first, size_t last)
+	{
+		vector<size_t>& h = hist[t];
+		for(size_t i = first; i < last; i++)
+		{
+			const double ct = particles[i].ct();
+			size_t k = nbins;
+			if(ct >= zmin && ct < zmax)
+			{
+				k = min(size_t((ct - zmin) / dz), nbins - 1);
+				while(k > 0 && ct < edge[k])
+				{
+					k--;
+				}
+				while(k + 1 < nbins && ct >= edge[k + 1])
+				{
+					k++;
+				}
+			}
+			dest[i] = k;
+			h[k]++;
+		}
+	});
+
+	// the first position of each slice in each block; the blocks are
+	// in order within a slice, so the partition is stable
+	counts.assign(nbins, 0);
+	size_t pos = 0;
+	for(size_t k = 0; k <= nbins; k++)
+	{
+		for(int t = 0; t < nt; t++)
+		{
+			const size_t c = hist[t][k];
+			hist[t][k] = pos;
+			pos += c;
+			if(k < nbins)
+			{
+				counts[k] += c;
+			}
+		}
+	}
+	// the removed particles are moved after all the slices
+	const size_t kept = hist[0][nbins];
+
+	Parallel::ForThreadBlocks(n, nt, 1, [&](int t, size_t first, size_t last)
+	{
+		vector<size_t>& h = hist[t];
+		for(size_t i = first; i < last; i++)
+		{
+			dest[i] = h[dest[i]]++;
+		}
+	});
+
+	Reorder(dest, kept);
+	return n - kept;
+}
+
+void ParticleBunch::Reorder(std::vector<size_t>& dest, size_t n)
+{
+	PSvectorArray& particles = Particles();
+	const size_t np = particles.size();
+	size_t moved = 0;
+	for(size_t i = 0; i < np; i++)
+	{
+		moved += dest[i] != i;
+	}
+
+	// A bunch far from the new order is copied, since swapping along
+	// the cycles of the permutation would then miss the cache on most
+	// particles. A bunch which is already nearly in order, as on
+	// repeated slicing, is permuted in place by following the cycles.
+	if(moved > np / 4)
+	{
+		PSvectorArray reordered(n);
+		Parallel::For(np, [&](size_t i)
+		{
+			if(dest[i] < n)
+			{
+				reordered[dest[i]] = particles[i];
+			}
+		});
+		particles.swap(reordered);
+		return;
+	}
+
+	for(size_t i = 0; i < np; i++)
+	{
+		while(dest[i] != i)
+		{
+			const size_t j = dest[i];
+			std::swap(particles[i], particles[j]);
+			std::swap(dest[i], dest[j]);
+		}
+	}
+	particles.resize(n);
 }
 
 void ParticleBunch::Output(std::ostream& os) const
@@ -397,6 +803,136 @@ void ParticleBunch::Input(double Q, std::istream& is)
 	qPerMP = Q / size();
 }
 
+void ParticleBunch::OutputBinary(const std::string& filename, size_t chunk) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		throw MerlinException("ParticleBunch::OutputBinary: cannot open " + filename);
+	}
+
+	const size_t n = size();
+	BunchFileHeader header;
+	memcpy(header.magic, bunchFileMagic, sizeof(bunchFileMagic));
+	header.version = bunchFileVersion;
+	header.ncolumns = PS_LENGTH;
+	header.count = n;
+	header.p0 = GetReferenceMomentum();
+	header.ct0 = GetReferenceTime();
+	header.chargeSign = GetChargeSign();
+	header.qPerMP = qPerMP;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	char names[PS_LENGTH][columnNameLength] = {};
+	for(int k = 0; k < PS_LENGTH; k++)
+	{
+		strncpy(names[k], columnNames[k], columnNameLength);
+	}
+	out.write(names[0], sizeof(names));
+
+	// the coordinate columns are written directly if they are current,
+	// anything else through a buffer of chunk values
+	const bool fromColumns = residency & columnsValid;
+	std::vector<double> buf(std::max<size_t>(std::min(chunk, n), 1));
+	for(int k = 0; k < PS_LENGTH; k++)
+	{
+		if(fromColumns && k < PS_COLUMNS)
+		{
+			out.write(reinterpret_cast<const char*>(pColumns.column(k)), n * sizeof(double));
+			continue;
+		}
+		for(size_t first = 0; first < n; first += buf.size())
+		{
+			const size_t m = std::min(buf.size(), n - first);
+			if(fromColumns)
+			{
+				const PSvectorTag* tag = pColumns.tag() + first;
+				for(size_t i = 0; i < m; i++)
+				{
+					buf[i] = tag[i].*tagFields[k - PS_COLUMNS];
+				}
+			}
+			else
+			{
+				for(size_t i = 0; i < m; i++)
+				{
+					buf[i] = pArray[first + i][k];
+				}
+			}
+			out.write(reinterpret_cast<const char*>(buf.data()), m * sizeof(double));
+		}
+	}
+
+	out.close();
+	if(!out)
+	{
+		throw MerlinException("ParticleBunch::OutputBinary: error writing " + filename);
+	}
+}
+
+void ParticleBunch::InputBinary(const std::string& filename)
+{
+	BunchFileMap file(filename);
+	const size_t n = file.Count();
+
+	pArray.clear();
+	pColumns.resize(n);
+	for(int k = 0; k < PS_COLUMNS; k++)
+	{
+		if(file.Column(k))
+		{
+			memcpy(pColumns.column(k), file.Column(k), n * sizeof(double));
+		}
+		else
+		{
+			std::fill(pColumns.column(k), pColumns.column(k) + n, 0.0);
+		}
+	}
+	PSvectorTag* tag = pColumns.tag();
+	for(int k = PS_COLUMNS; k < PS_LENGTH; k++)
+	{
+		const double* col = file.Column(k);
+		for(size_t i = 0; i < n; i++)
+		{
+			tag[i].*tagFields[k - PS_COLUMNS] = col ? col[i] : 0.0;
+		}
+	}
+	residency = columnsValid;
+
+	SetReferenceMomentum(file.Header().p0);
+	SetReferenceTime(file.Header().ct0);
+	SetChargeSign(file.Header().chargeSign);
+	qPerMP = file.Header().qPerMP;
+}
+
+void ParticleBunch::BinaryToText(const std::string& filename, std::ostream& os)
+{
+	BunchFileMap file(filename);
+
+	int oldp = os.precision(16);
+	ios_base::fmtflags oflg = os.setf(ios::scientific, ios::floatfield);
+	os << "#T P0 X XP Y YP CT DP" << std::endl;
+	for(size_t i = 0; i < file.Count(); i++)
+	{
+		os << std::setw(35) << file.Header().ct0;
+		os << std::setw(35) << file.Header().p0;
+		for(int k = 0; k < 6; k++)
+		{
+			os << std::setw(35) << (file.Column(k) ? file.Column(k)[i] : 0.0);
+		}
+		os << '\n';
+	}
+	os.precision(oldp);
+	os.flags(oflg);
+}
+
+void ParticleBunch::TextToBinary(std::istream& is, double Q, const std::string& filename)
+{
+	ParticleBunch bunch(1.0);
+	bunch.Input(Q, is);
+	bunch.OutputBinary(filename);
+}
+
 void ParticleBunch::SetCentroid()
 {
 	PSvector x;
@@ -419,6 +955,26 @@ void ParticleBunch::SetCentroid(const Particle& x0)
 	SetCentroid();
 }
 
+void ParticleBunch::SyncParticles() const
+{
+	std::lock_guard<std::mutex> guard(residency.lock);
+	if(!(residency & particlesValid))
+	{
+		pColumns.CopyTo(pArray);
+		residency.valid |= particlesValid;
+	}
+}
+
+void ParticleBunch::SyncColumns() const
+{
+	std::lock_guard<std::mutex> guard(residency.lock);
+	if(!(residency & columnsValid))
+	{
+		pColumns.Assign(pArray);
+		residency.valid |= columnsValid;
+	}
+}
+
 bool ParticleBunch::IsStable() const
 {
 	return true;
@@ -800,6 +1356,31 @@ void ParticleBunch::distribute()
 
 }
 
+PSmomentAccumulator ParticleBunch::AccumulateDistributedMoments(bool higher)
+{
+	Check_MPI_init();
+
+	const size_t k = PSmomentAccumulator::packedSize;
+	double local[k];
+	AccumulateMoments(higher).Pack(local);
+	vector<double> all(k * MPI_size);
+	MPI::COMM_WORLD.Allgather(local, k, MPI::DOUBLE, &all[0], k, MPI::DOUBLE);
+
+	vector<PSmomentAccumulator> acc(MPI_size, PSmomentAccumulator(higher));
+	for(int r = 0; r < MPI_size; r++)
+	{
+		acc[r].Unpack(&all[r * k]);
+	}
+	for(int stride = 1; stride < MPI_size; stride *= 2)
+	{
+		for(int r = 0; r + stride < MPI_size; r += 2 * stride)
+		{
+			acc[r].Merge(acc[r + stride]);
+		}
+	}
+	return acc[0];
+}
+
 void ParticleBunch::SendReferenceMomentum()
 {
 	Check_MPI_init();
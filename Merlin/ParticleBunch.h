@@ -9,9 +9,15 @@
 #define ParticleBunch_h 1
 
 #include "merlin_config.h"
+#include <atomic>
+#include <mutex>
+#include <string>
 #include "PSTypes.h"
+#include "PSvectorColumns.h"
+#include "PSmomentAccumulator.h"
 #include "Bunch.h"
 #include "PhysicalConstants.h"
+#include "ParallelFor.h"
 
 class Aperture; //#include "Aperture.h"
 class ParticleDistributionGenerator; //#include "ParticleDistributionGenerator.h"
@@ -47,6 +53,23 @@ public:
 	typedef PSvectorArray::iterator iterator;
 	typedef PSvectorArray::const_iterator const_iterator;
 
+	/**
+	 *	Particle storage layouts.
+	 *
+	 *	In arrayOfStructs (the default) the particles live in a
+	 *	PSvectorArray. In structOfArrays the particles are kept as
+	 *	separate coordinate columns (see PSvectorColumns) between
+	 *	steps, and integrators which provide column kernels use them
+	 *	directly. In either layout, access through begin()/end() or
+	 *	GetParticles() transparently transposes the bunch back to a
+	 *	PSvectorArray, so existing processes are unaffected.
+	 */
+	enum StorageLayout
+	{
+		arrayOfStructs,
+		structOfArrays
+	};
+
 	/**
 	 *	Constructs a ParticleBunch using the specified momentum,
 	 *	total charge and the particle array. Note that on exit,
@@ -91,6 +114,18 @@ public:
 	 */
 	std::pair<double, double> GetMoments(PScoord u) const;
 
+	/**
+	 *	Accumulate the mean and second moments of the bunch, and with
+	 *	higher true the third and fourth moments of each coordinate, in
+	 *	one pass. The particles are summed in fixed blocks on the
+	 *	ParallelFor threads and the blocks merged pairwise in a fixed
+	 *	order, so that the result does not depend on the number of
+	 *	threads. GetMoments() and GetProjectedMoments() are found from this; the
+	 *	centroid and single coordinate functions accumulate only what they
+	 *	return, in the same way.
+	 */
+	PSmomentAccumulator AccumulateMoments(bool higher = false) const;
+
 	/**
 	 *	Set the reference momentum to the mean (centroid)
 	 *	momentum of the bunch. Returns the new value in GeV/c.
@@ -132,6 +167,18 @@ public:
 	 */
 	virtual void SortByCT();
 
+	/**
+	 *	Partitions the particles into nbins slices of equal width in ct
+	 *	between zmin and zmax, in linear time, and removes the particles
+	 *	outside [zmin, zmax). The slices follow each other in ascending
+	 *	ct, but within a slice the particles keep their previous order
+	 *	rather than being sorted. On exit counts[n] is the number of
+	 *	particles in slice n.
+	 *
+	 *	@return The number of particles removed
+	 */
+	size_t PartitionByCT(double zmin, double zmax, size_t nbins, std::vector<size_t>& counts);
+
 	/**
 	 *	Output a bunch-model dependent representation to the
 	 *	specified stream.
@@ -141,6 +188,35 @@ public:
 	virtual void OutputIndexParticle(std::ostream& os, int index) const;
 	virtual void Input(double Q, std::istream& is);
 
+	/**
+	 *	Writes the bunch to a binary file: a versioned header with the
+	 *	reference momentum and time, the charge and the names of the
+	 *	columns, followed by one contiguous column of doubles for each
+	 *	coordinate and tag. The particle array is transposed chunk
+	 *	particles at a time, so the extra memory needed does not grow
+	 *	with the bunch. Throws MerlinException if the file cannot be
+	 *	written.
+	 */
+	void OutputBinary(const std::string& filename, size_t chunk = 65536) const;
+
+	/**
+	 *	Replaces the particles, reference momentum, reference time and
+	 *	charge with those in a file written by OutputBinary(). The file
+	 *	is memory mapped and each column copied straight into the
+	 *	column storage, without parsing or transposing. Columns missing
+	 *	from the file are set to zero. Throws MerlinException if the
+	 *	file cannot be read or is not a bunch file.
+	 */
+	void InputBinary(const std::string& filename);
+
+	/**
+	 *	Converts between the binary format and the text format of
+	 *	Output() and Input(). BinaryToText() writes straight from the
+	 *	mapped file, without building a bunch.
+	 */
+	static void BinaryToText(const std::string& filename, std::ostream& os);
+	static void TextToBinary(std::istream& is, double Q, const std::string& filename);
+
 	/**
 	 *	Add a (macro-)particle to the bunch.
 	 */
@@ -160,9 +236,45 @@ public:
 	virtual ParticleBunch::iterator erase(ParticleBunch::iterator p);
 	void reserve(const size_t n);
 
+	/**
+	 *	Removes the particles for which pred(p) is true, compacting the
+	 *	bunch in place and keeping the order of the survivors. pred is
+	 *	evaluated concurrently on the ParallelFor threads, so it must
+	 *	only depend on its particle. If lost is given, the removed
+	 *	particles are appended to it in their bunch order.
+	 *
+	 *	@return The number of particles removed
+	 */
+	template<class P>
+	size_t RemoveIf(P pred, PSvectorArray* lost = nullptr);
+
+	/**
+	 *	Removes the particles i for which removed[i] is non-zero, as
+	 *	RemoveIf. Bunches which keep per-particle data alongside the
+	 *	particles override this to remove it too.
+	 *
+	 *	@return The number of particles removed
+	 */
+	virtual size_t RemoveParticles(const std::vector<char>& removed, PSvectorArray* lost = nullptr);
+
 	PSvectorArray& GetParticles();
 	const PSvectorArray& GetParticles() const;
 
+	/**
+	 *	Selects the preferred storage layout.
+	 */
+	void SetStorageLayout(StorageLayout layout);
+	StorageLayout GetStorageLayout() const;
+
+	/**
+	 *	Returns the particles as coordinate columns, transposing
+	 *	from the PSvectorArray if that has been accessed since the
+	 *	last call. Any iterators into the PSvectorArray are
+	 *	invalidated.
+	 */
+	PSvectorColumns& GetColumns();
+	const PSvectorColumns& GetColumns() const;
+
 	/**
 	 *	Returns the first particle in the bunch.
 	 *	@return First particle in the bunch
@@ -317,6 +429,13 @@ public:
 	 * Update reference momentum on master/nodes
 	 */
 	void SendReferenceMomentum();
+	/**
+	 * Moments of the bunch over all ranks, from the accumulated moments
+	 * of each rank rather than by gathering the particles. Collective;
+	 * the ranks are merged in the same order on each, so every rank
+	 * gets the same result.
+	 */
+	PSmomentAccumulator AccumulateDistributedMoments(bool higher = false);
 
 	/**
 	 * Finalize
@@ -340,21 +459,122 @@ private:
 	 */
 	double qPerMP;
 
+	/**
+	 *	Which of pArray and pColumns currently hold valid data.
+	 */
+	enum
+	{
+		particlesValid = 1,
+		columnsValid = 2
+	};
+
+	StorageLayout layout;
+
+	/**
+	 *	The residency flags. The const accessors may fill in the other
+	 *	copy of the particles, which several threads reading the same
+	 *	const bunch could do at once, so the flags are atomic and the
+	 *	copy is made under the lock (see SyncParticles()). Copying a
+	 *	bunch copies the flags but not the lock.
+	 */
+	struct Residency
+	{
+		std::atomic<int> valid;
+		std::mutex lock;
+
+		explicit Residency(int v) :
+			valid(v)
+		{
+		}
+
+		Residency(const Residency& r) :
+			valid(r.valid.load())
+		{
+		}
+
+		Residency& operator=(const Residency& r)
+		{
+			valid = r.valid.load();
+			return *this;
+		}
+
+		Residency& operator=(int v)
+		{
+			valid = v;
+			return *this;
+		}
+
+		operator int() const
+		{
+			return valid.load();
+		}
+	};
+	mutable Residency residency;
+
+	/**
+	 *	Column copy of the particles (structOfArrays layout).
+	 */
+	mutable PSvectorColumns pColumns;
+
+	/**
+	 *	Fill in pArray from the columns, or the columns from pArray,
+	 *	unless already valid, holding the residency lock.
+	 */
+	void SyncParticles() const;
+	void SyncColumns() const;
+
 protected:
 
-	PSvectorArray pArray;
+	mutable PSvectorArray pArray;
+
+	/**
+	 *	Returns pArray, transposing it back from the columns first
+	 *	if required. The columns are marked as stale since the
+	 *	caller may modify the particles.
+	 */
+	PSvectorArray& Particles();
+	const PSvectorArray& Particles() const;
+
+	/**
+	 *	Moves particle i to position dest[i], where dest is a
+	 *	permutation of the particle indices, and then keeps only the
+	 *	first n particles. dest is used as workspace. Bunches which
+	 *	keep per-particle data alongside the particles override this
+	 *	to reorder it in the same way.
+	 */
+	virtual void Reorder(std::vector<size_t>& dest, size_t n);
 
 };
+
+inline PSvectorArray& ParticleBunch::Particles()
+{
+	if(residency != particlesValid)
+	{
+		SyncParticles();
+		residency = particlesValid;
+	}
+	return pArray;
+}
+
+inline const PSvectorArray& ParticleBunch::Particles() const
+{
+	if(!(residency & particlesValid))
+	{
+		SyncParticles();
+	}
+	return pArray;
+}
+
 inline void ParticleBunch::swap(ParticleBunch newbunch)
 {
 	//cout << "Before " << size() << "\t" << newbunch.size() << endl;
-	pArray.swap(newbunch.pArray);
+	Particles().swap(newbunch.Particles());
 	//cout << "After " << size() << "\t" << newbunch.size() << endl;
 }
 
 inline size_t ParticleBunch::AddParticle(const Particle& p)
 {
-	pArray.push_back(p);
+	Particles().push_back(p);
 	return size();
 }
 
@@ -366,12 +586,12 @@ inline void ParticleBunch::SetMacroParticleCharge(double q)
 
 inline ParticleBunch::iterator ParticleBunch::begin()
 {
-	return pArray.begin();
+	return Particles().begin();
 }
 
 inline ParticleBunch::iterator ParticleBunch::end()
 {
-	return pArray.end();
+	return Particles().end();
 }
 
 inline void ParticleBunch::push_back(const Particle& p)
@@ -381,52 +601,95 @@ inline void ParticleBunch::push_back(const Particle& p)
 
 inline ParticleBunch::const_iterator ParticleBunch::begin() const
 {
-	return pArray.begin();
+	return Particles().begin();
 }
 
 inline ParticleBunch::const_iterator ParticleBunch::end() const
 {
-	return pArray.end();
+	return Particles().end();
 }
 
 inline size_t ParticleBunch::size() const
 {
-	return pArray.size();
+	return (residency & particlesValid) ? pArray.size() : pColumns.size();
 }
 
 inline void ParticleBunch::reserve(const size_t n)
 {
-	pArray.reserve(n);
+	Particles().reserve(n);
 }
 
 inline ParticleBunch::iterator ParticleBunch::erase(ParticleBunch::iterator p)
 {
-	return pArray.erase(p);
+	return Particles().erase(p);
 }
 
 inline PSvectorArray& ParticleBunch::GetParticles()
 {
-	return pArray;
+	return Particles();
 }
 
 inline const PSvectorArray& ParticleBunch::GetParticles() const
 {
-	return pArray;
+	return Particles();
+}
+
+inline void ParticleBunch::SetStorageLayout(StorageLayout l)
+{
+	layout = l;
+}
+
+inline ParticleBunch::StorageLayout ParticleBunch::GetStorageLayout() const
+{
+	return layout;
+}
+
+inline PSvectorColumns& ParticleBunch::GetColumns()
+{
+	if(residency != columnsValid)
+	{
+		SyncColumns();
+		residency = columnsValid;
+	}
+	return pColumns;
+}
+
+inline const PSvectorColumns& ParticleBunch::GetColumns() const
+{
+	if(!(residency & columnsValid))
+	{
+		SyncColumns();
+	}
+	return pColumns;
 }
 
 inline const Particle& ParticleBunch::FirstParticle() const
 {
-	return pArray.front();
+	return Particles().front();
 }
 
 inline Particle& ParticleBunch::FirstParticle()
 {
-	return pArray.front();
+	return Particles().front();
 }
 
 inline void ParticleBunch::clear()
 {
 	pArray.clear();
+	pColumns.clear();
+	residency = particlesValid;
+}
+
+template<class P>
+size_t ParticleBunch::RemoveIf(P pred, PSvectorArray* lost)
+{
+	const PSvectorArray& particles = Particles();
+	std::vector<char> removed(particles.size());
+	Parallel::For(particles.size(), [&](size_t i)
+	{
+		removed[i] = pred(particles[i]);
+	});
+	return RemoveParticles(removed, lost);
 }
 
 inline void ParticleBunch::SetScatterConfigured(bool state)
@@ -11,44 +11,12 @@
 #include <vector>
 #include <cmath>
 
-#ifdef ENABLE_MPI
-#include <mpi.h>
-#include <fstream>
-#include <iostream>
-#endif
-
-namespace
-{
-
 using namespace std;
-using namespace ParticleTracking;
-
-size_t TruncateZ(ParticleBunch& particles, double zmin, double zmax)
-{
-	size_t lost = 0;
-	ParticleBunch::iterator p = particles.begin();
-	while(p != particles.end())
-	{
-		double z = p->ct();
-		if(z < zmin || z >= zmax)
-		{
-			p = particles.erase(p);
-			lost++;
-		}
-		else
-		{
-			p++;
-		}
-	}
-	return lost;
-}
-
-}
 
 namespace ParticleTracking
 {
 
-// Sort the bunch in ascending z (ct) order, and return
+// Partition the bunch into slices of ascending z (ct), and return
 // a vector of iterators which point to the equal-spaced
 // bin boundaries defines by zmin to zmax in steps of dz
 //
@@ -61,64 +29,29 @@ namespace ParticleTracking
 size_t ParticleBinList(ParticleBunch& bunch, double zmin, double zmax, size_t nbins,
 	vector<ParticleBunch::iterator>& pbins, vector<double>& hd, vector<double>& hdp, vector<double>* c)
 {
-//cout << "In ParticleBinList" << endl;
-//cout << zmin << "\t" << zmax << "\t" << nbins << endl;
 	double dz = (zmax - zmin) / double(nbins);
 	vector<ParticleBunch::iterator> bins;
-	vector<double> hbins(nbins, 0);
+	vector<size_t> counts;
 	bins.reserve(nbins + 1);
 
-	bunch.SortByCT();
-
-	size_t lost = TruncateZ(bunch, zmin, zmax);
+	// Only the slice of each particle is needed, not their order
+	// within it, so the bunch is partitioned rather than sorted.
+	size_t lost = bunch.PartitionByCT(zmin, zmax, nbins, counts);
 
+	vector<double> hbins(counts.begin(), counts.end());
 	ParticleBunch::iterator p = bunch.begin();
 	bins.push_back(p);
 
-	double z = zmin;
 	double total = 0;
 	size_t n;
 
 	for(n = 0; n < nbins; n++)
 	{
-		z += dz;
-		while(p != bunch.end() && p->ct() < z)
-		{
-			total++;
-			hbins[n]++;
-			p++;
-		}
+		p += counts[n];
+		total += counts[n];
 		bins.push_back(p);
 	}
 
-	if(p != bunch.end())
-	{
-#ifdef ENABLE_MPI
-		cerr << "bad slicing in rank: " << MPI::COMM_WORLD.Get_rank() << endl;
-#endif
-
-#ifndef ENABLE_MPI
-		cerr << "bad slicing" << endl;
-#endif
-
-		cerr << "z = " << z << " ct = " << p->ct() << " zmax = " << zmax << endl;
-		//Dump out the bad bunch
-		/*
-		    ofstream* badbunch = new ofstream("badbunch.bunch");
-		    bunch.Output(*badbunch);
-		    badbunch->close();
-		    delete badbunch;
-		    cerr << "Output of the current bunch is to badbunch.bunch" << endl;
-		 */
-#ifndef ENABLE_MPI
-		abort();
-#endif
-
-#ifdef ENABLE_MPI
-		MPI::COMM_WORLD.Abort(1);
-#endif
-	}
-
 	//	bins.push_back(p); // should be end()
 
 	// normalise distribution
@@ -164,21 +97,15 @@ size_t ParticleBunchDistribution(ParticleBunch& bunch, PScoord u, double umin, d
 	bins = vector<double>(nb, 0.0);
 	size_t np0 = bunch.size();
 
-	ParticleBunch::iterator p = bunch.begin();
 	size_t lost = 0;
 	double total = 0;
 
-	while(p != bunch.end())
+	for(ParticleBunch::const_iterator p = bunch.begin(); p != bunch.end(); p++)
 	{
 		double uval = (*p)[u];
 		if((uval < umin) || (uval > umax))
 		{
 			lost++;
-			if(truncate)
-			{
-				p = bunch.erase(p);
-				p--;
-			}
 		}
 		else
 		{
@@ -187,7 +114,13 @@ size_t ParticleBunchDistribution(ParticleBunch& bunch, PScoord u, double umin, d
 			bins[n]++;
 			total++;
 		}
-		p++;
+	}
+	if(truncate && lost)
+	{
+		bunch.RemoveIf([u, umin, umax](const Particle& p)
+		{
+			return p[u] < umin || p[u] > umax;
+		});
 	}
 	if(normalise)
 	{
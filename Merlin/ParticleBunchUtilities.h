@@ -17,7 +17,7 @@ namespace ParticleTracking
 {
 
 /**
- * Sort the bunch in ascending z (ct) order, and return
+ * Partition the bunch into slices of ascending z (ct), and return
  * a vector of iterators which point to the equal-spaced
  * bin boundaries defines by zmin to zmax in steps of dz
  *
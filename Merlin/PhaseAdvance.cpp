@@ -13,8 +13,6 @@
 #include "ParticleTracker.h"
 #include "RingDeltaTProcess.h"
 
-#include "ClosedOrbit.h"
-#include "TransferMatrix.h"
 #include "PhaseAdvance.h"
 #include "LatticeFunctions.h"
 
@@ -32,14 +30,25 @@ PhaseAdvance::PhaseAdvance(AcceleratorModel* aModel, LatticeFunctionTable* aTwis
 	//~ std::cout << "\n\t\t myLatticeFunctionTable->AddFunction(0,0,3);" << std::endl;
 }
 
+PhaseAdvance::~PhaseAdvance()
+{
+}
+
 void PhaseAdvance::SetDelta(double new_delta)
 {
 	delta = new_delta;
+	maps.reset();
 }
 
 void PhaseAdvance::ScaleBendPathLength(double scale)
 {
 	bendscale = scale;
+	maps.reset();
+}
+
+void PhaseAdvance::Invalidate()
+{
+	maps.reset();
 }
 
 double PhaseAdvance::PhaseAdvanceBetween(int n1, int n2, bool horizontal)
@@ -98,32 +107,16 @@ double PhaseAdvance::PhaseAdvanceBetween(string name, bool horizontal)
 
 RealMatrix PhaseAdvance::TransferMapBetween(int n1, int n2)
 {
-	Particle p2(0.);
-
-	if(n1 > n2)
+	if(!maps || !maps->UpdateChanged())
 	{
-		std::cout
-			<<
-			"\n\tPhaseAdvance::TransferMapBetween: WARNING: n1>n2, tracker cannot compute \nt Use GetPhaseAdvanceX(n2, n1)"
-			<< endl;
+		maps.reset(new SegmentMapCache(theModel, p0));
+		maps->SetDelta(delta);
+		maps->TransverseOnly(false);
+		maps->ScaleBendPathLength(bendscale);
+		maps->Build();
 	}
 
-	ClosedOrbit co(theModel, p0);
-	co.SetDelta(delta);
-	co.TransverseOnly(false);
-	co.ScaleBendPathLength(bendscale);
-
-	RealMatrix M(6);
-	TransferMatrix tm(theModel, p0);
-	tm.SetDelta(delta);
-	tm.ScaleBendPathLength(bendscale);
-
-	co.FindClosedOrbit(p2);
-	//~ std::cout << "PhaseAdvance::TransferMapBetween: ClosedOrbit done" << endl;
-	tm.FindTM(M, p2, n1, n2);
-	//~ std::cout << "PhaseAdvance::TransferMapBetween: TransferMatrix done" << endl;
-
-	return M;
+	return maps->MapBetween(n1, n2);
 }
 
 double PhaseAdvance::GetPhaseAdvanceX(int n2, int n1)
@@ -8,11 +8,13 @@
 #ifndef PhaseAdvance_h
 #define PhaseAdvance_h 1
 
+#include <memory>
 #include <string>
 #include "AcceleratorModel.h"
 #include "PSTypes.h"
 #include "LatticeFunctions.h"
 #include "TLAS.h"
+#include "SegmentMapCache.h"
 
 using namespace TLAS;
 
@@ -26,6 +28,7 @@ class PhaseAdvance
 {
 public:
 	PhaseAdvance(AcceleratorModel* aModel, LatticeFunctionTable* aTwiss, double refMomentum);
+	~PhaseAdvance();
 
 	void SetDelta(double new_delta);
 	void ScaleBendPathLength(double scale);
@@ -47,10 +50,26 @@ public:
 	double PhaseAdvanceBetween(string name, bool horizontal);
 
 	/**
-	 * Calculates the transfer matrix between two lattice elements
+	 * Calculates the transfer matrix between two lattice elements,
+	 * from the entrance of n1 to the exit of n2, about the closed orbit.
+	 * The closed orbit and the element maps are found on the first call,
+	 * so that later calls do not track. When an element's field or
+	 * geometry has been changed directly only its map is found again,
+	 * unless the change moves the closed orbit; a change through a
+	 * channel or an alignment change finds everything again (see
+	 * SegmentMapCache::UpdateChanged()). If n1 > n2 the map wraps around
+	 * the ring.
 	 */
 	RealMatrix TransferMapBetween(int n1, int n2);
 
+	/**
+	 * Discards the cached maps, so that the next TransferMapBetween()
+	 * finds the closed orbit and every element map again. Only needed
+	 * after a change which the cache cannot see, to a field other than a
+	 * multipole, solenoid or RF field.
+	 */
+	void Invalidate();
+
 	// Simple functions for the user
 	double GetPhaseAdvanceX(int n2, int n1 = 0);
 	double GetPhaseAdvanceY(int n2, int n1 = 0);
@@ -63,6 +82,8 @@ private:
 	double p0;
 	double delta;
 	double bendscale;
+
+	std::unique_ptr<SegmentMapCache> maps;
 };
 
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef PhiloxEngine_h
+#define PhiloxEngine_h 1
+
+#include "merlin_config.h"
+#include <cstdint>
+#include <limits>
+
+/**
+ * Counter-based random number engine (Philox4x64-10).
+ *
+ * The output is a pure function of a 128 bit key and a 256 bit counter,
+ * so any number of independent streams can be created without shared
+ * state: the stream is selected by the key and the first three counter
+ * words, and the last counter word counts the blocks drawn from it.
+ *
+ * Satisfies the UniformRandomBitGenerator requirements, so it can be
+ * used with the standard library distributions.
+ *
+ * J. K. Salmon et al., "Parallel random numbers: as easy as 1, 2, 3",
+ * Proc. SC11 (2011).
+ */
+class PhiloxEngine
+{
+public:
+	typedef std::uint64_t result_type;
+
+	static constexpr result_type min()
+	{
+		return 0;
+	}
+	static constexpr result_type max()
+	{
+		return std::numeric_limits<result_type>::max();
+	}
+
+	PhiloxEngine() :
+		PhiloxEngine(0, 0)
+	{
+	}
+
+	/**
+	 * Create the stream (c0, c1, c2) of the given key.
+	 */
+	PhiloxEngine(std::uint64_t k0, std::uint64_t k1, std::uint64_t c0 = 0, std::uint64_t c1 = 0, std::uint64_t c2 = 0)
+	{
+		key[0] = k0;
+		key[1] = k1;
+		ctr[0] = c0;
+		ctr[1] = c1;
+		ctr[2] = c2;
+		ctr[3] = 0;
+		used = 4;
+	}
+
+	result_type operator()()
+	{
+		if(used == 4)
+		{
+			Block(ctr, key, out);
+			ctr[3]++;
+			used = 0;
+		}
+		return out[used++];
+	}
+
+	void discard(unsigned long long n)
+	{
+		for(; n > 0 && used < 4; n--)
+		{
+			used++;
+		}
+		ctr[3] += n / 4;
+		if(n % 4)
+		{
+			Block(ctr, key, out);
+			ctr[3]++;
+			used = n % 4;
+		}
+	}
+
+	/**
+	 * The Philox4x64-10 bijection: out = f(ctr, key).
+	 */
+	static void Block(const std::uint64_t ctr[4], const std::uint64_t key[2], std::uint64_t out[4])
+	{
+		std::uint64_t x[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+		std::uint64_t k[2] = {key[0], key[1]};
+
+		for(int r = 0; r < 10; r++)
+		{
+			if(r > 0)
+			{
+				k[0] += 0x9E3779B97F4A7C15ULL;
+				k[1] += 0xBB67AE8584CAA73BULL;
+			}
+			std::uint64_t hi0, hi1;
+			std::uint64_t lo0 = MulHiLo(0xD2E7470EE14C6C93ULL, x[0], hi0);
+			std::uint64_t lo1 = MulHiLo(0xCA5A826395121157ULL, x[2], hi1);
+			x[0] = hi1 ^ x[1] ^ k[0];
+			x[1] = lo1;
+			x[2] = hi0 ^ x[3] ^ k[1];
+			x[3] = lo0;
+		}
+
+		for(int i = 0; i < 4; i++)
+		{
+			out[i] = x[i];
+		}
+	}
+
+	friend bool operator==(const PhiloxEngine& a, const PhiloxEngine& b)
+	{
+		for(int i = 0; i < 4; i++)
+		{
+			if(a.ctr[i] != b.ctr[i])
+			{
+				return false;
+			}
+		}
+		return a.key[0] == b.key[0] && a.key[1] == b.key[1] && a.used == b.used;
+	}
+
+	friend bool operator!=(const PhiloxEngine& a, const PhiloxEngine& b)
+	{
+		return !(a == b);
+	}
+
+private:
+
+	/**
+	 * @return The low word of a * b, with the high word in hi.
+	 */
+	static std::uint64_t MulHiLo(std::uint64_t a, std::uint64_t b, std::uint64_t& hi)
+	{
+#ifdef __SIZEOF_INT128__
+		__extension__ typedef unsigned __int128 uint128;
+		uint128 p = static_cast<uint128>(a) * b;
+		hi = static_cast<std::uint64_t>(p >> 64);
+		return static_cast<std::uint64_t>(p);
+#else
+		const std::uint64_t mask = 0xFFFFFFFFULL;
+		std::uint64_t a0 = a & mask, a1 = a >> 32;
+		std::uint64_t b0 = b & mask, b1 = b >> 32;
+		std::uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		std::uint64_t mid = (p00 >> 32) + (p01 & mask) + (p10 & mask);
+		hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+		return a * b;
+#endif
+	}
+
+	std::uint64_t key[2];
+	std::uint64_t ctr[4];
+	std::uint64_t out[4];
+	int used;
+};
+
+#endif
@@ -37,6 +37,11 @@ namespace
 
 double Ran1()
 {
+	// Use the particle's stream if the caller has opened one
+	if(RandomNG::inStream())
+	{
+		return RandomNG::uniform(0.0, 1.0);
+	}
 	static auto gen = RandomNG::getLocalGenerator(hash_string("PhotonSpectrumGen"));
 	static auto dist = std::uniform_real_distribution<>{0.0, 1.0};
 	return dist(gen);
@@ -59,15 +64,12 @@ double Ran1()
  * Modified by N. Walker (DESY) to use with the Merlin Class Library
  */
 
-double SynGenC(double xmin)
+struct SynGenParams
 {
-	static bool DoInit = true;
-	static double a1, a2, c1, xlow, ratio, LastXmin = -1.;
+	double a1, a2, c1, xlow, ratio;
 
-	if(DoInit || xmin != LastXmin)
+	SynGenParams(double xmin)
 	{
-		DoInit = false;
-		LastXmin = xmin;
 		if(xmin > 1.)
 		{
 			xlow = xmin;
@@ -96,6 +98,16 @@ double SynGenC(double xmin)
 			a2 = SynRadC(xlow) / exp(-xlow);
 		}
 	}
+};
+
+double SynGenC(double xmin)
+{
+	// The constants for xmin = 0 are initialised once (thread safe), so
+	// photons can be generated concurrently from particle streams
+	static const SynGenParams params0(0.0);
+	const SynGenParams params = xmin == 0.0 ? params0 : SynGenParams(xmin);
+	const double a1 = params.a1, a2 = params.a2, c1 = params.c1, xlow = params.xlow, ratio = params.ratio;
+
 	// Init done, now generate
 	double appr, exact, result;
 	do
@@ -7,10 +7,13 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <vector>
 #include "utils.h"
 #include "BunchProcess.h"
 #include "ProcessStepManager.h"
 #include "AcceleratorComponent.h"
+#include "ParticleBunch.h"
+#include "ParallelFor.h"
 #include "deleters.h"
 
 #include "MerlinProfile.h"
@@ -115,10 +118,68 @@ void DoProc::Trace(BunchProcess* proc)
 	(*vos) << "from: " << right << s0 << " to: " << s0 + ds << " (step = " << ds << ")" << std::endl;
 }
 
+/**
+ * Apply the step to the bunch tile by tile, with every process of run
+ * acting on a tile before the next tile is started. Particles removed
+ * from a tile leave a gap at its end, which is closed once all the
+ * tiles are done, keeping the particle order.
+ */
+void DoTiles(ParticleTracking::ParticleBunch& bunch, size_t tileSize, const std::vector<BunchProcess*>& run,
+	DoProc& dp)
+{
+	PSvectorArray& particles = bunch.GetParticles();
+	const size_t n = particles.size();
+	const size_t ntiles = (n + tileSize - 1) / tileSize;
+
+	for(BunchProcess* proc : run)
+	{
+		if(dp.vos != nullptr)
+		{
+			dp.Trace(proc);
+		}
+		proc->BeginTiles(dp.ds, ntiles);
+	}
+
+	std::vector<size_t> kept(ntiles);
+	Parallel::ForThreadBlocks(ntiles, Parallel::ThreadsFor(n), 1, [&](int, size_t t0, size_t t1)
+	{
+		for(size_t t = t0; t < t1; t++)
+		{
+			const size_t first = t * tileSize;
+			size_t last = std::min(first + tileSize, n);
+			for(BunchProcess* proc : run)
+			{
+				last = proc->DoProcessTile(dp.ds, t, first, last);
+			}
+			kept[t] = last - first;
+		}
+	});
+
+	size_t end = 0;
+	for(size_t t = 0; t < ntiles; t++)
+	{
+		const PSvectorArray::iterator first = particles.begin() + t * tileSize;
+		if(end != t * tileSize)
+		{
+			std::move(first, first + kept[t], particles.begin() + end);
+		}
+		end += kept[t];
+	}
+	if(end != n)
+	{
+		particles.erase(particles.begin() + end, particles.end());
+	}
+
+	for(BunchProcess* proc : run)
+	{
+		proc->EndTiles(dp.ds);
+	}
+}
+
 } // end of anonymous namespace
 
 ProcessStepManager::ProcessStepManager() :
-	total_s(0), log(nullptr), processTable()
+	total_s(0), log(nullptr), tileSize(0), currentBunch(nullptr), processTable()
 {
 }
 
@@ -130,12 +191,14 @@ ProcessStepManager::~ProcessStepManager()
 void ProcessStepManager::Initialise(Bunch& bunch)
 {
 	for_each(processTable.begin(), processTable.end(), InitProc(bunch));
+	currentBunch = &bunch;
 	total_s = 0;
 }
 
 void ProcessStepManager::Track(AcceleratorComponent& component)
 {
-	const std::string id = component.GetQualifiedName();
+	// the qualified name is only needed for the trace output
+	const std::string id = log ? component.GetQualifiedName() : std::string();
 
 	for_each(processTable.begin(), processTable.end(), SetCmpnt(component));
 
@@ -144,13 +207,69 @@ void ProcessStepManager::Track(AcceleratorComponent& component)
 	do
 	{
 		double ds = for_each(processTable.begin(), processTable.end(), CalcStepSize(sc - s)).ds;
-		for_each(processTable.begin(), processTable.end(), DoProc(s, ds, id, log));
+		if(tileSize != 0)
+		{
+			DoFusedStep(s, ds, id);
+		}
+		else
+		{
+			for_each(processTable.begin(), processTable.end(), DoProc(s, ds, id, log));
+		}
 		s += ds;
 	} while(!fequal(sc, s));
 
 	total_s += sc;
 }
 
+void ProcessStepManager::DoFusedStep(double s, double ds, const std::string& id)
+{
+	DoProc dp(s, ds, id, log);
+	ParticleTracking::ParticleBunch* pbunch = dynamic_cast<ParticleTracking::ParticleBunch*>(currentBunch);
+	if(pbunch == nullptr)
+	{
+		for_each(processTable.begin(), processTable.end(), dp);
+		return;
+	}
+
+	// Locality is checked as each run is formed, after any earlier
+	// processes of this step have been applied.
+	proc_itor p = processTable.begin();
+	while(p != processTable.end())
+	{
+		std::vector<BunchProcess*> run;
+		for(; p != processTable.end(); p++)
+		{
+			if(!(*p)->IsActive())
+			{
+				continue;
+			}
+			if(!(*p)->IsParticleLocal())
+			{
+				break;
+			}
+			run.push_back(*p);
+			if((*p)->IsTileBarrier())
+			{
+				p++;
+				break;
+			}
+		}
+
+		if(run.size() > 1)
+		{
+			DoTiles(*pbunch, tileSize, run, dp);
+		}
+		else if(run.size() == 1)
+		{
+			dp(run.front());
+		}
+		else if(p != processTable.end())
+		{
+			dp(*p++);
+		}
+	}
+}
+
 double ProcessStepManager::GetIntegratedLength()
 {
 	return total_s;
@@ -191,3 +310,8 @@ void ProcessStepManager::SetLogStream(ostream* os)
 {
 	log = os;
 }
+
+void ProcessStepManager::SetTileSize(size_t n)
+{
+	tileSize = n;
+}
@@ -10,6 +10,14 @@
 #include "LinearAlgebra.h"
 #include <algorithm>
 
+namespace
+{
+
+// PSvectors copied into columns at a time by MapKernel
+const size_t kernelBlock = 64;
+
+} // end anonymous namespace
+
 void RMap::ToMatrix(RealMatrix& R, bool init) const
 {
 	if(init)
@@ -52,6 +60,21 @@ void RMap::Apply(const PSvector& orig, PSvector& result) const
 	}
 }
 
+void RMap::Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const
+{
+	MapKernel k;
+	AppendTerms(k);
+	k.Apply(first, last);
+}
+
+void RMap::AppendTerms(MapKernel& k) const
+{
+	for(const_itor r = rterms.begin(); r != rterms.end(); r++)
+	{
+		k.AddTerm(r->i, r->j, r->val);
+	}
+}
+
 RMap::itor RMap::FindTerm(int i, int j)
 {
 	itor ri = rterms.begin();
@@ -104,3 +127,102 @@ void MakeIdentity(RMap& R, int ndf)
 		R.AddTerm(i, i, 1.0);
 	}
 }
+
+void MapKernel::AddTerm(int i, int j, double val)
+{
+	assert(i >= 0 && i < 6 && j >= 0 && j < 6);
+	Term t = {j, -1, val};
+	rows[i].push_back(t);
+}
+
+void MapKernel::AddTerm(int i, int j, int k, double val)
+{
+	assert(i >= 0 && i < 6 && j >= 0 && j < 6 && k >= 0 && k < 6);
+	Term t = {j, k, val};
+	rows[i].push_back(t);
+}
+
+void MapKernel::clear()
+{
+	for(int i = 0; i < 6; i++)
+	{
+		rows[i].clear();
+	}
+}
+
+void MapKernel::ApplyBlock(PSvectorArray::iterator first, size_t n, bool scaled, double Eratio) const
+{
+	double x[6][kernelBlock];
+	double y[6][kernelBlock];
+
+	for(size_t p = 0; p < n; p++)
+	{
+		for(int j = 0; j < 6; j++)
+		{
+			x[j][p] = first[p][j];
+		}
+	}
+	if(scaled)
+	{
+		for(size_t p = 0; p < n; p++)
+		{
+			x[ps_DP][p] = Eratio * (1 + x[ps_DP][p]) - 1;
+		}
+	}
+
+	// the scaled dp is not written back
+	const int nrows = scaled ? ps_DP : 6;
+	for(int i = 0; i < nrows; i++)
+	{
+		double* yi = y[i];
+		std::fill(yi, yi + n, 0.0);
+		for(std::vector<Term>::const_iterator t = rows[i].begin(); t != rows[i].end(); t++)
+		{
+			const double* xj = x[t->j];
+			const double val = t->val;
+			if(t->k < 0)
+			{
+				for(size_t p = 0; p < n; p++)
+				{
+					yi[p] += val * xj[p];
+				}
+			}
+			else
+			{
+				const double* xk = x[t->k];
+				for(size_t p = 0; p < n; p++)
+				{
+					yi[p] += val * xj[p] * xk[p];
+				}
+			}
+		}
+	}
+
+	for(size_t p = 0; p < n; p++)
+	{
+		for(int i = 0; i < nrows; i++)
+		{
+			first[p][i] = y[i][p];
+		}
+	}
+}
+
+void MapKernel::Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const
+{
+	while(first != last)
+	{
+		const size_t n = std::min(size_t(last - first), kernelBlock);
+		ApplyBlock(first, n, false, 1.0);
+		first += n;
+	}
+}
+
+void MapKernel::Apply(PSvectorArray::iterator first, PSvectorArray::iterator last, double Eratio) const
+{
+	while(first != last)
+	{
+		const size_t n = std::min(size_t(last - first), kernelBlock);
+		ApplyBlock(first, n, true, Eratio);
+		first += n;
+	}
+}
@@ -17,11 +17,114 @@
 #define RMap_h 1
 
 #include "merlin_config.h"
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include "PSTypes.h"
 #include "LinearAlgebra.h"
 #include "utils.h"
+#include "ParallelFor.h"
+
+/**
+ * class MapKernel
+ * The terms of an RMap, and the second-order terms of an RTMap, gathered
+ * by row for applying the map to many PSvectors at a time. The vectors
+ * are copied into columns in blocks, and each row of the result is
+ * accumulated over the block from its terms, in the order in which the
+ * terms were added. The result is therefore bit-identical to applying the
+ * map to each PSvector in turn, while the inner loops run over contiguous
+ * particles and vectorise.
+ */
+class MapKernel
+{
+public:
+
+	/**
+	 * Add the term R(i,j) (first order) or T(i,j,k) (second order), with
+	 * zero-based indices. Second-order terms must follow the first-order
+	 * terms of their row.
+	 */
+	void AddTerm(int i, int j, double val);
+	void AddTerm(int i, int j, int k, double val);
+
+	/**
+	 * Apply to the PSvectors [first, last).
+	 */
+	void Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const;
+
+	/**
+	 * Apply to the PSvectors [first, last) with dp/p scaled to the
+	 * momentum Pref of the map, where Eratio = P0/Pref. The original dp
+	 * is kept, as for map_applicator_dp.
+	 */
+	void Apply(PSvectorArray::iterator first, PSvectorArray::iterator last, double Eratio) const;
+
+	/**
+	 * Apply to the coordinates x[0..5], ordered as in a PSvector, of any
+	 * value type (for example a TPSA), without or with dp scaled.
+	 */
+	template<class T>
+	void Apply(T* x) const;
+	template<class T>
+	void Apply(T* x, double Eratio) const;
+
+	void clear();
+
+private:
+
+	struct Term
+	{
+		int j, k;
+		double val;
+	};
+
+	void ApplyBlock(PSvectorArray::iterator first, size_t n, bool scaled, double Eratio) const;
+
+	template<class T>
+	void Evaluate(const T* x, T* y, int nrows) const;
+
+	// k < 0 for first-order terms
+	std::vector<Term> rows[6];
+};
+
+template<class T>
+void MapKernel::Evaluate(const T* x, T* y, int nrows) const
+{
+	for(int i = 0; i < nrows; i++)
+	{
+		y[i] = 0.0;
+		for(std::vector<Term>::const_iterator t = rows[i].begin(); t != rows[i].end(); t++)
+		{
+			if(t->k < 0)
+			{
+				y[i] += t->val * x[t->j];
+			}
+			else
+			{
+				y[i] += t->val * x[t->j] * x[t->k];
+			}
+		}
+	}
+}
+
+template<class T>
+void MapKernel::Apply(T* x) const
+{
+	T y[6];
+	Evaluate(x, y, 6);
+	std::copy(y, y + 6, x);
+}
+
+template<class T>
+void MapKernel::Apply(T* x, double Eratio) const
+{
+	T xs[6];
+	std::copy(x, x + 6, xs);
+	xs[ps_DP] = Eratio * (1 + x[ps_DP]) - 1;
+	T y[6];
+	Evaluate(xs, y, ps_DP);
+	std::copy(y, y + ps_DP, x);
+}
 
 /**
  * class RMap
@@ -123,6 +226,16 @@ public:
 	 */
 	PSvector& Apply(PSvector&) const;
 
+	/**
+	 * Apply to the PSvectors [first, last), in blocks (see MapKernel)
+	 */
+	void Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const;
+
+	/**
+	 * Add the terms of the map to a MapKernel
+	 */
+	void AppendTerms(MapKernel& k) const;
+
 	/**
 	 * Apply to a covariance (sigma) matrix
 	 * - MSVC6 needs this to be defined here (inlined) for
@@ -465,13 +578,13 @@ struct map_applicator_dp
 template<class C, class M>
 void ApplyMap(const M& m, C& cont)
 {
-	for_each(cont.begin(), cont.end(), map_applicator<M, __TYPENAME__ C::value_type>(m));
+	Parallel::ForEach(cont.begin(), cont.end(), map_applicator<M, __TYPENAME__ C::value_type>(m));
 }
 
 template<class C, class M>
 void ApplyMap(const M& m, C& cont, double p0, double p1)
 {
-	for_each(cont.begin(), cont.end(), map_applicator_dp<M, __TYPENAME__ C::value_type>(m, p0 / p1));
+	Parallel::ForEach(cont.begin(), cont.end(), map_applicator_dp<M, __TYPENAME__ C::value_type>(m, p0 / p1));
 }
 
 #endif
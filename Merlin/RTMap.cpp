@@ -58,3 +58,40 @@ PSvector& RTMap::Apply(PSvector& X) const
 
 	return X = Y;
 }
+
+void RTMap::Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const
+{
+	MapKernel k;
+	AppendTerms(k);
+	k.Apply(first, last);
+}
+
+void RTMap::AppendTerms(MapKernel& k) const
+{
+	RMap::AppendTerms(k);
+	for(const_itor t = tterms.begin(); t != tterms.end(); t++)
+	{
+		k.AddTerm(t->i, t->j, t->k, t->val);
+	}
+}
+
+void ApplyMap(const RTMap& m, PSvectorArray& cont)
+{
+	MapKernel k;
+	m.AppendTerms(k);
+	Parallel::ForBlocks(cont.size(), 64, [&k, &cont](size_t first, size_t last)
+	{
+		k.Apply(cont.begin() + first, cont.begin() + last);
+	});
+}
+
+void ApplyMap(const RTMap& m, PSvectorArray& cont, double p0, double p1)
+{
+	MapKernel k;
+	m.AppendTerms(k);
+	const double Eratio = p0 / p1;
+	Parallel::ForBlocks(cont.size(), 64, [&k, &cont, Eratio](size_t first, size_t last)
+	{
+		k.Apply(cont.begin() + first, cont.begin() + last, Eratio);
+	});
+}
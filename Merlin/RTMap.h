@@ -79,6 +79,16 @@ public:
 	 */
 	PSvector& Apply(PSvector& p) const;
 
+	/**
+	 * Apply to the PSvectors [first, last), in blocks (see MapKernel)
+	 */
+	void Apply(PSvectorArray::iterator first, PSvectorArray::iterator last) const;
+
+	/**
+	 * Add the first- and second-order terms of the map to a MapKernel
+	 */
+	void AppendTerms(MapKernel& k) const;
+
 	/**
 	 * Output
 	 */
@@ -89,4 +99,11 @@ private:
 	NonLinearTermList tterms;
 };
 
+/**
+ * Apply an RTMap to an array of PSvectors, shared between the threads in
+ * blocks. These overloads replace the per-vector ApplyMap() templates.
+ */
+void ApplyMap(const RTMap& m, PSvectorArray& cont);
+void ApplyMap(const RTMap& m, PSvectorArray& cont, double p0, double p1);
+
 #endif
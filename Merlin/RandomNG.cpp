@@ -11,7 +11,11 @@
 std::vector<std::uint32_t> RandomNG::master_seed;
 std::unique_ptr<std::mt19937_64> RandomNG::generator;
 
-std::unordered_map<size_t, std::mt19937_64> RandomNG::generator_store;
+std::unordered_map<size_t, PhiloxEngine> RandomNG::generator_store;
+
+std::uint64_t RandomNG::stream_key = 0;
+bool RandomNG::counter_based = false;
+thread_local PhiloxEngine* RandomNG::stream = nullptr;
 
 void RandomNG::init()
 {
@@ -41,6 +45,20 @@ void RandomNG::reset()
 {
 	std::seed_seq ss(master_seed.begin(), master_seed.end());
 	generator.reset(new std::mt19937_64{ss});
+	stream_key = makeKey(0);
+}
+
+std::uint64_t RandomNG::makeKey(size_t name_hash)
+{
+	std::vector<std::uint32_t> seed{master_seed};
+	if(name_hash)
+	{
+		seed.push_back(name_hash);
+	}
+	std::seed_seq ss(seed.begin(), seed.end());
+	std::uint32_t k[2];
+	ss.generate(k, k + 2);
+	return (static_cast<std::uint64_t>(k[0]) << 32) | k[1];
 }
 
 void RandomNG::reset(std::uint32_t iseed)
@@ -62,17 +80,11 @@ const std::vector<std::uint32_t>& RandomNG::getSeed()
 
 double RandomNG::normal(double mean, double variance)
 {
-	if(!generator)
-		not_seeded();
 	std::normal_distribution<double> dist{mean, sqrt(variance)};
-	return dist(*generator);
+	return draw(dist);
 }
 double RandomNG::normal(double mean, double variance, double cutoff)
 {
-	if(!generator)
-	{
-		not_seeded();
-	}
 	if(cutoff == 0)
 	{
 		return normal(mean, variance);
@@ -84,44 +96,69 @@ double RandomNG::normal(double mean, double variance, double cutoff)
 	double x;
 	do
 	{
-		x = dist(*generator);
+		x = draw(dist);
 	} while(fabs(x - mean) > cutoff);
 	return x;
 }
 double RandomNG::uniform(double low, double high)
 {
-	if(!generator)
-	{
-		not_seeded();
-	}
 	std::uniform_real_distribution<double> dist{low, high};
-	return dist(*generator);
+	return draw(dist);
 }
 double RandomNG::poisson(double u)
 {
-	if(!generator)
-	{
-		not_seeded();
-	}
 	std::poisson_distribution<int> dist{u};
-	return dist(*generator);
+	return draw(dist);
 }
 double RandomNG::landau()
+{
+	landau_distribution<double> dist{};
+	return draw(dist);
+}
+
+std::mt19937_64& RandomNG::getGenerator()
+{
+	return *generator;
+}
+
+PhiloxEngine RandomNG::getStream(std::uint64_t particle, std::uint64_t turn, std::uint64_t element,
+	std::uint64_t step)
 {
 	if(!generator)
 	{
 		not_seeded();
 	}
-	landau_distribution<double> dist{};
-	return dist(*generator);
+	// The second key word separates particle streams from local generators
+	return PhiloxEngine(stream_key, 0, particle, turn, (element << 32) ^ step);
 }
 
-std::mt19937_64& RandomNG::getGenerator()
+RandomNG::Stream::Stream(std::uint64_t particle, std::uint64_t turn, std::uint64_t element, std::uint64_t step) :
+	engine(getStream(particle, turn, element, step)), previous(RandomNG::stream)
 {
-	return *generator;
+	RandomNG::stream = &engine;
+}
+
+RandomNG::Stream::~Stream()
+{
+	RandomNG::stream = previous;
+}
+
+void RandomNG::setCounterBased(bool on)
+{
+	counter_based = on;
+}
+
+bool RandomNG::isCounterBased()
+{
+	return counter_based;
+}
+
+bool RandomNG::inStream()
+{
+	return stream != nullptr;
 }
 
-std::mt19937_64& RandomNG::getLocalGenerator(size_t name_hash)
+PhiloxEngine& RandomNG::getLocalGenerator(size_t name_hash)
 {
 	if(!generator)
 	{
@@ -134,13 +171,7 @@ std::mt19937_64& RandomNG::getLocalGenerator(size_t name_hash)
 	}
 	else
 	{
-		// extend master seed
-		std::vector<std::uint32_t> new_seed{master_seed};
-		new_seed.push_back(name_hash);
-		std::seed_seq ss(new_seed.begin(), new_seed.end());
-		// create and store new generator
-		auto new_gen = std::mt19937_64{ss};
-		generator_store[name_hash] = new_gen;
+		resetLocalGenerator(name_hash);
 		return generator_store[name_hash];
 	}
 }
@@ -151,12 +182,8 @@ void RandomNG::resetLocalGenerator(size_t name_hash)
 	{
 		not_seeded();
 	}
-	std::vector<std::uint32_t> new_seed{master_seed};
-	new_seed.push_back(name_hash);
-	std::seed_seq ss(new_seed.begin(), new_seed.end());
-	// create and store new generator
-	auto new_gen = std::mt19937_64{ss};
-	generator_store[name_hash] = new_gen;
+	// create and store new generator, keyed on the master seed extended by name_hash
+	generator_store[name_hash] = PhiloxEngine(makeKey(name_hash), 1);
 }
 
 std::uint32_t hash_string(std::string s)
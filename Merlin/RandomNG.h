@@ -14,6 +14,7 @@
 #include <cstdint>
 #include <iostream>
 #include <unordered_map>
+#include "PhiloxEngine.h"
 
 /**
  * Singleton class for generating continuous floating point numbers from specific distributions.
@@ -23,6 +24,13 @@
  * * landau
  *
  * Also provides access to the generator for more optimised usage.
+ *
+ * By default all numbers come from one shared sequential generator. For
+ * reproducible parallel tracking, counter-based streams keyed on
+ * (master seed, particle id, turn, element) can be opened with
+ * RandomNG::Stream. While a Stream is alive the distribution functions
+ * called on that thread draw from it, so a particle gets the same numbers
+ * whichever thread or MPI rank tracks it and in whatever order.
  */
 
 class RandomNG
@@ -93,6 +101,57 @@ public:
 	/// Gives a reference to the actual generator
 	static std::mt19937_64& getGenerator();
 
+	/**
+	 * Get the counter-based generator for one particle at one point of
+	 * the tracking. The numbers depend only on the master seed and the
+	 * arguments.
+	 *
+	 * @param[in] particle The particle id
+	 * @param[in] turn The turn (or pass) number
+	 * @param[in] element The beamline index of the element
+	 * @param[in] step The step within the element
+	 */
+	static PhiloxEngine getStream(std::uint64_t particle, std::uint64_t turn, std::uint64_t element,
+		std::uint64_t step = 0);
+
+	/**
+	 * Draw from a particle stream on the calling thread.
+	 *
+	 * For the lifetime of the object, normal(), uniform(), poisson() and
+	 * landau() called on this thread use getStream(particle, turn,
+	 * element, step) instead of the shared generator. Streams may be
+	 * nested.
+	 */
+	class Stream
+	{
+	public:
+		Stream(std::uint64_t particle, std::uint64_t turn, std::uint64_t element, std::uint64_t step = 0);
+		~Stream();
+
+		Stream(const Stream&) = delete;
+		Stream& operator=(const Stream&) = delete;
+
+		PhiloxEngine& generator()
+		{
+			return engine;
+		}
+
+	private:
+		PhiloxEngine engine;
+		PhiloxEngine* previous;
+	};
+
+	/**
+	 * Select counter-based mode. Processes which support it then open a
+	 * particle Stream for their random numbers and may run in parallel.
+	 * This needs unique particle ids. Default false.
+	 */
+	static void setCounterBased(bool on);
+	static bool isCounterBased();
+
+	/// True if a Stream is active on the calling thread
+	static bool inStream();
+
 	/**
 	 * Get a new generator to be used within a physics process class
 	 *
@@ -103,9 +162,11 @@ public:
 	 *     auto gen = RandomNG::getLocalGenerator(hash_string("MyPhysicsProcess"));
 	 *
 	 * The generator is held within RandomNG::generator_store, so the same
-	 * generator will be returned if called with the same name_hash
+	 * generator will be returned if called with the same name_hash. It is
+	 * a counter-based generator whose key combines the master seed and
+	 * name_hash.
 	 */
-	static std::mt19937_64& getLocalGenerator(size_t name_hash);
+	static PhiloxEngine& getLocalGenerator(size_t name_hash);
 
 	/// Reset a given local generator
 	static void resetLocalGenerator(size_t name_hash);
@@ -114,7 +175,29 @@ private:
 	static std::vector<std::uint32_t> master_seed;
 	static std::unique_ptr<std::mt19937_64> generator;
 
-	static std::unordered_map<size_t, std::mt19937_64> generator_store;
+	static std::unordered_map<size_t, PhiloxEngine> generator_store;
+
+	/// Key derived from master_seed for counter-based generators
+	static std::uint64_t stream_key;
+	static bool counter_based;
+	static thread_local PhiloxEngine* stream;
+
+	static std::uint64_t makeKey(size_t name_hash);
+
+	/// Draw from the active stream, or the shared generator
+	template<class D>
+	static double draw(D& dist)
+	{
+		if(stream)
+		{
+			return dist(*stream);
+		}
+		if(!generator)
+		{
+			not_seeded();
+		}
+		return dist(*generator);
+	}
 
 	static void not_seeded()
 	{
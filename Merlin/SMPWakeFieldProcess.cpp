@@ -87,7 +87,8 @@ namespace SMPTracking
 {
 
 WakeFieldProcess::WakeFieldProcess(int prio, double sw, string aID) :
-	SMPBunchProcess(aID, prio), imploc(atExit), recalc(true), inc_tw(true), dz(sw), currentWake(nullptr)
+	SMPBunchProcess(aID, prio), imploc(atExit), recalc(true), inc_tw(true), dz(sw), currentWake(nullptr),
+	meshResolution(0)
 {
 }
 
@@ -150,6 +151,95 @@ void WakeFieldProcess::DoProcess(double ds)
 	}
 }
 
+template<class W>
+void WakeFieldProcess::MeshSum(W wake, WakeKind kind, double self, const vector<double>& q, vector<double>& out,
+	const vector<double>* q2, vector<double>* out2)
+{
+	const size_t np = slice_z.size();
+	const double h = dz / meshResolution;
+	const double z0 = slice_z.front();
+
+	// mesh cell of each slice, and the weight of the upper node of the
+	// cell in the linear deposition and interpolation
+	vector<size_t> cell(np);
+	vector<double> frac(np);
+	for(size_t i = 0; i < np; i++)
+	{
+		const double u = (slice_z[i] - z0) / h;
+		cell[i] = size_t(u);
+		frac[i] = u - cell[i];
+	}
+	const size_t nmesh = cell.back() + 2;
+
+	vector<double> m(nmesh, 0.0);
+	vector<double> m2(q2 ? nmesh : 0, 0.0);
+	for(size_t j = 0; j < np; j++)
+	{
+		m[cell[j]] += (1 - frac[j]) * q[j];
+		m[cell[j] + 1] += frac[j] * q[j];
+		if(q2)
+		{
+			m2[cell[j]] += (1 - frac[j]) * (*q2)[j];
+			m2[cell[j] + 1] += frac[j] * (*q2)[j];
+		}
+	}
+
+	ParticleTracking::SampledWake& w = meshWakes[make_pair(currentWake, int(kind))];
+	w.Sample(wake, nmesh, h, 0);
+	vector<double> g(nmesh);
+	vector<double> g2(q2 ? nmesh : 0);
+	w.Correlate(m.data(), g.data(), q2 ? m2.data() : nullptr, q2 ? g2.data() : nullptr);
+
+	// The mesh only sums the wake of nodes at or ahead of each node, so
+	// slices in the same or adjacent cells see part of each other's
+	// wake, whichever is ahead. Their contribution on the mesh is
+	// replaced by the exact one.
+	const double wk[3] = {wake(0 * h), wake(1 * h), wake(2 * h)};
+	out.assign(np, 0.0);
+	if(q2)
+	{
+		out2->assign(np, 0.0);
+	}
+	for(size_t i = 0; i < np; i++)
+	{
+		const size_t c = cell[i];
+		const double fi = frac[i];
+		out[i] = (1 - fi) * g[c] + fi * g[c + 1];
+		if(q2)
+		{
+			(*out2)[i] = (1 - fi) * g2[c] + fi * g2[c + 1];
+		}
+
+		size_t first = i;
+		while(first > 0 && cell[first - 1] + 1 >= c)
+		{
+			first--;
+		}
+		for(size_t j = first; j < np && cell[j] <= c + 1; j++)
+		{
+			const double ai[2] = {1 - fi, fi};
+			const double aj[2] = {1 - frac[j], frac[j]};
+			double wmesh = 0;
+			for(size_t a = 0; a < 2; a++)
+			{
+				for(size_t b = 0; b < 2; b++)
+				{
+					if(cell[j] + a >= c + b)
+					{
+						wmesh += aj[a] * ai[b] * wk[cell[j] + a - c - b];
+					}
+				}
+			}
+			const double wexact = j < i ? 0 : (j == i ? self * wake(0) : wake(slice_z[j] - slice_z[i]));
+			out[i] += (wexact - wmesh) * q[j];
+			if(q2)
+			{
+				(*out2)[i] += (wexact - wmesh) * (*q2)[j];
+			}
+		}
+	}
+}
+
 void WakeFieldProcess::ApplyWakefield(double ds)
 {
 	// here we apply the wake field for
@@ -167,25 +257,48 @@ void WakeFieldProcess::ApplyWakefield(double ds)
 	size_t np = slice_z.size();
 	double dE = -bload * ds;
 
-	for(size_t i = 0; i < np; i++)
+	vector<double> wake_x(np, 0.0);
+	vector<double> wake_y(np, 0.0);
+	if(inc_tw)
 	{
+		vector<Point2D> X0(np);
+		for(size_t j = 0; j < np; j++)
+		{
+			X0[j] = GetSliceCentroid(sliceBoundaries[j], sliceBoundaries[j + 1]);
+		}
 
-		double kick_x = 0;
-		double kick_y = 0;
-
-		if(inc_tw)
+		if(meshResolution)
+		{
+			vector<double> qx(np), qy(np);
+			for(size_t j = 0; j < np; j++)
+			{
+				qx[j] = slice_q[j] * X0[j].x;
+				qy[j] = slice_q[j] * X0[j].y;
+			}
+			const WakePotentials* wake = currentWake;
+			MeshSum([wake](double z)
+			{
+				return wake->Wtrans(z);
+			}, transWake, 0, qx, wake_x, &qy, &wake_y);
+		}
+		else
 		{
-			for(size_t j = i + 1; j < np; j++)
+			for(size_t i = 0; i < np; i++)
 			{
-				double w = (currentWake->Wtrans(slice_z[j] - slice_z[i])) * slice_q[j];
-				Point2D X0 = GetSliceCentroid(sliceBoundaries[j], sliceBoundaries[j + 1]);
-				kick_x += w * X0.x;
-				kick_y += w * X0.y;
+				for(size_t j = i + 1; j < np; j++)
+				{
+					double w = (currentWake->Wtrans(slice_z[j] - slice_z[i])) * slice_q[j];
+					wake_x[i] += w * X0[j].x;
+					wake_y[i] += w * X0[j].y;
+				}
 			}
 		}
+	}
 
-		double dPx = ds * wconv * kick_x;
-		double dPy = ds * wconv * kick_y;
+	for(size_t i = 0; i < np; i++)
+	{
+		double dPx = ds * wconv * wake_x[i];
+		double dPy = ds * wconv * wake_y[i];
 		double dPz = -ds * wake_z[i]; // beamloading
 
 		// apply the kicks to the macro-particles in the i-th slice
@@ -214,13 +327,29 @@ void WakeFieldProcess::PrepLWake()
 	wake_z = vector<double>(np, 0.0);
 	double qt = 0;
 	bload = 0;
+	if(meshResolution)
+	{
+		// note factor 0.5 for FTBL
+		const WakePotentials* wake = currentWake;
+		MeshSum([wake](double z)
+		{
+			return wake->Wlong(z);
+		}, longWake, 0.5, slice_q, wake_z);
+		for(size_t i = 0; i < np; i++)
+		{
+			wake_z[i] *= wconv;
+		}
+	}
 	for(size_t i = 0; i < np; i++)
 	{
-		for(size_t j = i; j < np; j++)
+		if(!meshResolution)
 		{
-			double dz = slice_z[j] - slice_z[i];
-			// note factor 0.5 for FTBL
-			wake_z[i] += (i == j ? 0.5 : 1.0) * (currentWake->Wlong(dz)) * slice_q[j] * wconv;
+			for(size_t j = i; j < np; j++)
+			{
+				double dz = slice_z[j] - slice_z[i];
+				// note factor 0.5 for FTBL
+				wake_z[i] += (i == j ? 0.5 : 1.0) * (currentWake->Wlong(dz)) * slice_q[j] * wconv;
+			}
 		}
 		// beam loading
 		bload += slice_q[i] * wake_z[i];
@@ -235,6 +364,7 @@ void WakeFieldProcess::InitialiseProcess(Bunch& bunch)
 	SMPBunchProcess::InitialiseProcess(bunch);
 	currentWake = nullptr;
 	recalc = true;
+	meshWakes.clear();
 }
 
 void WakeFieldProcess::PrepSlices()
@@ -10,7 +10,10 @@
 
 #include "SMPBunch.h"
 #include "SMPBunchProcess.h"
+#include "SampledWake.h"
 
+#include <map>
+#include <utility>
 #include <vector>
 #include <typeinfo>
 
@@ -52,6 +55,26 @@ public:
 		inc_tw = flg;
 	}
 
+	/**
+	 *	Selects how the wakes of the slices on each other are summed.
+	 *	With n = 0 (the default) the sum is taken over every pair of
+	 *	slices, in O(N^2) for N slices. Otherwise the slice charges are
+	 *	deposited on a uniform mesh of n cells per slice width and
+	 *	convolved with the wake by FFT, and the sum is interpolated back
+	 *	to the slices. The pairs of slices within one mesh cell of each
+	 *	other are summed exactly, so that the remaining error comes from
+	 *	the interpolation of the wake over a cell, and falls as 1/n^2.
+	 */
+	void SetMeshResolution(size_t n)
+	{
+		meshResolution = n;
+	}
+
+	size_t GetMeshResolution() const
+	{
+		return meshResolution;
+	}
+
 private:
 
 	void ApplyWakefield(double ds);
@@ -65,6 +88,21 @@ private:
 	void PrepLWake();
 	void PrepSlices();
 
+	enum WakeKind
+	{
+		longWake,
+		transWake
+	};
+
+	/**
+	 *	out[i] = sum over slices j >= i of W(slice_z[j] - slice_z[i]) q[j],
+	 *	with the j == i term weighted by self, found on the mesh. If q2
+	 *	is given, out2 is found from it in the same way.
+	 */
+	template<class W>
+	void MeshSum(W wake, WakeKind kind, double self, const std::vector<double>& q, std::vector<double>& out,
+		const std::vector<double>* q2 = nullptr, std::vector<double>* out2 = nullptr);
+
 	std::vector<double> wake_z;
 	std::vector<SMPBunch::iterator> sliceBoundaries;
 	std::vector<double> slice_z;
@@ -75,6 +113,13 @@ private:
 	const double dz; /// slice width for binning
 	WakePotentials* currentWake;
 
+	size_t meshResolution;
+
+	/**
+	 *	Wakes sampled at the mesh spacing, for each wake and kind.
+	 */
+	std::map<std::pair<const WakePotentials*, int>, ParticleTracking::SampledWake> meshWakes;
+
 };
 
 } // end namespace SMPTracking
@@ -0,0 +1,249 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "NumericalConstants.h"
+#include "SampledWake.h"
+
+using namespace std;
+
+namespace
+{
+
+typedef std::complex<double> Complex;
+
+// written out, as std::complex multiplication also checks for infinities
+inline Complex Multiply(const Complex& a, const Complex& b)
+{
+	return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+} // end anonymous namespace
+
+namespace ParticleTracking
+{
+
+size_t SampledWake::fftThreshold = 512;
+
+SampledWake::SampledWake() :
+	dz(0), offset(0)
+{
+}
+
+void SampledWake::SetFFTThreshold(size_t n)
+{
+	fftThreshold = n;
+}
+
+size_t SampledWake::GetFFTThreshold()
+{
+	return fftThreshold;
+}
+
+void SampledWake::Correlate(const double* q, double* out, const double* q2, double* out2)
+{
+	const size_t n = w.size();
+	if(n >= fftThreshold)
+	{
+		FFTConvolve(q, out, q2, out2, true);
+		return;
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		out[i] = 0;
+		for(size_t j = i; j < n; j++)
+		{
+			out[i] += w[j - i] * q[j];
+		}
+	}
+	if(q2)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			out2[i] = 0;
+			for(size_t j = i; j < n; j++)
+			{
+				out2[i] += w[j - i] * q2[j];
+			}
+		}
+	}
+}
+
+void SampledWake::Convolve(const double* q, double* out, const double* q2, double* out2)
+{
+	const size_t n = w.size();
+	if(n >= fftThreshold)
+	{
+		FFTConvolve(q, out, q2, out2, false);
+		return;
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		out[i] = 0;
+		for(size_t j = 0; j <= i; j++)
+		{
+			out[i] += w[i - j] * q[j];
+		}
+	}
+	if(q2)
+	{
+		for(size_t i = 0; i < n; i++)
+		{
+			out2[i] = 0;
+			for(size_t j = 0; j <= i; j++)
+			{
+				out2[i] += w[i - j] * q2[j];
+			}
+		}
+	}
+}
+
+void SampledWake::Correlate(const double* q, const double* x, double* outx, const double* y, double* outy)
+{
+	const size_t n = w.size();
+	if(n >= fftThreshold)
+	{
+		vector<double> qx(n), qy(n);
+		for(size_t j = 0; j < n; j++)
+		{
+			qx[j] = q[j] * x[j];
+			qy[j] = q[j] * y[j];
+		}
+		FFTConvolve(qx.data(), outx, qy.data(), outy, true);
+		return;
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		outx[i] = 0;
+		outy[i] = 0;
+		for(size_t j = i; j < n; j++)
+		{
+			const double wq = w[j - i] * q[j];
+			outx[i] += wq * x[j];
+			outy[i] += wq * y[j];
+		}
+	}
+}
+
+void SampledWake::Convolve(const double* q, double d, double* out)
+{
+	const size_t n = w.size();
+	if(n >= fftThreshold)
+	{
+		vector<double> qd(n);
+		for(size_t j = 0; j < n; j++)
+		{
+			qd[j] = q[j] / d;
+		}
+		FFTConvolve(qd.data(), out, nullptr, nullptr, false);
+		return;
+	}
+
+	for(size_t i = 0; i < n; i++)
+	{
+		out[i] = 0;
+		for(size_t j = 0; j <= i; j++)
+		{
+			out[i] += w[i - j] * q[j] / d;
+		}
+	}
+}
+
+void SampledWake::FFTConvolve(const double* q, double* out, const double* q2, double* out2, bool reverse)
+{
+	// The linear convolution of w with q, from the cyclic convolution of
+	// their zero padded transforms. For the correlation q is reversed.
+	// Since w is real, a second distribution is carried in the imaginary
+	// part and separates again in the result.
+	const size_t n = w.size();
+	size_t nfft = 1;
+	while(nfft < 2 * n)
+	{
+		nfft *= 2;
+	}
+
+	if(spectrum.size() != nfft)
+	{
+		twiddle.resize(nfft / 2);
+		for(size_t k = 0; k < nfft / 2; k++)
+		{
+			twiddle[k] = std::polar(1.0, -twoPi * k / nfft);
+		}
+		spectrum.assign(nfft, Complex(0, 0));
+		std::copy(w.begin(), w.end(), spectrum.begin());
+		FFT(spectrum);
+	}
+
+	work.assign(nfft, Complex(0, 0));
+	for(size_t j = 0; j < n; j++)
+	{
+		const size_t k = reverse ? n - 1 - j : j;
+		work[j] = Complex(q[k], q2 ? q2[k] : 0);
+	}
+
+	FFT(work);
+	for(size_t k = 0; k < nfft; k++)
+	{
+		work[k] = std::conj(Multiply(work[k], spectrum[k]));
+	}
+	// the inverse transform, as the conjugate of the forward transform of
+	// the conjugate
+	FFT(work);
+
+	const double scale = 1.0 / nfft;
+	for(size_t i = 0; i < n; i++)
+	{
+		const Complex& c = work[reverse ? n - 1 - i : i];
+		out[i] = c.real() * scale;
+		if(q2)
+		{
+			out2[i] = -c.imag() * scale;
+		}
+	}
+}
+
+void SampledWake::FFT(std::vector<Complex>& a) const
+{
+	const size_t nfft = a.size();
+
+	// bit reversed order
+	for(size_t i = 1, j = 0; i < nfft; i++)
+	{
+		size_t bit = nfft >> 1;
+		for(; j & bit; bit >>= 1)
+		{
+			j ^= bit;
+		}
+		j ^= bit;
+		if(i < j)
+		{
+			std::swap(a[i], a[j]);
+		}
+	}
+
+	for(size_t len = 2; len <= nfft; len <<= 1)
+	{
+		const size_t half = len / 2;
+		const size_t step = nfft / len;
+		for(size_t i = 0; i < nfft; i += len)
+		{
+			for(size_t k = 0; k < half; k++)
+			{
+				const Complex u = a[i + k];
+				const Complex v = Multiply(a[i + k + half], twiddle[k * step]);
+				a[i + k] = u + v;
+				a[i + k + half] = u - v;
+			}
+		}
+	}
+}
+
+} // end namespace ParticleTracking
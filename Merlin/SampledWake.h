@@ -0,0 +1,123 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef SampledWake_h
+#define SampledWake_h 1
+
+#include "merlin_config.h"
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace ParticleTracking
+{
+
+/**
+ *	A wake potential sampled at the slice spacing of a binned bunch,
+ *	w[k] = W((k + offset) dz) for k = 0 .. n - 1, and the sums over
+ *	the slices which give the wake of the whole bunch.
+ *
+ *	The samples are kept until the number of slices or the slice width
+ *	changes, so that the wake function is evaluated n times rather than
+ *	n^2 times for each bunch wake. For at least GetFFTThreshold()
+ *	slices the sums are found with FFTs in O(n log n); below that the
+ *	direct O(n^2) sums are faster, and are accumulated in the same
+ *	order as the original slice loops.
+ */
+class SampledWake
+{
+public:
+
+	SampledWake();
+
+	/**
+	 *	Sample wake(z) at z = (k + offset) dz, k = 0 .. n - 1, unless
+	 *	it is already sampled for the same n, dz and offset.
+	 */
+	template<class F>
+	void Sample(F wake, size_t n, double dz, double offset);
+
+	/**
+	 *	out[i] = sum over j = i .. n - 1 of w[j - i] q[j], the wake at
+	 *	slice i of the slices ahead of it. If q2 is given, out2 is found
+	 *	from it in the same way (at no extra cost with the FFT).
+	 */
+	void Correlate(const double* q, double* out, const double* q2 = nullptr, double* out2 = nullptr);
+
+	/**
+	 *	out[i] = sum over j = 0 .. i of w[i - j] q[j], the wake at slice
+	 *	i of the slices behind it.
+	 */
+	void Convolve(const double* q, double* out, const double* q2 = nullptr, double* out2 = nullptr);
+
+	/**
+	 *	The transverse wake: outx[i] = sum over j = i .. n - 1 of
+	 *	(w[j - i] q[j]) x[j], where q[j] is the charge of slice j and x[j]
+	 *	its centroid, and outy from y in the same way. The direct sums
+	 *	multiply in this order, as the original slice loops did.
+	 */
+	void Correlate(const double* q, const double* x, double* outx, const double* y, double* outy);
+
+	/**
+	 *	out[i] = sum over j = 0 .. i of (w[i - j] q[j]) / d, dividing each
+	 *	term in the direct sums as the original CSR wake loop did.
+	 */
+	void Convolve(const double* q, double d, double* out);
+
+	size_t size() const
+	{
+		return w.size();
+	}
+
+	/**
+	 *	Set the number of slices from which the sums are found with
+	 *	FFTs. Default 512.
+	 */
+	static void SetFFTThreshold(size_t n);
+	static size_t GetFFTThreshold();
+
+private:
+
+	std::vector<double> w;
+	double dz;
+	double offset;
+
+	/**
+	 *	The transform of w, zero padded to the FFT length, and the
+	 *	twiddle factors for that length.
+	 */
+	std::vector<std::complex<double> > spectrum;
+	std::vector<std::complex<double> > twiddle;
+	std::vector<std::complex<double> > work;
+
+	void FFTConvolve(const double* q, double* out, const double* q2, double* out2, bool reverse);
+	void FFT(std::vector<std::complex<double> >& a) const;
+
+	static size_t fftThreshold;
+};
+
+template<class F>
+void SampledWake::Sample(F wake, size_t n, double dz1, double offset1)
+{
+	if(w.size() == n && dz == dz1 && offset == offset1)
+	{
+		return;
+	}
+
+	w.resize(n);
+	for(size_t k = 0; k < n; k++)
+	{
+		w[k] = wake((k + offset1) * dz1);
+	}
+	dz = dz1;
+	offset = offset1;
+	spectrum.clear();
+}
+
+} // end namespace ParticleTracking
+
+#endif
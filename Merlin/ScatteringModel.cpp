@@ -29,7 +29,7 @@ using namespace PhysicalConstants;
 using namespace Collimation;
 
 ScatteringModel::ScatteringModel() :
-	energy_loss_mode(FullEnergyLoss)
+	energy_loss_mode(FullEnergyLoss), configured_material(size_t(-1))
 {
 	ScatterPlot_on = 0;
 	JawImpact_on = 0;
@@ -37,81 +37,82 @@ ScatteringModel::ScatteringModel() :
 
 ScatteringModel::~ScatteringModel()
 {
-	for(auto it : stored_cross_sections)
+	ClearMaterials();
+}
+
+void ScatteringModel::ClearMaterials()
+{
+	for(auto& m : materials)
 	{
-		delete it.second;
+		delete m.cs;
 	}
+	materials.clear();
+	material_indices.clear();
+	configured_material = size_t(-1);
 }
 
-double ScatteringModel::PathLength(Material* mat, double E0)
+size_t ScatteringModel::SelectMaterial(Material* mat, double E0)
 {
-	static double lambda;
-	CrossSections* CurrentCS;
+	std::map<std::string, size_t>::iterator it = material_indices.find(mat->GetSymbol());
 
-	CS_iterator = stored_cross_sections.find(mat->GetSymbol());
-
-	// If find gets to the end of the stored_cross_sections map, there is no value stored
-	if(CS_iterator == stored_cross_sections.end())
+	// If find gets to the end of the material_indices map, there is no value stored
+	if(it == material_indices.end())
 	{
 		//No previously calculated CrossSections, start from scratch
-		CurrentCS = new CrossSections(mat, E0, ScatteringPhysicsModel);
-
-		stored_cross_sections.insert(std::map<string, Collimation::CrossSections*>::value_type(mat->GetSymbol(),
-			CurrentCS));
-
-		//Set iterator to correct position
-		CS_iterator = stored_cross_sections.find(mat->GetSymbol());
+		MaterialScattering m;
+		m.material = mat;
+		m.cs = new CrossSections(mat, E0, ScatteringPhysicsModel);
+		m.lambda = m.cs->GetTotalMeanFreePath();
 
 		//Find fractions of cross sections
 		double sigma = 0;
-		int i = 0;
 		std::vector<ScatteringProcess*>::iterator p;
 
-		std::cout << "ScatteringModel::PathLength: MATERIAL = " << mat->GetSymbol() << std::endl;
+		std::cout << "ScatteringModel::SelectMaterial: MATERIAL = " << mat->GetSymbol() << std::endl;
 		for(p = Processes.begin(); p != Processes.end(); p++)
 		{
-			(*p)->Configure(mat, CurrentCS);
-			fraction[i] = (*p)->sigma;
+			(*p)->Configure(mat, m.cs);
+			m.cumulative.push_back((*p)->sigma);
 			std::cout << (*p)->GetProcessType() << "\t\t sigma = " << (*p)->sigma << " barns" << std::endl;
-			sigma += fraction[i];
-			++i;
+			sigma += (*p)->sigma;
 		}
 
-		for(unsigned int j = 0; j < fraction.size(); j++)
+		double sum = 0;
+		for(unsigned int j = 0; j < m.cumulative.size(); j++)
 		{
+			double fraction = m.cumulative[j] / sigma;
 			std::cout << " Process " << j << " total sigma " << setw(10) << setprecision(4) << sigma << "barns";
-			fraction[j] /= sigma;
-			std::cout << " fraction " << setw(10) << setprecision(4) << fraction[j] << std::endl;
+			std::cout << " fraction " << setw(10) << setprecision(4) << fraction << std::endl;
+			sum += fraction;
+			m.cumulative[j] = sum;
 		}
-	}
-	else
-	{
-		//Should return a pointer to the CrossSections we require
-		CurrentCS = CS_iterator->second;
-
-		//Make sure that the CrossSections are for the same case (scattering etc)
-		if(CurrentCS == CS_iterator->second)
+		if(!m.cumulative.empty())
 		{
-
+			// guard against rounding in the sum
+			m.cumulative.back() = 1;
 		}
-		else
-		{
-			std::cout << std::endl
-					  << "\tWarning: ScatteringModel::PathLength: CurrentCS != StoredCS, recalculating CrossSections"
-					  << std::endl;
-			CurrentCS = new CrossSections(mat, E0, ScatteringPhysicsModel);
-			stored_cross_sections.insert(std::map<string, Collimation::CrossSections*>::value_type(mat->GetSymbol(),
-				CurrentCS));
 
-			//Set iterator to correct position
-			CS_iterator = stored_cross_sections.find(mat->GetSymbol());
-		}
+		it = material_indices.insert(std::make_pair(mat->GetSymbol(), materials.size())).first;
+		materials.push_back(m);
+		configured_material = it->second;
+	}
 
+	if(configured_material != it->second)
+	{
+		const MaterialScattering& m = materials[it->second];
+		for(auto p : Processes)
+		{
+			p->Configure(m.material, m.cs);
+		}
+		configured_material = it->second;
 	}
 
-	//Calculate mean free path
-	lambda = CurrentCS->GetTotalMeanFreePath();
-	return -(lambda) * log(RandomNG::uniform(0, 1));
+	return it->second;
+}
+
+double ScatteringModel::PathLength(Material* mat, double E0)
+{
+	return PathLength(SelectMaterial(mat, E0));
 }
 
 void ScatteringModel::EnergyLoss(PSvector& p, double x, Material* mat, double E0)
@@ -246,25 +247,30 @@ void ScatteringModel::Straggle(PSvector& p, double x, Material* mat, double E1,
 
 bool ScatteringModel::ParticleScatter(PSvector& p, Material* mat, double E)
 {
-	if(fraction.size() == 0)
+	return ParticleScatter(p, SelectMaterial(mat, E), E);
+}
+
+bool ScatteringModel::ParticleScatter(PSvector& p, size_t material, double E)
+{
+	if(Processes.size() == 0)
 	{
 		cerr << "ScatteringModel has no ScatteringProcesses. Use AddProcess() or "
 			 << "one of the inbuilt ScatteringModels such as ScatteringModelMerlin." << endl;
 		exit(EXIT_FAILURE);
 	}
 
+	const std::vector<double>& cumulative = materials[material].cumulative;
 	double r = RandomNG::uniform(0, 1);
 
-	for(unsigned int i = 0; i < fraction.size(); i++)
+	for(unsigned int i = 0; i < cumulative.size(); i++)
 	{
-		r -= fraction[i];
-		if(r < 0)
+		if(r < cumulative[i])
 		{
 			return Processes[i]->Scatter(p, E);
 		}
 	}
 
-	cerr << " should never get this message : \n\tScatteringModel::ParticleScatter : scattering past r < 0, r = "
+	cerr << " should never get this message : \n\tScatteringModel::ParticleScatter : no process selected, r = "
 		 << r << endl;
 
 	exit(EXIT_FAILURE);
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <cmath>
 #include <map>
+#include <vector>
 
 #include "merlin_config.h"
 
@@ -25,6 +26,7 @@
 #include "PhysicalUnits.h"
 #include "PhysicalConstants.h"
 #include "NumericalConstants.h"
+#include "RandomNG.h"
 
 namespace Collimation
 {
@@ -92,6 +94,27 @@ struct ScatterPlotData
 
 };
 
+/**
+ * The cross sections of one material, with the derived quantities used for
+ * every scattering step
+ */
+struct MaterialScattering
+{
+	Material* material;
+	CrossSections* cs;
+
+	/**
+	 * Total mean free path
+	 */
+	double lambda;
+
+	/**
+	 * Cumulative fraction of the total cross section up to and including
+	 * each scattering process
+	 */
+	std::vector<double> cumulative;
+};
+
 enum EnergyLossMode
 {
 	SimpleEnergyLoss,
@@ -122,6 +145,23 @@ public:
 	 */
 	void SetScatterType(int st);
 
+	/**
+	 * Prepare to scatter particles in a material, calculating its cross
+	 * sections on first use and configuring the scattering processes for
+	 * it. Once a material is selected the scattering functions taking its
+	 * index may be called concurrently.
+	 * @return The index of the material in the cross section table
+	 */
+	size_t SelectMaterial(Material* mat, double E0);
+
+	/**
+	 * Calculate the particle path length in the selected material using scattering processes
+	 */
+	double PathLength(size_t material)
+	{
+		return -materials[material].lambda * log(RandomNG::uniform(0, 1));
+	}
+
 	/**
 	 * Calculate the particle path length in given material using scattering processes
 	 */
@@ -138,8 +178,10 @@ public:
 	void Straggle(PSvector& p, double x, Material* mat, double E1, double E2);
 
 	/**
-	 * Function performs scattering and returns true if inelastic scatter
+	 * Function performs scattering in the selected material and returns
+	 * false if the particle is lost
 	 */
+	bool ParticleScatter(PSvector& p, size_t material, double E);
 	bool ParticleScatter(PSvector& p, Material* mat, double E);
 
 // Other Functions
@@ -150,11 +192,12 @@ public:
 	virtual void AddProcess(Collimation::ScatteringProcess* S)
 	{
 		Processes.push_back(S);
-		fraction.push_back(0);
+		ClearMaterials();
 	}
 	void ClearProcesses()
 	{
 		Processes.clear();
+		ClearMaterials();
 	}
 
 	// Scatter plot
@@ -185,18 +228,24 @@ protected:
 	std::vector<Collimation::ScatteringProcess*> Processes;
 
 	/**
-	 * vector with fractions of the total scattering cross section assigned to each ScatteringProcess
+	 * Calculated CrossSections data for each material used, indexed by
+	 * SelectMaterial()
 	 */
-	std::vector<double> fraction;
+	std::vector<MaterialScattering> materials;
+	std::map<std::string, size_t> material_indices;
+	EnergyLossMode energy_loss_mode;
+
+private:
 
 	/**
-	 * Store calculated CrossSections data to save time
+	 * Forget the calculated cross sections
 	 */
-	std::map<std::string, Collimation::CrossSections*> stored_cross_sections;
-	std::map<std::string, Collimation::CrossSections*>::iterator CS_iterator;
-	EnergyLossMode energy_loss_mode;
+	void ClearMaterials();
 
-private:
+	/**
+	 * The material the scattering processes are configured for
+	 */
+	size_t configured_material;
 
 	/**
 	 * Energy loss via ionisation
@@ -78,7 +78,7 @@ bool Rutherford::Scatter(PSvector& p, double E)
 {
 	double TargetMass = AtomicMassUnit * mat->GetAtomicMass();
 
-	t = tmin / (1 - RandomNG::uniform(0, 1));
+	double t = tmin / (1 - RandomNG::uniform(0, 1));
 	ScatterStuff(p, t, TargetMass, E0);
 	p.type() = 6;
 
@@ -105,7 +105,7 @@ void SixTrackRutherford::Configure(Material* matin, CrossSections* CSin)
 bool SixTrackRutherford::Scatter(PSvector& p, double E)
 {
 
-	t = tmin / (1 - RandomNG::uniform(0, 1));
+	double t = tmin / (1 - RandomNG::uniform(0, 1));
 	ScatterStuff(p, t, E0);
 	p.type() = 6;
 
@@ -129,7 +129,7 @@ void Elasticpn::Configure(Material* matin, CrossSections* CSin)
 }
 bool Elasticpn::Scatter(PSvector& p, double E)
 {
-	t = cs->GetElasticScatter()->SelectT();
+	double t = cs->GetElasticScatter()->SelectT();
 
 	ScatterStuff(p, t, AtomicMassUnit, E0);
 	p.type() = 3;
@@ -155,8 +155,8 @@ void SixTrackElasticpn::Configure(Material* matin, CrossSections* CSin)
 bool SixTrackElasticpn::Scatter(PSvector& p, double E)
 {
 	double com_sqd = 2 * ProtonMassMeV * MeV * E;   //ecmsq in SixTrack
-	b_pp = 8.5 + 1.086 * log(sqrt(com_sqd)); // slope given on GeV units
-	t = -log(RandomNG::uniform(0, 1)) / b_pp;
+	double b_pp = 8.5 + 1.086 * log(sqrt(com_sqd)); // slope given on GeV units
+	double t = -log(RandomNG::uniform(0, 1)) / b_pp;
 
 	ScatterStuff(p, t, E0);
 	p.type() = 3;
@@ -185,7 +185,7 @@ bool ElasticpN::Scatter(PSvector& p, double E)
 {
 	double TargetMass = AtomicMassUnit * mat->GetAtomicMass();
 
-	t = -log(RandomNG::uniform(0, 1)) / b_N;
+	double t = -log(RandomNG::uniform(0, 1)) / b_N;
 	ScatterStuff(p, t, TargetMass, E0);
 	p.type() = 2;
 
@@ -212,7 +212,7 @@ void SixTrackElasticpN::Configure(Material* matin, CrossSections* CSin)
 bool SixTrackElasticpN::Scatter(PSvector& p, double E)
 {
 
-	t = -log(RandomNG::uniform(0, 1)) / b_N;
+	double t = -log(RandomNG::uniform(0, 1)) / b_N;
 	ScatterStuff(p, t, E0);
 	p.type() = 2;
 
@@ -237,8 +237,8 @@ void SingleDiffractive::Configure(Material* matin, CrossSections* CSin)
 bool SingleDiffractive::Scatter(PSvector& p, double E)
 {
 	std::pair<double, double> TM = cs->GetDiffractiveScatter()->Select();
-	t = TM.first;
-	m_rec = TM.second;
+	double t = TM.first;
+	double m_rec = TM.second;
 	double com_sqd = (2 * ProtonMassMeV * MeV * E0) + (2 * ProtonMassMeV * MeV * ProtonMassMeV * MeV);
 	double dp = m_rec * m_rec * E / com_sqd;
 
@@ -282,8 +282,8 @@ bool SixTrackSingleDiffractive::Scatter(PSvector& p, double E)
 	{
 		b = 7.0 * b_pp / 12.0;
 	}
-	t = -log(RandomNG::uniform(0, 1)) / b;
-	dp = xm2 * E / com_sqd;
+	double t = -log(RandomNG::uniform(0, 1)) / b;
+	double dp = xm2 * E / com_sqd;
 
 	ScatterStuff(dp, p, t, E0);
 	p.type() = 4;
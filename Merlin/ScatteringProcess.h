@@ -47,13 +47,13 @@ protected:
 	double E0;              /// Reference energy
 	Material* mat;          /// Material of the collimator being hit
 	CrossSections* cs;      /// CrossSections object holding all configured cross sections
-	double t;               /// Momentum transfer
 
 public:
 	virtual ~ScatteringProcess()
 	{
 	}
 	// The first function must be provided for all child classes, and probably the second as well
+	// Scatter may be called for many particles concurrently, so it must not modify the process
 	virtual bool Scatter(PSvector& p, double E) = 0;
 	virtual void Configure(Material* matin, CrossSections* CSin)
 	{
@@ -110,7 +110,6 @@ public:
 
 class SixTrackElasticpn: public ScatteringProcess
 {
-	double b_pp; /// slope
 public:
 	void Configure(Material* matin, CrossSections* CSin);
 	bool Scatter(PSvector& p, double E);
@@ -152,7 +151,6 @@ public:
  */
 class SingleDiffractive: public ScatteringProcess
 {
-	double m_rec; /// recoil mass
 public:
 	void Configure(Material* matin, CrossSections* CSin);
 	bool Scatter(PSvector& p, double E);
@@ -165,8 +163,6 @@ public:
 
 class SixTrackSingleDiffractive: public ScatteringProcess
 {
-	double m_rec; /// recoil mass
-	double dp;
 public:
 	void Configure(Material* matin, CrossSections* CSin);
 	bool Scatter(PSvector& p, double E);
@@ -0,0 +1,327 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include "ParticleBunch.h"
+#include "ParticleTracker.h"
+#include "RingDeltaTProcess.h"
+#include "ClosedOrbit.h"
+#include "CompiledLattice.h"
+#include "TPSA.h"
+#include "ArcGeometry.h"
+#include "MultipoleField.h"
+#include "BzField.h"
+#include "RFAcceleratingField.h"
+#include "SectorBend.h"
+#include "SegmentMapCache.h"
+
+using namespace ParticleTracking;
+
+namespace
+{
+// a change to the orbit smaller than this (m, rad) is rounding, and
+// leaves the maps downstream unchanged
+const double orbitTolerance = 1.0e-15;
+}
+
+SegmentMapCache::SegmentMapCache(AcceleratorModel* aModel, double refMomentum) :
+	theModel(aModel), p0(refMomentum), delta(1.0e-9), transverseOnly(false), bendscale(0), useTPSA(false),
+	nelements(0), leaves(0), generation(0), stale(false)
+{
+}
+
+SegmentMapCache::~SegmentMapCache()
+{
+}
+
+void SegmentMapCache::SetDelta(double new_delta)
+{
+	delta = new_delta;
+}
+
+void SegmentMapCache::TransverseOnly(bool flag)
+{
+	transverseOnly = flag;
+}
+
+void SegmentMapCache::ScaleBendPathLength(double scale)
+{
+	bendscale = scale;
+}
+
+void SegmentMapCache::UseTPSA(bool flag)
+{
+	useTPSA = flag;
+}
+
+void SegmentMapCache::Build()
+{
+	PSvector p(0);
+	ClosedOrbit co(theModel, p0);
+	co.SetDelta(delta);
+	co.TransverseOnly(transverseOnly);
+	if(bendscale != 0)
+	{
+		co.ScaleBendPathLength(bendscale);
+	}
+	co.UseTPSA(useTPSA);
+	co.FindClosedOrbit(p);
+	Build(p);
+}
+
+void SegmentMapCache::Build(const PSvector& start)
+{
+	generation = ModelElement::GetModelGeneration();
+	stale = false;
+	AcceleratorModel::Beamline bline = theModel->GetBeamline();
+	nelements = std::distance(bline.begin(), bline.end());
+	frames.assign(bline.begin(), bline.end());
+	state.resize(nelements);
+	leaves = 1;
+	while(leaves < nelements)
+	{
+		leaves *= 2;
+	}
+
+	if(useTPSA)
+	{
+		lattice.reset(new CompiledLattice(bline));
+	}
+	else
+	{
+		lattice.reset();
+	}
+
+	tree.assign(2 * leaves, RealMatrix(IdentityMatrix(6)));
+	orbit.resize(nelements + 1);
+	orbit[0] = start;
+	for(size_t n = 0; n < nelements; n++)
+	{
+		ElementState(frames[n], state[n]);
+		FindElementMap(n, orbit[n], tree[leaves + n], orbit[n + 1]);
+	}
+	for(size_t k = leaves - 1; k > 0; k--)
+	{
+		tree[k] = tree[2 * k + 1] * tree[2 * k];
+	}
+}
+
+bool SegmentMapCache::Update(int n)
+{
+	assert(n >= 0 && size_t(n) < nelements);
+	if(lattice)
+	{
+		lattice->Invalidate(n);
+	}
+
+	PSvector out;
+	ElementState(frames[n], state[n]);
+	FindElementMap(n, orbit[n], tree[leaves + n], out);
+	for(size_t k = (leaves + n) / 2; k > 0; k /= 2)
+	{
+		tree[k] = tree[2 * k + 1] * tree[2 * k];
+	}
+
+	for(int k = 0; k < 6; k++)
+	{
+		if(fabs(out[k] - orbit[n + 1][k]) > orbitTolerance)
+		{
+			stale = true;
+		}
+	}
+	return !stale;
+}
+
+bool SegmentMapCache::UpdateChanged()
+{
+	if(nelements == 0 || stale || generation != ModelElement::GetModelGeneration())
+	{
+		return false;
+	}
+
+	std::vector<double> current;
+	for(size_t n = 0; n < nelements; n++)
+	{
+		ElementState(frames[n], current);
+		if(current != state[n] && !Update(n))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SegmentMapCache::IsCurrent() const
+{
+	if(nelements == 0 || stale || generation != ModelElement::GetModelGeneration())
+	{
+		return false;
+	}
+
+	std::vector<double> current;
+	for(size_t n = 0; n < nelements; n++)
+	{
+		ElementState(frames[n], current);
+		if(current != state[n])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void SegmentMapCache::ElementState(const ComponentFrame* frame, std::vector<double>& state)
+{
+	state.clear();
+	if(!frame->IsComponent())
+	{
+		return;
+	}
+
+	const AcceleratorComponent& c = frame->GetComponent();
+	state.push_back(c.GetLength());
+	if(const ArcGeometry* arc = dynamic_cast<const ArcGeometry*>(c.GetGeometry()))
+	{
+		state.push_back(arc->GetCurvature());
+		state.push_back(arc->GetTilt());
+	}
+
+	const EMField* field = c.GetEMField();
+	if(const MultipoleField* mp = dynamic_cast<const MultipoleField*>(field))
+	{
+		const int np = mp->HighestMultipole();
+		state.push_back(mp->GetFieldScale());
+		state.push_back(np);
+		for(int k = 0; k <= np; k++)
+		{
+			const Complex b = mp->GetCoefficient(k);
+			state.push_back(b.real());
+			state.push_back(b.imag());
+		}
+	}
+	else if(const BzField* bz = dynamic_cast<const BzField*>(field))
+	{
+		state.push_back(bz->GetStrength());
+	}
+	else if(const RFAcceleratingField* rf = dynamic_cast<const RFAcceleratingField*>(field))
+	{
+		state.push_back(rf->GetFrequency());
+		state.push_back(rf->GetPhase());
+		state.push_back(rf->GetAmplitude());
+	}
+
+	if(const SectorBend* bend = dynamic_cast<const SectorBend*>(&c))
+	{
+		const SectorBend::PoleFace* faces[] = {bend->GetPoleFaceInfo().entrance, bend->GetPoleFaceInfo().exit};
+		for(const SectorBend::PoleFace* pf : faces)
+		{
+			state.push_back(pf != nullptr);
+			if(pf)
+			{
+				state.push_back(pf->rot);
+				state.push_back(pf->fint);
+				state.push_back(pf->hgap);
+				state.push_back(pf->type);
+			}
+		}
+	}
+}
+
+RealMatrix SegmentMapCache::Product(size_t first, size_t last) const
+{
+	// the maps to the left of the range are applied first
+	RealMatrix left(IdentityMatrix(6));
+	RealMatrix right(IdentityMatrix(6));
+	for(size_t l = first + leaves, r = last + leaves; l < r; l /= 2, r /= 2)
+	{
+		if(l & 1)
+		{
+			left = tree[l++] * left;
+		}
+		if(r & 1)
+		{
+			right = right * tree[--r];
+		}
+	}
+	return right * left;
+}
+
+RealMatrix SegmentMapCache::MapBetween(int n1, int n2) const
+{
+	assert(n1 >= 0 && n2 >= 0 && size_t(n1) < nelements && size_t(n2) < nelements);
+	if(n1 <= n2)
+	{
+		return Product(n1, n2 + 1);
+	}
+	return Product(0, n2 + 1) * Product(n1, nelements);
+}
+
+RealMatrix SegmentMapCache::OneTurnMap(int n) const
+{
+	return n == 0 ? Product(0, nelements) : MapBetween(n, n - 1);
+}
+
+const PSvector& SegmentMapCache::GetOrbit(int n) const
+{
+	assert(n >= 0 && size_t(n) <= nelements);
+	return orbit[n];
+}
+
+void SegmentMapCache::FindElementMap(size_t n, const PSvector& in, RealMatrix& M, PSvector& out)
+{
+	if(lattice)
+	{
+		TPSA<1> x[6];
+		for(int k = 0; k < 6; k++)
+		{
+			x[k] = TPSA<1>::Variable(k, in[k]);
+		}
+		if(lattice->TrackMapBetween(x, n, n + 1, p0, 1.0, bendscale))
+		{
+			for(int k = 0; k < 6; k++)
+			{
+				out[k] = x[k].Value();
+				for(int m = 0; m < 6; m++)
+				{
+					M(m, k) = x[m].Derivative(k);
+				}
+			}
+			return;
+		}
+	}
+
+	ParticleBunch bunch(p0, 1.0);
+	for(int k = 0; k < 7; k++)
+	{
+		Particle p = in;
+		if(k > 0)
+		{
+			p[k - 1] += delta;
+		}
+		bunch.push_back(p);
+	}
+
+	ParticleTracker tracker(theModel->GetBeamline(n, n), &bunch, false);
+	if(bendscale != 0)
+	{
+		RingDeltaTProcess* ringdt = new RingDeltaTProcess(2);
+		ringdt->SetBendScale(bendscale);
+		tracker.AddProcess(ringdt);
+	}
+	tracker.Run();
+
+	ParticleBunch::const_iterator ip = tracker.GetTrackedBunch().begin();
+	const Particle& pref = *ip++;
+	out = pref;
+	for(int k = 0; k < 6; k++, ip++)
+		for(int m = 0; m < 6; m++)
+		{
+			M(m, k) = ((*ip)[m] - pref[m]) / delta;
+		}
+}
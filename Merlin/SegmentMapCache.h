@@ -0,0 +1,177 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef SegmentMapCache_h
+#define SegmentMapCache_h 1
+
+#include <memory>
+#include <vector>
+#include "AcceleratorModel.h"
+#include "PSTypes.h"
+#include "TLAS.h"
+
+namespace ParticleTracking
+{
+class CompiledLattice;
+}
+
+using namespace TLAS;
+
+/**
+ *	Holds the linear map of every element of an AcceleratorModel about
+ *	the closed orbit (or a given orbit), so that the transfer matrix
+ *	between any two elements can be found without tracking.
+ *
+ *	The element maps are the leaves of a segment tree, each node of
+ *	which holds the product of the maps below it. The map between
+ *	elements n1 and n2 is then the product of O(log N) nodes, and when
+ *	an element changes only the nodes on its path to the root are
+ *	recomputed (see Update()).
+ *
+ *	Each element map is found as by TransferMatrix, either by tracking
+ *	particles displaced by delta through the element, or with a TPSA
+ *	(see UseTPSA()).
+ */
+class SegmentMapCache
+{
+public:
+	SegmentMapCache(AcceleratorModel* aModel, double refMomentum);
+	~SegmentMapCache();
+
+	void SetDelta(double new_delta);            // default: 1.0e-9
+	void TransverseOnly(bool flag);             // default: false
+	void ScaleBendPathLength(double scale);
+	void UseTPSA(bool flag);                    // default: false
+
+	/**
+	 *	Find the closed orbit at the start of the lattice, and the map
+	 *	of every element about it.
+	 */
+	void Build();
+
+	/**
+	 *	Find the map of every element about the trajectory which starts
+	 *	from orbit at the start of the lattice.
+	 */
+	void Build(const PSvector& orbit);
+
+	/**
+	 *	Recompute the map of element n, about the orbit stored at its
+	 *	entrance, and the products which contain it. The orbit itself is
+	 *	not found again: if the orbit at the exit of the element moves by
+	 *	more than rounding (after a change to a corrector, say) the maps
+	 *	downstream are stale, and IsCurrent() is false until Build().
+	 *
+	 *	@retval true if the orbit at the exit of element n is unchanged
+	 */
+	bool Update(int n);
+
+	/**
+	 *	Update() every element whose parameters (length, geometry, field,
+	 *	pole faces) have changed since its map was found, as after a
+	 *	direct call to SetFieldStrength().
+	 *
+	 *	@retval true if the maps are now current. If false, the model
+	 *	generation has changed or an update moved the orbit, and Build()
+	 *	is needed.
+	 */
+	bool UpdateChanged();
+
+	/**
+	 *	@return true if no element has been changed through a channel or
+	 *	moved (see ModelElement::GetModelGeneration()), and no element's
+	 *	parameters have been changed directly, since the maps were found.
+	 */
+	bool IsCurrent() const;
+
+	/**
+	 *	@return The transfer matrix from the entrance of element n1 to
+	 *	the exit of element n2, as TransferMatrix::FindTM(M, orbit, n1,
+	 *	n2). If n1 > n2 the map wraps around the end of the ring.
+	 */
+	RealMatrix MapBetween(int n1, int n2) const;
+
+	/**
+	 *	@return The one-turn map at the entrance of element n.
+	 */
+	RealMatrix OneTurnMap(int n = 0) const;
+
+	/**
+	 *	@return The orbit at the entrance of element n. n may be the
+	 *	number of elements, for the orbit at the end of the lattice.
+	 */
+	const PSvector& GetOrbit(int n) const;
+
+	/**
+	 *	@return The number of elements.
+	 */
+	size_t size() const
+	{
+		return nelements;
+	}
+
+private:
+	AcceleratorModel* theModel;
+	double p0;
+	double delta;
+	bool transverseOnly;
+	double bendscale;
+	bool useTPSA;
+
+	size_t nelements;
+	size_t leaves;
+	unsigned long generation;
+
+	/**
+	 *	Set when an Update() moved the orbit downstream of an element.
+	 */
+	bool stale;
+
+	/**
+	 *	tree[leaves + n] is the map of element n, and tree[k] the product
+	 *	tree[2k + 1] * tree[2k].
+	 */
+	std::vector<RealMatrix> tree;
+
+	/**
+	 *	The orbit at the entrance of each element, and at the end.
+	 */
+	std::vector<PSvector> orbit;
+
+	/**
+	 *	Each lattice frame, and the parameters of its component when its
+	 *	map was found (see ElementState()).
+	 */
+	std::vector<const ComponentFrame*> frames;
+	std::vector<std::vector<double> > state;
+
+	std::unique_ptr<ParticleTracking::CompiledLattice> lattice;
+
+	/**
+	 *	Find the map M of element n about orbit in, and the orbit out at
+	 *	its exit.
+	 */
+	void FindElementMap(size_t n, const PSvector& in, RealMatrix& M, PSvector& out);
+
+	/**
+	 *	Fill state with the parameters which determine the map of the
+	 *	component in frame, as SequenceIntegrator::GetMapState() does for
+	 *	the integrators.
+	 */
+	static void ElementState(const ComponentFrame* frame, std::vector<double>& state);
+
+	/**
+	 *	@return The product of the maps of elements first to last - 1.
+	 */
+	RealMatrix Product(size_t first, size_t last) const;
+
+	//Copy protection
+	SegmentMapCache(const SegmentMapCache& rhs);
+	SegmentMapCache& operator=(const SegmentMapCache& rhs);
+};
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef SimdDouble_h
+#define SimdDouble_h 1
+
+#include "merlin_config.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ *	Number of doubles processed per instruction by SimdDouble. This is
+ *	selected at compile time from the instruction set the library is
+ *	built for (see the ENABLE_NATIVE_ARCH cmake option).
+ */
+#if defined(__AVX512F__)
+#define MERLIN_SIMD_WIDTH 8
+#elif defined(__AVX__)
+#define MERLIN_SIMD_WIDTH 4
+#elif defined(__SSE2__)
+#define MERLIN_SIMD_WIDTH 2
+#else
+#define MERLIN_SIMD_WIDTH 1
+#endif
+
+/**
+ *	A pack of MERLIN_SIMD_WIDTH doubles.
+ *
+ *	Only the correctly rounded IEEE operations (+, -, *, /, sqrt and
+ *	sign manipulation) are done in vector registers. Transcendental
+ *	functions are evaluated lane by lane with the scalar libm
+ *	functions. A kernel written as a template over the value type
+ *	therefore gives bit-identical results when instantiated with
+ *	double or SimdDouble.
+ */
+class SimdDouble
+{
+public:
+
+	static const size_t width = MERLIN_SIMD_WIDTH;
+
+#if MERLIN_SIMD_WIDTH > 1
+	typedef double value_type __attribute__((vector_size(MERLIN_SIMD_WIDTH * sizeof(double))));
+#else
+	typedef double value_type;
+#endif
+
+	SimdDouble()
+	{
+	}
+
+	SimdDouble(double a)
+	{
+		double b[width];
+		for(size_t i = 0; i < width; i++)
+		{
+			b[i] = a;
+		}
+		std::memcpy(&v, b, sizeof(value_type));
+	}
+
+	static SimdDouble Load(const double* p)
+	{
+		SimdDouble r;
+		std::memcpy(&r.v, p, sizeof(value_type));
+		return r;
+	}
+
+	void Store(double* p) const
+	{
+		std::memcpy(p, &v, sizeof(value_type));
+	}
+
+	double operator[](size_t i) const
+	{
+		double a[width];
+		Store(a);
+		return a[i];
+	}
+
+	SimdDouble operator-() const
+	{
+		SimdDouble r;
+		r.v = -v;
+		return r;
+	}
+
+	SimdDouble& operator+=(const SimdDouble& b)
+	{
+		v += b.v;
+		return *this;
+	}
+	SimdDouble& operator-=(const SimdDouble& b)
+	{
+		v -= b.v;
+		return *this;
+	}
+	SimdDouble& operator*=(const SimdDouble& b)
+	{
+		v *= b.v;
+		return *this;
+	}
+	SimdDouble& operator/=(const SimdDouble& b)
+	{
+		v /= b.v;
+		return *this;
+	}
+
+	friend SimdDouble operator+(SimdDouble a, const SimdDouble& b)
+	{
+		return a += b;
+	}
+	friend SimdDouble operator-(SimdDouble a, const SimdDouble& b)
+	{
+		return a -= b;
+	}
+	friend SimdDouble operator*(SimdDouble a, const SimdDouble& b)
+	{
+		return a *= b;
+	}
+	friend SimdDouble operator/(SimdDouble a, const SimdDouble& b)
+	{
+		return a /= b;
+	}
+
+	friend SimdDouble sqrt(const SimdDouble& a)
+	{
+		SimdDouble r;
+#if defined(__AVX512F__)
+		r.v = (value_type) _mm512_sqrt_pd((__m512d) a.v);
+#elif defined(__AVX__)
+		r.v = (value_type) _mm256_sqrt_pd((__m256d) a.v);
+#elif defined(__SSE2__)
+		r.v = (value_type) _mm_sqrt_pd((__m128d) a.v);
+#else
+		r.v = std::sqrt(a.v);
+#endif
+		return r;
+	}
+
+	friend SimdDouble fabs(const SimdDouble& a)
+	{
+		return a.Map(std::fabs);
+	}
+	friend SimdDouble sin(const SimdDouble& a)
+	{
+		return a.Map(std::sin);
+	}
+	friend SimdDouble cos(const SimdDouble& a)
+	{
+		return a.Map(std::cos);
+	}
+	friend SimdDouble sinh(const SimdDouble& a)
+	{
+		return a.Map(std::sinh);
+	}
+	friend SimdDouble cosh(const SimdDouble& a)
+	{
+		return a.Map(std::cosh);
+	}
+
+private:
+
+	/**
+	 *	Apply a scalar function to each lane.
+	 */
+	SimdDouble Map(double (*f)(double)) const
+	{
+		double a[width];
+		Store(a);
+		for(size_t i = 0; i < width; i++)
+		{
+			a[i] = f(a[i]);
+		}
+		return Load(a);
+	}
+
+	value_type v;
+};
+
+#endif
@@ -31,7 +31,7 @@ inline bool AsZ(const AcceleratorSupport* s1, const AcceleratorSupport* s2)
 struct ApplyATL
 {
 
-	ApplyATL(double A, double dt, vector<double>& gmy, double vibv, std::mt19937_64* rg) :
+	ApplyATL(double A, double dt, vector<double>& gmy, double vibv, PhiloxEngine* rg) :
 		AT(A * dt), y(0), z(0), yy(gmy.begin()), vv(vibv), rng(rg)
 	{
 	}
@@ -57,7 +57,7 @@ struct ApplyATL
 	double z;
 	vector<double>::iterator yy;
 	double vv;
-	std::mt19937_64* rng;
+	PhiloxEngine* rng;
 
 };
 
@@ -11,6 +11,7 @@
 #include "merlin_config.h"
 #include <iostream>
 #include "AcceleratorSupport.h"
+#include "PhiloxEngine.h"
 
 /**
  *	Represents a simple ATL model of ground motion. On each
@@ -101,7 +102,7 @@ private:
 
 	AcceleratorSupportList theSupports;
 
-	std::mt19937_64* rg;
+	PhiloxEngine* rg;
 
 	//Copy protection
 	SimpleATL(const SimpleATL& rhs);
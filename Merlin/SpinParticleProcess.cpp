@@ -5,12 +5,14 @@
  * This file is derived from software bearing the copyright notice: (c) 2004 Daniel A. Bates (LBNL) -- All Rights Reserved --
  */
 
+#include <algorithm>
 #include "SpinParticleProcess.h"
 #include "SectorBend.h"
 #include "Solenoid.h"
 #include "Space3D.h"
 #include "PhysicalConstants.h"
 #include "utils.h"
+#include "ParallelFor.h"
 
 using namespace PhysicalConstants;
 using namespace PhysicalUnits;
@@ -84,11 +86,37 @@ void SpinParticleBunch::push_back(const Particle& p)
 
 void SpinParticleBunch::SortByCT()
 {
-	// Not yet fully implemented!
-	// At present, only the list of phase space vectors is sorted;
-	// the correlation with the list of spin vectors is lost.
+	// sort an index, so that the spin vectors can be moved with
+	// their phase space vectors
+	const PSvectorArray& particles = GetParticles();
+	vector<size_t> order(particles.size());
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), [&particles](size_t i, size_t j)
+	{
+		return particles[i].ct() < particles[j].ct();
+	});
 
-	ParticleBunch::SortByCT();
+	vector<size_t> dest(order.size());
+	for(size_t k = 0; k < order.size(); k++)
+	{
+		dest[order[k]] = k;
+	}
+	Reorder(dest, dest.size());
+}
+
+void SpinParticleBunch::Reorder(std::vector<size_t>& dest, size_t n)
+{
+	SpinVectorArray reordered(spinArray.size());
+	for(size_t i = 0; i < spinArray.size(); i++)
+	{
+		reordered[dest[i]] = spinArray[i];
+	}
+	reordered.resize(n);
+	spinArray.swap(reordered);
+	ParticleBunch::Reorder(dest, n);
 }
 
 void SpinParticleBunch::Output(std::ostream& os) const
@@ -133,7 +161,7 @@ SpinVector SpinParticleBunch::GetAverageSpin() const
 ParticleBunch::iterator SpinParticleBunch::erase(ParticleBunch::iterator p)
 {
 	// find the 'offset' of p from the start of the particle bunch
-	size_t n = distance(pArray.begin(), p);
+	size_t n = distance(begin(), p);
 
 	// remove the n-th spin vector
 	SpinVectorArray::iterator it = spinArray.begin();
@@ -144,6 +172,20 @@ ParticleBunch::iterator SpinParticleBunch::erase(ParticleBunch::iterator p)
 	return ParticleBunch::erase(p);
 }
 
+size_t SpinParticleBunch::RemoveParticles(const std::vector<char>& removed, PSvectorArray* lost)
+{
+	size_t k = 0;
+	for(size_t i = 0; i < spinArray.size(); i++)
+	{
+		if(!removed[i])
+		{
+			spinArray[k++] = spinArray[i];
+		}
+	}
+	spinArray.resize(k);
+	return ParticleBunch::RemoveParticles(removed, lost);
+}
+
 /**
  * Apply transformation to the particle coordinates and apply
  * the required spin vector rotations
@@ -228,7 +270,7 @@ public:
 	{
 	}
 
-	void RotateSpin(const Vector3D& bnorm, double ds, SpinVector& spin, double gamma)
+	void RotateSpin(const Vector3D& bnorm, double ds, SpinVector& spin, double gamma) const
 	{
 		double& spinx = spin.x();
 		double& spiny = spin.y();
@@ -295,14 +337,20 @@ void SpinParticleProcess::DoProcess(double ds)
 		P0 = pspin;
 	}
 
-	RotateSpinVector rot(isBend);
-
-	Vector3D b;
+	const RotateSpinVector rot(isBend);
 
 	SpinParticleBunch* spinbunch = dynamic_cast<SpinParticleBunch*>(currentBunch);
-	SpinVectorArray::iterator spin = spinbunch->beginSpinArray();
-	for(PSvectorArray::iterator p = spinbunch->begin(); p != spinbunch->end(); p++, spin++)
+	const PSvectorArray::iterator p0 = spinbunch->begin();
+	const SpinVectorArray::iterator spin0 = spinbunch->beginSpinArray();
+
+	// Each particle only rotates its own spin, so the particles can be
+	// shared between threads.
+	Parallel::For(spinbunch->size(), [&](size_t i)
 	{
+		PSvectorArray::iterator p = p0 + i;
+		SpinVectorArray::iterator spin = spin0 + i;
+		Vector3D b;
+
 		double norm = SpeedOfLight / brho / (1.0 + p->dp());
 		double gamma = P0 * (1.0 + p->dp()) / (ElectronMassMeV * MeV);
 
@@ -384,8 +432,7 @@ void SpinParticleProcess::DoProcess(double ds)
 				}
 			}
 		}
-
-	}
+	});
 
 	intS += ds;
 
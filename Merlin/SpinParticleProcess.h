@@ -37,6 +37,7 @@ class SpinParticleBunch: public ParticleBunch
 public:
 	SpinParticleBunch(double P0, double Qm = 1);
 	virtual ParticleBunch::iterator erase(ParticleBunch::iterator p);
+	virtual size_t RemoveParticles(const std::vector<char>& removed, PSvectorArray* lost = nullptr);
 	virtual size_t AddParticle(const Particle& p);
 	size_t AddParticle(const Particle& p, const SpinVector& spin);
 	virtual void push_back(const Particle& p);
@@ -47,6 +48,9 @@ public:
 	SpinVector GetAverageSpin() const;
 	virtual bool ApplyTransformation(const Transform3D& t);
 
+protected:
+	virtual void Reorder(std::vector<size_t>& dest, size_t n);
+
 private:
 	SpinVectorArray spinArray;
 };
@@ -6,6 +6,7 @@
  */
 
 #include <limits>
+#include <typeinfo>
 #include "PhysicalConstants.h"
 #include "MatrixPrinter.h"
 #include "utils.h"
@@ -14,6 +15,8 @@
 #include "StdIntegrators.h"
 #include "LCAVintegrator.h"
 #include "TransRFIntegrator.h"
+#include "TrackingKernels.h"
+#include "ParallelFor.h"
 
 using namespace std;
 using namespace PhysicalConstants;
@@ -24,52 +27,16 @@ using namespace PhysicalUnits;
 namespace
 {
 
-// Functor which applies a drift
-struct psdrift
-{
-	double z;
-	psdrift(double len) :
-		z(len)
-	{
-	}
-	void operator()(PSvector& p)
-	{
-		p.x() += p.xp() * z;
-		p.y() += p.yp() * z;
-	}
+using namespace ParticleTracking;
 
-};
-
-inline void ApplyDrift(PSvectorArray& psv, double z)
+inline void ApplyDrift(ParticleBunch* bunch, double z)
 {
 	if(z != 0)
 	{
-		for_each(psv.begin(), psv.end(), psdrift(z));
+		Kernels::Apply(bunch, Kernels::LinearDrift(z));
 	}
 }
 
-struct MultipoleKick
-{
-	const MultipoleField& field;
-	double scale;
-
-	MultipoleKick(const MultipoleField& f, double len, double P0, double q) :
-		field(f), scale(q * len * eV * SpeedOfLight / P0)
-	{
-	}
-
-	void operator()(PSvector& v)
-	{
-		double x = v.x();
-		double y = v.y();
-		double dp = v.dp();
-		Complex F = scale * field.GetField2D(x, y) / (1 + dp);
-		v.xp() += -F.real();
-		v.yp() += F.imag();
-	}
-
-};
-
 // Functor ApplyRFdp (used for full acceleration)
 struct ApplyRFdp
 {
@@ -127,7 +94,7 @@ END_INTG_SET
 void DriftCI::TrackStep(double ds)
 {
 	CHK_ZERO(ds);
-	ApplyDrift(currentBunch->GetParticles(), ds);
+	ApplyDrift(currentBunch, ds);
 	return;
 }
 
@@ -150,7 +117,7 @@ void TWRFStructureCI::TrackStep(double ds)
 	if(g == 0)
 	{
 		// cavity is off!
-		ApplyDrift(currentBunch->GetParticles(), ds);
+		ApplyDrift(currentBunch, ds);
 		return;
 	}
 
@@ -161,7 +128,7 @@ void TWRFStructureCI::TrackStep(double ds)
 
 	TransportMatrix::TWRFCavity(ds, g, f, phi, E0, true, Rm.R);
 
-	for_each(currentBunch->begin(), currentBunch->end(), ApplyRFdp(g * ds / E0, f, phi, Rm, true));
+	Parallel::ForEach(currentBunch->begin(), currentBunch->end(), ApplyRFdp(g * ds / E0, f, phi, Rm, true));
 
 	if(true)
 	{
@@ -225,7 +192,7 @@ void SectorBendCI::TrackStep(double ds)
 
 		// Apply the integrated kick, and then track
 		// through the linear second half
-		for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, ds, P0, q));
+		Kernels::Apply(currentBunch, Kernels::ThinMultipoleKick(field, ds, P0, q));
 		M.Apply(currentBunch->GetParticles(), P0);
 
 		// Remember to set the components back
@@ -314,21 +281,21 @@ void RectMultipoleCI::TrackStep(double ds)
 	}
 	else
 	{
-		ApplyDrift(currentBunch->GetParticles(), len);
+		ApplyDrift(currentBunch, len);
 	}
 
 	if(splitMagnet)
 	{
 		Complex b1 = field.GetCoefficient(1);
 		field.SetCoefficient(1, Complex(0));
-		for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, ds, P0, q));
+		Kernels::Apply(currentBunch, Kernels::ThinMultipoleKick(field, ds, P0, q));
 		if(b1 != 0.0)
 		{
 			M.Apply(currentBunch->GetParticles());
 		}
 		else
 		{
-			ApplyDrift(currentBunch->GetParticles(), len);
+			ApplyDrift(currentBunch, len);
 		}
 		field.SetCoefficient(1, b1);
 	}
@@ -360,11 +327,11 @@ void SWRFStructureCI::TrackStep(double ds)
 
 	if(g == 0)  //no RF voltage, apply a drift instead
 	{
-		ApplyDrift(currentBunch->GetParticles(), ds);
+		ApplyDrift(currentBunch, ds);
 	}
 	else
 	{
-		for_each(currentBunch->begin(), currentBunch->end(), ApplyRFdp(g * ds / E0, f, phi, Rm, true));
+		Parallel::ForEach(currentBunch->begin(), currentBunch->end(), ApplyRFdp(g * ds / E0, f, phi, Rm, true));
 	}
 	if(true)
 	{
@@ -392,16 +359,44 @@ void MonitorCI::TrackStep(double ds)
 		if(GetIntegratedLength() + ds > mpt)
 		{
 			double s1 = mpt - GetIntegratedLength();
-			ApplyDrift(currentBunch->GetParticles(), s1);
+			ApplyDrift(currentBunch, s1);
 			//				IncrStep(s1); // need to increment bunch timing
 			currentComponent->MakeMeasurement(*currentBunch);
 			ds -= s1;
 		}
-		ApplyDrift(currentBunch->GetParticles(), ds);
+		ApplyDrift(currentBunch, ds);
 	}
 	return;
 }
 
+bool MonitorCI::Compile(KernelSequence& seq)
+{
+	if(currentComponent->IsActive() && typeid(*currentComponent) != typeid(Monitor))
+	{
+		return false;
+	}
+
+	// the drifts of TrackStep() for the whole monitor, without the measurement
+	double len = currentComponent->GetLength();
+	if(len != 0)
+	{
+		double mpt = currentComponent->GetMeasurementPt() + len / 2;
+		if(len > mpt)
+		{
+			if(mpt != 0)
+			{
+				seq.AddLinearDrift(mpt);
+			}
+			len -= mpt;
+		}
+		if(len != 0)
+		{
+			seq.AddLinearDrift(len);
+		}
+	}
+	return true;
+}
+
 // Class SolenoidCI
 void SolenoidCI::TrackStep(double ds)
 {
@@ -416,7 +411,7 @@ void SolenoidCI::TrackStep(double ds)
 
 	if(fequal(Bz, 0))
 	{
-		ApplyDrift(currentBunch->GetParticles(), ds);
+		ApplyDrift(currentBunch, ds);
 	}
 	else
 	{
@@ -429,12 +424,12 @@ void SolenoidCI::TrackStep(double ds)
 		else
 		{
 			// We use the exact momentum map for each particle energy.
-			for(ParticleBunch::iterator p = currentBunch->begin(); p != currentBunch->end(); p++)
+			Parallel::ForEach(currentBunch->begin(), currentBunch->end(), [&](PSvector& p)
 			{
 				RMtrx M(2);
-				TransportMatrix::Solenoid(ds, q * Bz / brho / (1 + p->dp()), 0, true, true, M.R);
-				M.Apply(*p);
-			}
+				TransportMatrix::Solenoid(ds, q * Bz / brho / (1 + p.dp()), 0, true, true, M.R);
+				M.Apply(p);
+			});
 		}
 	}
 	return;
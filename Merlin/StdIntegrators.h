@@ -9,6 +9,9 @@
 #define ParticleTracking_StdIntegrators_h 1
 
 #include "merlin_config.h"
+#include <map>
+#include <utility>
+#include <vector>
 #include "SectorBend.h"
 #include "RectMultipole.h"
 #include "SWRFStructure.h"
@@ -20,6 +23,7 @@
 
 #include "ParticleComponentTracker.h"
 #include "ParticleMapPI.h"
+#include "KernelSequence.h"
 
 #define DECL_SIMPLE_INTG(I, C) class I: \
 	public ParticleComponentTracker::Integrator<C> { \
@@ -28,10 +32,224 @@
 namespace ParticleTracking
 {
 
+/**
+ *	Interface for integrators which can express the tracking of an
+ *	entire component as a KernelSequence (see CompiledLattice).
+ */
+class CompilableIntegrator
+{
+public:
+	virtual ~CompilableIntegrator()
+	{
+	}
+
+	/**
+	 *	Append the maps which track the current bunch through the whole
+	 *	of the current component to seq.
+	 *	@return false if the component must be tracked by the integrator
+	 *	itself, in which case seq is unchanged.
+	 */
+	virtual bool Compile(KernelSequence& seq) = 0;
+};
+
+/**
+ *	Base for integrators which build the maps for each step as a
+ *	KernelSequence. The sequence is applied to the whole bunch by
+ *	TrackStep(), to one tile at a time in fused tracking, and is compiled
+ *	into a CompiledLattice. Derived classes supply CompileStep(), and
+ *	CompileEntrance() and CompileExit() if they have boundary maps.
+ *
+ *	The sequences are cached for each component and step length, and are
+ *	only rebuilt when the reference momentum, the charge, the model
+ *	generation (see ModelElement::GetModelGeneration()) or the component
+ *	parameters returned by GetMapState() change. Repeated turns through a
+ *	lattice then need no map construction and no allocation.
+ */
+template<class C>
+class SequenceIntegrator: public ParticleComponentTracker::Integrator<C>, public CompilableIntegrator
+{
+public:
+
+	bool IsParticleLocal() const
+	{
+		return true;
+	}
+
+	void BeginTiles(double ds)
+	{
+		PruneCache();
+		tileEntrance = this->AtEntrance() ? &GetSequence(entranceStep) : nullptr;
+		tileStep = &GetSequence(ds);
+		tileExit = this->AtExit(ds) ? &GetSequence(exitStep) : nullptr;
+	}
+
+	void TrackTile(double ds, size_t first, size_t last) const
+	{
+		PSvectorArray::iterator p0 = this->currentBunch->begin() + first;
+		PSvectorArray::iterator p1 = this->currentBunch->begin() + last;
+		if(tileEntrance)
+		{
+			tileEntrance->Apply(p0, p1);
+		}
+		tileStep->Apply(p0, p1);
+		if(tileExit)
+		{
+			tileExit->Apply(p0, p1);
+		}
+	}
+
+	bool Compile(KernelSequence& seq)
+	{
+		CompileEntrance(seq);
+		CompileStep(this->currentComponent->GetLength(), seq);
+		CompileExit(seq);
+		return true;
+	}
+
+	void TrackStep(double ds)
+	{
+		PruneCache();
+		GetSequence(ds).Apply(*this->currentBunch);
+	}
+
+	void TrackEntrance()
+	{
+		PruneCache();
+		GetSequence(entranceStep).Apply(*this->currentBunch);
+	}
+
+	void TrackExit()
+	{
+		PruneCache();
+		GetSequence(exitStep).Apply(*this->currentBunch);
+	}
+
+protected:
+
+	/**
+	 *	Append the maps for a step ds through the body of the component.
+	 */
+	virtual void CompileStep(double ds, KernelSequence& seq) = 0;
+
+	virtual void CompileEntrance(KernelSequence& seq)
+	{
+	}
+
+	virtual void CompileExit(KernelSequence& seq)
+	{
+	}
+
+	/**
+	 *	Append to state the parameters of the current component (other
+	 *	than the step length) on which the compiled maps depend.
+	 */
+	virtual void GetMapState(std::vector<double>& state) const
+	{
+	}
+
+private:
+
+	// keys for the boundary maps, which do not depend on the step
+	static constexpr double entranceStep = -1;
+	static constexpr double exitStep = -2;
+
+	// the cache is emptied when it grows beyond this
+	static const size_t maxCachedSequences = 1 << 16;
+
+	struct CachedSequence
+	{
+		double P0;
+		double q;
+		unsigned long generation;
+		std::vector<double> state;
+		KernelSequence seq;
+		bool valid;
+
+		CachedSequence() :
+			P0(0), q(0), generation(0), valid(false)
+		{
+		}
+	};
+
+	typedef std::map<std::pair<const AcceleratorComponent*, double>, CachedSequence> SequenceCache;
+
+	const KernelSequence& GetSequence(double ds)
+	{
+		const double P0 = this->currentBunch->GetReferenceMomentum();
+		const double q = this->currentBunch->GetChargeSign();
+		const unsigned long generation = ModelElement::GetModelGeneration();
+		state.clear();
+		GetMapState(state);
+
+		CachedSequence& c = cache[std::make_pair(this->currentComponent, ds)];
+		if(c.valid && c.P0 == P0 && c.q == q && c.generation == generation && c.state == state)
+		{
+			return c.seq;
+		}
+
+		c.seq.clear();
+		if(ds == entranceStep)
+		{
+			CompileEntrance(c.seq);
+		}
+		else if(ds == exitStep)
+		{
+			CompileExit(c.seq);
+		}
+		else
+		{
+			CompileStep(ds, c.seq);
+		}
+		c.P0 = P0;
+		c.q = q;
+		c.generation = generation;
+		c.state = state;
+		c.valid = true;
+		return c.seq;
+	}
+
+	void PruneCache()
+	{
+		if(cache.size() > maxCachedSequences)
+		{
+			cache.clear();
+		}
+	}
+
+	SequenceCache cache;
+	std::vector<double> state;
+	const KernelSequence* tileEntrance = nullptr;
+	const KernelSequence* tileStep = nullptr;
+	const KernelSequence* tileExit = nullptr;
+};
+
 // common integrators
-DECL_SIMPLE_INTG(MonitorCI, Monitor)
-DECL_SIMPLE_INTG(MarkerCI, Marker)
 DECL_SIMPLE_INTG(SolenoidCI, Solenoid)
+
+/**
+ *	Monitors are compiled as drifts when they are inactive or do not
+ *	record data (class Monitor itself).
+ */
+class MonitorCI: public ParticleComponentTracker::Integrator<Monitor>, public CompilableIntegrator
+{
+public:
+	void TrackStep(double);
+	bool Compile(KernelSequence& seq);
+};
+
+class MarkerCI: public ParticleComponentTracker::Integrator<Marker>, public CompilableIntegrator
+{
+public:
+	void TrackStep(double);
+	bool IsParticleLocal() const
+	{
+		return true;
+	}
+	bool Compile(KernelSequence& seq)
+	{
+		return true;
+	}
+};
 //DECL_SIMPLE_INTG(ParticleMapCI,ParticleMapComponent)
 
 namespace THIN_LENS
@@ -58,17 +276,27 @@ DECL_INTG_SET(ParticleComponentTracker, StdISet)
 namespace TRANSPORT
 {
 
-DECL_SIMPLE_INTG(DriftCI, Drift)
-DECL_SIMPLE_INTG(RectMultipoleCI, RectMultipole)
+class DriftCI: public SequenceIntegrator<Drift>
+{
+protected:
+	void CompileStep(double ds, KernelSequence& seq);
+};
 
-class SectorBendCI: public ParticleComponentTracker::Integrator<SectorBend>
+class RectMultipoleCI: public SequenceIntegrator<RectMultipole>
+{
+protected:
+	void CompileStep(double ds, KernelSequence& seq);
+	void GetMapState(std::vector<double>& state) const;
+};
+
+class SectorBendCI: public SequenceIntegrator<SectorBend>
 {
-public:
-	void TrackStep(double);
-	void TrackEntrance();
-	void TrackExit();
 protected:
-	void ApplyPoleFaceRotation(const SectorBend::PoleFace* pf);
+	void CompileStep(double ds, KernelSequence& seq);
+	void CompileEntrance(KernelSequence& seq);
+	void CompileExit(KernelSequence& seq);
+	void CompilePoleFaceRotation(const SectorBend::PoleFace* pf, KernelSequence& seq);
+	void GetMapState(std::vector<double>& state) const;
 };
 
 DECL_INTG_SET(ParticleComponentTracker, StdISet)
@@ -22,6 +22,7 @@
 #include "PhysicalConstants.h"
 
 #include "SymplecticIntegrators.h"
+#include "TrackingKernels.h"
 
 namespace ParticleTracking
 {
@@ -49,122 +50,6 @@ using namespace ParticleTracking;
 using namespace PhysicalUnits;
 using namespace PhysicalConstants;
 
-// Drift Map
-struct DriftMap
-{
-private:
-	double ds;
-public:
-	DriftMap(double _ds) :
-		ds(_ds)
-	{
-	}
-	void operator()(PSvector& v) const
-	{
-		double x0 = v.x();
-		double y0 = v.y();
-		double ct0 = v.ct();
-
-		double d1 = 1.0 + v.dp();
-		double k = sqrt(d1 * d1 - v.xp() * v.xp() - v.yp() * v.yp());
-
-		v.x() += v.xp() * ds / k;
-		v.y() += v.yp() * ds / k;
-		v.ct() += ds - d1 * ds / k;
-	}
-
-};
-
-//Pole Face Rotation Map
-struct PoleFaceRotation
-{
-
-private:
-	double R10;
-	double R32;
-
-public:
-	PoleFaceRotation(double h, SectorBend::PoleFace pf)
-	{
-		const double theta = pf.rot;
-		const double fint = pf.fint;
-		const double hgap = pf.hgap;
-		const double sinTheta = sin(theta);
-		const double phi = 2.0 * fint * hgap * h * (1 + sinTheta * sinTheta) / cos(theta);
-		R10 = h * tan(theta);
-		R32 = -h*tan(theta - phi);
-	}
-
-	void operator()(PSvector& v) const
-	{
-		v.xp() += R10 * v.x();
-		v.yp() += R32 * v.y();
-	}
-
-};
-
-// Sector Bend Map (no quadrupole gradient)
-struct SectorBendMap
-{
-
-private:
-	double h, ds;
-
-public:
-	SectorBendMap(double _h, double _ds) :
-		h(_h), ds(_ds)
-	{
-	}
-
-	void operator()(PSvector& v) const
-	{
-
-		double& x0 = v.x();
-		double& px0 = v.xp();
-		double& y0 = v.y();
-		double& py0 = v.yp();
-		double& ct0 = v.ct();
-
-		double dp = v.dp();
-		double d1 = 1.0 + dp;
-
-		double wx = sqrt(h * h / d1);
-
-		double xs = sin(wx * ds);
-		double xc = cos(wx * ds);
-		double xs2 = sin(2 * wx * ds);
-		double xc2 = cos(2 * wx * ds);
-
-		double x1 = x0 * xc + px0 * xs * wx / h / h + dp * (1.0 - xc) / h;
-		double px1 = -h * h * x0 * xs / wx + px0 * xc + dp * h * xs / wx;
-
-		double y1 = y0 + py0 * ds / d1;
-		double py1 = py0;
-
-		double j2 = h * x0 - dp;
-
-		double c0 = -dp;
-		double c1 = -j2;
-		double c2 = -px0 / h;
-		double c3 = -px0 * px0 / d1 / d1 / 2.0;
-		double c4 = px0 * j2 / h / d1;
-		double c5 = -j2 * j2 / d1 / 2.0;
-		double c6 = -py0 * py0 / d1 / d1 / 2.0;
-
-		double ct1 = ct0
-			+ (2 * c0 + c3 + c5 + 2 * c6) * ds / 2.0
-			+ c1 * xs / wx + (c3 - c5) * xs2 / wx / 4.0
-			+ c2 * (1.0 - xc) + c4 * (1.0 - xc2) / 4.0;
-
-		x0 = x1;
-		px0 = px1;
-		y0 = y1;
-		py0 = py1;
-		ct0 = ct1;
-	}
-
-};
-
 // Sector Bend Map by Etienne Forest (no quadrupole gradient)
 struct SectorBendMapEF
 {
@@ -214,215 +99,6 @@ public:
 
 };
 
-// Sector Bend Map (with quadrupole gradient)
-struct CombinedFunctionSectorBendMap
-{
-
-private:
-	double h, k1, ds;
-
-public:
-	CombinedFunctionSectorBendMap(double _h, double _k1, double _ds) :
-		h(_h), k1(_k1), ds(_ds)
-	{
-	}
-
-	void operator()(PSvector& v) const
-	{
-
-		double xs, xc, ys, yc;
-		double xs2, xc2, ys2, yc2;
-
-		double& x0 = v.x();
-		double& px0 = v.xp();
-		double& y0 = v.y();
-		double& py0 = v.yp();
-		double& ct0 = v.ct();
-
-		double dp = v.dp();
-		double dp1 = 1.0 + v.dp();
-
-		double wx = sqrt(fabs(h * h + k1) / dp1);
-		double wy = sqrt(fabs(k1) / dp1);
-
-		if((h * h + k1) > 0)
-		{
-			xs = sin(wx * ds);
-			xc = cos(wx * ds);
-			xs2 = sin(2 * wx * ds);
-			xc2 = cos(2 * wx * ds);
-		}
-		else
-		{
-			xs = sinh(wx * ds);
-			xc = cosh(wx * ds);
-			xs2 = sinh(2 * wx * ds);
-			xc2 = cosh(2 * wx * ds);
-		}
-
-		if(k1 > 0)
-		{
-			ys = sinh(wy * ds);
-			yc = cosh(wy * ds);
-			ys2 = sinh(2 * wy * ds);
-			yc2 = cosh(2 * wy * ds);
-		}
-		else
-		{
-			ys = sin(wy * ds);
-			yc = cos(wy * ds);
-			ys2 = sin(2 * wy * ds);
-			yc2 = cos(2 * wy * ds);
-		}
-
-		double x1, px1;
-
-		if((k1 + h * h) == 0)
-		{
-			x1 = x0 + px0 * ds / (1.0 + dp) + dp * h * ds * ds / (1.0 + dp) / 2.0;
-			px1 = px0 * xc + dp * h * ds;
-		}
-		else
-		{
-			x1 = x0 * xc + px0 * xs * wx / fabs(k1 + h * h) + dp * h * (1.0 - xc) / (k1 + h * h);
-			px1 = -(k1 + h * h) * x0 * xs / wx + px0 * xc + dp * h * xs / wx;
-		}
-
-		double y1 = y0 * yc + py0 * ys * wy / fabs(k1);
-		double py1 = k1 * y0 * ys / wy + py0 * yc;
-
-		double j1 = k1 + h * h;
-		double j2 = (j1 * x0 - h * dp);
-
-		double c0 = -h * h * dp / j1;
-		double c1 = h * h * dp / j1 - h * x0;
-		double c2 = -h * px0 / j1;
-		double c3 = -px0 * px0 / dp1 / dp1 / 2.0;
-		double c4 = px0 * j2 / j1 / dp1;
-		double c5 = -j2 * j2 / j1 / dp1 / 2.0;
-		double c6 = -py0 * py0 / dp1 / dp1 / 2.0;
-		double c7 = -y0 * py0 / dp1;
-		double c8 = -y0 * y0 * k1 / dp1 / 2.0;
-
-		double ct1 = ct0
-			+ (2 * c0 + c3 + c5 + c6 - c8) * ds / 2.0
-			+ c1 * xs / wx + (c3 - c5) * xs2 / wx / 4.0
-			+ c2 * (1.0 - xc) + c4 * (1.0 - xc2) / 4.0
-			+ (c6 + c8) * ys2 / wy / 4.0 - c7 * (1.0 - yc2) / 4.0;
-
-		x0 = x1;
-		px0 = px1;
-		y0 = y1;
-		py0 = py1;
-		ct0 = ct1;
-	}
-
-};
-
-// Quadrupole Map
-struct QuadrupoleMap
-{
-
-private:
-	double k1, ds;
-
-public:
-	QuadrupoleMap(double _k1, double _ds) :
-		k1(_k1), ds(_ds)
-	{
-	}
-
-	void operator()(PSvector& v) const
-	{
-
-		double& x0 = v.x();
-		double& px0 = v.xp();
-		double& y0 = v.y();
-		double& py0 = v.yp();
-		double& ct0 = v.ct();
-
-		double dp1 = 1.0 + v.dp();
-		double w = sqrt(fabs(k1) / dp1);
-
-		double xs, xc, ys, yc;
-		double xs2, xc2, ys2, yc2;
-
-		if(k1 >= 0)
-		{
-			xs = sin(w * ds);
-			xc = cos(w * ds);
-			ys = sinh(w * ds);
-			yc = cosh(w * ds);
-			xs2 = sin(2 * w * ds);
-			xc2 = cos(2 * w * ds);
-			ys2 = sinh(2 * w * ds);
-			yc2 = cosh(2 * w * ds);
-		}
-		else
-		{
-			xs = sinh(w * ds);
-			xc = cosh(w * ds);
-			ys = sin(w * ds);
-			yc = cos(w * ds);
-			xs2 = sinh(2 * w * ds);
-			xc2 = cosh(2 * w * ds);
-			ys2 = sin(2 * w * ds);
-			yc2 = cos(2 * w * ds);
-		}
-
-		double x1 = x0 * xc + px0 * xs * w / fabs(k1);
-		double px1 = -k1 * x0 * xs / w + px0 * xc;
-
-		double y1 = y0 * yc + py0 * ys * w / fabs(k1);
-		double py1 = k1 * y0 * ys / w + py0 * yc;
-
-		double c3 = -px0 * px0 / dp1 / dp1 / 2.0;
-		double c4 = x0 * px0 / dp1;
-		double c5 = -x0 * x0 * k1 / dp1 / 2.0;
-		double c6 = -py0 * py0 / dp1 / dp1 / 2.0;
-		double c7 = -y0 * py0 / dp1;
-		double c8 = -y0 * y0 * k1 / dp1 / 2.0;
-
-		double ct1 = ct0
-			+ (c3 + c5 + c6 - c8) * ds / 2.0
-			+ (c3 - c5) * xs2 / w / 4.0
-			+ c4 * (1.0 - xc2) / 4.0
-			+ (c6 + c8) * ys2 / w / 4.0 - c7 * (1.0 - yc2) / 4.0;
-
-		x0 = x1;
-		px0 = px1;
-		y0 = y1;
-		py0 = py1;
-		ct0 = ct1;
-	}
-
-};
-
-// Thin Rectangular Multipole Map: Modified HR 07.12.15
-struct MultipoleKick
-{
-private:
-	const MultipoleField& field;
-	Complex scale;
-
-public:
-	MultipoleKick(const MultipoleField& f, double ds, double P0, double q, double phi = 0) :
-		field(f)
-	{
-		scale = q * ds * eV * SpeedOfLight / P0 * Complex(cos(phi), sin(phi));
-	}
-
-	void operator()(PSvector& v)
-	{
-		double x = v.x();
-		double y = v.y();
-		Complex F = scale * field.GetField2D(x, y);
-		v.xp() += -F.real();
-		v.yp() += F.imag();
-	}
-
-};
-
 //RF Structure Map
 struct RFStructureMap
 {
@@ -634,7 +310,7 @@ inline void ApplyDriftMap(ParticleBunch* bunch, double ds)
 {
 	if(ds != 0)
 	{
-		for_each(bunch->begin(), bunch->end(), DriftMap(ds));
+		Kernels::Apply(bunch, Kernels::DriftMap(ds));
 	}
 }
 
@@ -642,13 +318,13 @@ inline void ApplyMultipoleKick(ParticleBunch* bunch, MultipoleField& field, doub
 {
 	if(ds != 0)
 	{
-		for_each(bunch->begin(), bunch->end(), MultipoleKick(field, ds, P0, q));
+		Kernels::Apply(bunch, Kernels::MultipoleKick(field, ds, P0, q));
 	}
 }
 
 inline void ApplyPoleFaceRotation(ParticleBunch* bunch, double h, const SectorBend::PoleFace& pf)
 {
-	for_each(bunch->begin(), bunch->end(), PoleFaceRotation(h, pf));
+	Kernels::Apply(bunch, Kernels::PoleFaceRotation(h, pf.rot, pf.fint, pf.hgap));
 }
 
 inline void ApplySectorBendMap(ParticleBunch* bunch, double h, double ds)
@@ -657,11 +333,11 @@ inline void ApplySectorBendMap(ParticleBunch* bunch, double h, double ds)
 	{
 		if(h == 0)
 		{
-			for_each(bunch->begin(), bunch->end(), DriftMap(ds));
+			Kernels::Apply(bunch, Kernels::DriftMap(ds));
 		}
 		else
 		{
-			for_each(bunch->begin(), bunch->end(), SectorBendMap(h, ds));
+			Kernels::Apply(bunch, Kernels::SectorBendMap(h, ds));
 		}
 	}
 }
@@ -670,7 +346,7 @@ inline void ApplyCombinedFunctionSectorBendMap(ParticleBunch* bunch, double h, d
 {
 	if(ds != 0)
 	{
-		for_each(bunch->begin(), bunch->end(), CombinedFunctionSectorBendMap(h, k1, ds));
+		Kernels::Apply(bunch, Kernels::CombinedFunctionSectorBendMap(h, k1, ds));
 	}
 }
 
@@ -678,26 +354,26 @@ inline void ApplyQuadrupoleMap(ParticleBunch* bunch, double k1, double ds)
 {
 	if(ds != 0)
 	{
-		for_each(bunch->begin(), bunch->end(), QuadrupoleMap(k1, ds));
+		Kernels::Apply(bunch, Kernels::QuadrupoleMap(k1, ds));
 	}
 }
 
 inline void ApplyRFStructureMap(ParticleBunch* bunch, double Vnorm, double Verr, double kval, double phase, double
 	phaseErr, RMtrx& RM, bool full_accel)
 {
-	for_each(bunch->begin(), bunch->end(), RFStructureMap(Vnorm, Verr, kval, phase, phaseErr, RM, full_accel));
+	Parallel::ForEach(bunch->begin(), bunch->end(), RFStructureMap(Vnorm, Verr, kval, phase, phaseErr, RM, full_accel));
 }
 
 inline void ApplySWRFStructureMap(ParticleBunch* bunch, double Vnorm, double Verr, double kval, double phase, double
 	phaseErr, double length)
 {
-	for_each(bunch->begin(), bunch->end(), RSRFStructureMap(Vnorm, Verr, kval, phase, phaseErr, length));
+	Parallel::ForEach(bunch->begin(), bunch->end(), RSRFStructureMap(Vnorm, Verr, kval, phase, phaseErr, length));
 }
 
 inline void ApplySimpleRFStructureMap(ParticleBunch* bunch, double Vnorm, double Verr, double kval, double phase, double
 	phaseErr, double length)
 {
-	for_each(bunch->begin(), bunch->end(), SimpleRFStructureMap(Vnorm, Verr, kval, phase, phaseErr, length));
+	Parallel::ForEach(bunch->begin(), bunch->end(), SimpleRFStructureMap(Vnorm, Verr, kval, phase, phaseErr, length));
 }
 
 // TrackStep Routines
@@ -845,7 +521,7 @@ void RectMultipoleCI::TrackStep(double ds)
 	if(currentComponent->GetLength() == 0 && ds == 0 && !field.IsNullField())
 	{
 		// Using a ds = 1.0 for thin correctors
-		for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, 1.0, P0, q));
+		Kernels::Apply(currentBunch, Kernels::MultipoleKick(field, 1.0, P0, q));
 		return;
 	}
 	CHK_ZERO(ds);
@@ -881,11 +557,11 @@ void RectMultipoleCI::TrackStep(double ds)
 			if(cK1 != 0.0)
 			{
 				double phi = arg(cK1) / 2;
-				for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, ds, P0, q, -phi));
+				Kernels::Apply(currentBunch, Kernels::MultipoleKick(field, ds, P0, q, -phi));
 			}
 			else
 			{
-				for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, ds, P0, q));
+				Kernels::Apply(currentBunch, Kernels::MultipoleKick(field, ds, P0, q));
 			}
 			M.Apply(currentBunch->GetParticles());
 			field.SetCoefficient(1, b1);
@@ -901,7 +577,7 @@ void RectMultipoleCI::TrackStep(double ds)
 	{
 		Complex b1 = field.GetCoefficient(1);
 		field.SetCoefficient(1, Complex(0));
-		for_each(currentBunch->begin(), currentBunch->end(), MultipoleKick(field, ds, P0, q));
+		Kernels::Apply(currentBunch, Kernels::MultipoleKick(field, ds, P0, q));
 		ApplyDriftMap(currentBunch, len);
 		field.SetCoefficient(1, b1);
 	}
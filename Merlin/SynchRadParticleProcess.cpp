@@ -7,12 +7,14 @@
 
 #include <cmath>
 #include <algorithm>
+#include <vector>
 #include "utils.h"
 
 #include "SynchRadParticleProcess.h"
 #include "SectorBend.h"
 #include "RectMultipole.h"
 #include "RandomNG.h"
+#include "ParallelFor.h"
 
 #include "PhysicalUnits.h"
 #include "PhysicalConstants.h"
@@ -41,24 +43,20 @@ struct ApplySR
 	bool symp;
 	spec_gen photgen;
 
-	double meanU;
-	size_t n;
-
 	double PHOTCONST1, PHOTCONST2, ParticleMassMeV;
 
 	ApplySR(const MultipoleField& field, double dl, double p0, bool sV, const double PCONST1, const double PCONST2,
 		const double MassMeV, spec_gen sg = nullptr) :
-		Bf(field), dL(dl), P0(p0), symp(sV), photgen(sg), meanU(0), n(0), PHOTCONST1(PCONST1), PHOTCONST2(PCONST2),
+		Bf(field), dL(dl), P0(p0), symp(sV), photgen(sg), PHOTCONST1(PCONST1), PHOTCONST2(PCONST2),
 		ParticleMassMeV(MassMeV)
 	{
 	}
 
-	double MeanEnergyLoss() const
-	{
-		return meanU / n;
-	}
-
-	void operator()(PSvector& v)
+	/**
+	 *	Apply the radiation to one particle.
+	 *	@return The energy radiated.
+	 */
+	double operator()(PSvector& v) const
 	{
 		double B = abs(Bf.GetField2D(v.x(), v.y()));
 		double g = P0 * (1 + v.dp()) / ParticleMassMeV;
@@ -78,8 +76,6 @@ struct ApplySR
 			u = PHOTCONST2 * B * dL * uc;
 		}
 
-		meanU += u;
-
 		double& px = v.xp();
 		double& py = v.yp();
 		double& dp = v.dp();
@@ -105,7 +101,7 @@ struct ApplySR
 			px /= (1.0 + u / P0);
 			py /= (1.0 + u / P0);
 		}
-		n++;
+		return u;
 	}
 
 };
@@ -122,7 +118,8 @@ bool SynchRadParticleProcess::sympVars = false;
 
 SynchRadParticleProcess::SynchRadParticleProcess(int prio, bool q)
 
-	: ParticleBunchProcess("SYNCHROTRON RADIATION", prio), ns(1), incQ(false), adjustEref(true), dsMax(0)
+	: ParticleBunchProcess("SYNCHROTRON RADIATION", prio), ns(1), incQ(false), adjustEref(true), dsMax(0), turn(0),
+	element(0), tileKick(false)
 
 {
 
@@ -155,6 +152,13 @@ void SynchRadParticleProcess::SetCurrentComponent(AcceleratorComponent& componen
 		currentField = nullptr;
 	}
 
+	element = component.GetBeamlineIndex();
+	if(passes.size() <= element)
+	{
+		passes.resize(element + 1, 0);
+	}
+	turn = passes[element]++;
+
 	int ns1 = (ns == 0) ? 1 + component.GetLength() / dsMax : ns;
 	dL = component.GetLength() / ns1;
 	nk1 = 0;
@@ -170,11 +174,45 @@ void SynchRadParticleProcess::DoProcess(double ds)
 	if(fequal(intS += ds, (nk1 + 1) * dL))
 	{
 		double E0 = currentBunch->GetReferenceMomentum();
-		double meanU = for_each(
-			currentBunch->begin(),
-			currentBunch->end(),
-			ApplySR(*currentField, dL, E0, sympVars, PHOTCONST1, PHOTCONST2, ParticleMassMeV,
-			quantum)).MeanEnergyLoss();
+		const ApplySR sr(*currentField, dL, E0, sympVars, PHOTCONST1, PHOTCONST2, ParticleMassMeV, quantum);
+
+		// The energy loss of each particle is stored and summed in
+		// particle order so that the mean does not depend on the number
+		// of threads. Photon emission draws random numbers, so unless
+		// each particle has its own stream the quantum case stays on one
+		// thread.
+		const size_t np = currentBunch->size();
+		const PSvectorArray::iterator p = currentBunch->begin();
+		std::vector<double> u(np);
+		if(!quantum)
+		{
+			Parallel::For(np, [&](size_t i)
+			{
+				u[i] = sr(p[i]);
+			});
+		}
+		else if(RandomNG::isCounterBased())
+		{
+			Parallel::For(np, [&](size_t i)
+			{
+				RandomNG::Stream stream(p[i].id(), turn, element, nk1);
+				u[i] = sr(p[i]);
+			});
+		}
+		else
+		{
+			for(size_t i = 0; i < np; i++)
+			{
+				u[i] = sr(p[i]);
+			}
+		}
+
+		double meanU = 0;
+		for(size_t i = 0; i < np; i++)
+		{
+			meanU += u[i];
+		}
+		meanU /= np;
 
 		// Finally we adjust the reference of the
 		// bunch to reflect the mean energy loss
@@ -189,6 +227,73 @@ void SynchRadParticleProcess::DoProcess(double ds)
 
 }
 
+bool SynchRadParticleProcess::IsParticleLocal() const
+{
+	return !quantum || RandomNG::isCounterBased();
+}
+
+void SynchRadParticleProcess::BeginTiles(double ds, size_t ntiles)
+{
+	tileKick = fequal(intS += ds, (nk1 + 1) * dL);
+	if(tileKick)
+	{
+		tileU.assign(ntiles, std::vector<double>());
+	}
+}
+
+size_t SynchRadParticleProcess::DoProcessTile(double ds, size_t tile, size_t first, size_t last)
+{
+	if(!tileKick)
+	{
+		return last;
+	}
+
+	const ApplySR sr(*currentField, dL, currentBunch->GetReferenceMomentum(), sympVars, PHOTCONST1, PHOTCONST2,
+		ParticleMassMeV, quantum);
+	const PSvectorArray::iterator p = currentBunch->begin();
+	std::vector<double>& u = tileU[tile];
+	u.resize(last - first);
+	for(size_t i = first; i < last; i++)
+	{
+		if(quantum)
+		{
+			RandomNG::Stream stream(p[i].id(), turn, element, nk1);
+			u[i - first] = sr(p[i]);
+		}
+		else
+		{
+			u[i - first] = sr(p[i]);
+		}
+	}
+	return last;
+}
+
+void SynchRadParticleProcess::EndTiles(double ds)
+{
+	if(tileKick)
+	{
+		// Summed in particle order, as in DoProcess()
+		double meanU = 0;
+		size_t np = 0;
+		for(const std::vector<double>& u : tileU)
+		{
+			for(double ui : u)
+			{
+				meanU += ui;
+			}
+			np += u.size();
+		}
+		meanU /= np;
+
+		if(adjustEref)
+		{
+			currentBunch->AdjustRefMomentum(-meanU / currentBunch->GetReferenceMomentum());
+		}
+		nk1++;
+	}
+	active = nk1 != ns;
+}
+
 double SynchRadParticleProcess::GetMaxAllowedStepSize() const
 {
 
@@ -9,6 +9,8 @@
 #define SynchRadParticleProcess_h 1
 
 #include "merlin_config.h"
+#include <cstdint>
+#include <vector>
 
 #include "ParticleBunchProcess.h"
 #include "MultipoleField.h"
@@ -81,6 +83,21 @@ public:
 	 */
 	virtual double GetMaxAllowedStepSize() const;
 
+	/**
+	 *	The radiation is particle local unless photons are generated
+	 *	from the shared random number sequence, which must be drawn in
+	 *	particle order. Adjusting the reference energy needs the mean
+	 *	loss of the whole bunch, so it ends a fused run of processes.
+	 */
+	virtual bool IsParticleLocal() const;
+	virtual bool IsTileBarrier() const
+	{
+		return adjustEref;
+	}
+	virtual void BeginTiles(double ds, size_t ntiles);
+	virtual size_t DoProcessTile(double ds, size_t tile, size_t first, size_t last);
+	virtual void EndTiles(double ds);
+
 	/**
 	 *	Include radiation effects in Quadrupoles and Skew
 	 *	Quadrupoles.
@@ -193,6 +210,22 @@ private:
 
 	double dsMax;
 
+	/**
+	 *	Number of passes through each beamline element. In
+	 *	counter-based random mode this is the turn number of the
+	 *	particle random streams.
+	 */
+	std::vector<std::uint64_t> passes;
+	std::uint64_t turn;
+	size_t element;
+
+	/**
+	 *	True if the current fused step applies a kick, and the
+	 *	energy lost by the particles of each tile.
+	 */
+	bool tileKick;
+	std::vector<std::vector<double> > tileU;
+
 	// Copy prevention
 	SynchRadParticleProcess(const SynchRadParticleProcess& rhs);
 	SynchRadParticleProcess& operator=(const SynchRadParticleProcess& rhs);
@@ -0,0 +1,467 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef TPSA_h
+#define TPSA_h 1
+
+#include "merlin_config.h"
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <vector>
+
+/**
+ *	The number of monomials of degree <= N in the six phase space
+ *	coordinates, C(N+6, 6).
+ */
+constexpr int TPSABinomial(int n, int k)
+{
+	return k == 0 ? 1 : TPSABinomial(n - 1, k - 1) * n / k;
+}
+
+/**
+ *	A truncated power series in the six phase space coordinates
+ *	(x, x', y, y', ct, dp), to order N (differential algebra).
+ *
+ *	A TPSA supports the arithmetic operators and the elementary
+ *	functions used by the tracking maps, so that maps written for a
+ *	value type (the Kernels of TrackingKernels.h and KernelSequence)
+ *	can track a phase space point whose coordinates are TPSA
+ *	variables (see Variable()). The result is the Taylor expansion of
+ *	the map about that point: its value, the exact Jacobian (the first
+ *	order coefficients), and for N > 1 the higher order terms.
+ *
+ *	The series are held in fixed size arrays, so no allocation is
+ *	needed. The monomials are ordered by degree.
+ */
+template<int N>
+class TPSA
+{
+	static_assert(N >= 1, "TPSA order must be at least 1");
+
+public:
+
+	static const int nv = 6;
+	static const int size = TPSABinomial(N + nv, nv);
+
+	TPSA()
+	{
+		Clear(0);
+	}
+
+	TPSA(double c)
+	{
+		Clear(c);
+	}
+
+	/**
+	 *	@return The series x0 + dx_i, for the phase space coordinate
+	 *	i (0 to 5) expanded about x0.
+	 */
+	static TPSA Variable(int i, double x0)
+	{
+		assert(i >= 0 && i < nv);
+		TPSA a(x0);
+		if(N > 0)
+		{
+			a.c[1 + i] = 1;
+		}
+		return a;
+	}
+
+	/**
+	 *	@return The value of the series at the expansion point.
+	 */
+	double Value() const
+	{
+		return c[0];
+	}
+
+	/**
+	 *	@return The first derivative with respect to coordinate i.
+	 */
+	double Derivative(int i) const
+	{
+		assert(N > 0 && i >= 0 && i < nv);
+		return c[1 + i];
+	}
+
+	/**
+	 *	@return The second derivative with respect to coordinates i
+	 *	and j.
+	 */
+	double Derivative(int i, int j) const
+	{
+		assert(N > 1 && i >= 0 && i < nv && j >= 0 && j < nv);
+		int e[nv] = {0, 0, 0, 0, 0, 0};
+		e[i]++;
+		e[j]++;
+		const double a = c[GetTables().Index(e)];
+		return i == j ? 2 * a : a;
+	}
+
+	/**
+	 *	@return The coefficient of the monomial with exponents e[0..5].
+	 */
+	double Coefficient(const int* e) const
+	{
+		return c[GetTables().Index(e)];
+	}
+
+	TPSA operator-() const
+	{
+		TPSA r;
+		for(int k = 0; k < size; k++)
+		{
+			r.c[k] = -c[k];
+		}
+		return r;
+	}
+
+	TPSA& operator+=(const TPSA& b)
+	{
+		for(int k = 0; k < size; k++)
+		{
+			c[k] += b.c[k];
+		}
+		return *this;
+	}
+
+	TPSA& operator-=(const TPSA& b)
+	{
+		for(int k = 0; k < size; k++)
+		{
+			c[k] -= b.c[k];
+		}
+		return *this;
+	}
+
+	TPSA& operator*=(const TPSA& b)
+	{
+		return *this = *this * b;
+	}
+
+	TPSA& operator/=(const TPSA& b)
+	{
+		return *this = *this / b;
+	}
+
+	TPSA& operator+=(double b)
+	{
+		c[0] += b;
+		return *this;
+	}
+
+	TPSA& operator-=(double b)
+	{
+		c[0] -= b;
+		return *this;
+	}
+
+	TPSA& operator*=(double b)
+	{
+		for(int k = 0; k < size; k++)
+		{
+			c[k] *= b;
+		}
+		return *this;
+	}
+
+	TPSA& operator/=(double b)
+	{
+		return *this *= 1.0 / b;
+	}
+
+	friend TPSA operator+(TPSA a, const TPSA& b)
+	{
+		return a += b;
+	}
+
+	friend TPSA operator-(TPSA a, const TPSA& b)
+	{
+		return a -= b;
+	}
+
+	friend TPSA operator*(const TPSA& a, const TPSA& b)
+	{
+		const Tables& t = GetTables();
+		TPSA r;
+		for(typename std::vector<Product>::const_iterator p = t.products.begin(); p != t.products.end(); p++)
+		{
+			r.c[p->k] += a.c[p->i] * b.c[p->j];
+		}
+		return r;
+	}
+
+	friend TPSA operator/(const TPSA& a, const TPSA& b)
+	{
+		return a * Inverse(b);
+	}
+
+	friend TPSA operator+(TPSA a, double b)
+	{
+		return a += b;
+	}
+
+	friend TPSA operator+(double a, TPSA b)
+	{
+		return b += a;
+	}
+
+	friend TPSA operator-(TPSA a, double b)
+	{
+		return a -= b;
+	}
+
+	friend TPSA operator-(double a, const TPSA& b)
+	{
+		return -b + a;
+	}
+
+	friend TPSA operator*(TPSA a, double b)
+	{
+		return a *= b;
+	}
+
+	friend TPSA operator*(double a, TPSA b)
+	{
+		return b *= a;
+	}
+
+	friend TPSA operator/(TPSA a, double b)
+	{
+		return a /= b;
+	}
+
+	friend TPSA operator/(double a, const TPSA& b)
+	{
+		return Inverse(b) *= a;
+	}
+
+	friend TPSA sqrt(const TPSA& a)
+	{
+		// binomial series of (a0 + h)^(1/2)
+		const double a0 = a.c[0];
+		assert(a0 > 0);
+		double f[N + 1];
+		f[0] = std::sqrt(a0);
+		for(int n = 1; n <= N; n++)
+		{
+			f[n] = f[n - 1] * (0.5 - (n - 1)) / (n * a0);
+		}
+		return a.Compose(f);
+	}
+
+	friend TPSA sin(const TPSA& a)
+	{
+		double f[N + 1];
+		a.Trigonometric(std::sin(a.c[0]), std::cos(a.c[0]), -1, f);
+		return a.Compose(f);
+	}
+
+	friend TPSA cos(const TPSA& a)
+	{
+		double f[N + 1];
+		a.Trigonometric(std::cos(a.c[0]), -std::sin(a.c[0]), -1, f);
+		return a.Compose(f);
+	}
+
+	friend TPSA sinh(const TPSA& a)
+	{
+		double f[N + 1];
+		a.Trigonometric(std::sinh(a.c[0]), std::cosh(a.c[0]), 1, f);
+		return a.Compose(f);
+	}
+
+	friend TPSA cosh(const TPSA& a)
+	{
+		double f[N + 1];
+		a.Trigonometric(std::cosh(a.c[0]), std::sinh(a.c[0]), 1, f);
+		return a.Compose(f);
+	}
+
+	friend TPSA exp(const TPSA& a)
+	{
+		double f[N + 1];
+		f[0] = std::exp(a.c[0]);
+		for(int n = 1; n <= N; n++)
+		{
+			f[n] = f[n - 1] / n;
+		}
+		return a.Compose(f);
+	}
+
+	friend TPSA log(const TPSA& a)
+	{
+		const double a0 = a.c[0];
+		assert(a0 > 0);
+		double f[N + 1];
+		f[0] = std::log(a0);
+		double p = 1;
+		for(int n = 1; n <= N; n++)
+		{
+			p /= -a0;
+			f[n] = -p / n;
+		}
+		return a.Compose(f);
+	}
+
+	/**
+	 *	The sign is taken from the value, so the series is only
+	 *	meaningful away from zero.
+	 */
+	friend TPSA fabs(const TPSA& a)
+	{
+		return a.c[0] < 0 ? -a : a;
+	}
+
+	friend TPSA Inverse(const TPSA& a)
+	{
+		// geometric series of 1/(a0 + h)
+		const double a0 = a.c[0];
+		assert(a0 != 0);
+		double f[N + 1];
+		f[0] = 1.0 / a0;
+		for(int n = 1; n <= N; n++)
+		{
+			f[n] = -f[n - 1] / a0;
+		}
+		return a.Compose(f);
+	}
+
+private:
+
+	struct Product
+	{
+		int i, j, k;
+	};
+
+	/**
+	 *	The exponents of each monomial, and the products of pairs of
+	 *	monomials which are kept by the truncation.
+	 */
+	struct Tables
+	{
+		int exponents[size][nv];
+		std::map<std::vector<int>, int> index;
+		std::vector<Product> products;
+
+		Tables()
+		{
+			int n = 0;
+			int e[nv];
+			for(int d = 0; d <= N; d++)
+			{
+				Enumerate(e, 0, d, n);
+			}
+			assert(n == size);
+
+			for(int i = 0; i < size; i++)
+			{
+				for(int j = 0; j < size; j++)
+				{
+					int s[nv];
+					int d = 0;
+					for(int v = 0; v < nv; v++)
+					{
+						s[v] = exponents[i][v] + exponents[j][v];
+						d += s[v];
+					}
+					if(d <= N)
+					{
+						Product p = {i, j, Index(s)};
+						products.push_back(p);
+					}
+				}
+			}
+		}
+
+		// the monomials of degree d in the coordinates v..5
+		void Enumerate(int* e, int v, int d, int& n)
+		{
+			if(v == nv - 1)
+			{
+				e[v] = d;
+				std::copy(e, e + nv, exponents[n]);
+				index[std::vector<int>(e, e + nv)] = n;
+				n++;
+				return;
+			}
+			for(int k = d; k >= 0; k--)
+			{
+				e[v] = k;
+				Enumerate(e, v + 1, d - k, n);
+			}
+		}
+
+		int Index(const int* e) const
+		{
+			typename std::map<std::vector<int>, int>::const_iterator i = index.find(std::vector<int>(e, e + nv));
+			assert(i != index.end());
+			return i->second;
+		}
+	};
+
+	static const Tables& GetTables()
+	{
+		static const Tables tables;
+		return tables;
+	}
+
+	void Clear(double c0)
+	{
+		c[0] = c0;
+		for(int k = 1; k < size; k++)
+		{
+			c[k] = 0;
+		}
+	}
+
+	/**
+	 *	@return The series f[0] + f[1] h + ... + f[N] h^N, where h is
+	 *	this series without its value.
+	 */
+	TPSA Compose(const double* f) const
+	{
+		TPSA h = *this;
+		h.c[0] = 0;
+		TPSA r(f[N]);
+		for(int n = N - 1; n >= 0; n--)
+		{
+			r = r * h;
+			r.c[0] += f[n];
+		}
+		return r;
+	}
+
+	/**
+	 *	The Taylor coefficients of sin, cos (sign -1) or sinh, cosh
+	 *	(sign 1), given the function value f0 and its derivative f1.
+	 */
+	void Trigonometric(double f0, double f1, int sign, double* f) const
+	{
+		double d[2] = {f0, f1};
+		double factorial = 1;
+		for(int n = 0; n <= N; n++)
+		{
+			if(n > 0)
+			{
+				factorial *= n;
+			}
+			double dn = d[n % 2];
+			if(sign < 0 && (n / 2) % 2 == 1)
+			{
+				dn = -dn;
+			}
+			f[n] = dn / factorial;
+		}
+	}
+
+	double c[size];
+};
+
+#endif
@@ -87,6 +87,27 @@ public:
 		return this->active ? ctracker.GetRemainingLength() : 0;
 	}
 
+	bool IsParticleLocal() const
+	{
+		return this->active && ctracker.IsParticleLocal();
+	}
+
+	void BeginTiles(double ds, size_t ntiles)
+	{
+		ctracker.BeginTiles(ds);
+	}
+
+	size_t DoProcessTile(double ds, size_t tile, size_t first, size_t last)
+	{
+		ctracker.TrackTile(ds, first, last);
+		return last;
+	}
+
+	void EndTiles(double ds)
+	{
+		ctracker.EndTiles(ds);
+	}
+
 	void SetIntegratorSet(const integrator_set_base* iset)
 	{
 		ctracker.ClearIntegratorSet();
@@ -0,0 +1,235 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "TableCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * File layout, in native byte order:
+ *
+ *	char[8]		magic "MRLNTBL"
+ *	uint32		layout version
+ *	uint32		number of key values
+ *	uint64		number of tables
+ *	double[]	key
+ *	uint64[]	table lengths
+ *	double[]	table data, one table after another
+ *	uint64		FNV-1a hash of everything above
+ */
+
+namespace
+{
+
+const char magic[8] = "MRLNTBL";
+
+struct Header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t nkey;
+	std::uint64_t ntables;
+};
+
+class Hash
+{
+public:
+	Hash() :
+		h(0xcbf29ce484222325ULL)
+	{
+	}
+
+	void Add(const void* data, size_t n)
+	{
+		const unsigned char* c = static_cast<const unsigned char*>(data);
+		for(size_t i = 0; i < n; i++)
+		{
+			h = (h ^ c[i]) * 0x100000001b3ULL;
+		}
+	}
+
+	std::uint64_t Value() const
+	{
+		return h;
+	}
+
+private:
+	std::uint64_t h;
+};
+
+} // end anonymous namespace
+
+std::string TableCache::directory;
+
+void TableCache::SetDirectory(const std::string& dir)
+{
+	directory = dir;
+}
+
+const std::string& TableCache::GetDirectory()
+{
+	return directory;
+}
+
+bool TableCache::Enabled()
+{
+	return !directory.empty();
+}
+
+std::string TableCache::FileName(const std::string& name, const std::vector<double>& key)
+{
+	Hash h;
+	h.Add(key.data(), key.size() * sizeof(double));
+
+	std::ostringstream file;
+	file << directory << "/" << name << "_" << std::hex << std::setw(16) << std::setfill('0') << h.Value() << ".tbl";
+	return file.str();
+}
+
+bool TableCache::Load(const std::string& name, const std::vector<double>& key,
+	std::vector<std::vector<double> >& tables)
+{
+	if(!Enabled())
+	{
+		return false;
+	}
+
+	int fd = open(FileName(name, key).c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header) + sizeof(std::uint64_t)))
+	{
+		close(fd);
+		return false;
+	}
+	const size_t size = st.st_size;
+	void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const char* data = static_cast<const char*>(map);
+	bool valid = false;
+	Header header;
+	memcpy(&header, data, sizeof(header));
+
+	if(memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version && header.nkey == key.size()
+		&& header.ntables < size / sizeof(std::uint64_t))
+	{
+		size_t offset = sizeof(Header);
+		size_t need = offset + (key.size() + header.ntables + 1) * sizeof(std::uint64_t);
+		std::vector<std::uint64_t> lengths(header.ntables);
+		if(need <= size && memcmp(data + offset, key.data(), key.size() * sizeof(double)) == 0)
+		{
+			offset += key.size() * sizeof(double);
+			memcpy(lengths.data(), data + offset, lengths.size() * sizeof(std::uint64_t));
+			offset += lengths.size() * sizeof(std::uint64_t);
+
+			valid = true;
+			for(std::uint64_t n : lengths)
+			{
+				if(n > (size - need) / sizeof(double))
+				{
+					valid = false;
+					break;
+				}
+				need += n * sizeof(double);
+			}
+			valid = valid && need == size;
+		}
+
+		if(valid)
+		{
+			Hash h;
+			h.Add(data, size - sizeof(std::uint64_t));
+			std::uint64_t stored;
+			memcpy(&stored, data + size - sizeof(stored), sizeof(stored));
+			valid = stored == h.Value();
+		}
+
+		if(valid)
+		{
+			tables.resize(lengths.size());
+			for(size_t i = 0; i < lengths.size(); i++)
+			{
+				tables[i].resize(lengths[i]);
+				memcpy(tables[i].data(), data + offset, lengths[i] * sizeof(double));
+				offset += lengths[i] * sizeof(double);
+			}
+		}
+	}
+
+	munmap(map, size);
+	return valid;
+}
+
+bool TableCache::Store(const std::string& name, const std::vector<double>& key,
+	const std::vector<std::vector<double> >& tables)
+{
+	if(!Enabled())
+	{
+		return false;
+	}
+
+	const std::string file = FileName(name, key);
+	std::ostringstream tmpname;
+	tmpname << file << ".tmp." << getpid();
+	const std::string tmp = tmpname.str();
+
+	Header header;
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.nkey = key.size();
+	header.ntables = tables.size();
+
+	std::vector<std::uint64_t> lengths;
+	for(const auto& t : tables)
+	{
+		lengths.push_back(t.size());
+	}
+
+	Hash h;
+	std::ofstream out(tmp.c_str(), std::ios::binary);
+	auto write = [&](const void* data, size_t n)
+		{
+			h.Add(data, n);
+			out.write(static_cast<const char*>(data), n);
+		};
+
+	write(&header, sizeof(header));
+	write(key.data(), key.size() * sizeof(double));
+	write(lengths.data(), lengths.size() * sizeof(std::uint64_t));
+	for(const auto& t : tables)
+	{
+		write(t.data(), t.size() * sizeof(double));
+	}
+	std::uint64_t checksum = h.Value();
+	out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+	out.close();
+
+	if(!out || std::rename(tmp.c_str(), file.c_str()) != 0)
+	{
+		std::remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,74 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef TableCache_h
+#define TableCache_h 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * On-disk cache for expensive generated tables, such as the scattering
+ * distributions built by ppElasticScatter and ppDiffractiveScatter at
+ * startup.
+ *
+ * An entry is a set of tables of doubles, stored under a name and a key
+ * holding every parameter the tables depend on. Entries are versioned
+ * binary files with a checksum, read through a memory map. Any mismatch or
+ * damage makes Load() fail, so the caller regenerates the tables and
+ * stores them again. Files are written under a temporary name and renamed,
+ * so several jobs may share one cache directory.
+ *
+ * The cache is disabled until a directory is set.
+ */
+class TableCache
+{
+public:
+
+	/**
+	 * Set the cache directory, which must exist. An empty string
+	 * disables the cache.
+	 */
+	static void SetDirectory(const std::string& dir);
+	static const std::string& GetDirectory();
+
+	/**
+	 * @return true if a directory has been set
+	 */
+	static bool Enabled();
+
+	/**
+	 * Read the entry name for key into tables.
+	 * @retval true if a valid entry was found
+	 */
+	static bool Load(const std::string& name, const std::vector<double>& key,
+		std::vector<std::vector<double> >& tables);
+
+	/**
+	 * Write the entry name for key, replacing any existing entry.
+	 * @retval true if the entry was written
+	 */
+	static bool Store(const std::string& name, const std::vector<double>& key,
+		const std::vector<std::vector<double> >& tables);
+
+	/**
+	 * @return The file holding the entry name for key
+	 */
+	static std::string FileName(const std::string& name, const std::vector<double>& key);
+
+	/**
+	 * Version of the file layout. Entries written with another version
+	 * are ignored.
+	 */
+	static const std::uint32_t version = 1;
+
+private:
+	static std::string directory;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "TabulatedSampler.h"
+#include "MerlinException.h"
+
+InverseCDFSampler::InverseCDFSampler(const std::vector<double>& xv) :
+	x(xv), slope(xv.size()), du(0), last(0)
+{
+	if(x.size() < 2)
+	{
+		throw MerlinException("InverseCDFSampler: at least two points are needed");
+	}
+
+	last = x.size() - 2;
+	du = 1.0 / (x.size() - 1);
+	for(size_t i = 0; i + 1 < x.size(); i++)
+	{
+		slope[i] = (x[i + 1] - x[i]) / du;
+	}
+}
+
+AliasSampler::AliasSampler(const std::vector<double>& weights) :
+	prob(weights.size()), alias(weights.size())
+{
+	const size_t n = weights.size();
+	double total = 0;
+	for(double w : weights)
+	{
+		if(!(w >= 0))
+		{
+			throw MerlinException("AliasSampler: weights must be non-negative");
+		}
+		total += w;
+	}
+	if(n == 0 || !(total > 0))
+	{
+		throw MerlinException("AliasSampler: weights must have a positive sum");
+	}
+
+	// Scale so the mean probability is 1, then pair each under-full
+	// outcome with an over-full one that tops it up.
+	std::vector<std::uint32_t> small, large;
+	for(size_t i = 0; i < n; i++)
+	{
+		prob[i] = weights[i] * n / total;
+		alias[i] = i;
+		(prob[i] < 1 ? small : large).push_back(i);
+	}
+
+	while(!small.empty() && !large.empty())
+	{
+		std::uint32_t s = small.back();
+		std::uint32_t l = large.back();
+		small.pop_back();
+		alias[s] = l;
+		prob[l] -= 1 - prob[s];
+		if(prob[l] < 1)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Whatever is left over is 1 up to rounding
+	for(std::uint32_t i : small)
+	{
+		prob[i] = 1;
+	}
+	for(std::uint32_t i : large)
+	{
+		prob[i] = 1;
+	}
+}
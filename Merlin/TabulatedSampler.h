@@ -0,0 +1,107 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef TabulatedSampler_h
+#define TabulatedSampler_h 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Constant time sampling from an inverse cumulative distribution
+ * tabulated at equally spaced probabilities.
+ *
+ * Given x[0..n] with x[i] = F^-1(i/n), operator()(u) maps a uniform
+ * number u in [0,1] onto the distribution by linear interpolation. The
+ * slopes are precomputed, so a draw is one table lookup and one multiply
+ * add, with no search. The result is the same as
+ * Interpolation(x, 0, 1.0/n)(u).
+ */
+class InverseCDFSampler
+{
+public:
+	InverseCDFSampler() :
+		du(1)
+	{
+	}
+
+	/**
+	 * @param x The inverse CDF at n+1 equally spaced probabilities from 0 to 1
+	 */
+	explicit InverseCDFSampler(const std::vector<double>& x);
+
+	double operator()(double u) const
+	{
+		size_t n = u / du;
+		n = n < last ? n : last;
+		return x[n] + slope[n] * (u - du * n);
+	}
+
+	bool empty() const
+	{
+		return x.empty();
+	}
+
+private:
+	std::vector<double> x;
+	std::vector<double> slope;
+	double du;
+	size_t last;
+};
+
+/**
+ * Walker's alias method for constant time sampling of a discrete
+ * distribution with a given set of weights.
+ *
+ * A draw takes one uniform number, one table lookup and one comparison,
+ * independent of the number of outcomes. The tables are built in O(n)
+ * with Vose's algorithm.
+ *
+ * M. D. Vose, "A linear algorithm for generating random numbers with a
+ * given distribution", IEEE Trans. Software Eng. 17 (1991) 972.
+ */
+class AliasSampler
+{
+public:
+	AliasSampler()
+	{
+	}
+
+	/**
+	 * @param weights Non-negative, not necessarily normalised, weights
+	 */
+	explicit AliasSampler(const std::vector<double>& weights);
+
+	/**
+	 * @param u A uniform random number in [0,1)
+	 * @return The index of the selected outcome
+	 */
+	size_t operator()(double u) const
+	{
+		double r = u * prob.size();
+		size_t i = r;
+		i = i < prob.size() ? i : prob.size() - 1;
+		return (r - i) < prob[i] ? i : alias[i];
+	}
+
+	size_t size() const
+	{
+		return prob.size();
+	}
+
+	bool empty() const
+	{
+		return prob.empty();
+	}
+
+private:
+	std::vector<double> prob;
+	std::vector<std::uint32_t> alias;
+};
+
+#endif
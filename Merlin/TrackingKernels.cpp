@@ -0,0 +1,34 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "TrackingKernels.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+
+namespace ParticleTracking
+{
+namespace Kernels
+{
+
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+
+MultipoleKick::MultipoleKick(const MultipoleField& f, double ds, double P0, double q, double phi) :
+	field(f)
+{
+	Complex scale = q * ds * eV * SpeedOfLight / P0 * Complex(cos(phi), sin(phi));
+	sr = scale.real();
+	si = scale.imag();
+}
+
+ThinMultipoleKick::ThinMultipoleKick(const MultipoleField& f, double len, double P0, double q) :
+	field(f), scale(q * len * eV * SpeedOfLight / P0)
+{
+}
+
+} // end namespace Kernels
+} // end namespace ParticleTracking
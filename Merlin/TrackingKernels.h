@@ -0,0 +1,569 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#ifndef TrackingKernels_h
+#define TrackingKernels_h 1
+
+#include "merlin_config.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "ParticleBunch.h"
+#include "PSvectorColumns.h"
+#include "MultipoleField.h"
+#include "ParallelFor.h"
+#include "SimdDouble.h"
+
+namespace ParticleTracking
+{
+
+/**
+ *	Batched particle maps.
+ *
+ *	Each kernel is a functor templated on the value type, called as
+ *
+ *	    kernel(x, xp, y, yp, ct, dp)
+ *
+ *	where dp is read-only. The same kernel is used for the scalar
+ *	PSvector path (value type double) and for the column path
+ *	(value type SimdDouble, MERLIN_SIMD_WIDTH particles at a time), so
+ *	both give bit-identical results. The outputs enum lists the
+ *	coordinates a kernel writes, so the column path only stores those.
+ */
+namespace Kernels
+{
+
+#define KERNEL_OUT(c) (1 << (c))
+
+/**
+ *	Exact (symplectic) drift.
+ */
+struct DriftMap
+{
+	enum { outputs = KERNEL_OUT(ps_X) | KERNEL_OUT(ps_Y) | KERNEL_OUT(ps_CT) };
+
+	double ds;
+
+	DriftMap(double _ds) :
+		ds(_ds)
+	{
+	}
+
+	template<class T>
+	void operator()(T& x, T& xp, T& y, T& yp, T& ct, const T& dp) const
+	{
+		using std::sqrt;
+
+		T d1 = 1.0 + dp;
+		T k = sqrt(d1 * d1 - xp * xp - yp * yp);
+
+		x += xp * ds / k;
+		y += yp * ds / k;
+		ct += ds - d1 * ds / k;
+	}
+};
+
+/**
+ *	Paraxial (linear) drift, as used by the thin lens integrators.
+ */
+struct LinearDrift
+{
+	enum { outputs = KERNEL_OUT(ps_X) | KERNEL_OUT(ps_Y) };
+
+	double z;
+
+	LinearDrift(double len) :
+		z(len)
+	{
+	}
+
+	template<class T>
+	void operator()(T& x, T& xp, T& y, T& yp, T& ct, const T& dp) const
+	{
+		x += xp * z;
+		y += yp * z;
+	}
+};
+
+/**
+ *	Thin pole face rotation.
+ */
+struct PoleFaceRotation
+{
+	enum { outputs = KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_YP) };
+
+	double R10;
+	double R32;
+
+	PoleFaceRotation(double h, double theta, double fint, double hgap)
+	{
+		const double sinTheta = sin(theta);
+		const double phi = 2.0 * fint * hgap * h * (1 + sinTheta * sinTheta) / cos(theta);
+		R10 = h * tan(theta);
+		R32 = -h*tan(theta - phi);
+	}
+
+	template<class T>
+	void operator()(T& x, T& xp, T& y, T& yp, T& ct, const T& dp) const
+	{
+		xp += R10 * x;
+		yp += R32 * y;
+	}
+};
+
+/**
+ *	Sector bend with no quadrupole gradient.
+ */
+struct SectorBendMap
+{
+	enum { outputs = KERNEL_OUT(ps_X) | KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_Y) | KERNEL_OUT(ps_CT) };
+
+	double h, ds;
+
+	SectorBendMap(double _h, double _ds) :
+		h(_h), ds(_ds)
+	{
+	}
+
+	template<class T>
+	void operator()(T& x0, T& px0, T& y0, T& py0, T& ct0, const T& dp) const
+	{
+		using std::sqrt;
+		using std::sin;
+		using std::cos;
+
+		T d1 = 1.0 + dp;
+
+		T wx = sqrt(h * h / d1);
+
+		T xs = sin(wx * ds);
+		T xc = cos(wx * ds);
+		T xs2 = sin(2 * wx * ds);
+		T xc2 = cos(2 * wx * ds);
+
+		T x1 = x0 * xc + px0 * xs * wx / h / h + dp * (1.0 - xc) / h;
+		T px1 = -h * h * x0 * xs / wx + px0 * xc + dp * h * xs / wx;
+
+		T y1 = y0 + py0 * ds / d1;
+
+		T j2 = h * x0 - dp;
+
+		T c0 = -dp;
+		T c1 = -j2;
+		T c2 = -px0 / h;
+		T c3 = -px0 * px0 / d1 / d1 / 2.0;
+		T c4 = px0 * j2 / h / d1;
+		T c5 = -j2 * j2 / d1 / 2.0;
+		T c6 = -py0 * py0 / d1 / d1 / 2.0;
+
+		T ct1 = ct0
+			+ (2 * c0 + c3 + c5 + 2 * c6) * ds / 2.0
+			+ c1 * xs / wx + (c3 - c5) * xs2 / wx / 4.0
+			+ c2 * (1.0 - xc) + c4 * (1.0 - xc2) / 4.0;
+
+		x0 = x1;
+		px0 = px1;
+		y0 = y1;
+		ct0 = ct1;
+	}
+};
+
+/**
+ *	Sector bend with a quadrupole gradient.
+ */
+struct CombinedFunctionSectorBendMap
+{
+	enum { outputs = KERNEL_OUT(ps_X) | KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_Y) | KERNEL_OUT(ps_YP) | KERNEL_OUT(ps_CT) };
+
+	double h, k1, ds;
+
+	CombinedFunctionSectorBendMap(double _h, double _k1, double _ds) :
+		h(_h), k1(_k1), ds(_ds)
+	{
+	}
+
+	template<class T>
+	void operator()(T& x0, T& px0, T& y0, T& py0, T& ct0, const T& dp) const
+	{
+		using std::sqrt;
+		using std::fabs;
+		using std::sin;
+		using std::cos;
+		using std::sinh;
+		using std::cosh;
+
+		T xs, xc, ys, yc;
+		T xs2, xc2, ys2, yc2;
+
+		T dp1 = 1.0 + dp;
+
+		T wx = sqrt(fabs(h * h + k1) / dp1);
+		T wy = sqrt(fabs(k1) / dp1);
+
+		if((h * h + k1) > 0)
+		{
+			xs = sin(wx * ds);
+			xc = cos(wx * ds);
+			xs2 = sin(2 * wx * ds);
+			xc2 = cos(2 * wx * ds);
+		}
+		else
+		{
+			xs = sinh(wx * ds);
+			xc = cosh(wx * ds);
+			xs2 = sinh(2 * wx * ds);
+			xc2 = cosh(2 * wx * ds);
+		}
+
+		if(k1 > 0)
+		{
+			ys = sinh(wy * ds);
+			yc = cosh(wy * ds);
+			ys2 = sinh(2 * wy * ds);
+			yc2 = cosh(2 * wy * ds);
+		}
+		else
+		{
+			ys = sin(wy * ds);
+			yc = cos(wy * ds);
+			ys2 = sin(2 * wy * ds);
+			yc2 = cos(2 * wy * ds);
+		}
+
+		T x1, px1;
+
+		if((k1 + h * h) == 0)
+		{
+			x1 = x0 + px0 * ds / (1.0 + dp) + dp * h * ds * ds / (1.0 + dp) / 2.0;
+			px1 = px0 * xc + dp * h * ds;
+		}
+		else
+		{
+			x1 = x0 * xc + px0 * xs * wx / fabs(k1 + h * h) + dp * h * (1.0 - xc) / (k1 + h * h);
+			px1 = -(k1 + h * h) * x0 * xs / wx + px0 * xc + dp * h * xs / wx;
+		}
+
+		T y1 = y0 * yc + py0 * ys * wy / fabs(k1);
+		T py1 = k1 * y0 * ys / wy + py0 * yc;
+
+		double j1 = k1 + h * h;
+		T j2 = (j1 * x0 - h * dp);
+
+		T c0 = -h * h * dp / j1;
+		T c1 = h * h * dp / j1 - h * x0;
+		T c2 = -h * px0 / j1;
+		T c3 = -px0 * px0 / dp1 / dp1 / 2.0;
+		T c4 = px0 * j2 / j1 / dp1;
+		T c5 = -j2 * j2 / j1 / dp1 / 2.0;
+		T c6 = -py0 * py0 / dp1 / dp1 / 2.0;
+		T c7 = -y0 * py0 / dp1;
+		T c8 = -y0 * y0 * k1 / dp1 / 2.0;
+
+		T ct1 = ct0
+			+ (2 * c0 + c3 + c5 + c6 - c8) * ds / 2.0
+			+ c1 * xs / wx + (c3 - c5) * xs2 / wx / 4.0
+			+ c2 * (1.0 - xc) + c4 * (1.0 - xc2) / 4.0
+			+ (c6 + c8) * ys2 / wy / 4.0 - c7 * (1.0 - yc2) / 4.0;
+
+		x0 = x1;
+		px0 = px1;
+		y0 = y1;
+		py0 = py1;
+		ct0 = ct1;
+	}
+};
+
+/**
+ *	Thick quadrupole.
+ */
+struct QuadrupoleMap
+{
+	enum { outputs = KERNEL_OUT(ps_X) | KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_Y) | KERNEL_OUT(ps_YP) | KERNEL_OUT(ps_CT) };
+
+	double k1, ds;
+
+	QuadrupoleMap(double _k1, double _ds) :
+		k1(_k1), ds(_ds)
+	{
+	}
+
+	template<class T>
+	void operator()(T& x0, T& px0, T& y0, T& py0, T& ct0, const T& dp) const
+	{
+		using std::sqrt;
+		using std::fabs;
+		using std::sin;
+		using std::cos;
+		using std::sinh;
+		using std::cosh;
+
+		T dp1 = 1.0 + dp;
+		T w = sqrt(fabs(k1) / dp1);
+
+		T xs, xc, ys, yc;
+		T xs2, xc2, ys2, yc2;
+
+		if(k1 >= 0)
+		{
+			xs = sin(w * ds);
+			xc = cos(w * ds);
+			ys = sinh(w * ds);
+			yc = cosh(w * ds);
+			xs2 = sin(2 * w * ds);
+			xc2 = cos(2 * w * ds);
+			ys2 = sinh(2 * w * ds);
+			yc2 = cosh(2 * w * ds);
+		}
+		else
+		{
+			xs = sinh(w * ds);
+			xc = cosh(w * ds);
+			ys = sin(w * ds);
+			yc = cos(w * ds);
+			xs2 = sinh(2 * w * ds);
+			xc2 = cosh(2 * w * ds);
+			ys2 = sin(2 * w * ds);
+			yc2 = cos(2 * w * ds);
+		}
+
+		T x1 = x0 * xc + px0 * xs * w / fabs(k1);
+		T px1 = -k1 * x0 * xs / w + px0 * xc;
+
+		T y1 = y0 * yc + py0 * ys * w / fabs(k1);
+		T py1 = k1 * y0 * ys / w + py0 * yc;
+
+		T c3 = -px0 * px0 / dp1 / dp1 / 2.0;
+		T c4 = x0 * px0 / dp1;
+		T c5 = -x0 * x0 * k1 / dp1 / 2.0;
+		T c6 = -py0 * py0 / dp1 / dp1 / 2.0;
+		T c7 = -y0 * py0 / dp1;
+		T c8 = -y0 * y0 * k1 / dp1 / 2.0;
+
+		T ct1 = ct0
+			+ (c3 + c5 + c6 - c8) * ds / 2.0
+			+ (c3 - c5) * xs2 / w / 4.0
+			+ c4 * (1.0 - xc2) / 4.0
+			+ (c6 + c8) * ys2 / w / 4.0 - c7 * (1.0 - yc2) / 4.0;
+
+		x0 = x1;
+		px0 = px1;
+		y0 = y1;
+		py0 = py1;
+		ct0 = ct1;
+	}
+};
+
+/**
+ *	Evaluates a MultipoleField at (x,y) with the same sequence of
+ *	operations as MultipoleField::GetField2D(), so that the result is
+ *	bit-identical for any value type.
+ */
+class MultipoleFieldEvaluator
+{
+public:
+
+	explicit MultipoleFieldEvaluator(const MultipoleField& field)
+	{
+		null = field.IsNullField();
+		B0 = field.GetFieldScale();
+		if(!null)
+		{
+			for(int n = 0; n <= field.HighestMultipole(); n++)
+			{
+				bn.push_back(field.GetCoefficient(n).real());
+				an.push_back(field.GetCoefficient(n).imag());
+			}
+		}
+	}
+
+	/**
+	 *	Returns By + i Bx as (Br, Bi).
+	 */
+	template<class T>
+	void operator()(const T& x, const T& y, T& Br, T& Bi) const
+	{
+		if(null)
+		{
+			Br = 0.0;
+			Bi = 0.0;
+			return;
+		}
+
+		T zr = 1.0;
+		T zi = 0.0;
+		T sr = 0.0;
+		T si = 0.0;
+		for(size_t n = 0; n < bn.size(); n++)
+		{
+			sr += bn[n] * zr - an[n] * zi;
+			si += bn[n] * zi + an[n] * zr;
+			T tr = zr * x - zi * y;
+			zi = zr * y + zi * x;
+			zr = tr;
+		}
+		Br = B0 * sr;
+		Bi = B0 * si;
+	}
+
+private:
+	bool null;
+	double B0;
+	std::vector<double> bn;
+	std::vector<double> an;
+};
+
+/**
+ *	Integrated multipole kick with a complex scale factor (includes
+ *	the field rotation phi), as used by the symplectic integrators.
+ */
+struct MultipoleKick
+{
+	enum { outputs = KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_YP) };
+
+	MultipoleFieldEvaluator field;
+	double sr, si;
+
+	MultipoleKick(const MultipoleField& f, double ds, double P0, double q, double phi = 0);
+
+	template<class T>
+	void operator()(T& x, T& xp, T& y, T& yp, T& ct, const T& dp) const
+	{
+		T Br, Bi;
+		field(x, y, Br, Bi);
+		xp += -(sr * Br - si * Bi);
+		yp += sr * Bi + si * Br;
+	}
+};
+
+/**
+ *	Integrated multipole kick scaled by the particle momentum, as used
+ *	by the thin lens integrators.
+ */
+struct ThinMultipoleKick
+{
+	enum { outputs = KERNEL_OUT(ps_XP) | KERNEL_OUT(ps_YP) };
+
+	MultipoleFieldEvaluator field;
+	double scale;
+
+	ThinMultipoleKick(const MultipoleField& f, double len, double P0, double q);
+
+	template<class T>
+	void operator()(T& x, T& xp, T& y, T& yp, T& ct, const T& dp) const
+	{
+		T Br, Bi;
+		field(x, y, Br, Bi);
+		T d = 1 + dp;
+		xp += -(scale * Br / d);
+		yp += scale * Bi / d;
+	}
+};
+
+/**
+ *	Adaptor which applies a kernel to a single PSvector.
+ */
+template<class K>
+struct PSvectorKernel
+{
+	const K& k;
+
+	PSvectorKernel(const K& _k) :
+		k(_k)
+	{
+	}
+
+	void operator()(PSvector& v) const
+	{
+		k(v.x(), v.xp(), v.y(), v.yp(), v.ct(), v.dp());
+	}
+};
+
+/**
+ *	Apply kernel k to the particles [first, last) of columns c.
+ *	Particles are processed MERLIN_SIMD_WIDTH at a time, with any
+ *	remainder handled by the scalar instantiation of the kernel.
+ */
+template<class K>
+void Apply(PSvectorColumns& c, size_t first, size_t last, const K& k)
+{
+	double* x = c.x();
+	double* xp = c.xp();
+	double* y = c.y();
+	double* yp = c.yp();
+	double* ct = c.ct();
+	double* dp = c.dp();
+
+	const size_t w = SimdDouble::width;
+	size_t i = first;
+	for(; i + w <= last; i += w)
+	{
+		SimdDouble X = SimdDouble::Load(x + i);
+		SimdDouble XP = SimdDouble::Load(xp + i);
+		SimdDouble Y = SimdDouble::Load(y + i);
+		SimdDouble YP = SimdDouble::Load(yp + i);
+		SimdDouble CT = SimdDouble::Load(ct + i);
+		SimdDouble DP = SimdDouble::Load(dp + i);
+
+		k(X, XP, Y, YP, CT, DP);
+
+		if(K::outputs & KERNEL_OUT(ps_X))
+		{
+			X.Store(x + i);
+		}
+		if(K::outputs & KERNEL_OUT(ps_XP))
+		{
+			XP.Store(xp + i);
+		}
+		if(K::outputs & KERNEL_OUT(ps_Y))
+		{
+			Y.Store(y + i);
+		}
+		if(K::outputs & KERNEL_OUT(ps_YP))
+		{
+			YP.Store(yp + i);
+		}
+		if(K::outputs & KERNEL_OUT(ps_CT))
+		{
+			CT.Store(ct + i);
+		}
+	}
+	for(; i < last; i++)
+	{
+		k(x[i], xp[i], y[i], yp[i], ct[i], dp[i]);
+	}
+}
+
+template<class K>
+void Apply(PSvectorColumns& c, const K& k)
+{
+	Parallel::ForBlocks(c.size(), SimdDouble::width, [&c, &k](size_t first, size_t last)
+	{
+		Apply(c, first, last, k);
+	});
+}
+
+/**
+ *	Apply kernel k to every particle in the bunch, using the column
+ *	path if the bunch is in the structOfArrays layout.
+ */
+template<class K>
+void Apply(ParticleBunch* bunch, const K& k)
+{
+	if(bunch->GetStorageLayout() == ParticleBunch::structOfArrays)
+	{
+		Apply(bunch->GetColumns(), k);
+	}
+	else
+	{
+		Parallel::ForEach(bunch->begin(), bunch->end(), PSvectorKernel<K>(k));
+	}
+}
+
+} // end namespace Kernels
+} // end namespace ParticleTracking
+
+#endif
@@ -11,12 +11,37 @@
 using namespace std;
 using namespace ParticleTracking;
 
-TrackingOutputAV::TrackingOutputAV(const std::string& filename) :
+namespace
+{
+
+/*
+ * The text form of a record, one line per particle.
+ */
+void FormatRecord(std::ostream& os, const double* r)
+{
+	os << int(r[0]) << " "
+	   << unsigned(r[1]) << " "
+	   << std::fixed
+	   << r[2] << " "
+	   << std::scientific
+	   << r[3] << " "
+	   << r[4] << " "
+	   << r[5] << " "
+	   << r[6] << " "
+	   << r[7] << " "
+	   << std::fixed
+	   << int(r[8]) << " "
+	   << int(r[0]) << "\n";
+}
+
+} // end anonymous namespace
+
+TrackingOutputAV::TrackingOutputAV(const std::string& filename, bool binary) :
 	SimulationOutput(), current_s(0), suppress_unscattered(1), current_s_set(0), single_turn(1), turn_range_set(0),
 	s_range_set(0), turn_number(0)
 {
-	output_file = new std::ofstream(filename.c_str());
-	(*output_file) << "#id turn S x xp y yp dp type" << std::endl;
+	const std::vector<std::string> columns = {"id", "turn", "S", "x", "xp", "y", "yp", "dp", "type"};
+	writer = new AsyncOutputWriter(filename, columns, binary ? AsyncOutputWriter::Formatter() : FormatRecord);
 
 	// This sets a flag used in the TrackingSimulation class
 	output_all = 1;
@@ -24,8 +49,12 @@ TrackingOutputAV::TrackingOutputAV(const std::string& filename) :
 
 TrackingOutputAV::~TrackingOutputAV()
 {
-	output_file->close();
-	delete output_file;
+	delete writer;
+}
+
+void TrackingOutputAV::Flush()
+{
+	writer->Flush();
 }
 
 void TrackingOutputAV::Record(const ComponentFrame* frame, const Bunch* bunch)
@@ -69,28 +98,23 @@ void TrackingOutputAV::Record(const ComponentFrame* frame, const Bunch* bunch)
 		return;
 	}
 
-	string id = (*frame).GetComponent().GetQualifiedName();
-	double zComponent = frame->GetPosition() + frame->GetGeometryLength() / 2;
+	const double zComponent = frame->GetPosition() + frame->GetGeometryLength() / 2;
 
 	const ParticleBunch* PB = static_cast<const ParticleBunch*>(bunch);
 	for(ParticleBunch::const_iterator pb = PB->begin(); pb != PB->end(); pb++)
 	{
 		if((suppress_unscattered && pb->type() != -1) || (!suppress_unscattered))
 		{
-			(*output_file) << int(pb->id()) << " "
-						   << turn_number << " "
-						   << std::fixed
-						   << zComponent << " "
-			    //<< id << " "
-						   << std::scientific
-						   << pb->x() * 1e3  << " "
-						   << pb->xp() * 1e3  << " "
-						   << pb->y() * 1e3  << " "
-						   << pb->yp() * 1e3  << " "
-						   << pb->dp()  << " "
-						   << std::fixed
-						   << int(pb->type()) <<  " "
-						   << int(pb->id())  << endl;
+			double* r = writer->Append();
+			r[0] = pb->id();
+			r[1] = turn_number;
+			r[2] = zComponent;
+			r[3] = pb->x() * 1e3;
+			r[4] = pb->xp() * 1e3;
+			r[5] = pb->y() * 1e3;
+			r[6] = pb->yp() * 1e3;
+			r[7] = pb->dp();
+			r[8] = pb->type();
 		}
 	}
 
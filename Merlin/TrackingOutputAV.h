@@ -8,14 +8,26 @@
 #ifndef _h_TrackingOutputAV
 #define _h_TrackingOutputAV
 #include "TrackingSimulation.h"
-#include <fstream>
+#include "AsyncOutputWriter.h"
 
+/**
+ * Records the coordinates of each particle at each component. The
+ * coordinates are copied into the buffers of an AsyncOutputWriter and
+ * written to the file on a background thread, as text lines or, if
+ * binary is true, as binary blocks readable with
+ * AsyncOutputWriter::ReadBinary().
+ */
 class TrackingOutputAV: public SimulationOutput
 {
 public:
-	TrackingOutputAV(const std::string& filename);
+	TrackingOutputAV(const std::string& filename, bool binary = false);
 	~TrackingOutputAV();
 
+	/**
+	 * Waits until everything recorded so far is written to the file.
+	 */
+	void Flush();
+
 	/**
 	 * This allows us to refrain from outputting non scattered particles
 	 */
@@ -57,7 +69,7 @@ protected:
 	void RecordFinalBunch(const Bunch* bunch);
 
 private:
-	std::ofstream* output_file;
+	AsyncOutputWriter* writer;
 
 	unsigned int turn;
 	double start_s;
@@ -321,14 +321,10 @@ void SimulationOutput::AddIdentifier(const string& pattern, size_t nocc)
 
 void SimulationOutput::DoRecord(const ComponentFrame* frame, const Bunch* bunch)
 {
-	if(frame->IsComponent())
+	// the qualified name is only built if it is needed
+	if(frame->IsComponent() && (output_all || IsMember(frame->GetComponent().GetQualifiedName())))
 	{
-		string id = (*frame).GetComponent().GetQualifiedName();
-
-		if(output_all || IsMember(id))
-		{
-			Record(frame, bunch);
-		}
+		Record(frame, bunch);
 	}
 }
 
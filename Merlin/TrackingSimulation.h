@@ -183,6 +183,16 @@ public:
 		stepper.SetLogStream(nullptr);
 	}
 
+	/**
+	 * Apply particle local processes to tiles of n particles in a
+	 * single pass (see ProcessStepManager::SetTileSize()). n = 0
+	 * (default) disables fusing.
+	 */
+	void SetTileSize(size_t n)
+	{
+		stepper.SetTileSize(n);
+	}
+
 	/**
 	 * If handle==true, then any MerlinException thrown while
 	 * the simulation is running is handled locally, and Run()
@@ -12,11 +12,13 @@
 #include "ClosedOrbit.h"
 #include "TransferMatrix.h"
 #include "MatrixPrinter.h"
+#include "CompiledLattice.h"
+#include "TPSA.h"
 
 using namespace ParticleTracking;
 
 TransferMatrix::TransferMatrix(AcceleratorModel* aModel, double refMomentum) :
-	theModel(aModel), p0(refMomentum), radiation(false), obspnt(0), delta(1.0e-9), bendscale(0)
+	theModel(aModel), p0(refMomentum), radiation(false), obspnt(0), delta(1.0e-9), bendscale(0), useTPSA(false)
 {
 }
 
@@ -56,6 +58,52 @@ void TransferMatrix::ScaleBendPathLength(double scale)
 	bendscale = scale;
 }
 
+void TransferMatrix::UseTPSA(bool flag)
+{
+	useTPSA = flag;
+}
+
+template<class L>
+bool TransferMatrix::FindTMTPSA(L& lattice, RealMatrix& M, const PSvector& orbit)
+{
+	TPSA<1> x[6];
+	for(int k = 0; k < 6; k++)
+	{
+		x[k] = TPSA<1>::Variable(k, orbit[k]);
+	}
+	if(!lattice.TrackMap(x, p0, 1.0, bendscale))
+	{
+		return false;
+	}
+	for(int k = 0; k < 6; k++)
+		for(int m = 0; m < 6; m++)
+		{
+			M(m, k) = x[m].Derivative(k);
+		}
+	return true;
+}
+
+bool TransferMatrix::FindChromaticTM(RealMatrix& M, RealMatrix& dM, const PSvector& orbit)
+{
+	CompiledLattice lattice(theModel->GetRing(obspnt));
+	TPSA<2> x[6];
+	for(int k = 0; k < 6; k++)
+	{
+		x[k] = TPSA<2>::Variable(k, orbit[k]);
+	}
+	if(!lattice.TrackMap(x, p0, 1.0, bendscale))
+	{
+		return false;
+	}
+	for(int k = 0; k < 6; k++)
+		for(int m = 0; m < 6; m++)
+		{
+			M(m, k) = x[m].Derivative(k);
+			dM(m, k) = x[m].Derivative(k, ps_DP);
+		}
+	return true;
+}
+
 void TransferMatrix::FindTM(RealMatrix& M)
 {
 	PSvector p(0);
@@ -76,6 +124,7 @@ void TransferMatrix::FindTM(RealMatrix& M)
 		co.ScaleBendPathLength(bendscale);
 	}
 
+	co.UseTPSA(useTPSA);
 	co.FindClosedOrbit(p, obspnt);
 	FindTM(M, p);
 }
@@ -99,12 +148,22 @@ void TransferMatrix::FindClosedOrbitTM(RealMatrix& M, PSvector& orbit)
 		co.ScaleBendPathLength(bendscale);
 	}
 
+	co.UseTPSA(useTPSA);
 	co.FindClosedOrbit(orbit, obspnt);
 	FindTM(M, orbit);
 }
 
 void TransferMatrix::FindTM(RealMatrix& M, PSvector& orbit)
 {
+	if(useTPSA && !radiation)
+	{
+		CompiledLattice lattice(theModel->GetRing(obspnt));
+		if(FindTMTPSA(lattice, M, orbit))
+		{
+			return;
+		}
+	}
+
 	ParticleBunch bunch(p0, 1.0);
 	int k = 0;
 	for(k = 0; k < 7; k++)
@@ -165,6 +224,15 @@ void TransferMatrix::FindTM(RealMatrix& M, PSvector& orbit)
 
 void TransferMatrix::FindTM(RealMatrix& M, PSvector& orbit, int n1, int n2)
 {
+	if(useTPSA && !radiation)
+	{
+		CompiledLattice lattice(theModel->GetBeamline(n1, n2));
+		if(FindTMTPSA(lattice, M, orbit))
+		{
+			return;
+		}
+	}
+
 	ParticleBunch bunch(p0, 1.0);
 	int k = 0;
 	for(k = 0; k < 7; k++)
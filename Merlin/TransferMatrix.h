@@ -32,6 +32,23 @@ public:
 	void SetObservationPoint(int n);
 	void SetDelta(double new_delta);
 
+	/**
+	 * If true, the matrices (and the closed orbit) are found from a single
+	 * pass of a TPSA through a CompiledLattice instead of by tracking
+	 * displaced particles, so that delta is not used. Particle tracking is
+	 * still used with radiation, or if the lattice cannot be compiled.
+	 * Default false.
+	 */
+	void UseTPSA(bool flag);
+
+	/**
+	 * Find the one-turn matrix M about orbit, and its derivative dM with
+	 * respect to dp, from a single pass of a second-order TPSA.
+	 * @return false, leaving M and dM unchanged, if the ring cannot be
+	 * compiled.
+	 */
+	bool FindChromaticTM(RealMatrix& M, RealMatrix& dM, const PSvector& orbit);
+
 private:
 	AcceleratorModel* theModel;
 	double p0;
@@ -43,7 +60,10 @@ private:
 	double radstepsize;
 	int radnumsteps;
 	double bendscale;
+	bool useTPSA;
 
+	template<class L>
+	bool FindTMTPSA(L& lattice, RealMatrix& M, const PSvector& orbit);
 };
 
 #endif
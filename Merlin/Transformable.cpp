@@ -7,11 +7,13 @@
 
 #include <cassert>
 #include "Transformable.h"
+#include "ModelElement.h"
 
 // macro for transformations
 #define _TRNSFM(func) \
 	if(local_T) (*local_T) *= Transform3D::func; \
 	else local_T = new Transform3D(Transform3D::func); \
+	ModelElement::ModelChanged(); \
 	Invalidate();
 
 Transformable::~Transformable()
@@ -49,5 +51,6 @@ void Transformable::ClearTransform()
 		delete local_T;
 		local_T = nullptr;
 	}
+	ModelElement::ModelChanged();
 	Invalidate();
 }
@@ -52,176 +52,62 @@ namespace
 // tolerance for bend scaling
 #define REL_ENGY_TOL 1.0 - 06
 
-struct MultipoleKick
-{
-	const MultipoleField& field;
-	Complex scale;
-
-	MultipoleKick(const MultipoleField& f, double len, double P0, double q, double phi = 0) :
-		field(f)
-	{
-		//cout <<"apply multipolekick"<<endl;
-		scale = q * len * eV * SpeedOfLight / P0 * Complex(cos(phi), sin(phi));
-	}
-
-	void operator()(PSvector& v)
-	{
-		double x = v.x();
-		double y = v.y();
-		double dp = v.dp();
-		Complex F = scale * field.GetField2D(x, y) / (1 + dp);
-		v.xp() += -F.real();
-		v.yp() += F.imag();
-	}
-
-};
-
-// Apply a map without dp/p scaling
-struct ApplyMap
+inline bool operator==(const Complex& z, double x)
 {
-	RTMap* m;
-	ApplyMap(RTMap* amap) :
-		m(amap)
-	{
-	}
-	void operator()(PSvector& p)
-	{
-		m->Apply(p);
-	}
-
-};
+	return z.imag() == 0 && z.real() == x;
+}
 
-// Apply map with a dp/p scaling
-struct ApplyMap1
+inline bool operator!=(const Complex& z, double x)
 {
-	RTMap* m;
-	double Eratio;
-
-	ApplyMap1(RTMap* amap, double Er) :
-		m(amap), Eratio(Er)
-	{
-	}
-	void operator()(PSvector& p)
-	{
-		double dp = p.dp();
-		p.dp() = Eratio * (1 + dp) - 1;
-		m->Apply(p);
-		p.dp() = dp;
-	}
-
-};
+	return !(z == x);
+}
 
-struct ApplyDrift
+// the field scale and coefficients, for the map caches
+void AppendFieldState(const MultipoleField& field, std::vector<double>& state)
 {
-	const double s;
-	ApplyDrift(double len) :
-		s(len)
+	const int np = field.HighestMultipole();
+	state.push_back(field.GetFieldScale());
+	state.push_back(np);
+	for(int n = 0; n <= np; n++)
 	{
+		const Complex b = field.GetCoefficient(n);
+		state.push_back(b.real());
+		state.push_back(b.imag());
 	}
-	void operator()(PSvector& p)
-	{
-		const double xp = p.xp();
-		const double yp = p.yp();
-		p.x() += s * xp;
-		p.y() += s * yp;
-		p.ct() -= s * (xp * xp + yp * yp) / 2.0;
-	}
-
-};
+}
 
-// Functor ApplyRFdp (used for full acceleration)
-struct ApplyRFMap
+void AppendPoleFaceState(const SectorBend::PoleFace* pf, std::vector<double>& state)
 {
-
-	double Vn, k, phi0, cosPhi0, d0;
-	RTMap* m;
-	bool fullacc;
-
-	ApplyRFMap(double Vnorm, double f, double phase, RTMap* m1, bool full_acc) :
-		Vn(Vnorm), k(twoPi * f / SpeedOfLight), phi0(phase), m(m1), fullacc(full_acc)
-	{
-		cosPhi0 = cos(phi0);
-		d0 = 1 + Vn * cosPhi0;
-	}
-
-	void operator()(PSvector& p) const
+	if(pf)
 	{
-		m->Apply(p);
-		if(fullacc)
-		{
-			p.dp() = (p.dp() + Vn * (cos(phi0 - k * p.ct()) - cosPhi0)) / d0;
-		}
-		else
-		{
-			p.dp() += Vn * cos(phi0 - k * p.ct());
-		}
+		state.push_back(1);
+		state.push_back(pf->rot);
+		state.push_back(pf->fint);
+		state.push_back(pf->hgap);
+		state.push_back(pf->type);
 	}
-
-};
-
-inline void ApplyMapToBunch(ParticleBunch& bunch, RTMap* amap)
-{
-//Old method (and now MPI)
-#ifndef ENABLE_OPENMP
-	for_each(bunch.begin(), bunch.end(), ApplyMap(amap));
-#endif
-
-//OpenMP option
-#ifdef ENABLE_OPENMP
-	#pragma omp parallel for
-	for(size_t i = 0; i < bunch.size(); i++)
+	else
 	{
-		amap->Apply(bunch.GetParticles()[i]);
+		state.push_back(0);
 	}
-#endif
-}
-
-inline void ApplyMapToBunch(ParticleBunch& bunch, RTMap* amap, double Er)
-{
-	for_each(bunch.begin(), bunch.end(), ApplyMap1(amap, Er));
-}
-
-inline void ApplyDriftToBunch(ParticleBunch& bunch, double len)
-{
-	for_each(bunch.begin(), bunch.end(), ApplyDrift(len));
-}
-
-void RotateBunchAboutZ(ParticleBunch& bunch, double phi)
-{
-	RMtrx M(2);
-	TransportMatrix::Srot(phi, M.R);
-	M.Apply(bunch.GetParticles());
-}
-
-inline bool operator==(const Complex& z, double x)
-{
-	return z.imag() == 0 && z.real() == x;
-}
-
-inline bool operator!=(const Complex& z, double x)
-{
-	return !(z == x);
 }
 }
 
 namespace TRANSPORT
 {
 
-void DriftCI::TrackStep(double ds)
+void DriftCI::CompileStep(double ds, KernelSequence& seq)
 {
 	CHK_ZERO(ds);
-	RTMap* m = DriftTM(ds);
-	ApplyMapToBunch(*currentBunch, m);
-	delete m;
-	return;
+	seq.AddDriftMap(ds);
 }
 
-void SectorBendCI::TrackStep(double ds)
+void SectorBendCI::CompileStep(double ds, KernelSequence& seq)
 {
 	CHK_ZERO(ds);
 
 	double h = (*currentComponent).GetGeometry().GetCurvature();
-	MultipoleField& field = (*currentComponent).GetField();
+	const MultipoleField& field = (*currentComponent).GetField();
 	const double P0 = (*currentBunch).GetReferenceMomentum();
 	const double q = (*currentBunch).GetChargeSign();
 	const double Pref = (*currentComponent).GetMatchedMomentum(q);
@@ -237,79 +123,66 @@ void SectorBendCI::TrackStep(double ds)
 	// following is true
 	bool splitMagnet = b0.imag() != 0 || K1.imag() != 0 || np > 1;
 	double len = splitMagnet ? ds / 2.0 : ds;
+	bool scaled = !fequal(P0, Pref, REL_ENGY_TOL);
 
-	// Construct the second-order map
-	RTMap* M = (abs(K1) == 0) ? SectorBendTM(len, h) : GenSectorBendTM(len, h, K1.real(), 0);
-
-	if(fequal(P0, Pref, REL_ENGY_TOL))
+	// The second-order map for (each half of) the step
+	auto AddBodyMap = [&]()
 	{
-		ApplyMapToBunch(*currentBunch, M);
-	}
-	else
-	{
-		ApplyMapToBunch(*currentBunch, M, P0 / Pref);
-	}
+		RTMap* M = (abs(K1) == 0) ? SectorBendTM(len, h) : GenSectorBendTM(len, h, K1.real(), 0);
+		if(scaled)
+		{
+			seq.AddMap(M, P0 / Pref);
+		}
+		else
+		{
+			seq.AddMap(M);
+		}
+	};
+
+	AddBodyMap();
 
 	// Now if we have split the magnet, we need to
 	// apply the kick approximation, and then
 	// re-apply the map M
 	if(splitMagnet)
 	{
-
-		// First we set the real parts of the
-		// dipole and quad fields to zero, since these
-		// components have been modeled in the matrix
+		// The real parts of the dipole and quad fields are
+		// modeled in the matrix, so they are removed from the kick
+		MultipoleField kick(field);
 		Complex b1 = field.GetCoefficient(1);
-		field.SetCoefficient(0, Complex(0, b0.imag()));
-		field.SetCoefficient(1, Complex(0, b1.imag()));
+		kick.SetCoefficient(0, Complex(0, b0.imag()));
+		kick.SetCoefficient(1, Complex(0, b1.imag()));
 
 		// Apply the integrated kick, and then track
 		// through the linear second half
-		for_each((*currentBunch).begin(), (*currentBunch).end(), MultipoleKick(field, ds, P0, q));
-
-		if(fequal(P0, Pref, REL_ENGY_TOL))
-		{
-			ApplyMapToBunch(*currentBunch, M);
-		}
-		else
-		{
-			ApplyMapToBunch(*currentBunch, M, P0 / Pref);
-		}
-
-		// Remember to set the components back
-		field.SetCoefficient(0, b0);
-		field.SetCoefficient(1, b1);
+		seq.AddKick(kick, ds, P0, q);
+		AddBodyMap();
 	}
-
-	// must delete the map
-	delete M;
-	return;
-
 }
 
-void SectorBendCI::TrackEntrance()
+void SectorBendCI::CompileEntrance(KernelSequence& seq)
 {
 	const SectorBend::PoleFaceInfo& pfi = currentComponent->GetPoleFaceInfo();
 	double tilt = (*currentComponent).GetGeometry().GetTilt();
 	if(tilt != 0)
 	{
-		RotateBunchAboutZ(*currentBunch, -tilt);
+		seq.AddRotation(-tilt);
 	}
-	ApplyPoleFaceRotation(pfi.entrance);
+	CompilePoleFaceRotation(pfi.entrance, seq);
 }
 
-void SectorBendCI::TrackExit()
+void SectorBendCI::CompileExit(KernelSequence& seq)
 {
 	const SectorBend::PoleFaceInfo& pfi = currentComponent->GetPoleFaceInfo();
 	double tilt = (*currentComponent).GetGeometry().GetTilt();
-	ApplyPoleFaceRotation(pfi.exit);
+	CompilePoleFaceRotation(pfi.exit, seq);
 	if(tilt != 0)
 	{
-		RotateBunchAboutZ(*currentBunch, tilt);
+		seq.AddRotation(tilt);
 	}
 }
 
-void SectorBendCI::ApplyPoleFaceRotation(const SectorBend::PoleFace* pf)
+void SectorBendCI::CompilePoleFaceRotation(const SectorBend::PoleFace* pf, KernelSequence& seq)
 {
 #define _PFV(p, v) !(p) ? 0 : p->v;
 
@@ -324,12 +197,21 @@ void SectorBendCI::ApplyPoleFaceRotation(const SectorBend::PoleFace* pf)
 	double fint = _PFV(pf, fint);
 	double ent = _PFV(pf, type);
 
-	RTMap* M = PoleFaceTM(h, k, beta, c, fint, hg, ent);
-	ApplyMapToBunch(*currentBunch, M);
-	delete M;
+	seq.AddMap(PoleFaceTM(h, k, beta, c, fint, hg, ent));
 }
 
-void RectMultipoleCI::TrackStep(double ds)
+void SectorBendCI::GetMapState(std::vector<double>& state) const
+{
+	const SectorBend::PoleFaceInfo& pfi = currentComponent->GetPoleFaceInfo();
+	state.push_back(currentComponent->GetGeometry().GetCurvature());
+	state.push_back(currentComponent->GetGeometry().GetTilt());
+	state.push_back(currentComponent->GetMatchedMomentum(currentBunch->GetChargeSign()));
+	AppendFieldState(currentComponent->GetField(), state);
+	AppendPoleFaceState(pfi.entrance, state);
+	AppendPoleFaceState(pfi.exit, state);
+}
+
+void RectMultipoleCI::CompileStep(double ds, KernelSequence& seq)
 {
 	// Here we use a matrix to represent the quadrupole term, and a
 	// single kick at the centre of the element for the other multipoles,
@@ -339,7 +221,7 @@ void RectMultipoleCI::TrackStep(double ds)
 	double P0 = (*currentBunch).GetReferenceMomentum();
 	double q = (*currentBunch).GetChargeSign();
 	double brho = P0 / eV / SpeedOfLight;
-	MultipoleField& field = (*currentComponent).GetField();
+	const MultipoleField& field = (*currentComponent).GetField();
 
 	// we now support thin-lens kicks (this has been added to support
 	// thin-lens corrector dipoles)
@@ -347,7 +229,7 @@ void RectMultipoleCI::TrackStep(double ds)
 	if((*currentComponent).GetLength() == 0 && ds == 0 && !field.IsNullField())
 	{
 		// treat field as integrated strength
-		for_each((*currentBunch).begin(), (*currentBunch).end(), MultipoleKick(field, 1.0, P0, q));
+		seq.AddKick(field, 1.0, P0, q);
 		return;
 	}
 
@@ -383,24 +265,21 @@ void RectMultipoleCI::TrackStep(double ds)
 
 		if(!fequal(phi, 0))
 		{
-			RotateBunchAboutZ(*currentBunch, -phi);
+			seq.AddRotation(-phi);
 		}
 
-		RTMap* M = QuadrupoleTM(len, K1);
-		ApplyMapToBunch(*currentBunch, M);
+		seq.AddMap(QuadrupoleTM(len, K1));
 		if(splitMagnet)
 		{
-			Complex b1 = field.GetCoefficient(1);
-			field.SetCoefficient(1, Complex(0));
-			for_each((*currentBunch).begin(), (*currentBunch).end(), MultipoleKick(field, ds, P0, q, -phi));
+			MultipoleField kick(field);
+			kick.SetCoefficient(1, Complex(0));
+			seq.AddKick(kick, ds, P0, q, -phi);
 			// Apply second half of map
-			ApplyMapToBunch(*currentBunch, M);
-			field.SetCoefficient(1, b1);
+			seq.AddMap(QuadrupoleTM(len, K1));
 		}
-		delete M;
 		if(!fequal(phi, 0))
 		{
-			RotateBunchAboutZ(*currentBunch, phi);
+			seq.AddRotation(phi);
 		}
 	}
 	else if(cK2 != 0.0)   // sextupole R+T matrix with thin-lens kicks for other multipoles
@@ -420,38 +299,39 @@ void RectMultipoleCI::TrackStep(double ds)
 
 		if(!fequal(phi, 0))
 		{
-			RotateBunchAboutZ(*currentBunch, -phi);
+			seq.AddRotation(-phi);
 		}
 
-		RTMap* M = SextupoleTM(len, K2);
-		ApplyMapToBunch(*currentBunch, M);
+		seq.AddMap(SextupoleTM(len, K2));
 		if(splitMagnet)
 		{
-			Complex b2 = field.GetCoefficient(2);
-			field.SetCoefficient(2, Complex(0));
-			for_each((*currentBunch).begin(), (*currentBunch).end(), MultipoleKick(field, ds, P0, q, -phi));
+			MultipoleField kick(field);
+			kick.SetCoefficient(2, Complex(0));
+			seq.AddKick(kick, ds, P0, q, -phi);
 			// Apply second half of map
-			ApplyMapToBunch(*currentBunch, M);
-			field.SetCoefficient(2, b2);
+			seq.AddMap(SextupoleTM(len, K2));
 		}
-		delete M;
 		if(!fequal(phi, 0))
 		{
-			RotateBunchAboutZ(*currentBunch, phi);
+			seq.AddRotation(phi);
 		}
 	}
 	else   // drift with a kick in the middle
 	{
-		ApplyDriftToBunch(*currentBunch, len);
+		seq.AddDrift(len);
 		if(splitMagnet)
 		{
-			for_each((*currentBunch).begin(), (*currentBunch).end(), MultipoleKick(field, ds, P0, q));
+			seq.AddKick(field, ds, P0, q);
 			// Apply second half of map
-			ApplyDriftToBunch(*currentBunch, len);
+			seq.AddDrift(len);
 		}
 	}
+}
 
-	return;
+void RectMultipoleCI::GetMapState(std::vector<double>& state) const
+{
+	state.push_back(currentComponent->GetLength());
+	AppendFieldState(currentComponent->GetField(), state);
 }
 
 } // end of namespace TRANSPORT
@@ -211,7 +211,6 @@ void WakeFieldProcess::DoProcess(double ds)
 	current_s += ds;
 	if(fequal(current_s, impulse_s))
 	{
-		currentBunch->SortByCT();
 		Init();
 		ApplyWakefield(clen);
 		active = false;
@@ -225,7 +224,6 @@ void WakeFieldProcess::DoProcess(double ds)
 		currentBunch->gather();
 		if(currentBunch->MPI_rank == 0)
 		{
-			currentBunch->SortByCT();
 			Init();
 			ApplyWakefield(clen);
 		}
@@ -332,7 +330,8 @@ void WakeFieldProcess::Init()
 
 void WakeFieldProcess::CalculateWakeL()
 {
-	wake_z = vector<double>(bunchSlices.size(), 0.0);
+	const size_t n = bunchSlices.size();
+	wake_z = vector<double>(n, 0.0);
 	double a0 = dz * fabs(currentBunch->GetTotalCharge()) * ElectronCharge * Volt;
 
 	// Estimate the bunch wake at the slice boundaries by
@@ -347,28 +346,40 @@ void WakeFieldProcess::CalculateWakeL()
 	// 2) amplitude of wake depends on slope of charge distribution
 	//    rather than directly on the distribution
 	// Code to handle CSR wake added by A.Wolski 12/2/2003
+	//
+	// The wake is sampled once for each slice separation, and the
+	// sums over slices are done by SampledWake.
 
+	const WakePotentials* wake = currentWake;
+	vector<double> q(n, 0.0);
 	if(currentWake->Is_CSR())
 	{
-		for(size_t i = 0; i < bunchSlices.size(); i++)
+		// slices j = 1 .. i - 1 behind slice i, at (j - i + 0.5) dz
+		SampledWake& w = GetSampledWake(wake, csrWake);
+		w.Sample([wake](double z)
 		{
-			for(size_t j = 1; j < i; j++)
-			{
-				wake_z[i] += Qdp[j] * (currentWake->Wlong((j - i + 0.5) * dz)) / dz;
-			}
-			wake_z[i] *= a0;
+			return z > 0 ? 0 : wake->Wlong(z);
+		}, n, -dz, -0.5);
+		for(size_t j = 1; j < n - 1; j++)
+		{
+			q[j] = Qdp[j];
 		}
+		w.Convolve(q.data(), dz, wake_z.data());
 	}
 	else
 	{
-		for(size_t i = 0; i < bunchSlices.size(); i++)
+		// slices j = i .. nbins - 1 ahead of slice i, at (j - i + 0.5) dz
+		SampledWake& w = GetSampledWake(wake, longWake);
+		w.Sample([wake](double z)
 		{
-			for(size_t j = i; j < bunchSlices.size() - 1; j++)
-			{
-				wake_z[i] += Qd[j] * (currentWake->Wlong((j - i + 0.5) * dz));
-			}
-			wake_z[i] *= a0;
-		}
+			return wake->Wlong(z);
+		}, n, dz, 0.5);
+		std::copy(Qd.begin(), Qd.end(), q.begin());
+		w.Correlate(q.data(), wake_z.data());
+	}
+	for(size_t i = 0; i < n; i++)
+	{
+		wake_z[i] *= a0;
 	}
 
 #ifndef NDEBUG
@@ -381,38 +392,48 @@ void WakeFieldProcess::CalculateWakeL()
 
 void WakeFieldProcess::CalculateWakeT()
 {
-	// This routine is rather cpu intensive.
 	// First, calculate the transverse centroid of
 	// each bunch slice by taking the mean of the
 	// particle positions
 
-	vector<Point2D> xyc;
-	xyc.reserve(nbins);
-	size_t i;
-	for(i = 0; i < nbins; i++)
+	const size_t n = bunchSlices.size();
+	vector<double> q(n, 0.0);
+	vector<double> xc(n, 0.0);
+	vector<double> yc(n, 0.0);
+	for(size_t i = 0; i < nbins; i++)
 	{
-		xyc.push_back(GetSliceCentroid(bunchSlices[i], bunchSlices[i + 1]));
+		Point2D c = GetSliceCentroid(bunchSlices[i], bunchSlices[i + 1]);
+		q[i] = Qd[i];
+		xc[i] = c.x;
+		yc[i] = c.y;
 	}
 
 	// Now estimate the transverse bunch wake at the slice
 	// boundaries in the same way we did for the longitudinal wake.
 
 	double a0 = dz * (fabs(currentBunch->GetTotalCharge())) * ElectronCharge * Volt;
-	wake_x = vector<double>(bunchSlices.size(), 0.0);
-	wake_y = vector<double>(bunchSlices.size(), 0.0);
-	for(i = 0; i < bunchSlices.size(); i++)
+	wake_x = vector<double>(n, 0.0);
+	wake_y = vector<double>(n, 0.0);
+
+	const WakePotentials* wake = currentWake;
+	SampledWake& w = GetSampledWake(wake, transWake);
+	w.Sample([wake](double z)
+	{
+		return wake->Wtrans(z);
+	}, n, dz, 0.5);
+	w.Correlate(q.data(), xc.data(), wake_x.data(), yc.data(), wake_y.data());
+	for(size_t i = 0; i < n; i++)
 	{
-		for(size_t j = i; j < bunchSlices.size() - 1; j++)
-		{
-			double wxy = Qd[j] * (currentWake->Wtrans((j - i + 0.5) * dz));
-			wake_x[i] += wxy * xyc[j].x;
-			wake_y[i] += wxy * xyc[j].y;
-		}
 		wake_x[i] *= a0;
 		wake_y[i] *= a0;
 	}
 }
 
+SampledWake& WakeFieldProcess::GetSampledWake(const WakePotentials* wake, WakeKind kind, int mode)
+{
+	return sampledWakes[std::make_tuple(wake, int(kind), mode)];
+}
+
 void WakeFieldProcess::DumpSliceCentroids(ostream& os) const
 {
 	for(size_t i = 0; i < nbins; i++)
@@ -427,6 +448,7 @@ void WakeFieldProcess::InitialiseProcess(Bunch& bunch)
 	ParticleBunchProcess::InitialiseProcess(bunch);
 	currentWake = nullptr;
 	recalc = true;
+	sampledWakes.clear();
 }
 
 // Calculate the Savitsky-Golay smoothing filter
@@ -12,12 +12,15 @@
 #include <time.h>
 #endif
 
+#include <map>
+#include <tuple>
 #include <vector>
 #include <typeinfo>
 
 #include "WakePotentials.h"
 #include "ParticleBunchProcess.h"
 #include "StringPattern.h"
+#include "SampledWake.h"
 
 class WakePotentials;
 
@@ -81,6 +84,25 @@ protected:
 	virtual void CalculateWakeT();
 	virtual void ApplyWakefield(double ds);
 
+	/**
+	 *	The kinds of sampled wake held for each wake potential.
+	 */
+	enum WakeKind
+	{
+		longWake,
+		transWake,
+		csrWake
+
+	};
+
+	/**
+	 *	@return The samples of a wake function of wake, of the given kind
+	 *	and mode, kept from earlier steps. The caller samples the function
+	 *	with SampledWake::Sample(), which does nothing if the slices have
+	 *	not changed.
+	 */
+	SampledWake& GetSampledWake(const WakePotentials* wake, WakeKind kind, int mode = 0);
+
 	WakePotentials* currentWake;
 
 	std::vector<ParticleBunch::iterator> bunchSlices;
@@ -97,6 +119,8 @@ protected:
 
 	size_t oldBunchLen;
 
+	std::map<std::tuple<const WakePotentials*, int, int>, SampledWake> sampledWakes;
+
 private:
 	//Copy protection
 	WakeFieldProcess(const WakeFieldProcess& rhs);
@@ -7,10 +7,12 @@
 
 #include "../tests.h"
 #include <iostream>
+#include <limits>
 
 #include "InterpolatedApertures.h"
 #include "Aperture.h"
 #include "CollimatorAperture.h"
+#include "RandomNG.h"
 
 void testCollimatorAperture()
 {
@@ -96,10 +98,157 @@ void testInterpolatedApertureFactory()
 	assert(apInt->getType() == "RECTELLIPSEinterpolated");
 }
 
+void testBatchCheck()
+{
+	ApertureFactory factory;
+	vector<Aperture*> apertures;
+	for(string type : {"CIRCLE", "RECTANGLE", "ELLIPSE", "RECTELLIPSE"})
+	{
+		apertures.push_back(factory.getInstance(type, 0, 0.02, 0.015, 0.022, 0.018));
+	}
+	apertures.push_back(factory.getInstance("OCTAGON", 0, 0.02, 0.015, 0.4, 1.2));
+	apertures.push_back(new CollimatorAperture(0.03, 0.02, 0.3, 1.0, 0, 0));
+	CollimatorAperture* tapered = new CollimatorAperture(0.03, 0.02, 0.3, 1.0, 0.001, -0.002);
+	tapered->SetExitWidth(0.025);
+	tapered->SetExitHeight(0.028);
+	tapered->SetExitXOffset(0.002);
+	apertures.push_back(tapered);
+	apertures.push_back(new OneSidedUnalignedCollimatorAperture(0.03, 0.02, 0.3, 1.0, 0.001, 0, true));
+
+	RandomNG::init(12);
+	const size_t n = 1001;
+	vector<double> x(n), y(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		x[i] = RandomNG::uniform(-0.03, 0.03);
+		y[i] = RandomNG::uniform(-0.03, 0.03);
+	}
+
+	// NaN coordinates, which the particle by particle checks of most
+	// apertures leave inside for NANCheckProcess
+	const double nan = numeric_limits<double>::quiet_NaN();
+	x[10] = nan;
+	y[20] = nan;
+	x[30] = y[30] = nan;
+
+	// the batch check must agree exactly with the particle by particle check
+	for(Aperture* ap : apertures)
+	{
+		for(double z : {0.0, 0.4})
+		{
+			vector<char> inside(n);
+			size_t count = ap->CheckBatchWithinApertureBoundaries(x.data(), y.data(), z, n, inside.data());
+			size_t expected = 0;
+			for(size_t i = 0; i < n; i++)
+			{
+				bool in = ap->CheckWithinApertureBoundaries(x[i], y[i], z);
+				assert(bool(inside[i]) == in);
+				expected += in;
+			}
+			assert(count == expected);
+			assert(count > 0 && count < n);
+		}
+		delete ap;
+	}
+}
+
+/*
+ * Interpolate by scanning for the bracketing apertures, as done before the
+ * intervals were precomputed
+ */
+bool ReferenceInterpolatedCheck(const vector<Aperture*>& aps, double x, double y, double z)
+{
+	Aperture* apBack = aps[aps.size() - 2];
+	Aperture* apFront = aps.back();
+	for(size_t n = 1; n < aps.size(); n++)
+	{
+		if(aps[n]->getSlongitudinal() >= z)
+		{
+			apFront = aps[n];
+			apBack = aps[n - 1];
+			break;
+		}
+	}
+	double ax = fabs(x), ay = fabs(y);
+	if(ax + ay < min({apFront->getRectHalfWidth(), apFront->getRectHalfHeight(), apFront->getEllipHalfWidth(),
+					  apFront->getEllipHalfHeight(), apBack->getRectHalfWidth(), apBack->getRectHalfHeight(),
+					  apBack->getEllipHalfWidth(), apBack->getEllipHalfHeight()}))
+		return true;
+	double ds = apFront->getSlongitudinal() - apBack->getSlongitudinal();
+	double d = apFront->getSlongitudinal() - z;
+	double rw = apFront->getRectHalfWidth() - (((apFront->getRectHalfWidth() - apBack->getRectHalfWidth()) / ds) * d);
+	double rh = apFront->getRectHalfHeight() - (((apFront->getRectHalfHeight() - apBack->getRectHalfHeight()) / ds)
+		* d);
+	double ew = apFront->getEllipHalfWidth() - (((apFront->getEllipHalfWidth() - apBack->getEllipHalfWidth()) / ds) * d);
+	double eh = apFront->getEllipHalfHeight() - (((apFront->getEllipHalfHeight() - apBack->getEllipHalfHeight()) / ds)
+		* d);
+	if(ax + ay < min({rw, rh, ew, eh}))
+		return true;
+	if(((x * x) / (ew * ew)) + ((y * y) / (eh * eh)) > 1)
+		return false;
+	return !(ax > rw || ay > rh);
+}
+
+void testInterpolatedAperture()
+{
+	ApertureFactory factory;
+	InterpolatorFactory intfactory;
+	RandomNG::init(13);
+
+	// unequal then equal spacing
+	for(double spacing : {0.0, 0.5})
+	{
+		vector<Aperture*> aps;
+		double s = 0;
+		for(int k = 0; k < 12; k++)
+		{
+			double a = 0.02 + 0.004 * sin(k);
+			aps.push_back(factory.getInstance("RECTELLIPSE", s, a, 0.9 * a, 1.05 * a, a));
+			s += spacing > 0 ? spacing : 0.1 + 0.3 * (k % 3);
+		}
+		Aperture* ap = intfactory.getInstance(aps);
+
+		const size_t n = 500;
+		vector<double> x(n), y(n);
+		vector<char> inside(n);
+		for(int step = 0; step < 200; step++)
+		{
+			double z = RandomNG::uniform(0, aps.back()->getSlongitudinal());
+			if(step % 20 == 0)
+			{
+				// exactly on an aperture
+				z = aps[step / 20 + 1]->getSlongitudinal();
+			}
+			for(size_t i = 0; i < n; i++)
+			{
+				x[i] = RandomNG::uniform(-0.03, 0.03);
+				y[i] = RandomNG::uniform(-0.03, 0.03);
+			}
+			size_t count = ap->CheckBatchWithinApertureBoundaries(x.data(), y.data(), z, n, inside.data());
+			size_t expected = 0;
+			for(size_t i = 0; i < n; i++)
+			{
+				bool in = ReferenceInterpolatedCheck(aps, x[i], y[i], z);
+				assert(ap->CheckWithinApertureBoundaries(x[i], y[i], z) == in);
+				assert(bool(inside[i]) == in);
+				expected += in;
+			}
+			assert(count == expected);
+		}
+		delete ap;
+		for(Aperture* a : aps)
+		{
+			delete a;
+		}
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	testApertureFactory();
 	testInterpolatedApertureFactory();
 	testCollimatorAperture();
+	testBatchCheck();
+	testInterpolatedAperture();
 	cout << "all aperture tests successful" << endl;
 }
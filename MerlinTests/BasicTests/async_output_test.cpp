@@ -0,0 +1,113 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "AsyncOutputWriter.h"
+
+/*
+ * Write records through AsyncOutputWriter with blocks much smaller than
+ * the output, so that the ring wraps many times, and check the binary and
+ * text files against the records.
+ */
+
+using namespace std;
+
+namespace
+{
+
+const char* file = "async_output_test.out";
+const vector<string> columns = {"n", "a", "b"};
+
+void Fill(double* r, size_t i)
+{
+	r[0] = i;
+	r[1] = sin(0.1 * i);
+	r[2] = exp(-1e-4 * i);
+}
+
+void Format(ostream& os, const double* r)
+{
+	os << int(r[0]) << " " << scientific << setprecision(10) << r[1] << " " << r[2] << "\n";
+}
+
+void TestBinary(size_t nrec)
+{
+	{
+		AsyncOutputWriter writer(file, columns, AsyncOutputWriter::Formatter(), 100, 3);
+		assert(writer.Width() == 3);
+		for(size_t i = 0; i < nrec / 2; i++)
+		{
+			Fill(writer.Append(), i);
+		}
+
+		// everything so far is in the file after a flush
+		writer.Flush();
+		vector<string> names;
+		vector<double> records;
+		assert(AsyncOutputWriter::ReadBinary(file, names, records));
+		assert(records.size() == 3 * (nrec / 2));
+
+		for(size_t i = nrec / 2; i < nrec; i++)
+		{
+			Fill(writer.Append(), i);
+		}
+	}
+
+	vector<string> names;
+	vector<double> records;
+	assert(AsyncOutputWriter::ReadBinary(file, names, records));
+	assert(names == columns);
+	assert(records.size() == 3 * nrec);
+	for(size_t i = 0; i < nrec; i++)
+	{
+		double r[3];
+		Fill(r, i);
+		assert(records[3 * i] == r[0] && records[3 * i + 1] == r[1] && records[3 * i + 2] == r[2]);
+	}
+}
+
+void TestText(size_t nrec)
+{
+	ostringstream expected;
+	expected << "#n a b" << endl;
+	{
+		AsyncOutputWriter writer(file, columns, Format, 64);
+		for(size_t i = 0; i < nrec; i++)
+		{
+			double* r = writer.Append();
+			Fill(r, i);
+			Format(expected, r);
+		}
+	}
+
+	ifstream in(file);
+	ostringstream text;
+	text << in.rdbuf();
+	assert(text.str() == expected.str());
+
+	vector<string> names;
+	vector<double> records;
+	assert(!AsyncOutputWriter::ReadBinary(file, names, records));
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	TestBinary(10007);
+	TestBinary(0);
+	TestText(5003);
+	remove(file);
+	return 0;
+}
@@ -5,12 +5,153 @@
  * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
  */
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
 #include <sstream>
 #include "../tests.h"
+#include "MerlinException.h"
 #include "ParticleBunchTypes.h"
 
 using namespace std;
 
+namespace
+{
+
+const char* binfile = "bunch_io_test.bin";
+
+ParticleBunch* MakeBunch(size_t npart)
+{
+	ParticleBunch* bunch = new ParticleBunch(450.0, 1.1e11 / npart);
+	bunch->SetReferenceTime(12.5);
+	for(size_t i = 0; i < npart; i++)
+	{
+		Particle p(0);
+		for(int k = 0; k < 6; k++)
+		{
+			p[k] = sin(1.0 + i + 7.3 * k) * pow(10.0, -k);
+		}
+		p.type() = i % 3;
+		p.location() = 0.5 * i;
+		p.id() = i;
+		p.sd() = 1e-3 * i;
+		bunch->AddParticle(p);
+	}
+	return bunch;
+}
+
+void CheckSame(const ParticleBunch& b1, const ParticleBunch& b2)
+{
+	assert(b1.size() == b2.size());
+	assert(b1.GetReferenceMomentum() == b2.GetReferenceMomentum());
+	assert(b1.GetReferenceTime() == b2.GetReferenceTime());
+	assert(b1.GetChargeSign() == b2.GetChargeSign());
+	assert(b1.GetTotalCharge() == b2.GetTotalCharge());
+	for(size_t i = 0; i < b1.size(); i++)
+	{
+		assert(b1.GetParticles()[i] == b2.GetParticles()[i]);
+		assert(b1.GetParticles()[i].id() == b2.GetParticles()[i].id());
+		assert(b1.GetParticles()[i].sd() == b2.GetParticles()[i].sd());
+	}
+}
+
+/*
+ * Binary round trips from both storage layouts, with chunks smaller than
+ * the bunch, and conversion to and from the text format.
+ */
+void TestBinary()
+{
+	ParticleBunch* b1 = MakeBunch(1000);
+	ParticleBunch b2(1.0);
+
+	b1->OutputBinary(binfile, 7);
+	b2.InputBinary(binfile);
+	CheckSame(*b1, b2);
+
+	b1->GetColumns();
+	b1->OutputBinary(binfile, 64);
+	b2.InputBinary(binfile);
+	b2.SetStorageLayout(ParticleBunch::structOfArrays);
+	assert(b2.GetColumns().size() == 1000);
+	CheckSame(*b1, b2);
+
+	// the converter gives the same text as Output
+	ostringstream text, converted;
+	b1->Output(text);
+	ParticleBunch::BinaryToText(binfile, converted);
+	assert(text.str() == converted.str());
+
+	// the text format keeps the coordinates exactly, but not the tags
+	istringstream in(text.str());
+	ParticleBunch::TextToBinary(in, b1->GetTotalCharge(), binfile);
+	ParticleBunch b3(1.0);
+	b3.InputBinary(binfile);
+	assert(b3.size() == b1->size());
+	assert(b3.GetReferenceMomentum() == b1->GetReferenceMomentum());
+	assert(b3.GetReferenceTime() == b1->GetReferenceTime());
+	for(size_t i = 0; i < b3.size(); i++)
+	{
+		for(int k = 0; k < 6; k++)
+		{
+			assert(b3.GetParticles()[i][k] == b1->GetParticles()[i][k]);
+		}
+	}
+
+	// an empty bunch
+	ParticleBunch empty(1.0);
+	empty.OutputBinary(binfile);
+	b3.InputBinary(binfile);
+	assert(b3.size() == 0);
+
+	// anything else is rejected
+	{
+		ofstream bad(binfile);
+		bad << text.str();
+	}
+	bool thrown = false;
+	try
+	{
+		b3.InputBinary(binfile);
+	}
+	catch(MerlinException& e)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	delete b1;
+	remove(binfile);
+}
+
+void TestThroughput()
+{
+	typedef chrono::steady_clock clock;
+	const size_t npart = 200000;
+	ParticleBunch* b1 = MakeBunch(npart);
+	ParticleBunch b2(1.0);
+
+	clock::time_point t0 = clock::now();
+	stringstream text;
+	b1->Output(text);
+	b2.Input(1, text);
+	clock::time_point t1 = clock::now();
+	b1->OutputBinary(binfile);
+	b2.InputBinary(binfile);
+	b2.GetParticles();
+	clock::time_point t2 = clock::now();
+
+	const double ttext = chrono::duration<double>(t1 - t0).count();
+	const double tbin = chrono::duration<double>(t2 - t1).count();
+	cout << npart << " particles written and read: text " << ttext << " s, binary " << tbin << " s" << endl;
+	assert(tbin < ttext);
+
+	delete b1;
+	remove(binfile);
+}
+
+} // end anonymous namespace
+
 int main(int argc, char* argv[])
 {
 	double beam_mom = 100;
@@ -57,5 +198,8 @@ int main(int argc, char* argv[])
 
 	delete b1;
 	delete b2;
+
+	TestBinary();
+	TestThroughput();
 	return 0;
 }
@@ -6,8 +6,12 @@
  */
 
 #include <iostream>
+#include <cstring>
+#include <thread>
 #include "../tests.h"
 #include "ParticleBunchTypes.h"
+#include "ParallelFor.h"
+#include "SpinParticleProcess.h"
 
 using namespace std;
 
@@ -29,6 +33,222 @@ int main(int argc, char* argv[])
 	assert(myBunch_p->size() == 1);
 	assert(myBunch_p->FirstParticle().x() == 1);
 
+	// Column (structure-of-arrays) storage
+	for(int i = 1; i < 10; i++)
+	{
+		Particle q(0);
+		q.x() = i;
+		q.dp() = 0.1 * i;
+		q.id() = i;
+		myBunch_p->AddParticle(q);
+	}
+	myBunch_p->SetStorageLayout(ParticleBunch::structOfArrays);
+	PSvectorColumns& cols = myBunch_p->GetColumns();
+	assert(cols.size() == 10);
+	assert(myBunch_p->size() == 10);
+	assert(cols.x()[3] == 3);
+	assert(cols[4].id() == 4);
+	for(PSvectorColumns::iterator c = cols.begin(); c != cols.end(); c++)
+	{
+		c->x() += 1;
+	}
+	cols.dp()[2] = 0.5;
+
+	// access through the PSvector view transposes back
+	assert(myBunch_p->FirstParticle().x() == 2);
+	assert((myBunch_p->begin() + 2)->dp() == 0.5);
+	assert((myBunch_p->begin() + 9)->id() == 9);
+	(myBunch_p->begin() + 5)->y() = 7;
+	assert(myBunch_p->GetColumns().y()[5] == 7);
+	assert(PSvector(myBunch_p->GetColumns()[5]) == *(myBunch_p->begin() + 5));
+
+	// Partition into slices of ct, with the particles outside the
+	// range removed, and the spin vectors kept with their particles
+	SpinParticleBunch spinBunch(beam_mom, charge);
+	for(int i = 0; i < 1000; i++)
+	{
+		Particle q(0);
+		q.ct() = ((i * 7919) % 1000) * 0.001 - 0.1;
+		q.id() = i;
+		spinBunch.AddParticle(q, SpinVector(0, 0, q.ct()));
+	}
+	vector<size_t> counts;
+	size_t lost = spinBunch.PartitionByCT(0, 0.8, 10, counts);
+	assert(lost == 200);
+	assert(spinBunch.size() == 800);
+	assert(counts.size() == 10);
+
+	ParticleBunch::iterator q = spinBunch.begin();
+	SpinVectorArray::iterator sv = spinBunch.beginSpinArray();
+	for(size_t n = 0; n < counts.size(); n++)
+	{
+		for(size_t k = 0; k < counts[n]; k++, q++, sv++)
+		{
+			assert(q->ct() >= 0.08 * n - 1e-12 && q->ct() < 0.08 * (n + 1) + 1e-12);
+			assert(sv->z() == q->ct());
+		}
+	}
+	assert(q == spinBunch.end());
+
+	spinBunch.SortByCT();
+	sv = spinBunch.beginSpinArray();
+	for(q = spinBunch.begin(); q != spinBunch.end(); q++, sv++)
+	{
+		assert(q == spinBunch.begin() || (q - 1)->ct() <= q->ct());
+		assert(sv->z() == q->ct());
+	}
+
+	// Remove in place, keeping the order of the survivors and of the
+	// lost particles, and the spins of the survivors
+	PSvectorArray removed;
+	const size_t nspin = spinBunch.size();
+	size_t nremoved = spinBunch.RemoveIf([](const Particle& p)
+	{
+		return int(p.id()) % 3 == 0;
+	}, &removed);
+	assert(nremoved == removed.size());
+	assert(spinBunch.size() + nremoved == nspin);
+	sv = spinBunch.beginSpinArray();
+	for(q = spinBunch.begin(); q != spinBunch.end(); q++, sv++)
+	{
+		assert(int(q->id()) % 3 != 0);
+		assert(q == spinBunch.begin() || (q - 1)->ct() <= q->ct());
+		assert(sv->z() == q->ct());
+	}
+	for(size_t k = 0; k < removed.size(); k++)
+	{
+		assert(int(removed[k].id()) % 3 == 0);
+		assert(k == 0 || removed[k - 1].ct() <= removed[k].ct());
+	}
+
+	// Moments about a large offset, against a two-pass sum in long double,
+	// and merged from two halves
+	ParticleBunch offsetBunch(beam_mom, charge);
+	for(int i = 0; i < 10000; i++)
+	{
+		Particle q(0);
+		q.x() = 1e6 + 1e-3 * sin(0.37 * i);
+		q.y() = 1e-3 * ((i * 7919) % 10000) / 10000.0 + 0.1 * q.x();
+		offsetBunch.AddParticle(q);
+	}
+	long double mx = 0, my = 0;
+	for(q = offsetBunch.begin(); q != offsetBunch.end(); q++)
+	{
+		mx += q->x();
+		my += q->y();
+	}
+	mx /= offsetBunch.size();
+	my /= offsetBunch.size();
+	long double vx = 0, vy = 0, cxy = 0;
+	for(q = offsetBunch.begin(); q != offsetBunch.end(); q++)
+	{
+		vx += (q->x() - mx) * (q->x() - mx);
+		vy += (q->y() - my) * (q->y() - my);
+		cxy += (q->x() - mx) * (q->y() - my);
+	}
+	vx /= offsetBunch.size();
+	vy /= offsetBunch.size();
+	cxy /= offsetBunch.size();
+
+	// x is only known to about 1e-10 at an offset of 1e6
+	PSmoments S;
+	offsetBunch.GetMoments(S);
+	assert_close(S.mean(ps_X), mx, 1e-9);
+	assert_close(S(ps_X, ps_X), vx, 1e-8 * vx);
+	assert_close(S(ps_Y, ps_Y), vy, 1e-8 * vy);
+	assert_close(S(ps_X, ps_Y), cxy, 1e-8 * sqrt(vx * vy));
+	assert_close(offsetBunch.GetMoments(ps_Y).second, sqrt(vy), 1e-8 * sqrt(vy));
+
+	// the centroid and single coordinate functions, which only find the
+	// means (and one variance)
+	PSvector c;
+	offsetBunch.GetCentroid(c);
+	assert_close(c.x(), mx, 1e-9);
+	assert_close(c.y(), my, 1e-10);
+	assert_close(offsetBunch.GetMoments(ps_X).first, mx, 1e-9);
+	assert_close(offsetBunch.GetMoments(ps_X).second, sqrt(vx), 1e-8 * sqrt(vx));
+	const Point2D pc = offsetBunch.GetProjectedCentroid(ps_Y, ps_X);
+	assert(pc.x == c.y() && pc.y == c.x());
+
+	PSmomentAccumulator m1(true), m2(true);
+	m1.Add(&offsetBunch.GetParticles()[0], 3000);
+	m2.Add(&offsetBunch.GetParticles()[3000], offsetBunch.size() - 3000);
+	m1.Merge(m2);
+	const PSmomentAccumulator m = offsetBunch.AccumulateMoments(true);
+	assert(m.Count() == offsetBunch.size());
+	assert_close(m1.Variance(ps_X), m.Variance(ps_X), 1e-8 * vx);
+	assert_close(m1.Skewness(ps_X), m.Skewness(ps_X), 1e-5);
+	assert_close(m1.Kurtosis(ps_X), m.Kurtosis(ps_X), 1e-6);
+	// x is a sampled sine
+	assert_close(m.Skewness(ps_X), 0, 1e-3);
+	assert_close(m.Kurtosis(ps_X), 1.5, 1e-3);
+
+	// The moments do not depend on the number of threads, for a bunch
+	// with several chunks of blocks and a partial block at the end
+	ParticleBunch bigBunch(beam_mom, charge);
+	for(int i = 0; i < 100003; i++)
+	{
+		Particle q(0);
+		q.x() = 1e-3 * sin(0.37 * i) + 1e-4;
+		q.ct() = 1e-2 * cos(0.011 * i);
+		q.dp() = 1e-4 * ((i * 7919) % 1000) / 1000.0;
+		bigBunch.AddParticle(q);
+	}
+	const size_t grain = Parallel::GetGrainSize();
+	Parallel::SetGrainSize(1);
+	double packed1[PSmomentAccumulator::packedSize];
+	PSvector centroid1;
+	pair<double, double> dp1;
+	for(int nt = 1; nt <= 4; nt++)
+	{
+		Parallel::SetNumThreads(nt);
+		double packed[PSmomentAccumulator::packedSize];
+		bigBunch.AccumulateMoments(true).Pack(packed);
+		PSvector centroid;
+		bigBunch.GetCentroid(centroid);
+		const pair<double, double> dp = bigBunch.GetMoments(ps_DP);
+		if(nt == 1)
+		{
+			memcpy(packed1, packed, sizeof(packed));
+			centroid1 = centroid;
+			dp1 = dp;
+		}
+		assert(memcmp(packed, packed1, sizeof(packed)) == 0);
+		for(int k = 0; k < 6; k++)
+		{
+			assert(centroid[k] == centroid1[k]);
+		}
+		assert(dp == dp1);
+	}
+	Parallel::SetNumThreads(0);
+	Parallel::SetGrainSize(grain);
+
+	// Several threads reading the same const bunch, held in columns, each
+	// needing the particle array
+	bigBunch.GetColumns();
+	const ParticleBunch& constBunch = bigBunch;
+	vector<PSvector> centroids(4);
+	vector<thread> readers;
+	for(int k = 0; k < 4; k++)
+	{
+		readers.emplace_back([&constBunch, &centroids, k]
+		{
+			assert(constBunch.size() == 100003);
+			constBunch.GetCentroid(centroids[k]);
+		});
+	}
+	for(thread& r : readers)
+	{
+		r.join();
+	}
+	for(int k = 0; k < 4; k++)
+	{
+		for(int i = 0; i < 6; i++)
+		{
+			assert(centroids[k][i] == centroid1[i]);
+		}
+	}
+
 	delete myBunch_p;
 	delete myBunch_e;
 	return 0;
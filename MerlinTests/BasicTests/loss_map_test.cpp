@@ -0,0 +1,178 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <cstdio>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "Collimator.h"
+#include "Drift.h"
+#include "LossMapCollimationOutput.h"
+#include "MerlinException.h"
+
+/*
+ * Check that streamed loss maps, whole and merged from partial results,
+ * give the same output as loss maps built from every lost particle.
+ */
+
+using namespace std;
+using namespace ParticleTracking;
+
+namespace
+{
+
+struct Loss
+{
+	AcceleratorComponent* component;
+	double pos;
+};
+
+vector<AcceleratorComponent*> MakeLattice()
+{
+	vector<AcceleratorComponent*> lattice;
+	lattice.push_back(new Drift("D1", 1.35));
+	lattice.push_back(new Collimator("TCP", 0.6));
+	lattice.push_back(new Drift("D2", 2.0));
+	lattice.push_back(new Drift("D1", 0.75));
+	lattice.push_back(new Drift("D3", 0.05));
+	lattice.push_back(new Drift("D3", 0.05));
+
+	double s = 0;
+	for(AcceleratorComponent* c : lattice)
+	{
+		c->SetComponentLatticePosition(s);
+		s += c->GetLength();
+	}
+	return lattice;
+}
+
+vector<Loss> MakeLosses(const vector<AcceleratorComponent*>& lattice)
+{
+	mt19937 rng(1);
+	vector<Loss> losses;
+	for(int i = 0; i < 20000; i++)
+	{
+		AcceleratorComponent* c = lattice[rng() % lattice.size()];
+		double pos = uniform_real_distribution<double>(0, c->GetLength())(rng);
+		if(i % 10 == 0)
+		{
+			// on the edges of the intervals
+			pos = 0.1 * (rng() % (int(c->GetLength() * 10) + 1));
+		}
+		losses.push_back(Loss{c, pos});
+	}
+	return losses;
+}
+
+void Configure(LossMapCollimationOutput& output, bool streaming)
+{
+	output.SetWarmRegion(make_pair(3.0, 4.0));
+	output.SetStreaming(streaming);
+}
+
+void Dispose(LossMapCollimationOutput& output, const vector<Loss>& losses, size_t first, size_t last)
+{
+	Particle p(0);
+	for(size_t i = first; i < last; i++)
+	{
+		output.Dispose(*losses[i].component, losses[i].pos, p);
+	}
+}
+
+string Result(LossMapCollimationOutput& output)
+{
+	output.Finalise();
+	ostringstream os;
+	output.Output(&os);
+	return os.str();
+}
+
+void Check(OutputType otype, const vector<Loss>& losses)
+{
+	const size_t n = losses.size();
+	const char* partial = "loss_map_test.partial";
+
+	LossMapCollimationOutput stored(otype), streamed(otype);
+	Configure(stored, false);
+	Configure(streamed, true);
+	Dispose(stored, losses, 0, n);
+	Dispose(streamed, losses, 0, n);
+	const string expected = Result(stored);
+	assert(Result(streamed) == expected);
+	assert(streamed.DeadParticles.empty());
+
+	// two jobs, each with part of the losses
+	LossMapCollimationOutput job1(otype), job2(otype), merged(otype);
+	Configure(job1, true);
+	Configure(job2, true);
+	Configure(merged, true);
+	Dispose(job1, losses, 0, n / 3);
+	Dispose(job2, losses, n / 3, n);
+	job1.WritePartial(partial);
+	merged.MergePartial(partial);
+	job2.WritePartial(partial);
+	merged.MergePartial(partial);
+	assert(Result(merged) == expected);
+	remove(partial);
+
+	if(otype == tencm)
+	{
+		// the interval starts found as a running sum, one step at a time
+		map<pair<double, double>, double> counts;
+		for(const Loss& l : losses)
+		{
+			double inter = 0.0;
+			while(!(l.pos >= inter && l.pos < inter + 0.1))
+			{
+				inter += 0.1;
+			}
+			counts[make_pair(l.component->GetComponentLatticePosition(), inter)] += 1;
+		}
+		size_t total = 0;
+		for(const LossData& d : streamed.OutputLosses)
+		{
+			total += d.lost;
+			if(d.ElementName != "Drift.D3")
+			{
+				assert(counts[make_pair(d.s, d.interval)] == d.lost);
+			}
+		}
+		assert(total == n);
+	}
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	vector<AcceleratorComponent*> lattice = MakeLattice();
+	const vector<Loss> losses = MakeLosses(lattice);
+
+	Check(tencm, losses);
+	Check(nearestelement, losses);
+
+	bool thrown = false;
+	try
+	{
+		LossMapCollimationOutput output(precise);
+		output.SetStreaming(true);
+	}
+	catch(MerlinException& e)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	for(AcceleratorComponent* c : lattice)
+	{
+		delete c;
+	}
+	return 0;
+}
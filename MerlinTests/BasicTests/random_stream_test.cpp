@@ -0,0 +1,173 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "RandomNG.h"
+#include "PhiloxEngine.h"
+#include "ParallelFor.h"
+
+/*
+ * Tests of the counter-based particle random streams.
+ */
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+	// Known answer tests for Philox4x64-10 (Random123 kat_vectors)
+	{
+		uint64_t ctr[4] = {0, 0, 0, 0};
+		uint64_t key[2] = {0, 0};
+		uint64_t out[4];
+		PhiloxEngine::Block(ctr, key, out);
+		assert(out[0] == 0x16554d9eca36314cULL);
+		assert(out[1] == 0xdb20fe9d672d0fdcULL);
+		assert(out[2] == 0xd7e772cee186176bULL);
+		assert(out[3] == 0x7e68b68aec7ba23bULL);
+	}
+	{
+		uint64_t ctr[4] = {0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL, 0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL};
+		uint64_t key[2] = {0x452821e638d01377ULL, 0xbe5466cf34e90c6cULL};
+		uint64_t out[4];
+		PhiloxEngine::Block(ctr, key, out);
+		assert(out[0] == 0xa528f45403e61d95ULL);
+		assert(out[1] == 0x38c72dbd566e9788ULL);
+		assert(out[2] == 0xa5a1610e72fd18b5ULL);
+		assert(out[3] == 0x57bd43b5e52b7fe6ULL);
+	}
+
+	// discard() skips the same numbers as drawing them
+	{
+		PhiloxEngine a(1, 2, 3), b(1, 2, 3);
+		for(int n : {0, 1, 3, 4, 5, 9})
+		{
+			for(int i = 0; i < n; i++)
+			{
+				a();
+			}
+			b.discard(n);
+			assert(a == b);
+			assert(a() == b());
+		}
+	}
+
+	RandomNG::init(4242);
+
+	// A stream depends only on its coordinates
+	{
+		PhiloxEngine s1 = RandomNG::getStream(17, 3, 250);
+		vector<uint64_t> first;
+		for(int i = 0; i < 10; i++)
+		{
+			first.push_back(s1());
+		}
+
+		// draw from other streams and the shared generator in between
+		RandomNG::uniform(0, 1);
+		PhiloxEngine other = RandomNG::getStream(18, 3, 250);
+		other();
+
+		PhiloxEngine s2 = RandomNG::getStream(17, 3, 250);
+		for(int i = 0; i < 10; i++)
+		{
+			assert(s2() == first[i]);
+		}
+
+		assert(RandomNG::getStream(17, 4, 250)() != first[0]);
+		assert(RandomNG::getStream(17, 3, 251)() != first[0]);
+		assert(RandomNG::getStream(17, 3, 250, 1)() != first[0]);
+		assert(RandomNG::getStream(16, 3, 250)() != first[0]);
+
+		// and on the seed
+		RandomNG::reset(4243);
+		assert(RandomNG::getStream(17, 3, 250)() != first[0]);
+		RandomNG::reset(4242);
+		assert(RandomNG::getStream(17, 3, 250)() == first[0]);
+	}
+
+	// An active Stream takes the draws without disturbing the shared generator
+	{
+		RandomNG::reset();
+		vector<double> shared;
+		for(int i = 0; i < 5; i++)
+		{
+			shared.push_back(RandomNG::normal(0, 1));
+		}
+
+		RandomNG::reset();
+		assert(!RandomNG::inStream());
+		for(int i = 0; i < 5; i++)
+		{
+			RandomNG::Stream stream(i, 0, 0);
+			assert(RandomNG::inStream());
+			double a = RandomNG::normal(0, 1);
+			{
+				RandomNG::Stream nested(i, 0, 1);
+				RandomNG::landau();
+			}
+			double b = RandomNG::normal(0, 1);
+			assert(a != b);
+		}
+		assert(!RandomNG::inStream());
+		for(int i = 0; i < 5; i++)
+		{
+			assert(RandomNG::normal(0, 1) == shared[i]);
+		}
+	}
+
+	// Results do not depend on the order or thread of evaluation
+	const size_t n = 20000;
+	vector<double> serial(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		RandomNG::Stream stream(i, 7, 12);
+		serial[i] = RandomNG::uniform(-1, 1) + RandomNG::normal(0, 1);
+	}
+
+	Parallel::SetGrainSize(16);
+	Parallel::SetNumThreads(4);
+	vector<double> parallel(n);
+	Parallel::For(n, [&](size_t j)
+	{
+		size_t i = n - 1 - j;
+		RandomNG::Stream stream(i, 7, 12);
+		parallel[i] = RandomNG::uniform(-1, 1) + RandomNG::normal(0, 1);
+	});
+	for(size_t i = 0; i < n; i++)
+	{
+		assert(serial[i] == parallel[i]);
+	}
+
+	// Simple moments of numbers taken across many streams
+	const size_t nstream = 200000;
+	double su = 0, su2 = 0, sn = 0, sn2 = 0;
+	for(size_t i = 0; i < nstream; i++)
+	{
+		RandomNG::Stream stream(i, 1, 2);
+		double u = RandomNG::uniform(0, 1);
+		double g = RandomNG::normal(0, 1);
+		su += u;
+		su2 += u * u;
+		sn += g;
+		sn2 += g * g;
+	}
+	su /= nstream;
+	su2 /= nstream;
+	sn /= nstream;
+	sn2 /= nstream;
+	cout << "uniform mean " << su << " var " << su2 - su * su << endl;
+	cout << "normal mean " << sn << " var " << sn2 - sn * sn << endl;
+	assert_close(su, 0.5, 0.005);
+	assert_close(su2 - su * su, 1.0 / 12, 0.002);
+	assert_close(sn, 0.0, 0.01);
+	assert_close(sn2 - sn * sn, 1.0, 0.01);
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "SampledWake.h"
+
+/*
+ * Check the slice sums of SampledWake, direct and by FFT, against
+ * explicit sums over a wake function, and that the direct transverse and
+ * CSR sums are bit-identical to the original WakeFieldProcess loops.
+ */
+
+using namespace std;
+using namespace ParticleTracking;
+
+namespace
+{
+
+double Wake(double z)
+{
+	return exp(-z / 3.0) * cos(2.0 * z) + 0.1 * z;
+}
+
+void Check(size_t n, size_t threshold)
+{
+	SampledWake::SetFFTThreshold(threshold);
+
+	const double dz = 0.01;
+	vector<double> q(n), q2(n);
+	for(size_t j = 0; j < n; j++)
+	{
+		q[j] = exp(-pow((j - 0.4 * n) / (0.1 * n), 2));
+		q2[j] = q[j] * sin(0.1 * j);
+	}
+
+	int calls = 0;
+	SampledWake w;
+	for(int pass = 0; pass < 2; pass++)
+	{
+		w.Sample([&calls](double z)
+		{
+			calls++;
+			return Wake(z);
+		}, n, dz, 0.5);
+	}
+	assert(calls == int(n));
+
+	vector<double> out(n), out2(n), conv(n);
+	w.Correlate(q.data(), out.data(), q2.data(), out2.data());
+	w.Convolve(q.data(), conv.data());
+
+	double scale = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		double c = 0, c2 = 0, v = 0;
+		for(size_t j = i; j < n; j++)
+		{
+			c += Wake((j - i + 0.5) * dz) * q[j];
+			c2 += Wake((j - i + 0.5) * dz) * q2[j];
+		}
+		for(size_t j = 0; j <= i; j++)
+		{
+			v += Wake((i - j + 0.5) * dz) * q[j];
+		}
+		scale = max(scale, fabs(c));
+		assert_close(out[i], c, 1e-12 * (1 + scale));
+		assert_close(out2[i], c2, 1e-12 * (1 + scale));
+		assert_close(conv[i], v, 1e-12 * (1 + scale));
+	}
+}
+
+// the loops of WakeFieldProcess::CalculateWakeT and the CSR wake before
+// the wake was sampled
+void CheckOriginalOrder(size_t n, size_t threshold)
+{
+	SampledWake::SetFFTThreshold(threshold);
+
+	const double dz = 0.013;
+	vector<double> q(n), x(n), y(n), qdp(n, 0.0);
+	for(size_t j = 0; j < n; j++)
+	{
+		q[j] = exp(-pow((j - 0.4 * n) / (0.1 * n), 2));
+		x[j] = 1e-3 * sin(0.37 * j);
+		y[j] = 1e-4 * cos(0.11 * j) + 3e-5;
+	}
+	for(size_t j = 1; j < n - 1; j++)
+	{
+		qdp[j] = (q[j + 1] - q[j - 1]) / (2 * dz);
+	}
+	// as Qd, which has an empty slice at the end
+	q[n - 1] = 0;
+
+	SampledWake wt;
+	wt.Sample(Wake, n, dz, 0.5);
+	vector<double> wx(n), wy(n);
+	wt.Correlate(q.data(), x.data(), wx.data(), y.data(), wy.data());
+
+	SampledWake wcsr;
+	wcsr.Sample([](double z)
+	{
+		return z > 0 ? 0 : Wake(z);
+	}, n, -dz, -0.5);
+	vector<double> wz(n);
+	wcsr.Convolve(qdp.data(), dz, wz.data());
+
+	const bool exact = n < threshold;
+	for(size_t i = 0; i < n; i++)
+	{
+		double ex = 0, ey = 0, ez = 0;
+		for(size_t j = i; j < n - 1; j++)
+		{
+			double wxy = q[j] * Wake((j - i + 0.5) * dz);
+			ex += wxy * x[j];
+			ey += wxy * y[j];
+		}
+		for(size_t j = 1; j < i; j++)
+		{
+			ez += qdp[j] * (Wake((double(j) - double(i) + 0.5) * dz)) / dz;
+		}
+		if(exact)
+		{
+			assert(wx[i] == ex && wy[i] == ey && wz[i] == ez);
+		}
+		else
+		{
+			assert_close(wx[i], ex, 1e-12);
+			assert_close(wy[i], ey, 1e-12);
+			assert_close(wz[i], ez, 1e-9);
+		}
+	}
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	const size_t threshold = SampledWake::GetFFTThreshold();
+
+	Check(50, 1000);
+	Check(50, 1);
+	Check(1001, 1000);
+	Check(1001, 1);
+	CheckOriginalOrder(300, 1000);
+	CheckOriginalOrder(300, 1);
+
+	SampledWake::SetFFTThreshold(threshold);
+	return 0;
+}
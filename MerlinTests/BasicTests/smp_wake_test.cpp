@@ -0,0 +1,117 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <cmath>
+#include <iostream>
+
+#include "Drift.h"
+#include "SMPBunch.h"
+#include "SMPWakeFieldProcess.h"
+#include "WakePotentials.h"
+
+/*
+ * Check the wake kicks of the SMP wakefield process found on a mesh
+ * against the sum over every pair of slices, and that the mesh error
+ * falls as the mesh is refined.
+ */
+
+using namespace std;
+using namespace SMPTracking;
+
+namespace
+{
+
+class ResonatorWake: public WakePotentials
+{
+public:
+	double Wlong(double z) const
+	{
+		return 1e13 * cos(z / 2e-4) * exp(-z / 1e-3);
+	}
+	double Wtrans(double z) const
+	{
+		return 1e16 * sin(z / 2e-4) * exp(-z / 1e-3);
+	}
+};
+
+SMPBunch* MakeBunch()
+{
+	const double p0 = 250;
+	SMPBunch* bunch = new SMPBunch(p0, 2e10);
+	for(int i = 0; i < 1500; i++)
+	{
+		// irregular spacing of about two slice widths
+		const double z = (2.0 * i + 0.7 * sin(1.3 * i)) * 1e-6;
+		SliceMacroParticle p(2e10 / 1500 * exp(-pow((z - 1.5e-3) / 6e-4, 2)));
+		p.ct() = z;
+		p.x() = 1e-5 * sin(z / 3e-4);
+		p.y() = 1e-5 * cos(z / 5e-4);
+		bunch->AddParticle(p);
+	}
+	return bunch;
+}
+
+/*
+ * Largest difference in the kicks of two tracked bunches, relative to
+ * the largest kick.
+ */
+double KickError(const SMPBunch& b1, const SMPBunch& b2)
+{
+	double kmax[3] = {0, 0, 0};
+	double emax[3] = {0, 0, 0};
+	for(size_t i = 0; i < b1.Size(); i++)
+	{
+		const double k1[3] = {b1.Get(i).dp(), b1.Get(i).xp(), b1.Get(i).yp()};
+		const double k2[3] = {b2.Get(i).dp(), b2.Get(i).xp(), b2.Get(i).yp()};
+		for(int k = 0; k < 3; k++)
+		{
+			kmax[k] = max(kmax[k], fabs(k1[k]));
+			emax[k] = max(emax[k], fabs(k1[k] - k2[k]));
+		}
+	}
+	assert(kmax[0] > 0 && kmax[1] > 0 && kmax[2] > 0);
+	return max(max(emax[0] / kmax[0], emax[1] / kmax[1]), emax[2] / kmax[2]);
+}
+
+SMPBunch* Track(size_t meshResolution)
+{
+	ResonatorWake* wake = new ResonatorWake();
+	Drift structure("structure", 1.0);
+	structure.SetWakePotentials(wake);
+
+	SMPBunch* bunch = MakeBunch();
+	WakeFieldProcess wfp(1, 1e-6);
+	wfp.SetMeshResolution(meshResolution);
+	wfp.InitialiseProcess(*bunch);
+	wfp.SetCurrentComponent(structure);
+	wfp.DoProcess(1.0);
+
+	delete wake;
+	return bunch;
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	SMPBunch* pairwise = Track(0);
+	SMPBunch* coarse = Track(2);
+	SMPBunch* fine = Track(8);
+
+	const double ecoarse = KickError(*pairwise, *coarse);
+	const double efine = KickError(*pairwise, *fine);
+	cout << "relative kick error: " << ecoarse << " (2 cells per slice) " << efine << " (8 cells per slice)" << endl;
+
+	assert(efine < 1e-6);
+	assert(efine < ecoarse / 8);
+
+	delete pairwise;
+	delete coarse;
+	delete fine;
+	return 0;
+}
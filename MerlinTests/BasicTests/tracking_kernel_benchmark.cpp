@@ -0,0 +1,141 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "AcceleratorModelConstructor.h"
+#include "Components.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "ParticleBunchTypes.h"
+#include "ParticleTracker.h"
+#include "SymplecticIntegrators.h"
+#include "StdIntegrators.h"
+#include "SimdDouble.h"
+#include "RandomNG.h"
+
+/*
+ * Report the tracking throughput, in particles * elements per second, of
+ * the SYMPLECTIC and THIN_LENS integrator sets for each element type and
+ * each bunch storage layout.
+ *
+ * usage: tracking_kernel_benchmark [particles] [turns]
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+using namespace ParticleTracking;
+
+namespace
+{
+
+const double P0 = 7000;
+const double brho = P0 / eV / SpeedOfLight;
+
+AcceleratorModel* MakeModel(AcceleratorComponent* (*make)(int), int nelm)
+{
+	AcceleratorModelConstructor ctor;
+	ctor.NewModel();
+	for(int i = 0; i < nelm; i++)
+	{
+		ctor.AppendComponent(*make(i));
+	}
+	return ctor.GetModel();
+}
+
+AcceleratorComponent* MakeDrift(int i)
+{
+	return new Drift("d" + to_string(i), 1.0 * meter);
+}
+
+AcceleratorComponent* MakeQuadrupole(int i)
+{
+	return new Quadrupole("q" + to_string(i), 1.0 * meter, (i % 2 ? 1 : -1) * 0.01 * brho);
+}
+
+AcceleratorComponent* MakeSectorBend(int i)
+{
+	const double h = 0.001;
+	return new SectorBend("b" + to_string(i), 1.0 * meter, h, h * brho);
+}
+
+AcceleratorComponent* MakeSextupole(int i)
+{
+	return new Sextupole("s" + to_string(i), 0.5 * meter, 0.1 * brho);
+}
+
+double Run(AcceleratorModel* model, const ParticleTracker::integrator_set_base& iset,
+	ParticleBunch::StorageLayout layout, size_t npart, int nelm, int nturns)
+{
+	PSvectorArray particles;
+	for(size_t i = 0; i < npart; i++)
+	{
+		Particle p(0);
+		p.x() = RandomNG::normal(0, 1e-6);
+		p.xp() = RandomNG::normal(0, 1e-8);
+		p.y() = RandomNG::normal(0, 1e-6);
+		p.yp() = RandomNG::normal(0, 1e-8);
+		p.dp() = RandomNG::normal(0, 1e-6);
+		particles.push_back(p);
+	}
+
+	ProtonBunch bunch(P0, 1, particles);
+	bunch.SetStorageLayout(layout);
+	ParticleTracker tracker(model->GetBeamline(), &bunch);
+	tracker.SetIntegratorSet(&iset);
+
+	auto start = chrono::steady_clock::now();
+	for(int turn = 0; turn < nturns; turn++)
+	{
+		tracker.Track(&bunch);
+	}
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	return double(npart) * nelm * nturns / elapsed.count();
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	size_t npart = argc > 1 ? stoul(argv[1]) : 10000;
+	int nturns = argc > 2 ? stoi(argv[2]) : 10;
+	const int nelm = 100;
+
+	RandomNG::init(1);
+
+	SYMPLECTIC::StdISet symplectic;
+	THIN_LENS::StdISet thin;
+	const ParticleTracker::integrator_set_base* isets[] = {&symplectic, &thin};
+	const char* iset_names[] = {"SYMPLECTIC", "THIN_LENS"};
+
+	AcceleratorComponent* (*makers[])(int) = {MakeDrift, MakeQuadrupole, MakeSectorBend, MakeSextupole};
+	const char* element_names[] = {"Drift", "Quadrupole", "SectorBend", "Sextupole"};
+
+	cout << "SIMD width " << SimdDouble::width << ", " << npart << " particles, " << nelm
+		 << " elements, " << nturns << " turns" << endl;
+	cout << setw(12) << "integrator" << setw(12) << "element" << setw(16) << "AoS [p.e/s]"
+		 << setw(16) << "SoA [p.e/s]" << setw(10) << "speedup" << endl;
+
+	for(int e = 0; e < 4; e++)
+	{
+		AcceleratorModel* model = MakeModel(makers[e], nelm);
+		for(int s = 0; s < 2; s++)
+		{
+			double aos = Run(model, *isets[s], ParticleBunch::arrayOfStructs, npart, nelm, nturns);
+			double soa = Run(model, *isets[s], ParticleBunch::structOfArrays, npart, nelm, nturns);
+			cout << setw(12) << iset_names[s] << setw(12) << element_names[e] << setw(16) << setprecision(4)
+				 << aos << setw(16) << soa << setw(10) << soa / aos << endl;
+		}
+		delete model;
+	}
+	return 0;
+}
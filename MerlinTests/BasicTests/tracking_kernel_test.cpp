@@ -0,0 +1,544 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include <cstring>
+#include <limits>
+#include "../tests.h"
+
+#include "AcceleratorModelConstructor.h"
+#include "Components.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "ParticleBunchTypes.h"
+#include "ParticleTracker.h"
+#include "SymplecticIntegrators.h"
+#include "StdIntegrators.h"
+#include "TrackingKernels.h"
+#include "ParallelFor.h"
+#include "RandomNG.h"
+#include "SynchRadParticleProcess.h"
+#include "NANCheckProcess.h"
+#include "CompiledLattice.h"
+#include "BasicTransportMaps.h"
+#include "CollimatorAperture.h"
+#include "CollimateProtonProcess.h"
+#include "CollimationOutput.h"
+#include "ScatteringModelsMerlin.h"
+#include "MaterialDatabase.h"
+
+/*
+ * Check that the batched (column) kernels give bit-identical results to
+ * the per-particle path, both for the individual kernels and batched
+ * RTMaps and when tracking a bunch through a lattice with the SYMPLECTIC
+ * and THIN_LENS integrator sets, that the results do not depend on the
+ * number of threads, that fused tracking in tiles matches unfused
+ * tracking, also with collimation, and that a CompiledLattice matches a ParticleTracker, also
+ * after the lattice is changed.
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+using namespace ParticleTracking;
+
+namespace
+{
+
+PSvectorArray MakeParticles(size_t n)
+{
+	PSvectorArray particles;
+	for(size_t i = 0; i < n; i++)
+	{
+		Particle p(0);
+		p.x() = RandomNG::normal(0, 1e-6);
+		p.xp() = RandomNG::normal(0, 1e-8);
+		p.y() = RandomNG::normal(0, 1e-6);
+		p.yp() = RandomNG::normal(0, 1e-8);
+		p.ct() = RandomNG::normal(0, 1e-4);
+		p.dp() = RandomNG::normal(0, 1e-6);
+		p.id() = i;
+		particles.push_back(p);
+	}
+	return particles;
+}
+
+bool BitIdentical(const PSvectorArray& a, const PSvectorArray& b)
+{
+	if(a.size() != b.size())
+	{
+		return false;
+	}
+	for(size_t i = 0; i < a.size(); i++)
+	{
+		for(int k = 0; k < PS_LENGTH; k++)
+		{
+			double u = a[i][k];
+			double v = b[i][k];
+			// the sign of a NaN is not specified by IEEE arithmetic
+			if(std::isnan(u) && std::isnan(v))
+			{
+				continue;
+			}
+			if(memcmp(&u, &v, sizeof(double)) != 0)
+			{
+				cout << "particle " << i << " coord " << k << ": " << u << " != " << v << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// use an odd number of particles so that the scalar tail is exercised
+const size_t npart = 1001;
+
+template<class K>
+void CheckKernel(const K& k, const char* name)
+{
+	PSvectorArray ref = MakeParticles(npart);
+	PSvectorColumns cols(ref);
+
+	for_each(ref.begin(), ref.end(), Kernels::PSvectorKernel<K>(k));
+	Kernels::Apply(cols, k);
+
+	PSvectorArray res;
+	cols.CopyTo(res);
+	cout << name << endl;
+	assert(BitIdentical(ref, res));
+}
+
+PSvectorArray Track(AcceleratorModel* model, const ParticleTracker::integrator_set_base& iset,
+	ParticleBunch::StorageLayout layout)
+{
+	RandomNG::init(12345);
+	PSvectorArray particles = MakeParticles(npart);
+	ProtonBunch* bunch = new ProtonBunch(7000, 1, particles);
+	bunch->SetStorageLayout(layout);
+
+	ParticleTracker* tracker = new ParticleTracker(model->GetBeamline(), bunch);
+	tracker->SetIntegratorSet(&iset);
+	for(int turn = 0; turn < 10; turn++)
+	{
+		tracker->Track(bunch);
+	}
+
+	PSvectorArray result = bunch->GetParticles();
+	delete tracker;
+	delete bunch;
+	return result;
+}
+
+/*
+ * Track with the TRANSPORT integrators, synchrotron radiation and a NAN
+ * check, fused in tiles of tileSize particles (0 for unfused). If
+ * adjustEref is false the radiation does not end the fused run, so the
+ * NAN check joins it and culls a bad particle from the middle of a tile.
+ */
+PSvectorArray TrackFused(AcceleratorModel* model, size_t tileSize, bool adjustEref)
+{
+	RandomNG::init(12345);
+	PSvectorArray particles = MakeParticles(npart);
+	if(!adjustEref)
+	{
+		particles[500].xp() = std::numeric_limits<double>::quiet_NaN();
+	}
+	ProtonBunch* bunch = new ProtonBunch(7000, 1, particles);
+
+	ParticleTracker* tracker = new ParticleTracker(model->GetBeamline(), bunch);
+	SynchRadParticleProcess* sr = new SynchRadParticleProcess(1);
+	sr->IncludeQuadRadiation(true);
+	sr->SetNumComponentSteps(2);
+	sr->AdjustBunchReferenceEnergy(adjustEref);
+	tracker->AddProcess(sr);
+	NANCheckProcess* nancheck = new NANCheckProcess;
+	nancheck->SetCullNAN(true);
+	tracker->AddProcess(nancheck);
+	tracker->SetTileSize(tileSize);
+	for(int turn = 0; turn < 10; turn++)
+	{
+		tracker->Track(bunch);
+	}
+
+	PSvectorArray result = bunch->GetParticles();
+	PSvector reference(0);
+	reference.dp() = bunch->GetReferenceMomentum();
+	result.push_back(reference);
+	delete tracker;
+	delete bunch;
+	return result;
+}
+
+class RecordingOutput: public CollimationOutput
+{
+public:
+	void Dispose(AcceleratorComponent& currcomponent, double pos, Particle& particle, int turn = 0)
+	{
+		particles.push_back(particle);
+		particles.back().location() = pos;
+	}
+
+	PSvectorArray particles;
+};
+
+/*
+ * Track a wide beam through magnet apertures and a scattering collimator
+ * with the TRANSPORT integrators, collimation and a NAN check, fused in
+ * tiles of tileSize particles (0 for unfused). The survivors are followed
+ * by the particles passed to the CollimationOutput, each with its loss
+ * position as its location, and the remaining particle indices.
+ */
+PSvectorArray TrackCollimated(AcceleratorModel* model, size_t tileSize, bool counterBased)
+{
+	RandomNG::init(12345);
+	RandomNG::setCounterBased(counterBased);
+	PSvectorArray particles = MakeParticles(npart);
+	for(size_t i = 0; i < npart; i++)
+	{
+		particles[i].xp() = RandomNG::normal(0, 1e-10);
+		particles[i].yp() = RandomNG::normal(0, 1e-10);
+	}
+	particles[300].ct() = std::numeric_limits<double>::quiet_NaN();
+	ProtonBunch* bunch = new ProtonBunch(7000, 1, particles);
+
+	ParticleTracker* tracker = new ParticleTracker(model->GetBeamline(), bunch);
+	ScatteringModelMerlin scatter;
+	RecordingOutput output;
+	CollimateProtonProcess* collimate = new CollimateProtonProcess(2, COLL_AT_EXIT);
+	collimate->SetScatteringModel(&scatter);
+	collimate->ScatterAtCollimator(true);
+	collimate->SetLossThreshold(101.0);
+	collimate->SetOutputBinSize(0.01);
+	collimate->SetCollimationOutput(&output);
+	collimate->IndexParticles(true);
+	tracker->AddProcess(collimate);
+	NANCheckProcess* nancheck = new NANCheckProcess;
+	nancheck->SetCullNAN(true);
+	tracker->AddProcess(nancheck);
+	tracker->SetTileSize(tileSize);
+	for(int turn = 0; turn < 3; turn++)
+	{
+		tracker->Track(bunch);
+	}
+
+	PSvectorArray result = bunch->GetParticles();
+	result.insert(result.end(), output.particles.begin(), output.particles.end());
+	for(size_t index : collimate->GetIndexes())
+	{
+		PSvector p(0);
+		p.x() = index;
+		result.push_back(p);
+	}
+	RandomNG::setCounterBased(false);
+	delete tracker;
+	delete bunch;
+	return result;
+}
+
+/*
+ * Track turns of a ring with a ParticleTracker (compiled == false) or a
+ * CompiledLattice, moving a quadrupole and changing its strength half
+ * way through. The model is restored afterwards.
+ */
+PSvectorArray TrackRing(AcceleratorModel* model, bool compiled, bool fuse = false)
+{
+	RandomNG::init(12345);
+	PSvectorArray particles = MakeParticles(npart);
+	ProtonBunch* bunch = new ProtonBunch(7000, 1, particles);
+
+	vector<ComponentFrame*> frames;
+	model->ExtractComponents("*.qa", frames);
+	Quadrupole& quad = static_cast<Quadrupole&>(frames[0]->GetComponent());
+	const double b = quad.GetFieldStrength();
+
+	ParticleTracker tracker(model->GetRing(), bunch);
+	CompiledLattice lattice(model->GetRing());
+	lattice.FuseDrifts(fuse);
+	for(int turn = 0; turn < 10; turn++)
+	{
+		if(turn == 5)
+		{
+			frames[0]->Translate(1e-6, -2e-6, 0);
+			quad.SetFieldStrength(1.1 * b);
+			ModelElement::ModelChanged();
+		}
+		if(compiled)
+		{
+			lattice.Track(*bunch);
+		}
+		else
+		{
+			tracker.Track(bunch);
+		}
+	}
+	if(compiled)
+	{
+		// the rf structure is not compiled
+		assert(lattice.GetNumberCompiled() == lattice.GetNumberOfEntries() - 1);
+	}
+
+	frames[0]->ClearTransform();
+	quad.SetFieldStrength(b);
+
+	PSvectorArray result = bunch->GetParticles();
+	PSvector reference(0);
+	reference.dp() = bunch->GetReferenceMomentum();
+	reference.ct() = bunch->GetReferenceTime();
+	result.push_back(reference);
+	delete bunch;
+	return result;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	RandomNG::init(12345);
+
+	cout << "SIMD width: " << MERLIN_SIMD_WIDTH << endl;
+
+	MultipoleField field(1.0, 4);
+	field.SetCoefficient(0, Complex(0.01, -0.002));
+	field.SetCoefficient(1, Complex(0.3, 0.05));
+	field.SetCoefficient(2, Complex(12.0, -3.0));
+	field.SetCoefficient(3, Complex(-200.0, 40.0));
+
+	// The column field evaluation must reproduce MultipoleField::GetField2D
+	Kernels::MultipoleFieldEvaluator eval(field);
+	for(int i = 0; i < 100; i++)
+	{
+		double x = RandomNG::normal(0, 1e-3);
+		double y = RandomNG::normal(0, 1e-3);
+		Complex B = field.GetField2D(x, y);
+		double Bref[2] = {B.real(), B.imag()};
+		double Br, Bi;
+		eval(x, y, Br, Bi);
+		assert(memcmp(&Br, &Bref[0], sizeof(double)) == 0);
+		assert(memcmp(&Bi, &Bref[1], sizeof(double)) == 0);
+	}
+
+	CheckKernel(Kernels::DriftMap(2.5), "DriftMap");
+	CheckKernel(Kernels::LinearDrift(2.5), "LinearDrift");
+	CheckKernel(Kernels::PoleFaceRotation(0.01, 0.02, 0.5, 0.03), "PoleFaceRotation");
+	CheckKernel(Kernels::SectorBendMap(0.01, 1.5), "SectorBendMap");
+	CheckKernel(Kernels::CombinedFunctionSectorBendMap(0.01, 0.02, 1.5), "CombinedFunctionSectorBendMap +k1");
+	CheckKernel(Kernels::CombinedFunctionSectorBendMap(0.01, -0.02, 1.5), "CombinedFunctionSectorBendMap -k1");
+	CheckKernel(Kernels::QuadrupoleMap(0.05, 1.5), "QuadrupoleMap +k1");
+	CheckKernel(Kernels::QuadrupoleMap(-0.05, 1.5), "QuadrupoleMap -k1");
+	CheckKernel(Kernels::MultipoleKick(field, 0.5, 7000, 1, 0.1), "MultipoleKick");
+	CheckKernel(Kernels::ThinMultipoleKick(field, 0.5, 7000, 1), "ThinMultipoleKick");
+
+	// The batched RTMap must reproduce the per-PSvector map, also with a
+	// rescaled momentum and a range which is not a whole number of blocks
+	{
+		RTMap* M = GenSectorBendTM(1.5, 0.01, 0.02, 0);
+		PSvectorArray particles = MakeParticles(1000);
+		PSvectorArray single = particles;
+		PSvectorArray scaled = particles;
+		for(PSvectorArray::iterator p = single.begin(); p != single.end(); p++)
+		{
+			M->Apply(*p);
+		}
+		M->Apply(particles.begin(), particles.end());
+		cout << "RTMap" << endl;
+		assert(BitIdentical(single, particles));
+
+		single = scaled;
+		for(PSvectorArray::iterator p = single.begin(); p != single.end(); p++)
+		{
+			map_applicator_dp<RTMap, PSvector>(*M, 1.001)(*p);
+		}
+		ApplyMap(*M, scaled, 1.001, 1.0);
+		cout << "RTMap scaled" << endl;
+		assert(BitIdentical(single, scaled));
+		delete M;
+	}
+
+	// Track through a small lattice with both storage layouts
+	const double P0 = 7000;
+	const double brho = P0 / eV / SpeedOfLight;
+	const double h = 0.002;
+
+	AcceleratorModelConstructor* ctor = new AcceleratorModelConstructor();
+	ctor->NewModel();
+	ctor->AppendComponent(*new Drift("d1", 1.0 * meter));
+	ctor->AppendComponent(*new Quadrupole("q1", 3.0 * meter, 0.02 * brho));
+	ctor->AppendComponent(*new Drift("d2", 1.0 * meter));
+	ctor->AppendComponent(*new SectorBend("b1", 10.0 * meter, h, h * brho));
+	ctor->AppendComponent(*new Drift("d3", 1.0 * meter));
+	ctor->AppendComponent(*new Sextupole("s1", 0.5 * meter, 0.5 * brho));
+	ctor->AppendComponent(*new Quadrupole("q2", 3.0 * meter, -0.02 * brho));
+	ctor->AppendComponent(*new Drift("d4", 1.0 * meter));
+	AcceleratorModel* model = ctor->GetModel();
+	delete ctor;
+
+	cout << "SYMPLECTIC" << endl;
+	SYMPLECTIC::StdISet symplectic;
+	PSvectorArray ref = Track(model, symplectic, ParticleBunch::arrayOfStructs);
+	assert(!std::isnan(ref[0].x()) && !std::isnan(ref[0].ct()));
+	assert(BitIdentical(ref, Track(model, symplectic, ParticleBunch::structOfArrays)));
+
+	cout << "THIN_LENS" << endl;
+	THIN_LENS::StdISet thin;
+	assert(BitIdentical(Track(model, thin, ParticleBunch::arrayOfStructs),
+		Track(model, thin, ParticleBunch::structOfArrays)));
+
+	cout << "TRANSPORT threads" << endl;
+	TRANSPORT::StdISet transport;
+	Parallel::SetGrainSize(16);
+	Parallel::SetNumThreads(1);
+	PSvectorArray serial = Track(model, transport, ParticleBunch::arrayOfStructs);
+	Parallel::SetNumThreads(3);
+	assert(BitIdentical(serial, Track(model, transport, ParticleBunch::arrayOfStructs)));
+	assert(BitIdentical(Track(model, symplectic, ParticleBunch::arrayOfStructs),
+		Track(model, symplectic, ParticleBunch::structOfArrays)));
+
+	cout << "fused" << endl;
+	for(bool adjustEref : {true, false})
+	{
+		PSvectorArray unfused = TrackFused(model, 0, adjustEref);
+		assert(unfused.size() == (adjustEref ? npart : npart - 1) + 1);
+		assert(BitIdentical(unfused, TrackFused(model, 64, adjustEref)));
+		assert(BitIdentical(unfused, TrackFused(model, 7, adjustEref)));
+		assert(BitIdentical(unfused, TrackFused(model, 5000, adjustEref)));
+	}
+
+	delete model;
+
+	cout << "fused collimation" << endl;
+	{
+		MaterialDatabase materials;
+		ctor = new AcceleratorModelConstructor();
+		ctor->NewModel();
+		Drift* d1 = new Drift("d1", 1.0 * meter);
+		d1->SetAperture(new CircularAperture(2.5e-3));
+		ctor->AppendComponent(*d1);
+		Quadrupole* q1 = new Quadrupole("q1", 3.0 * meter, 0.02 * brho);
+		q1->SetAperture(new CircularAperture(2e-3));
+		ctor->AppendComponent(*q1);
+		const double length = 0.05;
+		Collimator* col = new Collimator("tcp", length);
+		col->SetMaterial(materials.FindMaterial("Cu"));
+		CollimatorAperture* jaws = new CollimatorAperture(3e-3, 1, 0, length, 0, 0);
+		jaws->SetExitWidth(jaws->GetFullEntranceWidth());
+		jaws->SetExitHeight(jaws->GetFullEntranceHeight());
+		col->SetAperture(jaws);
+		ctor->AppendComponent(*col);
+		Drift* d2 = new Drift("d2", 1.0 * meter);
+		d2->SetAperture(new CircularAperture(2e-3));
+		ctor->AppendComponent(*d2);
+		model = ctor->GetModel();
+		delete ctor;
+
+		for(bool counterBased : {false, true})
+		{
+			PSvectorArray unfused = TrackCollimated(model, 0, counterBased);
+			cout << "tracked " << unfused.size() << endl;
+			assert(unfused.size() > npart);
+			assert(BitIdentical(unfused, TrackCollimated(model, 64, counterBased)));
+			assert(BitIdentical(unfused, TrackCollimated(model, 7, counterBased)));
+			assert(BitIdentical(unfused, TrackCollimated(model, 5000, counterBased)));
+		}
+		delete model;
+	}
+
+	cout << "compiled" << endl;
+	ctor = new AcceleratorModelConstructor();
+	ctor->NewModel();
+	ctor->AppendComponent(*new Drift("d1", 1.0 * meter));
+	ctor->AppendComponent(*new Marker("mk"));
+	ctor->AppendComponent(*new Drift("d2", 1.5 * meter));
+	ctor->AppendComponent(*new Monitor("m1", 0.5 * meter, 0.1 * meter));
+	ctor->AppendComponent(*new Quadrupole("qa", 3.0 * meter, 0.02 * brho));
+	ctor->AppendComponent(*new XCor("c1", 0, 1e-4 * brho));
+	SectorBend* bend = new SectorBend("b1", 10.0 * meter, h, h * brho);
+	bend->SetPoleFaceInfo(new SectorBend::PoleFace(0.5 * h * 10.0));
+	bend->GetField().SetCoefficient(2, Complex(0.05, 0));
+	ctor->AppendComponent(*bend);
+	ctor->AppendComponent(*new Sextupole("s1", 0.5 * meter, 0.5 * brho));
+	ctor->AppendComponent(*new SWRFStructure("rf", 1, 400 * MHz, 1e-4));
+	ctor->AppendComponent(*new Quadrupole("qb", 3.0 * meter, -0.02 * brho));
+	ctor->AppendComponent(*new Drift("d3", 1.0 * meter));
+	ctor->AppendComponent(*new Drift("d4", 2.0 * meter));
+	model = ctor->GetModel();
+	delete ctor;
+
+	PSvectorArray tracked = TrackRing(model, false);
+	assert(BitIdentical(tracked, TrackRing(model, true)));
+	PSvectorArray fused = TrackRing(model, true, true);
+	assert(fused.size() == tracked.size());
+	for(size_t i = 0; i < tracked.size(); i++)
+	{
+		for(int k = 0; k < PS_LENGTH; k++)
+		{
+			assert_close(fused[i][k], tracked[i][k], 1e-10 * (fabs(tracked[i][k]) + 1e-6));
+		}
+	}
+
+	// the cached maps follow a direct change of the field, which does
+	// not bump the model generation
+	{
+		vector<ComponentFrame*> frames;
+		model->ExtractComponents("*.qb", frames);
+		Quadrupole& quad = static_cast<Quadrupole&>(frames[0]->GetComponent());
+		const double b = quad.GetFieldStrength();
+
+		PSvectorArray particles = MakeParticles(npart);
+		PSvectorArray copy = particles;
+		ProtonBunch cached(7000, 1, particles);
+		ProtonBunch fresh(7000, 1, copy);
+		ParticleTracker tracker(model->GetRing(), &cached);
+		tracker.Track(&cached);
+		quad.SetFieldStrength(0.9 * b);
+		tracker.Track(&cached);
+
+		quad.SetFieldStrength(b);
+		ParticleTracker(model->GetRing(), &fresh).Track(&fresh);
+		quad.SetFieldStrength(0.9 * b);
+		ParticleTracker(model->GetRing(), &fresh).Track(&fresh);
+		quad.SetFieldStrength(b);
+		assert(BitIdentical(cached.GetParticles(), fresh.GetParticles()));
+	}
+
+	// losses at an aperture at the end of the ring, which removes about
+	// half of the particles on the first turn
+	{
+		PSvectorArray particles = MakeParticles(npart);
+		PSvectorArray copy = particles;
+		ProtonBunch bunch(7000, 1, particles);
+		ProtonBunch probe(7000, 1, copy);
+		CompiledLattice lattice(model->GetRing());
+		lattice.Track(probe);
+		vector<double> r;
+		for(PSvectorArray::const_iterator p = probe.begin(); p != probe.end(); p++)
+		{
+			r.push_back(hypot(p->x(), p->y()));
+		}
+		nth_element(r.begin(), r.begin() + npart / 2, r.end());
+		const double radius = r[npart / 2];
+
+		vector<ComponentFrame*> frames;
+		model->ExtractComponents("*.d4", frames);
+		frames[0]->GetComponent().SetAperture(new CircularAperture(radius));
+		lattice.CheckApertures(true);
+		lattice.Track(bunch, 3);
+		const vector<CompiledLattice::LostParticle>& lost = lattice.GetLostParticles();
+		cout << "lost " << lost.size() << endl;
+		assert(!lost.empty() && bunch.size() + lost.size() == npart);
+		for(size_t i = 0; i < lost.size(); i++)
+		{
+			assert(lost[i].component == &frames[0]->GetComponent());
+			assert(hypot(lost[i].p.x(), lost[i].p.y()) >= radius);
+		}
+		for(size_t i = 1; i < bunch.size(); i++)
+		{
+			assert(bunch.GetParticles()[i - 1].id() < bunch.GetParticles()[i].id());
+		}
+	}
+
+	delete model;
+	return 0;
+}
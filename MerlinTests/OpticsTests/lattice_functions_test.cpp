@@ -0,0 +1,116 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <iostream>
+
+#include "AcceleratorModelConstructor.h"
+#include "Components.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "ClosedOrbit.h"
+#include "LatticeFunctions.h"
+#include "ParallelFor.h"
+
+/*
+ * Check that the closed orbit does not depend on the number of threads
+ * which track its columns, and that a momentum scan of the lattice
+ * functions agrees with the single calculation.
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+
+int main()
+{
+	// a ring of four FODO cells, with a sextupole and a steering error
+	const double P0 = 7000;
+	const double brho = P0 / eV / SpeedOfLight;
+	const double h = 0.001;
+
+	AcceleratorModelConstructor* ctor = new AcceleratorModelConstructor();
+	ctor->NewModel();
+	for(int cell = 0; cell < 4; cell++)
+	{
+		ctor->AppendComponent(*new Quadrupole("qf", 3.0 * meter, 0.02 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Sextupole("s", 0.5 * meter, 2.0 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new Quadrupole("qd", 3.0 * meter, -0.02 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+	}
+	ctor->AppendComponent(*new XCor("xcor", 0, 2e-5 * brho));
+	AcceleratorModel* model = ctor->GetModel();
+	delete ctor;
+
+	// closed orbit, with the columns tracked on one thread and on several
+	const int nthreads = Parallel::GetNumThreads();
+	PSvector orbit1(0);
+	orbit1.dp() = 1e-4;
+	PSvector orbitN = orbit1;
+
+	Parallel::SetNumThreads(1);
+	ClosedOrbit co1(model, P0);
+	co1.TransverseOnly(true);
+	co1.FindClosedOrbit(orbit1);
+
+	Parallel::SetNumThreads(nthreads);
+	ClosedOrbit coN(model, P0);
+	coN.TransverseOnly(true);
+	coN.FindClosedOrbit(orbitN);
+
+	assert(fabs(orbit1.x()) > 1e-6);
+	for(int k = 0; k < 6; k++)
+	{
+		assert(orbit1[k] == orbitN[k]);
+	}
+
+	// momentum scan
+	LatticeFunctionTable lft(model, P0);
+	lft.Calculate();
+
+	vector<double> dp;
+	dp.push_back(-1e-4);
+	dp.push_back(0);
+	dp.push_back(1e-4);
+	vector<LatticeFunctionTable*> scan;
+	lft.CalculateMomentumScan(dp, scan);
+	assert(scan.size() == dp.size());
+
+	int rows, cols;
+	lft.Size(rows, cols);
+	cout << "rows " << rows << " columns " << cols << endl;
+	for(int n = 0; n < rows; n++)
+	{
+		for(int i = 1; i <= 4; i++)
+		{
+			assert(scan[1]->Value(i, 0, 0, n) == lft.Value(i, 0, 0, n));
+		}
+		assert(scan[1]->Value(1, 1, 1, n) == lft.Value(1, 1, 1, n));
+		assert(scan[1]->Value(3, 3, 2, n) == lft.Value(3, 3, 2, n));
+		assert(scan[2]->Value(6, 0, 0, n) == 1e-4);
+	}
+	for(int k = 0; k < 4; k++)
+	{
+		assert_close(scan[2]->Value(k + 1, 0, 0, 0), orbit1[k], 1e-12);
+	}
+
+	// the dispersion is seen in the orbit
+	assert(scan[2]->Value(1, 0, 0, 0) > scan[1]->Value(1, 0, 0, 0));
+	assert(scan[0]->Value(1, 0, 0, 0) < scan[1]->Value(1, 0, 0, 0));
+
+	for(size_t n = 0; n < scan.size(); n++)
+	{
+		delete scan[n];
+	}
+	delete model;
+	return 0;
+}
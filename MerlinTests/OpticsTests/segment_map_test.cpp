@@ -0,0 +1,184 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <iostream>
+
+#include "AcceleratorModelConstructor.h"
+#include "Components.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "TransferMatrix.h"
+#include "SegmentMapCache.h"
+#include "PhaseAdvance.h"
+
+/*
+ * Check that the transfer matrices between elements taken from a
+ * SegmentMapCache agree with those found by TransferMatrix, including
+ * after an element has been changed and updated, and that PhaseAdvance
+ * sees a direct change to a field.
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+
+namespace
+{
+
+void AssertMatrixClose(const RealMatrix& A, const RealMatrix& B, double tol)
+{
+	for(int i = 0; i < 6; i++)
+	{
+		for(int j = 0; j < 6; j++)
+		{
+			assert_close(A(i, j), B(i, j), tol * (1 + fabs(B(i, j))));
+		}
+	}
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	// a ring of four FODO cells, with a sextupole and a steering error
+	const double P0 = 7000;
+	const double brho = P0 / eV / SpeedOfLight;
+	const double h = 0.001;
+
+	AcceleratorModelConstructor* ctor = new AcceleratorModelConstructor();
+	ctor->NewModel();
+	Quadrupole* qf = nullptr;
+	for(int cell = 0; cell < 4; cell++)
+	{
+		Quadrupole* q = new Quadrupole("qf", 3.0 * meter, 0.02 * brho);
+		if(cell == 2)
+		{
+			qf = q;
+		}
+		ctor->AppendComponent(*q);
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Sextupole("s", 0.5 * meter, 2.0 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new Quadrupole("qd", 3.0 * meter, -0.02 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+	}
+	XCor* xcor = new XCor("xcor", 0, 2e-5 * brho);
+	ctor->AppendComponent(*xcor);
+	AcceleratorModel* model = ctor->GetModel();
+	delete ctor;
+
+	int nqf = 0;
+	AcceleratorModel::Beamline bline = model->GetBeamline();
+	for(AcceleratorModel::BeamlineIterator f = bline.begin(); f != bline.end(); f++, nqf++)
+	{
+		if((*f)->IsComponent() && &(*f)->GetComponent() == qf)
+		{
+			break;
+		}
+	}
+
+	SegmentMapCache maps(model, P0);
+	maps.TransverseOnly(true);
+	maps.UseTPSA(true);
+	maps.Build();
+	assert(maps.IsCurrent());
+	const int n = maps.size();
+	cout << "elements: " << n << endl;
+
+	// the orbit closes
+	for(int k = 0; k < 4; k++)
+	{
+		assert_close(maps.GetOrbit(n)[k], maps.GetOrbit(0)[k], 1e-13);
+	}
+
+	TransferMatrix tm(model, P0);
+	tm.UseTPSA(true);
+	RealMatrix M(6);
+	PSvector orbit = maps.GetOrbit(0);
+	tm.FindTM(M, orbit);
+	AssertMatrixClose(maps.OneTurnMap(), M, 1e-12);
+
+	const int spans[][2] = {{0, 0}, {3, 17}, {5, n - 1}, {11, 12}, {1, n - 2}};
+	for(size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++)
+	{
+		const int n1 = spans[s][0];
+		const int n2 = spans[s][1];
+		orbit = maps.GetOrbit(n1);
+		tm.FindTM(M, orbit, n1, n2);
+		AssertMatrixClose(maps.MapBetween(n1, n2), M, 1e-12);
+	}
+
+	// a map which wraps around the ring
+	RealMatrix M1(6), M2(6);
+	orbit = maps.GetOrbit(20);
+	tm.FindTM(M1, orbit, 20, n - 1);
+	orbit = maps.GetOrbit(0);
+	tm.FindTM(M2, orbit, 0, 4);
+	AssertMatrixClose(maps.MapBetween(20, 4), M2 * M1, 1e-12);
+
+	// element maps found by finite differences
+	SegmentMapCache mapsFD(model, P0);
+	mapsFD.TransverseOnly(true);
+	mapsFD.Build(maps.GetOrbit(0));
+	AssertMatrixClose(mapsFD.OneTurnMap(), maps.OneTurnMap(), 1e-4);
+
+	// maps about the design orbit, which the corrector at the end of the
+	// ring does not reach
+	SegmentMapCache axis(model, P0);
+	axis.TransverseOnly(true);
+	axis.UseTPSA(true);
+	axis.Build(PSvector(0));
+
+	// change one quadrupole directly, which the model generation does
+	// not see
+	qf->SetFieldStrength(0.021 * brho);
+	assert(!maps.IsCurrent());
+	assert(!axis.IsCurrent());
+
+	// on the design orbit only the quadrupole's map is found again
+	assert(axis.UpdateChanged());
+	assert(axis.IsCurrent());
+	orbit = PSvector(0);
+	tm.FindTM(M, orbit, 0, n - 1);
+	AssertMatrixClose(axis.OneTurnMap(), M, 1e-12);
+
+	// on the closed orbit the orbit downstream moves; the maps downstream
+	// are still about the old orbit, so only the maps up to the quadrupole
+	// are compared
+	assert(!maps.Update(nqf));
+	assert(!maps.IsCurrent());
+	assert(!maps.UpdateChanged());
+	orbit = maps.GetOrbit(0);
+	tm.FindTM(M, orbit, 0, nqf);
+	AssertMatrixClose(maps.MapBetween(0, nqf), M, 1e-12);
+	orbit = maps.GetOrbit(nqf);
+	tm.FindTM(M, orbit, nqf, nqf);
+	AssertMatrixClose(maps.MapBetween(nqf, nqf), M, 1e-12);
+	maps.Build();
+	assert(maps.IsCurrent());
+
+	// the corrector moves the trajectory
+	xcor->SetFieldStrength(3e-5 * brho);
+	assert(!axis.UpdateChanged());
+	assert(!axis.IsCurrent());
+
+	// PhaseAdvance finds the maps again after a direct change
+	PhaseAdvance pa(model, nullptr, P0);
+	const RealMatrix before = pa.TransferMapBetween(0, 30);
+	qf->SetFieldStrength(0.019 * brho);
+	const RealMatrix after = pa.TransferMapBetween(0, 30);
+	PhaseAdvance fresh(model, nullptr, P0);
+	AssertMatrixClose(after, fresh.TransferMapBetween(0, 30), 1e-12);
+	assert(fabs(after(0, 0) - before(0, 0)) > 1e-3);
+
+	delete model;
+	return 0;
+}
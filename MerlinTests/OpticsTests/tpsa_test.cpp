@@ -0,0 +1,177 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ */
+
+#include "../tests.h"
+
+#include <iostream>
+
+#include "AcceleratorModelConstructor.h"
+#include "Components.h"
+#include "PhysicalUnits.h"
+#include "PhysicalConstants.h"
+#include "ParticleTracker.h"
+#include "CompiledLattice.h"
+#include "ClosedOrbit.h"
+#include "TransferMatrix.h"
+#include "TPSA.h"
+
+/*
+ * Check the TPSA arithmetic, and that the closed orbit and one-turn
+ * matrices found from a single TPSA pass through a small ring agree
+ * with those found by tracking displaced particles.
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace PhysicalConstants;
+using namespace ParticleTracking;
+
+namespace
+{
+
+template<int N>
+void AssertSeriesClose(const TPSA<N>& a, const TPSA<N>& b)
+{
+	int e[6] = {0, 0, 0, 0, 0, 0};
+	for(int i = 0; i < 6; i++)
+	{
+		for(int j = 0; j < 6; j++)
+		{
+			e[i]++;
+			e[j]++;
+			assert_close(a.Coefficient(e), b.Coefficient(e), 1e-12);
+			e[i]--;
+			e[j]--;
+		}
+		assert_close(a.Derivative(i), b.Derivative(i), 1e-12);
+	}
+	assert_close(a.Value(), b.Value(), 1e-12);
+}
+
+} // end anonymous namespace
+
+int main()
+{
+	// identities of the elementary functions, to third order
+	TPSA<3> a = TPSA<3>::Variable(0, 0.7) + 0.5 * TPSA<3>::Variable(2, 0) - TPSA<3>::Variable(5, 0) * TPSA<3>::Variable(0,
+		0);
+	AssertSeriesClose(sqrt(a) * sqrt(a), a);
+	AssertSeriesClose(sin(a) * sin(a) + cos(a) * cos(a), TPSA<3>(1));
+	AssertSeriesClose(cosh(a) * cosh(a) - sinh(a) * sinh(a), TPSA<3>(1));
+	AssertSeriesClose(exp(log(a)), a);
+	AssertSeriesClose((1.0 / a) * a, TPSA<3>(1));
+	assert_close(sin(a).Derivative(0, 0), -sin(0.7), 1e-12);
+	assert_close(sin(a).Derivative(0, 5), -cos(0.7), 1e-12);
+
+	// a ring of four FODO cells, with a sextupole and a steering error
+	const double P0 = 7000;
+	const double brho = P0 / eV / SpeedOfLight;
+	const double h = 0.001;
+
+	AcceleratorModelConstructor* ctor = new AcceleratorModelConstructor();
+	ctor->NewModel();
+	for(int cell = 0; cell < 4; cell++)
+	{
+		ctor->AppendComponent(*new Quadrupole("qf", 3.0 * meter, 0.02 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Sextupole("s", 0.5 * meter, 2.0 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new Quadrupole("qd", 3.0 * meter, -0.02 * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+		ctor->AppendComponent(*new SectorBend("b", 2.0 * meter, h, h * brho));
+		ctor->AppendComponent(*new Drift("d", 1.0 * meter));
+	}
+	ctor->AppendComponent(*new XCor("xcor", 0, 2e-5 * brho));
+	AcceleratorModel* model = ctor->GetModel();
+	delete ctor;
+
+	// a single pass of doubles agrees with a ParticleTracker
+	PSvector p(0);
+	p.x() = 1e-4;
+	p.yp() = -2e-5;
+	p.dp() = 1e-4;
+	ParticleTracker tracker(model->GetRing(), p, P0);
+	tracker.Run();
+	PSvector tracked = tracker.GetTrackedBunch().FirstParticle();
+
+	CompiledLattice lattice(model->GetRing());
+	double x[6];
+	for(int k = 0; k < 6; k++)
+	{
+		x[k] = p[k];
+	}
+	assert(lattice.TrackMap(x, P0));
+	for(int k = 0; k < 6; k++)
+	{
+		assert_close(x[k], tracked[k], 1e-15);
+	}
+
+	// closed orbit
+	PSvector orbitFD(0);
+	ClosedOrbit coFD(model, P0);
+	coFD.TransverseOnly(true);
+	coFD.FindClosedOrbit(orbitFD);
+
+	PSvector orbit(0);
+	ClosedOrbit co(model, P0);
+	co.TransverseOnly(true);
+	co.UseTPSA(true);
+	co.FindClosedOrbit(orbit);
+	cout << "closed orbit iterations: " << coFD.iter << " (finite differences) " << co.iter << " (TPSA)" << endl;
+
+	assert(fabs(orbit.x()) > 1e-6);
+	for(int k = 0; k < 4; k++)
+	{
+		assert_close(orbit[k], orbitFD[k], 1e-10);
+		x[k] = orbit[k];
+	}
+	x[4] = x[5] = 0;
+	lattice.TrackMap(x, P0);
+	for(int k = 0; k < 4; k++)
+	{
+		assert_close(x[k], orbit[k], 1e-13);
+	}
+
+	// one-turn matrix
+	RealMatrix MFD(6), M(6), dM(6);
+	TransferMatrix tmFD(model, P0);
+	tmFD.FindTM(MFD, orbit);
+	TransferMatrix tm(model, P0);
+	tm.UseTPSA(true);
+	tm.FindTM(M, orbit);
+	// the finite differences include the second order terms times delta,
+	// which are up to 2e4 * 1e-9 here
+	for(int i = 0; i < 6; i++)
+	{
+		for(int j = 0; j < 6; j++)
+		{
+			assert_close(M(i, j), MFD(i, j), 1e-4 * (1 + fabs(M(i, j))));
+		}
+	}
+
+	// chromatic derivative of the one-turn matrix
+	RealMatrix M2(6), Mp(6), Mm(6);
+	assert(tm.FindChromaticTM(M2, dM, orbit));
+	const double ddp = 1e-6;
+	PSvector op = orbit;
+	PSvector om = orbit;
+	op.dp() += ddp;
+	om.dp() -= ddp;
+	tm.FindTM(Mp, op);
+	tm.FindTM(Mm, om);
+	for(int i = 0; i < 6; i++)
+	{
+		for(int j = 0; j < 6; j++)
+		{
+			assert_close(M2(i, j), M(i, j), 1e-12 * (1 + fabs(M(i, j))));
+			assert_close(dM(i, j), (Mp(i, j) - Mm(i, j)) / (2 * ddp), 1e-5 * (1 + fabs(dM(i, j))));
+		}
+	}
+
+	delete model;
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "../tests.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Components.h"
+#include "CollimatorAperture.h"
+#include "AcceleratorModelConstructor.h"
+
+#include "ParticleTracker.h"
+#include "ParticleBunchTypes.h"
+
+#include "CollimateProtonProcess.h"
+#include "CollimationOutput.h"
+#include "ScatteringModelsMerlin.h"
+#include "MaterialDatabase.h"
+
+#include "PhysicalUnits.h"
+#include "ParallelFor.h"
+#include "RandomNG.h"
+
+/*
+ * Scatter a beam into a copper collimator jaw using counter-based random
+ * numbers, and check that the surviving particles and the losses passed
+ * to the CollimationOutput, in order, do not depend on the number of
+ * threads.
+ */
+
+using namespace std;
+using namespace PhysicalUnits;
+using namespace ParticleTracking;
+
+namespace
+{
+
+class RecordingOutput: public CollimationOutput
+{
+public:
+	void Dispose(AcceleratorComponent& currcomponent, double pos, Particle& particle, int turn = 0)
+	{
+		positions.push_back(pos);
+		particles.push_back(particle);
+	}
+
+	vector<double> positions;
+	vector<Particle> particles;
+};
+
+bool Same(const Particle& a, const Particle& b)
+{
+	return memcmp(&a, &b, sizeof(Particle)) == 0;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	const size_t npart = argc > 1 ? stoul(argv[1]) : 2000;
+	const int nturns = 3;
+	const double beam_energy = 7000.0;
+
+	RandomNG::init(1234);
+	RandomNG::setCounterBased(true);
+
+	MaterialDatabase mat;
+	AcceleratorModelConstructor construct;
+	construct.NewModel();
+	double length = 0.05;
+	Collimator* col = new Collimator("TestCollimator", length);
+	col->SetMaterial(mat.FindMaterial("Cu"));
+	CollimatorAperture* app = new CollimatorAperture(2, 2, 0, length, 0, 0);
+	app->SetExitWidth(app->GetFullEntranceWidth());
+	app->SetExitHeight(app->GetFullEntranceHeight());
+	col->SetAperture(app);
+	construct.AppendComponent(*col);
+	AcceleratorModel* model = construct.GetModel();
+
+	PSvectorArray input;
+	for(size_t i = 0; i < npart; i++)
+	{
+		Particle p(0);
+		p.id() = i;
+		p.x() = RandomNG::uniform(-1e-3, 1e-3);
+		p.y() = 1.0 + RandomNG::uniform(-1e-6, 2e-6);
+		p.yp() = RandomNG::normal(0, 1e-6);
+		input.push_back(p);
+	}
+
+	ScatteringModelMerlin scatter;
+
+	vector<Particle> survivors[2];
+	RecordingOutput outputs[2];
+	int threads[2] = {1, 4};
+
+	for(int run = 0; run < 2; run++)
+	{
+		Parallel::SetNumThreads(threads[run]);
+
+		PSvectorArray particles = input;
+		ProtonBunch bunch(beam_energy, 1, particles);
+		ParticleTracker tracker(model->GetRing(), &bunch);
+		CollimateProtonProcess* collimate = new CollimateProtonProcess(2, 4);
+		collimate->SetScatteringModel(&scatter);
+		collimate->ScatterAtCollimator(true);
+		collimate->SetLossThreshold(101.0);
+		collimate->SetOutputBinSize(0.01);
+		collimate->SetCollimationOutput(&outputs[run]);
+		tracker.AddProcess(collimate);
+
+		for(int turn = 0; turn < nturns; turn++)
+		{
+			tracker.Track(&bunch);
+		}
+		survivors[run].assign(bunch.begin(), bunch.end());
+		cout << threads[run] << " threads: " << survivors[run].size() << " survive, " << outputs[run].particles.size()
+			 << " lost" << endl;
+	}
+
+	assert(outputs[0].particles.size() > 0);
+	assert(survivors[0].size() > 0);
+
+	assert(survivors[0].size() == survivors[1].size());
+	for(size_t i = 0; i < survivors[0].size(); i++)
+	{
+		assert(Same(survivors[0][i], survivors[1][i]));
+	}
+
+	assert(outputs[0].particles.size() == outputs[1].particles.size());
+	for(size_t i = 0; i < outputs[0].particles.size(); i++)
+	{
+		assert(outputs[0].positions[i] == outputs[1].positions[i]);
+		assert(Same(outputs[0].particles[i], outputs[1].particles[i]));
+	}
+
+	delete model;
+	return 0;
+}
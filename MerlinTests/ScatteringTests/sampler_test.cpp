@@ -0,0 +1,181 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "../tests.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "TabulatedSampler.h"
+#include "Interpolation.h"
+#include "DiffractiveScatter.h"
+#include "RandomNG.h"
+
+/*
+ * Tests of the constant time samplers: the alias table reproduces its
+ * weights, the inverse CDF sampler agrees with the interpolation it
+ * replaces, and the diffractive sampler follows the marginal distributions
+ * of its cross section, found by integration, by a Kolmogorov-Smirnov test.
+ */
+
+using namespace std;
+using namespace ParticleTracking;
+
+namespace
+{
+
+/**
+ * @return The Kolmogorov-Smirnov statistic of a sample against a CDF
+ * tabulated at the increasing points x
+ */
+double KSDistance(vector<double> a, const vector<double>& x, const vector<double>& cdf)
+{
+	sort(a.begin(), a.end());
+	double d = 0;
+	for(size_t i = 0; i < a.size(); i++)
+	{
+		size_t j = upper_bound(x.begin(), x.end(), a[i]) - x.begin();
+		double f;
+		if(j == 0)
+		{
+			f = 0;
+		}
+		else if(j == x.size())
+		{
+			f = 1;
+		}
+		else
+		{
+			f = cdf[j - 1] + (cdf[j] - cdf[j - 1]) * (a[i] - x[j - 1]) / (x[j] - x[j - 1]);
+		}
+		d = max(d, max(fabs(double(i + 1) / a.size() - f), fabs(double(i) / a.size() - f)));
+	}
+	return d;
+}
+
+/**
+ * @return n + 1 points spaced logarithmically from lo to hi
+ */
+vector<double> LogGrid(double lo, double hi, size_t n)
+{
+	vector<double> x(n + 1);
+	for(size_t i = 0; i <= n; i++)
+	{
+		x[i] = lo * pow(hi / lo, double(i) / n);
+	}
+	x[n] = hi;
+	return x;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	RandomNG::init(314);
+
+	// Alias table frequencies
+	{
+		vector<double> w = {1, 0, 3, 0.5, 10, 0, 2.5};
+		double total = 17;
+		AliasSampler alias(w);
+		const size_t n = 1000000;
+		vector<size_t> count(w.size(), 0);
+		for(size_t k = 0; k < n; k++)
+		{
+			count[alias(RandomNG::uniform(0, 1))]++;
+		}
+		for(size_t i = 0; i < w.size(); i++)
+		{
+			double p = w[i] / total;
+			cout << i << " " << p << " " << double(count[i]) / n << endl;
+			assert_close(double(count[i]) / n, p, 5 * sqrt(p * (1 - p) / n) + 1e-12);
+			if(w[i] == 0)
+			{
+				assert(count[i] == 0);
+			}
+		}
+		assert(alias(0.0) < w.size());
+		assert(alias(1.0) < w.size());
+		assert_throws(AliasSampler(vector<double>(3, 0.0)), MerlinException);
+	}
+
+	// The inverse CDF sampler matches equally spaced interpolation
+	{
+		vector<double> x;
+		for(int i = 0; i <= 1000; i++)
+		{
+			x.push_back(pow(i / 1000.0, 3) + 0.01 * i);
+		}
+		InverseCDFSampler sampler(x);
+		Interpolation interp(x, 0, 1.0 / 1000);
+		for(int k = 0; k < 100000; k++)
+		{
+			double u = RandomNG::uniform(0, 1);
+			assert(sampler(u) == interp(u));
+		}
+		assert(sampler(0.0) == x.front());
+		assert_close(sampler(1.0), x.back(), 1e-12);
+	}
+
+	// The diffractive sampler follows its cross section
+	{
+		const double t_min = 0.0001, t_max = 4, xi_min = 0.0001, xi_max = 0.12;
+		ppDiffractiveScatter diffractive;
+		diffractive.SetTMin(t_min);
+		diffractive.SetTMax(t_max);
+		diffractive.SetXiMin(xi_min);
+		diffractive.SetXiMax(xi_max);
+		diffractive.GenerateDistribution(7000.0);
+
+		// marginal CDFs of t and xi, by the midpoint rule on a log grid
+		const size_t ng = 2000;
+		vector<double> tx = LogGrid(t_min, t_max, ng);
+		vector<double> xx = LogGrid(xi_min, xi_max, ng);
+		vector<double> tcdf(ng + 1, 0.0), xcdf(ng + 1, 0.0);
+		for(size_t i = 0; i < ng; i++)
+		{
+			const double tt = 0.5 * (tx[i] + tx[i + 1]);
+			for(size_t j = 0; j < ng; j++)
+			{
+				const double xi = 0.5 * (xx[j] + xx[j + 1]);
+				const double p = max(0.0, diffractive.DifferentialCrossSection(tt, xi)) * (tx[i + 1] - tx[i]) * (xx[j + 1]
+					- xx[j]);
+				tcdf[i + 1] += p;
+				xcdf[j + 1] += p;
+			}
+		}
+		for(size_t i = 0; i < ng; i++)
+		{
+			tcdf[i + 1] += tcdf[i];
+			xcdf[i + 1] += xcdf[i];
+		}
+		for(size_t i = 0; i <= ng; i++)
+		{
+			tcdf[i] /= tcdf[ng];
+			xcdf[i] /= xcdf[ng];
+		}
+
+		const size_t n = argc > 1 ? stoul(argv[1]) : 100000;
+		vector<double> t, xi;
+		for(size_t k = 0; k < n; k++)
+		{
+			pair<double, double> a = diffractive.Select();
+			t.push_back(a.first);
+			xi.push_back(a.second * a.second / diffractive.GetS());
+		}
+
+		// 0.1% critical value for a sample of size n
+		double critical = 1.95 / sqrt(double(n));
+		double dt = KSDistance(t, tx, tcdf);
+		double dx = KSDistance(xi, xx, xcdf);
+		cout << "KS distance t: " << dt << " xi: " << dx << " critical: " << critical << endl;
+		assert(dt < critical);
+		assert(dx < critical);
+	}
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Merlin++: C++ Class Library for Charged Particle Accelerator Simulations
+ * Copyright (c) 2001-2018 The Merlin++ developers
+ * This file is covered by the terms the GNU GPL version 2, or (at your option) any later version, see the file COPYING
+ * This file is derived from software bearing the copyright notice in merlin4_copyright.txt
+ */
+
+#include "../tests.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "TableCache.h"
+#include "ElasticScatter.h"
+#include "RandomNG.h"
+
+/*
+ * Tests of the on-disk table cache: entries round trip, a changed key or a
+ * damaged file is a miss, and an elastic scattering table read from the
+ * cache samples exactly as the generated one.
+ */
+
+using namespace std;
+using namespace ParticleTracking;
+
+namespace
+{
+
+vector<double> SampleElastic(size_t n)
+{
+	ppElasticScatter elastic;
+	elastic.SetTMin(1e-4);
+	elastic.SetTMax(1.0);
+	elastic.SetStepSize(1e-3);
+	elastic.GenerateTDistribution(7000.0);
+
+	RandomNG::reset(99);
+	vector<double> t;
+	for(size_t i = 0; i < n; i++)
+	{
+		t.push_back(elastic.SelectT());
+	}
+	t.push_back(elastic.GetElasticCrossSection());
+	t.push_back(elastic.GetElasticCrossSectionN());
+	return t;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	char dir[] = "/tmp/merlin_table_cache_XXXXXX";
+	assert(mkdtemp(dir) != nullptr);
+
+	vector<double> key = {1, 7000.0, 0.5};
+	vector<vector<double> > tables = {{1.5, -2.0}, {}, {3.0, 4.0, 5.0}};
+	vector<vector<double> > loaded;
+
+	// Disabled until a directory is set
+	assert(!TableCache::Enabled());
+	assert(!TableCache::Store("test", key, tables));
+	assert(!TableCache::Load("test", key, loaded));
+
+	TableCache::SetDirectory(dir);
+	assert(!TableCache::Load("test", key, loaded));
+	assert(TableCache::Store("test", key, tables));
+	assert(TableCache::Load("test", key, loaded));
+	assert(loaded == tables);
+
+	// Any change to the key misses
+	vector<double> other = key;
+	other[1] = 6500.0;
+	assert(!TableCache::Load("test", other, loaded));
+	other = key;
+	other.push_back(0);
+	assert(!TableCache::Load("test", other, loaded));
+
+	// A damaged file misses
+	{
+		fstream file(TableCache::FileName("test", key).c_str(), ios::in | ios::out | ios::binary);
+		file.seekp(-12, ios::end);
+		file.put(0x55);
+	}
+	assert(!TableCache::Load("test", key, loaded));
+	{
+		ofstream file(TableCache::FileName("test", key).c_str(), ios::binary);
+		file << "MRLNTBL";
+	}
+	assert(!TableCache::Load("test", key, loaded));
+
+	// Generated and cached elastic tables give the same draws
+	RandomNG::init(1);
+	vector<double> generated = SampleElastic(10000);
+	vector<double> cached = SampleElastic(10000);
+	assert(generated == cached);
+
+	// Without a directory the table is generated again
+	TableCache::SetDirectory("");
+	assert(SampleElastic(10000) == generated);
+
+	string cmd = string("rm -rf ") + dir;
+	assert(system(cmd.c_str()) == 0);
+	return 0;
+}